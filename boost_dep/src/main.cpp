@@ -9,46 +9,731 @@
  */
 
 #include <cstddef>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <locale>
 #include <fstream>
+#include <sstream>
 #include <iostream>
 #include <iterator>
 #include <algorithm>
 #include <stdexcept>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/program_options.hpp>
+#include <boost/exception/exception.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <json.hpp>
+#include <json_shards.hpp>
 #include <dep_tree.hpp>
 #include <filesystem_scanner.hpp>
+#include <compile_commands.hpp>
+#include <parse_cache.hpp>
+#include <filesystem_ext.hpp>
+#include <compressed_stream.hpp>
+#include <library_graph.hpp>
+#include <node_attributes.hpp>
+#include <build_levels.hpp>
+#include <graph_algorithms.hpp>
+#include <pch_advisor.hpp>
+#include <dependency_breakers.hpp>
+#include <file_extractor.hpp>
+#include <library_packager.hpp>
+#include <source_pack.hpp>
+#include <git_index.hpp>
+#include <git_history.hpp>
+#include <cxx_parser.hpp>
+#include <trace.hpp>
 
 namespace po = boost::program_options;
 
+namespace {
+
+//! Output parameters
+struct output_params
+{
+    std::string format;
+    std::string weight;
+    bool reduce;
+    unsigned int thread_count;
+    boost::filesystem::path boost_root;
+    //! The directory to write the JSON output to, one file per library. If empty, the output is written to one file.
+    boost::filesystem::path shards_dir;
+    //! Shard file name suffix
+    std::string shard_suffix;
+    //! The translation units for the precompiled header recommendation
+    std::vector< dep_node* > translation_units;
+    pch_params pch;
+};
+
+//! Batch mode target
+struct scan_target
+{
+    //! The directory to scan
+    boost::filesystem::path dir;
+    //! The output file name
+    std::string output;
+};
+
+//! Output file, which is compressed if the name ends with .gz or .zst. If the file name is empty, the output is written to stdout.
+class output_file
+{
+private:
+    std::ofstream m_file;
+    boost::scoped_ptr< compressed_ofstream > m_compressed_file;
+    std::ostream* m_output;
+
+public:
+    explicit output_file(std::string const& fname) : m_output(&std::cout)
+    {
+        if (!fname.empty())
+        {
+            compression_format compression = compression_from_file_name(fname);
+            if (compression != no_compression)
+            {
+                // The output is compressed in a separate thread while it is being produced
+                m_compressed_file.reset(new compressed_ofstream(fname, compression));
+                m_output = m_compressed_file.get();
+            }
+            else
+            {
+                m_file.open(fname.c_str(), std::ios::out | std::ios::trunc);
+                if (!m_file.is_open())
+                    BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open output file: " + fname));
+                m_output = &m_file;
+            }
+        }
+    }
+
+    std::ostream& stream() { return *m_output; }
+
+    //! Finishes writing the file
+    void close()
+    {
+        if (m_compressed_file)
+            m_compressed_file->close();
+    }
+};
+
+//! Writes the tree to the output file or to stdout if the file name is empty
+void write_output(dep_tree& root, std::string const& out_fname, output_params const& params)
+{
+    trace_span span("output", "write_output", out_fname);
+    if ((params.format == "json" || params.format == "compact") && params.reduce)
+    {
+        trace_span reduce_span("output", "reduce_dependencies");
+        reduce_dependencies(root, params.thread_count);
+    }
+
+    if (params.format == "json" && !params.shards_dir.empty())
+    {
+        write_json_shards(root, params.shards_dir, params.shard_suffix, params.thread_count);
+        return;
+    }
+
+    output_file file(out_fname);
+    std::ostream* output = &file.stream();
+
+    if (params.format == "json")
+    {
+        serialize_json(root, *output, true, true, "\t", params.thread_count);
+    }
+    else if (params.format == "compact")
+    {
+        serialize_compact_json(root, *output);
+    }
+    else if (params.format == "levels")
+    {
+        library_graph graph;
+        build_library_graph(root, graph);
+        if (params.reduce)
+            reduce_library_dependencies(graph, params.thread_count);
+
+        std::vector< boost::uintmax_t > weights;
+        if (params.weight == "bytes")
+            weights = compute_library_sizes(graph, params.boost_root);
+
+        build_levels levels;
+        compute_build_levels(graph, weights, levels);
+        serialize_build_levels_json(graph, levels, *output);
+    }
+    else if (params.format == "pch")
+    {
+        pch_recommendation recommendation;
+        recommend_pch(params.translation_units, params.pch, recommendation);
+        serialize_pch_recommendation_json(recommendation, *output);
+    }
+    else if (params.format == "breakers")
+    {
+        library_graph graph;
+        build_library_graph(root, graph);
+
+        dependency_breakers breakers;
+        find_dependency_breakers(graph, params.boost_root, breakers, params.thread_count);
+        serialize_dependency_breakers_json(graph, breakers, *output);
+    }
+
+    file.close();
+}
+
+/*!
+ * Reads the batch manifest. Every line of the manifest contains a directory to scan and the output file name, separated with
+ * whitespace. Relative paths are relative to the manifest location. Empty lines and lines starting with '#' are ignored.
+ */
+void read_manifest(boost::filesystem::path const& manifest, std::vector< scan_target >& targets)
+{
+    std::string manifest_str = manifest.string();
+    std::ifstream file(manifest_str.c_str());
+    if (!file.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open manifest file: " + manifest_str));
+
+    boost::filesystem::path base_dir = boost::filesystem::absolute(manifest).parent_path();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream strm(line);
+        std::string dir, output;
+        if (!(strm >> dir) || dir[0] == '#')
+            continue;
+        if (!(strm >> output))
+            BOOST_THROW_EXCEPTION(std::runtime_error("No output file specified for " + dir + " in manifest file: " + manifest_str));
+
+        scan_target target;
+        target.dir = boost::filesystem::absolute(dir, base_dir);
+        target.output = boost::filesystem::absolute(output, base_dir).string();
+        targets.push_back(target);
+    }
+}
+
+//! Finds the header in the current directory or in the include directories. Returns the path with all symlinks resolved.
+boost::filesystem::path find_header(std::string const& header, std::vector< boost::filesystem::path > const& include_dirs)
+{
+    boost::filesystem::path path = boost::filesystem::system_complete(header);
+    if (boost::filesystem::is_regular_file(path))
+        return boost::filesystem::canonical(path);
+
+    for (std::vector< boost::filesystem::path >::const_iterator it = include_dirs.begin(), end = include_dirs.end(); it != end; ++it)
+    {
+        path = *it / header;
+        if (boost::filesystem::is_regular_file(path))
+            return boost::filesystem::canonical(path);
+    }
+
+    BOOST_THROW_EXCEPTION(std::invalid_argument("Header not found: " + header));
+}
+
+//! The extract command: creates the files needed by the headers in the target directory
+int extract_command(int argc, char* argv[])
+{
+    po::options_description options("boost-dep extract options");
+    options.add_options()
+        ("help", "produce this help message")
+        ("jobs,j", po::value< unsigned int >()->default_value(0u), "number of threads to use (0 - detect automatically)")
+        ("to", po::value< std::string >(), "directory to create the files in")
+        ("header", po::value< std::vector< std::string > >()->composing(), "header to extract with its dependencies, relative to the current directory or the include directories")
+        ("include,I", po::value< std::vector< std::string > >()->composing(), "directories to search included headers in")
+        ("boost-root", po::value< std::string >(), "Boost root directory")
+        ("parse-cache", po::value< std::string >(), "file to cache parsing results in, shared between runs")
+        ("method", po::value< std::string >()->default_value("link"), "the way to create the files: link (hardlinks, by default), clone (reflinks, which don't share modifications with the original files) or copy; the files are copied if hardlinks or reflinks are not supported")
+        ("keep-layout", "keep the modular Boost layout of the files instead of merging the include directories of the libraries");
+
+    po::positional_options_description positional_options;
+    positional_options.add("header", -1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional_options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << "Usage: boost-dep extract --to DIR [options] header...\n\n" << options << std::endl;
+        return 0;
+    }
+
+    const po::variable_value* arg = &vm["to"];
+    if (arg->empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Target directory must be specified"));
+
+    extract_params ext_params;
+    ext_params.target_dir = boost::filesystem::system_complete(arg->as< std::string >());
+    ext_params.thread_count = vm["jobs"].as< unsigned int >();
+    ext_params.merge_include_dirs = vm.count("keep-layout") == 0;
+
+    std::string method = vm["method"].as< std::string >();
+    if (method == "link")
+        ext_params.method = extract_link;
+    else if (method == "clone")
+        ext_params.method = extract_clone;
+    else if (method == "copy")
+        ext_params.method = extract_copy;
+    else
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported extraction method: " + method));
+
+    arg = &vm["boost-root"];
+    ext_params.boost_root = arg->empty() ? find_boost_root() : boost::filesystem::system_complete(arg->as< std::string >());
+
+    scan_params params = scan_params::typical(ext_params.boost_root);
+    arg = &vm["include"];
+    if (!arg->empty())
+    {
+        std::vector< std::string > includes = arg->as< std::vector< std::string > >();
+        std::vector< boost::filesystem::path > include_dirs;
+        std::copy(includes.begin(), includes.end(), std::back_inserter(include_dirs));
+        include_dirs.insert(include_dirs.end(), params.include_dirs.begin(), params.include_dirs.end());
+        params.include_dirs.swap(include_dirs);
+    }
+
+    arg = &vm["header"];
+    if (arg->empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("No headers to extract specified"));
+
+    std::vector< scan_entry > entries;
+    std::vector< std::string > headers = arg->as< std::vector< std::string > >();
+    for (std::vector< std::string >::const_iterator it = headers.begin(), end = headers.end(); it != end; ++it)
+    {
+        boost::filesystem::path path = find_header(*it, params.include_dirs);
+        if (!is_descendant(ext_params.boost_root, path))
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Header is not within Boost root: " + *it));
+        entries.push_back(scan_entry(path));
+    }
+
+    parse_cache cache;
+    boost::filesystem::path cache_file;
+    arg = &vm["parse-cache"];
+    if (!arg->empty())
+    {
+        cache_file = arg->as< std::string >();
+        cache.load(cache_file);
+        params.cache = &cache;
+    }
+
+    // Only the files reachable from the headers are parsed
+    dep_tree root;
+    std::vector< dep_node* > entry_nodes;
+    scan_entry_points(entries, params, root, &entry_nodes);
+
+    if (params.cache && cache.is_modified())
+        cache.save(cache_file);
+
+    std::vector< dep_node const* > closure;
+    collect_dependency_closure(entry_nodes, closure);
+
+    extract_stats stats;
+    extract_files(closure, root, ext_params, stats);
+
+    std::cout << "Extracted " << (stats.linked_files + stats.cloned_files + stats.copied_files) << " files: " << stats.linked_files << " hardlinked, "
+        << stats.cloned_files << " cloned, " << stats.copied_files << " copied (" << stats.copied_bytes << " bytes)" << std::endl;
+
+    return 0;
+}
+
+//! Parses the shard specification in the form "i/N"
+void parse_shard(std::string const& shard, scan_params& params)
+{
+    std::istringstream strm(shard);
+    unsigned int index = 0u, count = 0u;
+    char separator = 0;
+    if (!(strm >> index >> separator >> count) || separator != '/' || strm.get() != std::istringstream::traits_type::eof() || count == 0u || index >= count)
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Incorrect shard specified, must be i/N with i < N: " + shard));
+
+    params.shard_index = index;
+    params.shard_count = count;
+}
+
+//! Reads the tree from a JSON file or from a directory of JSON shards
+void read_input(boost::filesystem::path const& input, dep_tree& root)
+{
+    trace_span span("parse", "read_input", input);
+    if (boost::filesystem::is_directory(input))
+    {
+        sharded_dep_tree shards(input);
+        shards.load_all();
+        merge(root, shards.get_tree());
+        return;
+    }
+
+    try
+    {
+        decompressing_ifstream file(input);
+        parse_json(file, root);
+    }
+    catch (boost::exception& e)
+    {
+        e << file_name_info(input.string());
+        throw;
+    }
+}
+
+//! The merge command: merges the trees of multiple scans, e.g. of the shards scanned with --shard
+int merge_command(int argc, char* argv[])
+{
+    po::options_description options("boost-dep merge options");
+    options.add_options()
+        ("help", "produce this help message")
+        ("jobs,j", po::value< unsigned int >()->default_value(0u), "number of threads to use (0 - detect automatically)")
+        ("input", po::value< std::vector< std::string > >()->composing(), "json or compact json file or shards directory to merge, compressed if the name ends with .gz or .zst")
+        ("output,o", po::value< std::string >(), "output file (stdout by default), compressed if the name ends with .gz or .zst")
+        ("output-suffix", po::value< std::string >()->default_value(".json"), "output file name suffix in the shards directory")
+        ("shards", po::value< std::string >(), "directory to write the json output to, one file per library, with an index file that maps node paths to the files")
+        ("compact", "write the output in the compact format, with a node table and node indices for dependencies")
+        ("reduce", "write only the dependencies that are not implied by other dependencies (transitive reduction)");
+
+    po::positional_options_description positional_options;
+    positional_options.add("input", -1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional_options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << "Usage: boost-dep merge [options] input...\n\n" << options << std::endl;
+        return 0;
+    }
+
+    const po::variable_value* arg = &vm["input"];
+    if (arg->empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("No inputs to merge specified"));
+    std::vector< std::string > inputs = arg->as< std::vector< std::string > >();
+
+    output_params out_params;
+    out_params.format = vm.count("compact") ? "compact" : "json";
+    out_params.thread_count = vm["jobs"].as< unsigned int >();
+    out_params.reduce = vm.count("reduce") > 0;
+
+    std::string out_fname;
+    arg = &vm["output"];
+    if (!arg->empty())
+        out_fname = arg->as< std::string >();
+
+    arg = &vm["shards"];
+    if (!arg->empty())
+    {
+        if (!out_fname.empty())
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Sharded output cannot be combined with output files"));
+        if (out_params.format != "json")
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Sharded output is only supported for the json format"));
+        out_params.shards_dir = boost::filesystem::system_complete(arg->as< std::string >());
+        out_params.shard_suffix = vm["output-suffix"].as< std::string >();
+    }
+
+    // The first input is read into the resulting tree, the others are read separately and merged into it
+    dep_tree root;
+    read_input(inputs.front(), root);
+    for (std::vector< std::string >::const_iterator it = inputs.begin() + 1, end = inputs.end(); it != end; ++it)
+    {
+        dep_tree input_root;
+        read_input(*it, input_root);
+
+        trace_span span("merge", "merge", *it);
+        merge(root, input_root);
+    }
+
+    write_output(root, out_fname, out_params);
+
+    return 0;
+}
+
+//! The history command: reports the library dependencies added and removed by every commit in a range
+int history_command(int argc, char* argv[])
+{
+    po::options_description options("boost-dep history options");
+    options.add_options()
+        ("help", "produce this help message")
+        ("range", po::value< std::string >()->default_value("HEAD"), "commit range: FROM..TO reports the first parent history after FROM up to TO, TO reports the history up to TO from the root commit")
+        ("repository,C", po::value< std::string >(), "git working tree or git directory (the current directory by default)")
+        ("max-count,n", po::value< std::size_t >()->default_value(0u), "report only this number of the latest commits (0 - no limit)")
+        ("no-submodules", "don't scan the files of submodules")
+        ("parse-cache", po::value< std::string >(), "file to cache parsing results in, shared between runs")
+        ("output,o", po::value< std::string >(), "output file (stdout by default), compressed if the name ends with .gz or .zst");
+
+    po::positional_options_description positional_options;
+    positional_options.add("range", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional_options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << "Usage: boost-dep history [options] [range]\n\n" << options << std::endl;
+        return 0;
+    }
+
+    history_params params;
+    params.cxx_wildcards = default_cxx_wildcards();
+    params.max_count = vm["max-count"].as< std::size_t >();
+    params.follow_submodules = vm.count("no-submodules") == 0;
+
+    std::string range = vm["range"].as< std::string >();
+    std::string::size_type pos = range.find("..");
+    if (pos != std::string::npos)
+    {
+        params.from = range.substr(0, pos);
+        params.to = range.substr(pos + 2u);
+    }
+    else
+    {
+        params.to = range;
+    }
+    if (params.to.empty())
+        params.to = "HEAD";
+
+    // Either a working tree, which may be a subdirectory, or a bare git directory
+    const po::variable_value* arg = &vm["repository"];
+    boost::filesystem::path repository = arg->empty() ? boost::filesystem::current_path() : boost::filesystem::system_complete(arg->as< std::string >());
+    if (boost::filesystem::is_directory(repository / "objects") && boost::filesystem::is_regular_file(repository / "HEAD"))
+    {
+        params.git_dir = repository;
+    }
+    else
+    {
+        boost::filesystem::path worktree = find_git_worktree(repository);
+        if (worktree.empty())
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Directory is not in a git repository: " + repository.string()));
+        params.git_dir = find_git_dir(worktree);
+    }
+
+    parse_cache cache;
+    boost::filesystem::path cache_file;
+    arg = &vm["parse-cache"];
+    if (!arg->empty())
+    {
+        cache_file = arg->as< std::string >();
+        cache.load(cache_file);
+        params.cache = &cache;
+    }
+
+    std::vector< history_commit > commits;
+    history_stats stats;
+    scan_history(params, commits, &stats);
+
+    if (params.cache && cache.is_modified())
+        cache.save(cache_file);
+
+    std::string out_fname;
+    arg = &vm["output"];
+    if (!arg->empty())
+        out_fname = arg->as< std::string >();
+
+    output_file file(out_fname);
+    serialize_history_json(commits, file.stream());
+    file.close();
+
+    if (stats.missing_submodule_commits > 0u)
+        std::cerr << "Warning: " << stats.missing_submodule_commits << " submodule commits were not found and were scanned as empty directories" << std::endl;
+
+    return 0;
+}
+
+//! The package command: creates an archive and a manifest for every library
+int package_command(int argc, char* argv[])
+{
+    po::options_description options("boost-dep package options");
+    options.add_options()
+        ("help", "produce this help message")
+        ("jobs,j", po::value< unsigned int >()->default_value(0u), "number of threads to use (0 - detect automatically)")
+        ("to", po::value< std::string >(), "directory to create the packages in")
+        ("input", po::value< std::vector< std::string > >()->composing(), "json file or shards directory with the scanned tree, compressed if the name ends with .gz or .zst; Boost root is scanned if not specified")
+        ("boost-root", po::value< std::string >(), "Boost root directory")
+        ("parse-cache", po::value< std::string >(), "file to cache parsing results in, shared between runs")
+        ("compression", po::value< std::string >()->default_value("none"), "archive compression: none (by default), gzip or zstd")
+        ("reduce", "list only the library dependencies that are not implied by other dependencies (transitive reduction)");
+
+    po::positional_options_description positional_options;
+    positional_options.add("input", -1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).positional(positional_options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << "Usage: boost-dep package --to DIR [options] [input...]\n\n" << options << std::endl;
+        return 0;
+    }
+
+    const po::variable_value* arg = &vm["to"];
+    if (arg->empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Target directory must be specified"));
+
+    package_params pkg_params;
+    pkg_params.target_dir = boost::filesystem::system_complete(arg->as< std::string >());
+    pkg_params.thread_count = vm["jobs"].as< unsigned int >();
+
+    std::string compression = vm["compression"].as< std::string >();
+    if (compression == "none")
+        pkg_params.compression = no_compression;
+    else if (compression == "gzip")
+        pkg_params.compression = gzip_compression;
+    else if (compression == "zstd")
+        pkg_params.compression = zstd_compression;
+    else
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported compression: " + compression));
+
+    arg = &vm["boost-root"];
+    pkg_params.boost_root = arg->empty() ? find_boost_root() : boost::filesystem::system_complete(arg->as< std::string >());
+
+    dep_tree root;
+    arg = &vm["input"];
+    if (!arg->empty())
+    {
+        std::vector< std::string > inputs = arg->as< std::vector< std::string > >();
+        read_input(inputs.front(), root);
+        for (std::vector< std::string >::const_iterator it = inputs.begin() + 1, end = inputs.end(); it != end; ++it)
+        {
+            dep_tree input_root;
+            read_input(*it, input_root);
+            merge(root, input_root);
+        }
+    }
+    else
+    {
+        scan_params params = scan_params::typical(pkg_params.boost_root);
+
+        parse_cache cache;
+        boost::filesystem::path cache_file;
+        arg = &vm["parse-cache"];
+        if (!arg->empty())
+        {
+            cache_file = arg->as< std::string >();
+            cache.load(cache_file);
+            params.cache = &cache;
+        }
+
+        scan_filesystem_tree(pkg_params.boost_root, params, root);
+
+        if (params.cache && cache.is_modified())
+            cache.save(cache_file);
+    }
+
+    library_graph graph;
+    build_library_graph(root, graph);
+    if (vm.count("reduce"))
+        reduce_library_dependencies(graph, pkg_params.thread_count);
+
+    package_stats stats;
+    package_libraries(graph, pkg_params, stats);
+
+    std::cout << "Packaged " << stats.libraries << " libraries: " << stats.files << " files (" << stats.bytes << " bytes, "
+        << stats.sent_bytes << " bytes copied by the kernel)" << std::endl;
+
+    return 0;
+}
+
+//! The pack command: stores the source tree in a single file, which can be scanned instead of the tree
+int pack_command(int argc, char* argv[])
+{
+    po::options_description options("boost-dep pack options");
+    options.add_options()
+        ("help", "produce this help message")
+        ("to", po::value< std::string >(), "source pack file to create")
+        ("boost-root", po::value< std::string >(), "Boost root directory")
+        ("prune", po::value< std::vector< std::string > >()->composing(), "don't pack the directories and files matching the pattern relative to Boost root, at any depth; patterns starting with '!' exclude the matching paths from pruning, the last matching pattern wins")
+        ("prune-file", po::value< std::vector< std::string > >()->composing(), "file with the prune patterns, one per line; the patterns from the files are applied before the ones from the command line");
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << "Usage: boost-dep pack --to FILE [options]\n\n" << options << std::endl;
+        return 0;
+    }
+
+    const po::variable_value* arg = &vm["to"];
+    if (arg->empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Source pack file must be specified"));
+    boost::filesystem::path pack_file = boost::filesystem::system_complete(arg->as< std::string >());
+
+    source_pack_params params;
+    arg = &vm["boost-root"];
+    params.boost_root = arg->empty() ? find_boost_root() : boost::filesystem::system_complete(arg->as< std::string >());
+    params.boost_root = normalize_path(params.boost_root);
+
+    arg = &vm["prune-file"];
+    if (!arg->empty())
+    {
+        std::vector< std::string > files = arg->as< std::vector< std::string > >();
+        for (std::vector< std::string >::const_iterator it = files.begin(), end = files.end(); it != end; ++it)
+            params.prune.load(*it);
+    }
+
+    arg = &vm["prune"];
+    if (!arg->empty())
+    {
+        std::vector< std::string > rules = arg->as< std::vector< std::string > >();
+        for (std::vector< std::string >::const_iterator it = rules.begin(), end = rules.end(); it != end; ++it)
+            params.prune.add_rule(*it);
+    }
+
+    source_pack_stats stats;
+    create_source_pack(params, pack_file, stats);
+
+    std::cout << "Packed " << stats.directories << " directories, " << stats.files << " files and " << stats.symlinks << " symlinks: "
+        << stats.content_bytes << " bytes of file contents, " << stats.pack_bytes << " bytes in total" << std::endl;
+
+    return 0;
+}
+
+} // namespace
+
 int main(int argc, char* argv[])
 {
     try
     {
         std::locale::global(std::locale::classic());
 
+        // Commands are selected by the first argument, scanning is the default
+        if (argc > 1 && std::strcmp(argv[1], "extract") == 0)
+            return extract_command(argc - 1, argv + 1);
+        if (argc > 1 && std::strcmp(argv[1], "merge") == 0)
+            return merge_command(argc - 1, argv + 1);
+        if (argc > 1 && std::strcmp(argv[1], "history") == 0)
+            return history_command(argc - 1, argv + 1);
+        if (argc > 1 && std::strcmp(argv[1], "package") == 0)
+            return package_command(argc - 1, argv + 1);
+        if (argc > 1 && std::strcmp(argv[1], "pack") == 0)
+            return pack_command(argc - 1, argv + 1);
+
         // Command line parameters definition
         po::options_description general_options("General options");
         general_options.add_options()
-            ("help", "produce this help message");
+            ("help", "produce this help message")
+            ("jobs,j", po::value< unsigned int >()->default_value(0u), "number of threads to use (0 - detect automatically)");
 
         po::options_description input_options("Input options");
         input_options.add_options()
-            ("scan-dir,s", po::value< std::string >(), "directory to scan")
+            ("scan-dir,s", po::value< std::vector< std::string > >()->composing(), "directory to scan; multiple directories are scanned in one session and written to separate files in the output directory, with the node paths relative to Boost root instead of the scanned directory")
+            ("manifest", po::value< std::string >(), "file with the list of directories to scan in one session and the output files for them, one pair per line; the node paths are relative to Boost root, like for multiple scanned directories")
+            ("entry,e", po::value< std::vector< std::string > >()->composing(), "scan only the files reachable from this file through includes")
+            ("compile-commands,p", po::value< std::string >(), "scan only the files reachable from the translation units in this compilation database")
             ("include,I", po::value< std::vector< std::string > >()->composing(), "directories to search included headers in")
-            ("boost-root", po::value< std::string >(), "Boost root directory");
+            ("boost-root", po::value< std::string >(), "Boost root directory")
+            ("parse-cache", po::value< std::string >(), "file to cache parsing results in, shared between runs")
+            ("pack", po::value< std::string >(), "source pack created with the pack command to scan instead of the filesystem; the pack is mounted at Boost root, which is the directory the pack was created from by default")
+            ("prune", po::value< std::vector< std::string > >()->composing(), "don't scan the directories and files matching the pattern relative to Boost root, at any depth, e.g. libs/*/test/**; patterns starting with '!' exclude the matching paths from pruning, the last matching pattern wins")
+            ("prune-file", po::value< std::vector< std::string > >()->composing(), "file with the prune patterns, one per line; the patterns from the files are applied before the ones from the command line")
+            ("git-index", po::value< std::string >()->implicit_value("verify"), "read the list of files from the git index instead of walking the directories: verify (check the files for modifications, by default) or trust (assume the files are not modified)")
+            ("shard", po::value< std::string >(), "scan only the shard i of N (i/N) of the files, partitioned by path; the outputs of all shards are combined with the merge command");
 
         po::options_description output_options("Output options");
         output_options.add_options()
-            ("output,o", po::value< std::string >(), "output file (stdout by default)")
-            ("format,f", po::value< std::string >()->default_value("json"), "output format (json by default)");
+            ("output,o", po::value< std::string >(), "output file (stdout by default), compressed if the name ends with .gz or .zst")
+            ("output-dir", po::value< std::string >(), "output directory for multiple scanned directories; the output file names are the directory paths relative to Boost root")
+            ("output-suffix", po::value< std::string >()->default_value(".json"), "output file name suffix in the output directory or the shards directory")
+            ("shards", po::value< std::string >(), "directory to write the json output to, one file per library, with an index file that maps node paths to the files")
+            ("format,f", po::value< std::string >()->default_value("json"), "output format: json (header dependency tree, by default), compact (header dependency tree with a node table and node indices for dependencies), levels (library build levels), pch (precompiled header recommendation for the entry files) or breakers (includes between libraries, ranked by how much of the dependency closure their removal would remove)")
+            ("attributes", "write the file attributes collected on scanning: size, modification time, line count, content hash, library and parse time")
+            ("reduce", "write only the dependencies that are not implied by other dependencies (transitive reduction)")
+            ("pch-budget", po::value< boost::uintmax_t >()->default_value(16u * 1024u * 1024u), "maximum total size of the headers in the recommended precompiled header, in bytes")
+            ("weight", po::value< std::string >()->default_value("count"), "library weight for the critical path in the levels format: count (every library weighs 1, by default) or bytes (total size of the library files)")
+            ("trace", po::value< std::string >(), "file to write the timeline of the processing stages to, in Chrome trace event format; compressed if the name ends with .gz or .zst");
 
         po::options_description options("boost-dep options");
         options.add(general_options).add(input_options).add(output_options);
@@ -63,20 +748,36 @@ int main(int argc, char* argv[])
         // Command line arguments processing
         if (vm.count("help"))
         {
-            std::cout << options << std::endl;
+            std::cout << "Usage: boost-dep [options] [scan-dir...]\n       boost-dep extract --to DIR [options] header...\n       boost-dep merge [options] input...\n       boost-dep history [options] [range]\n       boost-dep package --to DIR [options] [input...]\n       boost-dep pack --to FILE [options]\n\n" << options << std::endl;
             return 0;
         }
 
-        boost::filesystem::path scan_dir;
-        const po::variable_value* arg = &vm["scan-dir"];
+        std::string trace_fname;
+        const po::variable_value* arg = &vm["trace"];
         if (!arg->empty())
         {
-            scan_dir = arg->as< std::string >();
-            scan_dir = boost::filesystem::system_complete(scan_dir);
+            trace_fname = arg->as< std::string >();
+            enable_tracing();
+            set_trace_thread_name("main");
         }
-        else
+
+        std::vector< boost::filesystem::path > scan_dirs;
+        arg = &vm["scan-dir"];
+        if (!arg->empty())
         {
-            scan_dir = boost::filesystem::current_path();
+            std::vector< std::string > dirs = arg->as< std::vector< std::string > >();
+            for (std::vector< std::string >::const_iterator it = dirs.begin(), end = dirs.end(); it != end; ++it)
+                scan_dirs.push_back(boost::filesystem::system_complete(*it));
+        }
+
+        // The source pack must outlive scanning
+        boost::scoped_ptr< source_pack > pack;
+        arg = &vm["pack"];
+        if (!arg->empty())
+        {
+            if (vm.count("git-index"))
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Scanning a source pack cannot be combined with the git index"));
+            pack.reset(new source_pack(arg->as< std::string >()));
         }
 
         boost::filesystem::path boost_root;
@@ -85,6 +786,12 @@ int main(int argc, char* argv[])
         {
             boost_root = arg->as< std::string >();
             boost_root = boost::filesystem::system_complete(boost_root);
+            if (pack)
+                pack->mount(boost_root);
+        }
+        else if (pack)
+        {
+            boost_root = pack->root();
         }
         else
         {
@@ -92,6 +799,7 @@ int main(int argc, char* argv[])
         }
 
         scan_params params = scan_params::typical(boost_root);
+        params.pack = pack.get();
 
         arg = &vm["include"];
         if (!arg->empty())
@@ -103,30 +811,206 @@ int main(int argc, char* argv[])
             params.include_dirs.swap(include_dirs);
         }
 
-        std::ofstream file;
-        std::ostream* output = &std::cout;
+        arg = &vm["prune-file"];
+        if (!arg->empty())
+        {
+            std::vector< std::string > files = arg->as< std::vector< std::string > >();
+            for (std::vector< std::string >::const_iterator it = files.begin(), end = files.end(); it != end; ++it)
+                params.prune.load(*it);
+        }
+
+        arg = &vm["prune"];
+        if (!arg->empty())
+        {
+            std::vector< std::string > rules = arg->as< std::vector< std::string > >();
+            for (std::vector< std::string >::const_iterator it = rules.begin(), end = rules.end(); it != end; ++it)
+                params.prune.add_rule(*it);
+        }
+
+        params.collect_attributes = vm.count("attributes") > 0;
+
+        arg = &vm["git-index"];
+        if (!arg->empty())
+        {
+            std::string const& mode = arg->as< std::string >();
+            if (mode == "verify")
+                params.git_index = git_index_verify;
+            else if (mode == "trust")
+                params.git_index = git_index_trust;
+            else
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported git index mode: " + mode));
+        }
+
+        std::vector< scan_entry > entries;
+        arg = &vm["compile-commands"];
+        if (!arg->empty())
+            entries = read_compile_commands(arg->as< std::string >());
+
+        arg = &vm["entry"];
+        if (!arg->empty())
+        {
+            std::vector< std::string > entry_files = arg->as< std::vector< std::string > >();
+            for (std::vector< std::string >::const_iterator it = entry_files.begin(), end = entry_files.end(); it != end; ++it)
+                entries.push_back(scan_entry(*it));
+        }
+
+        std::string out_fname;
         arg = &vm["output"];
+        if (!arg->empty())
+            out_fname = arg->as< std::string >();
+
+        // In batch mode multiple directories are scanned and written to separate files
+        std::vector< scan_target > targets;
+        arg = &vm["manifest"];
+        if (!arg->empty())
+            read_manifest(arg->as< std::string >(), targets);
+
+        arg = &vm["output-dir"];
+        if (!arg->empty() || scan_dirs.size() > 1u)
+        {
+            if (arg->empty())
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Output directory must be specified for multiple scanned directories"));
+
+            boost::filesystem::path output_dir = boost::filesystem::system_complete(arg->as< std::string >());
+            std::string output_suffix = vm["output-suffix"].as< std::string >();
+            for (std::vector< boost::filesystem::path >::const_iterator it = scan_dirs.begin(), end = scan_dirs.end(); it != end; ++it)
+            {
+                boost::filesystem::path relative_dir = make_relative(boost_root, normalize_path(*it));
+                if (relative_dir.empty() || relative_dir.is_absolute())
+                    BOOST_THROW_EXCEPTION(std::invalid_argument("Scanned directory is not within Boost root: " + it->string()));
+
+                scan_target target;
+                target.dir = *it;
+                target.output = (output_dir / relative_dir).string() + output_suffix;
+                targets.push_back(target);
+            }
+        }
+
+        if (!targets.empty() && !entries.empty())
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Multiple scanned directories cannot be combined with entry files"));
+        // Only the files reachable from the entries are scanned, the scanned directory would be silently ignored
+        if (!scan_dirs.empty() && !entries.empty())
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Scanned directories cannot be combined with entry files"));
+
+        output_params out_params;
+        out_params.thread_count = vm["jobs"].as< unsigned int >();
+        out_params.reduce = vm.count("reduce") > 0;
+        out_params.boost_root = boost_root;
+
+        out_params.format = vm["format"].as< std::string >();
+        if (out_params.format != "json" && out_params.format != "compact" && out_params.format != "levels" && out_params.format != "pch" && out_params.format != "breakers")
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported output format: " + out_params.format));
+        if (out_params.format == "pch" && entries.empty())
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Precompiled header recommendation requires entry files or a compilation database"));
+
+        arg = &vm["shards"];
         if (!arg->empty())
         {
-            std::string out_fname = arg->as< std::string >();
-            file.open(out_fname.c_str(), std::ios::out | std::ios::trunc);
-            if (!file.is_open())
-                BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open output file: " + out_fname));
-            output = &file;
+            if (out_params.format != "json")
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Sharded output is only supported for the json format"));
+            if (!targets.empty() || !out_fname.empty())
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Sharded output cannot be combined with output files"));
+            out_params.shards_dir = boost::filesystem::system_complete(arg->as< std::string >());
+            out_params.shard_suffix = vm["output-suffix"].as< std::string >();
         }
 
-        std::string out_format = vm["format"].as< std::string >();
-        if (out_format != "json")
-            BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported output format: " + out_format));
+        arg = &vm["shard"];
+        if (!arg->empty())
+        {
+            // The shards are partial trees, which are only meaningful when merged
+            if ((out_params.format != "json" && out_params.format != "compact") || out_params.reduce)
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Scanning a shard is only supported for the json and compact formats without reduction"));
+            if (!entries.empty())
+                BOOST_THROW_EXCEPTION(std::invalid_argument("Scanning a shard cannot be combined with entry files"));
+            parse_shard(arg->as< std::string >(), params);
+        }
+
+        out_params.pch.boost_root = boost_root;
+        out_params.pch.budget = vm["pch-budget"].as< boost::uintmax_t >();
+
+        out_params.weight = vm["weight"].as< std::string >();
+        if (out_params.weight != "count" && out_params.weight != "bytes")
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported library weight: " + out_params.weight));
+
+        parse_cache cache;
+        boost::filesystem::path cache_file;
+        arg = &vm["parse-cache"];
+        if (!arg->empty())
+        {
+            cache_file = arg->as< std::string >();
+            cache.load(cache_file);
+            params.cache = &cache;
+        }
 
         // Filesystem scanning
         dep_tree root;
+        std::vector< dep_node* > target_nodes;
 
-        scan_filesystem_tree(scan_dir, params, root);
+        {
+            trace_span span("scan", "scan");
+            if (!targets.empty())
+            {
+                // All directories share the scanning state, so every file is parsed and every include is resolved once
+                scan_session session(params, root);
+                for (std::vector< scan_target >::const_iterator it = targets.begin(), end = targets.end(); it != end; ++it)
+                    target_nodes.push_back(session.scan_directory(it->dir));
+            }
+            else if (!entries.empty())
+            {
+                // Put the entry files outside Boost tree (i.e. the user's sources) to the tree as well
+                params.external_root = "$external";
+                out_params.pch.external_root = params.external_root;
+                scan_entry_points(entries, params, root, &out_params.translation_units);
+            }
+            else
+            {
+                // The packed tree is scanned from Boost root by default, the current directory may not be in the pack
+                boost::filesystem::path scan_dir = scan_dirs.empty() ? (pack ? boost_root : boost::filesystem::current_path()) : scan_dirs.front();
+                scan_filesystem_tree(scan_dir, params, root);
+            }
+        }
+
+        if (params.cache && cache.is_modified())
+        {
+            trace_span span("scan", "save_parse_cache");
+            cache.save(cache_file);
+        }
+
+        if (params.collect_attributes)
+        {
+            trace_span span("scan", "assign_libraries");
+            library_graph graph;
+            build_library_graph(root, graph);
+            assign_library_attributes(graph, root.get_attributes());
+        }
 
         // Saving the result
-        if (out_format == "json")
-            serialize_json(root, *output);
+        if (!targets.empty())
+        {
+            for (std::size_t i = 0, n = targets.size(); i < n; ++i)
+            {
+                boost::filesystem::path output_dir = boost::filesystem::path(targets[i].output).parent_path();
+                if (!output_dir.empty())
+                    boost::filesystem::create_directories(output_dir);
+
+                // Every output only contains the nodes of the scanned directory and the nodes they refer to. Unlike the output of
+                // a separate scan of the directory, the nodes are laid out relative to Boost root, so the directory node is nested.
+                dep_tree target_root;
+                copy_subtree(*target_nodes[i], target_root);
+                write_output(target_root, targets[i].output, out_params);
+            }
+        }
+        else
+        {
+            write_output(root, out_fname, out_params);
+        }
+
+        if (!trace_fname.empty())
+        {
+            output_file file(trace_fname);
+            write_trace_json(file.stream());
+            file.close();
+        }
     }
     catch (std::exception& e)
     {
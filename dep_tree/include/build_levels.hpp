@@ -0,0 +1,59 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for computing library build order
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_BUILD_LEVELS_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_BUILD_LEVELS_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <library_graph.hpp>
+
+/*!
+ * Library build schedule. Libraries that depend on each other (i.e. form a cycle in the dependency graph) are collapsed into a single
+ * component, which has to be built as a whole. Components are assigned to levels, so that every component only depends on components
+ * of the lower levels. All components of a level can be built in parallel once the lower levels are built.
+ */
+struct build_levels
+{
+    //! Components, each is a list of library indices. Components are ordered so that every component follows its dependencies.
+    std::vector< std::vector< std::size_t > > components;
+    //! The component index of every library
+    std::vector< std::size_t > library_components;
+    //! Indices of the components this component depends on
+    std::vector< std::vector< std::size_t > > component_dependencies;
+    //! The level of every component
+    std::vector< std::size_t > component_levels;
+    //! Component indices for every level
+    std::vector< std::vector< std::size_t > > levels;
+    //! Weight of every library
+    std::vector< boost::uintmax_t > library_weights;
+    //! Weight of every component, which is the total weight of its libraries
+    std::vector< boost::uintmax_t > component_weights;
+
+    //! The longest weighted chain of dependent components, starting from the one that has to be built first
+    std::vector< std::size_t > critical_path;
+    //! The total weight of the components in the critical path
+    boost::uintmax_t critical_path_weight;
+
+    build_levels() : critical_path_weight(0u) {}
+};
+
+/*!
+ * The function computes the build levels and the critical path for the library graph. The \a weights contain the weight of every library,
+ * e.g. the library size. If \a weights is empty, every library weighs 1, so the critical path is the longest chain of libraries.
+ */
+void compute_build_levels(library_graph const& graph, std::vector< boost::uintmax_t > const& weights, build_levels& levels);
+
+//! Serializes the build levels into JSON format
+void serialize_build_levels_json(library_graph const& graph, build_levels const& levels, std::ostream& strm, bool pretty_print = true, const char* indent = "\t");
+
+#endif // BOOST_PKG_DEP_TREE_BUILD_LEVELS_HPP_INCLUDED_
@@ -0,0 +1,24 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for reading compilation databases (compile_commands.json)
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_COMPILE_COMMANDS_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_COMPILE_COMMANDS_HPP_INCLUDED_
+
+#include <vector>
+#include <boost/filesystem/path.hpp>
+#include <filesystem_scanner.hpp>
+
+/*!
+ * The function reads the compilation database and returns the scanning entries for the translation units described in it.
+ * The include directories of every entry are extracted from the -I, -isystem, -iquote and -idirafter compiler options.
+ */
+std::vector< scan_entry > read_compile_commands(boost::filesystem::path const& path);
+
+#endif // BOOST_PKG_DEP_TREE_COMPILE_COMMANDS_HPP_INCLUDED_
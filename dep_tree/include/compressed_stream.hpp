@@ -0,0 +1,115 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for reading and writing compressed files
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_COMPRESSED_STREAM_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_COMPRESSED_STREAM_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <deque>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <boost/config.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/filesystem/path.hpp>
+
+//! Compression formats
+enum compression_format
+{
+    no_compression,
+    gzip_compression,
+    zstd_compression
+};
+
+//! The function detects the compression format by the file name extension: ".gz" or ".zst"
+compression_format compression_from_file_name(boost::filesystem::path const& path);
+
+/*!
+ * Stream buffer that compresses the written data in a separate thread. The data is collected in blocks, which are passed to
+ * the compression thread as they fill up, so that compression and writing the file are overlapped with producing the data.
+ */
+class pipelined_compressor_buf :
+    public std::streambuf
+{
+private:
+    //! Data block
+    typedef std::vector< char > block;
+
+private:
+    //! The blocks to be compressed, in order
+    std::deque< block > m_queue;
+    //! The blocks that have been written and can be reused
+    std::vector< block > m_free_blocks;
+    //! The block being filled
+    block m_current;
+    bool m_finished;
+
+    boost::iostreams::filtering_ostream m_compressor;
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    boost::exception_ptr m_error;
+    boost::thread m_thread;
+
+public:
+    //! Opens the file and starts the compression thread. Throws if the file cannot be opened.
+    pipelined_compressor_buf(boost::filesystem::path const& path, compression_format format);
+    //! Finishes writing the file, if not finished yet. Errors are ignored.
+    ~pipelined_compressor_buf();
+
+    //! Writes the remaining data, finishes the compressed stream and closes the file. Throws if any error happened while writing.
+    void close();
+
+protected:
+    int_type overflow(int_type c);
+    int sync();
+
+private:
+    //! Passes the current block to the compression thread
+    bool submit_block();
+    //! Compression thread function
+    void compress_blocks();
+
+    BOOST_DELETED_FUNCTION(pipelined_compressor_buf(pipelined_compressor_buf const&))
+    BOOST_DELETED_FUNCTION(pipelined_compressor_buf& operator=(pipelined_compressor_buf const&))
+};
+
+//! Output file stream that compresses the data in a separate thread
+class compressed_ofstream :
+    public std::ostream
+{
+private:
+    pipelined_compressor_buf m_buf;
+
+public:
+    compressed_ofstream(boost::filesystem::path const& path, compression_format format);
+
+    //! Finishes writing the file. Throws if any error happened while writing.
+    void close() { m_buf.close(); }
+};
+
+/*!
+ * Input file stream that transparently decompresses gzip and zstd files. The compression format is detected by the file content,
+ * uncompressed files are read as is.
+ */
+class decompressing_ifstream :
+    public boost::iostreams::filtering_istream
+{
+public:
+    //! Opens the file. Throws if the file cannot be opened.
+    explicit decompressing_ifstream(boost::filesystem::path const& path);
+};
+
+#endif // BOOST_PKG_DEP_TREE_COMPRESSED_STREAM_HPP_INCLUDED_
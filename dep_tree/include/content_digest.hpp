@@ -0,0 +1,60 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines content digests used to identify file contents
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_CONTENT_DIGEST_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_CONTENT_DIGEST_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <boost/array.hpp>
+#include <boost/utility/string_ref.hpp>
+
+/*!
+ * File content digest. The digest is a 128-bit non-cryptographic hash of the file content (MurmurHash3). It is several times
+ * faster to compute than lexing the file, which is what makes caching parsing results by content worthwhile.
+ */
+typedef boost::array< unsigned char, 16 > content_digest;
+
+/*!
+ * Git object identifier, which is the SHA-1 hash of the object. The git index stores the identifiers of the file contents, so for the files
+ * that are known to be unmodified since they were added to the index the identifier can be used instead of the content digest.
+ */
+typedef boost::array< unsigned char, 20 > git_object_id;
+
+//! Hash function for using content digests and git object identifiers in unordered containers
+struct content_digest_hash
+{
+    typedef std::size_t result_type;
+
+    template< std::size_t N >
+    result_type operator() (boost::array< unsigned char, N > const& digest) const
+    {
+        // The digest is already well distributed
+        result_type res = 0;
+        for (std::size_t i = 0; i < sizeof(result_type); ++i)
+            res = (res << 8) | digest[i];
+        return res;
+    }
+};
+
+//! Computes the digest of the file content
+content_digest compute_content_digest(boost::string_ref const& content);
+
+//! Converts the digest to a hex string
+std::string to_hex_string(content_digest const& digest);
+//! Converts the git object identifier to a hex string
+std::string to_hex_string(git_object_id const& id);
+
+//! Parses the digest from a hex string. Returns \c false if the string is not a valid digest.
+bool from_hex_string(boost::string_ref const& str, content_digest& digest);
+//! Parses the git object identifier from a hex string. Returns \c false if the string is not a valid identifier.
+bool from_hex_string(boost::string_ref const& str, git_object_id& id);
+
+#endif // BOOST_PKG_DEP_TREE_CONTENT_DIGEST_HPP_INCLUDED_
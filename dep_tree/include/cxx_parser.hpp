@@ -11,15 +11,35 @@
 #ifndef BOOST_PKG_DEP_TREE_CXX_PARSER_HPP_INCLUDED_
 #define BOOST_PKG_DEP_TREE_CXX_PARSER_HPP_INCLUDED_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <dep_tree.hpp>
+#include <content_digest.hpp>
+#include <filesystem_ext.hpp>
 #include <boost/exception/error_info.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/utility/string_ref.hpp>
+
+class parse_cache;
+class filesystem_index;
+class source_pack;
 
 //! Error info used to communicate the file name that failed to be parsed
 typedef boost::error_info< struct file_name, std::string > file_name_info;
 
+//! Include directive, as it is written in the source
+struct cxx_include_directive
+{
+    //! The included header name, without quotes or angle brackets
+    std::string header;
+    //! \c true if the header name is enclosed in quotes, \c false if in angle brackets
+    bool is_quoted;
+
+    cxx_include_directive() : is_quoted(false) {}
+    cxx_include_directive(boost::string_ref const& h, bool quoted) : header(h.data(), h.size()), is_quoted(quoted) {}
+};
+
 //! Filesystem scanner parameters
 struct cxx_parser_params
 {
@@ -29,11 +49,47 @@ struct cxx_parser_params
     std::vector< boost::filesystem::path > include_dirs;
     //! Whether the parser should also generate reverse dependencies (i.e. fill dependent lists)
     bool create_reverse_dependencies;
+    //! Name of the top level node to put the files outside Boost root to. If empty, such files are not added to the tree.
+    std::string external_root;
+    //! If not \c NULL, the cache of the extracted include directives, keyed by file content
+    parse_cache* cache;
+    //! Whether the file size, modification time, line count, content hash and parse time are stored in the attributes of the file nodes
+    bool collect_attributes;
+    //! If not \c NULL, the insertion cursor of the tree root, which is used to add the nodes of the parsed and the included files
+    dep_node::insertion_cursor* node_cursor;
+    //! If not \c NULL, the filesystem index to use for looking up included headers
+    filesystem_index* fs_index;
+    //! Identifier of the search path for \c include_dirs in the filesystem index. Only used if \c fs_index is not \c NULL.
+    std::size_t include_search_path;
+    //! If not \c NULL, the source pack to read the files within its mount point from. \c fs_index must use the same pack.
+    source_pack const* pack;
+    //! Canonical form of \c boost_root. If set, the included files found with \c fs_index are attributed to the tree nodes without allocating memory.
+    canonical_root canonical_boost_root;
 
     cxx_parser_params();
 };
 
-//! The function creates a node for a header and fills its dependencies depending on the header contents
-void parse_cxx(boost::filesystem::path const& path, cxx_parser_params const& params, dep_tree& root);
+/*!
+ * The version of the include directive lexer. It must be incremented whenever \c parse_cxx_includes can extract different includes
+ * from the same source, since the parse caches written by the other versions are discarded on this number.
+ */
+const unsigned int cxx_lexer_version = 2u;
+
+//! The function extracts include directives from the C++ source
+void parse_cxx_includes(boost::string_ref const& source, std::vector< cxx_include_directive >& includes);
+
+//! The function returns the tree node path for the file or an empty string if the file is not represented in the tree
+std::string make_node_path(boost::filesystem::path const& path, cxx_parser_params const& params);
+//! The function returns the file path for the tree node path. This is the reverse of \c make_node_path.
+boost::filesystem::path make_file_path(std::string const& node_path, boost::filesystem::path const& boost_root, std::string const& external_root);
+
+/*!
+ * The function creates a node for a header and fills its dependencies depending on the header contents. Returns the node of the file
+ * or \c NULL if the file is not represented in the tree.
+ * If \a included_files is not \c NULL, the full paths of the found included files are appended to it.
+ * If \a object_id is not \c NULL, it must be the git object identifier of the file content. It is used to look up the parsing results
+ * in the cache without reading the file. The attributes that require the file content are not collected in this case.
+ */
+dep_node* parse_cxx(boost::filesystem::path const& path, cxx_parser_params const& params, dep_tree& root, std::vector< boost::filesystem::path >* included_files = NULL, git_object_id const* object_id = NULL);
 
 #endif // BOOST_PKG_DEP_TREE_CXX_PARSER_HPP_INCLUDED_
@@ -11,6 +11,7 @@
 #ifndef BOOST_PKG_DEP_TREE_DEP_TREE_HPP_INCLUDED_
 #define BOOST_PKG_DEP_TREE_DEP_TREE_HPP_INCLUDED_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <boost/config.hpp>
@@ -25,6 +26,8 @@ typedef boost::intrusive::set_base_hook<
     boost::intrusive::optimize_size< true >
 > dep_node_set_hook_t;
 
+class node_attributes;
+
 class dep_node :
     public dep_node_set_hook_t
 {
@@ -54,7 +57,21 @@ public:
         }
     };
 
-    //! List of nodes for tracking dependencies
+    /*!
+     * Ordering predicate for the lists of dependencies and dependents. The nodes are ordered by identifier, which does not depend
+     * on the node addresses, so the order of the lists is the same in every run.
+     */
+    struct order_by_id
+    {
+        typedef bool result_type;
+
+        result_type operator() (dep_node const* left, dep_node const* right) const BOOST_NOEXCEPT
+        {
+            return left->get_id() < right->get_id();
+        }
+    };
+
+    //! List of nodes for tracking dependencies, ordered with \c order_by_id
     typedef std::vector< dep_node* > nodes;
 
     //! Set of nodes for lookup by name
@@ -65,8 +82,16 @@ public:
         boost::intrusive::constant_time_size< false >
     > node_set;
 
+    class insertion_cursor;
+
+private:
+    //! The data shared by all nodes of the tree, which is owned by the root node
+    struct tree_data;
+
 private:
     dep_node* m_parent;
+    tree_data* m_tree;
+    std::size_t m_id;
     node_set m_children;
     const std::string m_name;
     nodes m_dependencies;
@@ -94,10 +119,23 @@ public:
     //! Returns a possibly nested child node by the specified path
     dep_node* navigate(boost::string_ref const& path, char separator = default_node_separator) BOOST_NOEXCEPT;
 
+    /*!
+     * Returns the node identifier, which is unique within the tree. The identifiers are allocated densely in the order the nodes are created,
+     * the root node has identifier 0. The identifiers index the node attributes.
+     */
+    std::size_t get_id() const BOOST_NOEXCEPT { return m_id; }
+    //! Returns the number of the allocated node identifiers in the tree, i.e. the greatest identifier plus one
+    std::size_t get_node_count() const BOOST_NOEXCEPT;
+    //! Returns the attributes of the nodes of the tree
+    node_attributes& get_attributes() BOOST_NOEXCEPT;
+    node_attributes const& get_attributes() const BOOST_NOEXCEPT;
+
     //! Returns the node name
     std::string const& get_name() const BOOST_NOEXCEPT { return m_name; }
     //! Returns the full node name
     std::string get_full_name(char separator = default_node_separator) const;
+    //! Returns the node path from the root node, which can be used with \c navigate and \c add_nested_child of the root node
+    std::string get_path(char separator = default_node_separator) const;
     //! Returns the nodes that this node depend on
     nodes const& get_dependencies() const BOOST_NOEXCEPT { return m_dependencies; }
     //! Returns the nodes that depend on this node
@@ -105,6 +143,8 @@ public:
 
     //! Adds an immediate child node or returns the existing node if one exists
     dep_node* add_child(boost::string_ref const& name);
+    //! Adds an immediate child node or returns the existing node if one exists. The insertion is constant time if the child is to be inserted right before \a hint.
+    dep_node* add_child(node_set::const_iterator hint, boost::string_ref const& name);
     //! Adds a possibly nested child node or returns the existing node if one exists
     dep_node* add_nested_child(boost::string_ref const& path, char separator = default_node_separator);
 
@@ -113,19 +153,91 @@ public:
     //! Adds a dependency node identified by path from root node. The node is created, if needed.
     void add_dependency(boost::string_ref const& path, char separator = default_node_separator);
 
+    //! Replaces all dependencies of the node
+    void set_dependencies(nodes const& deps);
+
     //! Adds a dependent node
     void add_dependent(dep_node* node);
     //! Adds a dependent node identified by path from root node. The node is created, if needed.
     void add_dependent(boost::string_ref const& path, char separator = default_node_separator);
+    //! Replaces all dependents of the node
+    void set_dependents(nodes const& rdeps);
+    //! Removes all dependent nodes
+    void clear_dependents() BOOST_NOEXCEPT { m_dependents.clear(); }
 
     BOOST_DELETED_FUNCTION(dep_node(dep_node const&))
     BOOST_DELETED_FUNCTION(dep_node& operator=(dep_node const&))
+
+    friend void reconstruct_reverse_dependencies(dep_node& root, unsigned int thread_count);
+    friend void merge(dep_node& into, dep_node const& from);
+};
+
+/*!
+ * Insertion cursor for adding nested child nodes of a base node in bulk. The cursor remembers the last added path and the nodes along it,
+ * and resumes from the node of the longest common prefix of the paths, so the components shared with the previous path are not looked up
+ * again. The first new component is inserted with the next sibling of the previously added one as the hint, which makes it constant time when
+ * the paths are added in order. Adding paths in directory walk order or adding paths with long common prefixes, like include targets, skips most
+ * of the per-component lookups.
+ *
+ * The nodes are never removed from the tree, so the cursor stays valid until the tree is destroyed. The cursor is not thread-safe, like the tree.
+ */
+class dep_node::insertion_cursor
+{
+private:
+    //! A node along the last added path
+    struct chain_entry
+    {
+        dep_node* node;
+        //! The end of the node name in the path
+        std::size_t path_end;
+
+        chain_entry(dep_node* n, std::size_t end) : node(n), path_end(end) {}
+    };
+
+private:
+    dep_node* m_base;
+    char m_separator;
+    std::string m_path;
+    std::vector< chain_entry > m_chain;
+
+public:
+    explicit insertion_cursor(dep_node& base, char separator = default_node_separator) : m_base(&base), m_separator(separator) {}
+
+    //! Returns the node the paths are relative to
+    dep_node* get_base() const BOOST_NOEXCEPT { return m_base; }
+
+    //! Adds a possibly nested child node of the base node or returns the existing node if one exists, like \c dep_node::add_nested_child
+    dep_node* add_nested_child(boost::string_ref const& path);
+    //! Forgets the last added path
+    void reset() BOOST_NOEXCEPT
+    {
+        m_path.clear();
+        m_chain.clear();
+    }
 };
 
 //! A typedef to signify root nodes
 typedef dep_node dep_tree;
 
-//! The function reconstructs reverse dependencies between the tree nodes
-void reconstruct_reverse_dependencies(dep_tree& root);
+/*!
+ * The function reconstructs reverse dependencies between the tree nodes. The existing dependents are preserved. The reverse edges are built in bulk:
+ * the dependents of every node are counted, the storage for them is allocated and then the edges are scattered into it. The passes are run
+ * concurrently for large trees. If \a thread_count is 0, the number of threads is selected automatically.
+ */
+void reconstruct_reverse_dependencies(dep_tree& root, unsigned int thread_count = 0);
+
+/*!
+ * The function merges the tree \a from into the tree \a into. The nodes are unified by path, the dependencies and the dependents of the unified
+ * nodes are united, and the attributes of the nodes of \a from are copied to the unified nodes. The children of every node are merged in one pass over both ordered child sets,
+ * and the edges are united with the ordered edge lists after distributing them by node identifier with counting sort, so the time is linear in the number of nodes and edges.
+ */
+void merge(dep_tree& into, dep_tree const& from);
+
+/*!
+ * The function copies the node with all its children to another tree, at the same path. The dependencies and dependents of the copied
+ * nodes are copied as well, the nodes they refer to are created in the target tree, if needed. The attributes of the copied nodes are copied too.
+ * Returns the copy of the node.
+ */
+dep_node* copy_subtree(dep_node const& node, dep_tree& target_root);
 
 #endif // BOOST_PKG_DEP_TREE_DEP_TREE_HPP_INCLUDED_
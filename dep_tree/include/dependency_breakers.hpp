@@ -0,0 +1,78 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for finding the includes that pull the most into the dependency closures of libraries
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_DEPENDENCY_BREAKERS_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_DEPENDENCY_BREAKERS_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <dep_tree.hpp>
+#include <library_graph.hpp>
+
+//! Dependency closure of a library: the files reachable from the library files through includes, except the library files themselves
+struct library_closure
+{
+    //! The number of other libraries that have files in the closure
+    std::size_t libraries;
+    std::size_t files;
+    boost::uintmax_t bytes;
+
+    library_closure() : libraries(0u), files(0u), bytes(0u) {}
+};
+
+//! An include of a header of another library and what it alone brings into the closure of the including library
+struct dependency_breaker
+{
+    //! The including library
+    std::size_t library;
+    //! The including file
+    dep_node const* from;
+    //! The included file
+    dep_node const* to;
+    //! The library of the included file
+    std::size_t to_library;
+    //! The libraries that would leave the closure if the include was removed, ordered
+    std::vector< std::size_t > libraries;
+    //! The number of files that would leave the closure
+    std::size_t files;
+    //! The total size of the files that would leave the closure
+    boost::uintmax_t bytes;
+
+    dependency_breaker() : library(0u), from(NULL), to(NULL), to_library(0u), files(0u), bytes(0u) {}
+};
+
+//! Dependency breaker analysis results
+struct dependency_breakers
+{
+    //! Closures of the libraries, in the order of the libraries in the graph
+    std::vector< library_closure > closures;
+    //! All includes between libraries, the ones that remove the most libraries, files and bytes from the closure first
+    std::vector< dependency_breaker > breakers;
+};
+
+/*!
+ * The function ranks the includes between libraries by how much of the dependency closure of the including library would go away
+ * if the include was removed: the number of libraries, files and bytes. The tree nodes are assumed to be named relative to \a boost_root.
+ *
+ * The files that leave the closure are exactly the files every include path to which goes through the include. For every library,
+ * the includes of other libraries are split with virtual vertices and the dominator tree of the include graph is built, rooted
+ * at the library files, so the files that leave the closure are the ones dominated by the virtual vertex of the include. This answers
+ * all includes of the library in one pass over its closure. The libraries are processed in parallel. If \a thread_count is 0,
+ * the number of threads is selected automatically.
+ */
+void find_dependency_breakers(library_graph const& graph, boost::filesystem::path const& boost_root, dependency_breakers& result, unsigned int thread_count = 0);
+
+//! Serializes the dependency breaker analysis results into JSON format
+void serialize_dependency_breakers_json(library_graph const& graph, dependency_breakers const& breakers, std::ostream& strm, bool pretty_print = true, const char* indent = "\t");
+
+#endif // BOOST_PKG_DEP_TREE_DEPENDENCY_BREAKERS_HPP_INCLUDED_
@@ -0,0 +1,77 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines helpers for copying file data through POSIX file descriptors
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_FILE_DESCRIPTOR_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_FILE_DESCRIPTOR_HPP_INCLUDED_
+
+#include <boost/config.hpp>
+
+#if !defined(BOOST_WINDOWS)
+
+#include <cstddef>
+#include <cerrno>
+#include <boost/throw_exception.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define BOOST_PKG_DEP_TREE_HAS_COPY_FILE_RANGE
+#endif
+
+//! Closes the file descriptor on scope exit
+class file_descriptor_guard
+{
+private:
+    int m_fd;
+
+public:
+    explicit file_descriptor_guard(int fd) : m_fd(fd) {}
+    ~file_descriptor_guard() { ::close(m_fd); }
+
+    BOOST_DELETED_FUNCTION(file_descriptor_guard(file_descriptor_guard const&))
+    BOOST_DELETED_FUNCTION(file_descriptor_guard& operator=(file_descriptor_guard const&))
+};
+
+//! Throws the exception with the error code from \c errno
+BOOST_NORETURN inline void throw_system_error(const char* what)
+{
+    BOOST_THROW_EXCEPTION(boost::system::system_error(errno, boost::system::system_category(), what));
+}
+
+/*!
+ * Checks if the error means that linking, cloning or copying the data in the kernel is not supported for the files, as opposed to an I/O error.
+ * The caller is expected to fall back to a more generic way of copying the data.
+ */
+inline bool is_not_supported(int err)
+{
+    return err == EXDEV || err == EPERM || err == EMLINK || err == ENOTSUP || err == EOPNOTSUPP || err == ENOSYS || err == EINVAL || err == ETXTBSY || err == EBADF;
+}
+
+//! Writes all data to the file
+inline void write_data(int fd, const char* data, std::size_t size)
+{
+    for (std::size_t written = 0u; written < size;)
+    {
+        ssize_t res = ::write(fd, data + written, size - written);
+        if (res < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw_system_error("Failed to write file");
+        }
+        written += static_cast< std::size_t >(res);
+    }
+}
+
+#endif // !defined(BOOST_WINDOWS)
+
+#endif // BOOST_PKG_DEP_TREE_FILE_DESCRIPTOR_HPP_INCLUDED_
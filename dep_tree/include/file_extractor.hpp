@@ -0,0 +1,69 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for extracting the subset of Boost files needed by a set of headers
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_FILE_EXTRACTOR_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_FILE_EXTRACTOR_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <dep_tree.hpp>
+
+//! The ways to create the extracted files
+enum extract_method
+{
+    //! Create hardlinks to the original files. If not possible, the files are cloned or copied.
+    extract_link,
+    //! Clone the files (i.e. create reflinks, which share the data with the original files until modified). If not possible, the files are copied.
+    extract_clone,
+    //! Copy the file data
+    extract_copy
+};
+
+//! Extraction parameters
+struct extract_params
+{
+    boost::filesystem::path boost_root;
+    //! The directory to create the files in
+    boost::filesystem::path target_dir;
+    extract_method method;
+    /*!
+     * If \c true, the headers of modular Boost libraries are placed in the common include directory of the target directory, as in
+     * the monolithic Boost layout, e.g. libs/config/include/boost/config.hpp is extracted to boost/config.hpp
+     */
+    bool merge_include_dirs;
+    //! If 0, the number of threads is selected automatically
+    unsigned int thread_count;
+
+    extract_params() : method(extract_link), merge_include_dirs(true), thread_count(0u) {}
+};
+
+//! Extraction statistics
+struct extract_stats
+{
+    std::size_t linked_files;
+    std::size_t cloned_files;
+    std::size_t copied_files;
+    boost::uintmax_t copied_bytes;
+
+    extract_stats() : linked_files(0u), cloned_files(0u), copied_files(0u), copied_bytes(0u) {}
+};
+
+//! The function collects the nodes reachable from the entry nodes through dependencies, including the entry nodes themselves
+void collect_dependency_closure(std::vector< dep_node* > const& entries, std::vector< dep_node const* >& closure);
+
+/*!
+ * The function creates the files of the nodes in the target directory. The nodes are assumed to be named relative to Boost root. The files are
+ * created concurrently, the existing files in the target directory are replaced.
+ */
+void extract_files(std::vector< dep_node const* > const& nodes, dep_tree& root, extract_params const& params, extract_stats& stats);
+
+#endif // BOOST_PKG_DEP_TREE_FILE_EXTRACTOR_HPP_INCLUDED_
@@ -14,7 +14,9 @@
 #include <cstddef>
 #include <string>
 #include <stdexcept>
+#include <boost/config.hpp>
 #include <boost/throw_exception.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 
@@ -51,13 +53,125 @@ inline boost::filesystem::path peel_symlinks(boost::filesystem::path path, boost
     return normalize_path(boost::filesystem::system_complete(path));
 }
 
+//! Checks if the character is a path separator
+inline bool is_path_separator(char c)
+{
+#if defined(BOOST_WINDOWS)
+    return c == '/' || c == '\\';
+#else
+    return c == '/';
+#endif
+}
+
+/*!
+ * Checks if the path is the directory or is within the directory. Unlike comparing the path prefix, "/a/b_c" is not considered to be within "/a/b".
+ * The paths are compared as strings, so they must be in the same form, e.g. both absolute and normalized. Does not allocate memory.
+ */
+inline bool is_within_directory(boost::string_ref const& dir, boost::string_ref const& path)
+{
+    const std::size_t dir_size = dir.size();
+    return path.starts_with(dir) && (path.size() == dir_size || dir_size == 0u || is_path_separator(dir[dir_size - 1u]) || is_path_separator(path[dir_size]));
+}
+
+//! Returns the part of the path relative to the directory, without the leading separators. The path must be within the directory. Does not allocate memory.
+inline boost::string_ref make_relative_part(boost::string_ref const& dir, boost::string_ref const& path)
+{
+    boost::string_ref res = path.substr(dir.size());
+    while (!res.empty() && is_path_separator(res.front()))
+        res.remove_prefix(1u);
+    return res;
+}
+
+//! Returns the part of the absolute path relative to the filesystem root, like \c boost::filesystem::path::relative_path. Does not allocate memory.
+inline boost::string_ref make_root_relative_part(boost::string_ref path)
+{
+#if defined(BOOST_WINDOWS)
+    if (path.size() >= 2u && path[1] == ':')
+        path.remove_prefix(2u);
+#endif
+    while (!path.empty() && is_path_separator(path.front()))
+        path.remove_prefix(1u);
+    return path;
+}
+
+/*!
+ * Removes the '.' and '..' elements and repeated separators from the absolute path in place, like \c normalize_path.
+ * The '..' elements that would go above the root are dropped. Does not allocate memory.
+ */
+inline void normalize_path_in_place(std::string& path)
+{
+    // The root part (e.g. "/" or "C:\\") is kept as is
+    std::size_t root_size = path.size() - make_root_relative_part(path).size();
+    std::size_t out = root_size, in = root_size, size = path.size();
+    while (in < size)
+    {
+        std::size_t elem_end = in;
+        while (elem_end < size && !is_path_separator(path[elem_end]))
+            ++elem_end;
+
+        const std::size_t elem_size = elem_end - in;
+        if (elem_size == 0u || (elem_size == 1u && path[in] == '.'))
+        {
+            // Skip empty and '.' elements
+        }
+        else if (elem_size == 2u && path[in] == '.' && path[in + 1u] == '.')
+        {
+            // Remove the last element
+            while (out > root_size && !is_path_separator(path[out - 1u]))
+                --out;
+            if (out > root_size)
+                --out;
+        }
+        else
+        {
+            // The output never overtakes the input, so the characters can be moved forward
+            if (out > root_size)
+                path[out++] = path[in - 1u];
+            for (std::size_t i = in; i < elem_end; ++i)
+                path[out++] = path[i];
+        }
+
+        in = elem_end + 1u;
+    }
+
+    path.resize(out);
+}
+
+/*!
+ * Root directory, such as Boost root. The directory path is made absolute and normalized once, so that checking if other paths are
+ * within the root and making them relative to the root are string operations that don't allocate memory.
+ */
+class canonical_root
+{
+private:
+    boost::filesystem::path m_path;
+    std::string m_string;
+
+public:
+    canonical_root() {}
+    explicit canonical_root(boost::filesystem::path const& root)
+    {
+        m_string = boost::filesystem::system_complete(root).string();
+        normalize_path_in_place(m_string);
+        m_path = m_string;
+    }
+
+    bool empty() const { return m_string.empty(); }
+    boost::filesystem::path const& path() const { return m_path; }
+    std::string const& string() const { return m_string; }
+
+    //! Checks if the path is the root or is within the root. The path must be absolute and normalized.
+    bool contains(boost::string_ref const& path) const { return !m_string.empty() && is_within_directory(m_string, path); }
+    //! Returns the path relative to the root, which is empty for the root itself. The path must be within the root.
+    boost::string_ref make_relative(boost::string_ref const& path) const { return make_relative_part(m_string, path); }
+};
+
 //! Tests is one path is a descendant to the other
 inline bool is_descendant(boost::filesystem::path const& parent, boost::filesystem::path const& descendant)
 {
     std::string p = boost::filesystem::system_complete(parent).string();
     std::string d = boost::filesystem::system_complete(descendant).string();
-    std::size_t parent_len = p.size();
-    return parent_len <= d.size() && p.compare(0, parent_len, d.c_str(), parent_len) == 0;
+    return is_within_directory(p, d);
 }
 
 //! Makes one path relative to the other
@@ -65,15 +179,10 @@ inline boost::filesystem::path make_relative(boost::filesystem::path const& pare
 {
     std::string p = boost::filesystem::system_complete(parent).string();
     std::string d = boost::filesystem::system_complete(descendant).string();
-    std::size_t parent_len = p.size(), descendant_len = d.size();
-    if (parent_len <= d.size() && p.compare(0, parent_len, d.c_str(), parent_len) == 0)
+    if (is_within_directory(p, d))
     {
-        std::size_t i = parent_len;
-        while (i < descendant_len && (d[i] == '/' || d[i] == '\\'))
-        {
-            ++i;
-        }
-        return boost::filesystem::path(d.c_str() + i);
+        boost::string_ref relative = make_relative_part(p, d);
+        return boost::filesystem::path(relative.begin(), relative.end());
     }
     else
     {
@@ -0,0 +1,151 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the in-memory filesystem index
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_FILESYSTEM_INDEX_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_FILESYSTEM_INDEX_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+
+class source_pack;
+
+/*!
+ * The index caches directory listings and symlink targets, so that the repeated filesystem queries made while resolving
+ * included headers are answered from memory. Every directory is listed at most once, and the file types are taken from
+ * the listing, so looking up a file, including one that does not exist, does not require a syscall once its directory
+ * has been listed. The results of looking up files in search paths (i.e. lists of include directories) are also cached,
+ * so every distinct included header is looked up in the search path directories only once. Looking up the files that have been
+ * found before does not allocate memory, and the paths of new files are resolved in reusable string buffers rather than by
+ * building paths element by element.
+ *
+ * If a source pack is attached, the directories and symlinks within its mount point are looked up in the pack, so scanning
+ * the packed tree does not access the filesystem.
+ *
+ * The index assumes the filesystem does not change while it is used. The index is not thread-safe.
+ */
+class filesystem_index
+{
+public:
+    //! Directory entry: the file name and the file type, not following symlinks
+    typedef std::pair< std::string, boost::filesystem::file_type > entry;
+    //! Directory entries, ordered by name
+    typedef std::vector< entry > entries;
+    //! Search path identifier
+    typedef std::size_t search_path_id;
+
+private:
+    //! String hash function that allows to look up strings by \c boost::string_ref without constructing a string
+    struct string_hash
+    {
+        typedef std::size_t result_type;
+
+        result_type operator() (boost::string_ref const& str) const { return boost::hash_range(str.begin(), str.end()); }
+    };
+    //! String equality predicate that allows to look up strings by \c boost::string_ref
+    struct string_equal
+    {
+        typedef bool result_type;
+
+        result_type operator() (boost::string_ref const& left, boost::string_ref const& right) const { return left == right; }
+    };
+
+    typedef boost::unordered_map< std::string, entries, string_hash, string_equal > directory_map;
+    typedef boost::unordered_map< std::string, boost::filesystem::path, string_hash, string_equal > symlink_map;
+    //! Resolved file paths, an empty path means the file was not found
+    typedef boost::unordered_map< std::string, boost::filesystem::path, string_hash, string_equal > file_map;
+
+    //! Search path and the cache of the files found in it
+    struct search_path
+    {
+        std::vector< boost::filesystem::path > dirs;
+        file_map found_files;
+    };
+
+    //! Result of a quick file lookup
+    enum lookup_result
+    {
+        not_found,
+        found,
+        unknown
+    };
+
+private:
+    //! The source pack or \c NULL
+    source_pack const* m_pack;
+    directory_map m_directories;
+    symlink_map m_symlinks;
+    file_map m_files;
+    std::vector< search_path > m_search_paths;
+    std::string m_lookup_buffer;
+    //! Buffer for composing file paths for cache lookups, so that the lookups don't allocate memory
+    std::string m_path_buffer;
+    //! Buffer for resolving the symlinks in the paths of the files that are looked up for the first time
+    std::string m_resolve_buffer;
+    //! The last root path passed to \c find_regular_file and its complete form
+    boost::filesystem::path m_root_path;
+    std::string m_root_string;
+
+public:
+    //! Creates the index. If \a pack is not \c NULL, the paths within the pack mount point are looked up in the pack.
+    explicit filesystem_index(source_pack const* pack = NULL) : m_pack(pack) {}
+
+    //! Returns the entries of the directory. Returns an empty list if the directory does not exist.
+    entries const& list_directory(boost::filesystem::path const& dir);
+
+    //! Returns the file status, without following symlinks. Equivalent to \c boost::filesystem::symlink_status.
+    boost::filesystem::file_status symlink_status(boost::filesystem::path const& path);
+    //! Returns the file status, following symlinks. Equivalent to \c boost::filesystem::status.
+    boost::filesystem::file_status status(boost::filesystem::path const& path);
+    //! Checks if the file exists. Equivalent to \c boost::filesystem::exists.
+    bool exists(boost::filesystem::path const& path) { return boost::filesystem::exists(status(path)); }
+    //! Returns the symlink target. Equivalent to \c boost::filesystem::read_symlink.
+    boost::filesystem::path const& read_symlink(boost::filesystem::path const& path);
+
+    //! Follows all symlinks and returns the path that is referred to by the symlinks. Equivalent to \c peel_symlinks.
+    boost::filesystem::path peel_symlinks(boost::filesystem::path path, boost::filesystem::file_status* status = NULL);
+    //! Follows all symlinks, for all directories up to the root path as well. Equivalent to \c recursive_peel_symlinks.
+    boost::filesystem::path recursive_peel_symlinks(boost::filesystem::path const& root_path, boost::filesystem::path const& path, boost::filesystem::file_status* status = NULL);
+
+    /*!
+     * Looks for a regular file \a relative_path in the directory \a dir and returns the path with all symlinks peeled. The symlinks
+     * are peeled relative to \a root_path if the file is within it, or relative to the filesystem root otherwise. Returns an empty
+     * path if the file is not found or is not a regular file. The result is cached, so \a root_path must be the same every time
+     * the same file is looked up.
+     */
+    boost::filesystem::path const& find_regular_file(boost::filesystem::path const& root_path, boost::filesystem::path const& dir, boost::string_ref const& relative_path);
+
+    //! Registers a search path, i.e. a list of directories to look for files in, in order. Equal search paths share the identifier.
+    search_path_id add_search_path(std::vector< boost::filesystem::path > const& dirs);
+    //! Looks for a regular file in the search path directories. Returns the path of the first found file with all symlinks peeled, or an empty path.
+    boost::filesystem::path const& find_in_search_path(search_path_id id, boost::filesystem::path const& root_path, boost::string_ref const& relative_path);
+
+private:
+    //! Returns the entries of the directory, which is specified by a normalized path
+    entries const& list_normalized_directory(boost::string_ref const& dir);
+    //! Returns the file type, without following symlinks. The path must be absolute and normalized.
+    boost::filesystem::file_type normalized_symlink_type(boost::string_ref const& path);
+    //! Returns the symlink target. The path must be absolute and normalized.
+    boost::filesystem::path const& read_normalized_symlink(boost::string_ref const& path);
+    //! Follows the symlinks of the last element of the normalized path, in place, and returns the file type of the resulting path
+    boost::filesystem::file_type peel_normalized_symlinks(std::string& path);
+    //! Follows the symlinks of every element of \a path after the \a root_size leading characters. The result is composed in \a resolved_path.
+    boost::filesystem::file_type recursive_peel_normalized_symlinks(boost::string_ref const& path, std::size_t root_size, std::string& resolved_path);
+    //! Checks if the file exists, without building paths. Returns \c unknown if the path contains elements that require full resolution, like symlinks.
+    lookup_result quick_lookup(boost::filesystem::path const& dir, boost::string_ref const& relative_path);
+};
+
+#endif // BOOST_PKG_DEP_TREE_FILESYSTEM_INDEX_HPP_INCLUDED_
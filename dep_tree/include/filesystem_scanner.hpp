@@ -14,8 +14,14 @@
 #include <cstddef>
 #include <string>
 #include <vector>
-#include <dep_tree.hpp>
+#include <boost/config.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/filesystem/path.hpp>
+#include <dep_tree.hpp>
+#include <prune_rules.hpp>
+
+class parse_cache;
+class source_pack;
 
 //! The function finds Boost root directory
 boost::filesystem::path find_boost_root();
@@ -29,6 +35,27 @@ std::vector< boost::filesystem::path > default_skip_root_dirs();
 //! The function returns wildcards for the filenames that are typically used to store C++ code in Boost
 std::vector< std::string > default_cxx_wildcards();
 
+//! The function detects if the file should be parsed as C++
+bool is_cxx_file(boost::filesystem::path const& path, std::vector< std::string > const& cxx_wildcards);
+
+//! The function checks if the filename matches any of the wildcards
+bool match_wildcards(std::string const& filename, std::vector< std::string > const& wildcards);
+
+//! The ways to use the git index for scanning directories
+enum git_index_mode
+{
+    //! Walk the directory tree, the git index is not used
+    git_index_none,
+    /*!
+     * Enumerate the files from the git index of the working tree instead of walking the directory tree. The C++ files are checked for modifications
+     * by comparing the file status with the one stored in the index. The unmodified files are looked up in the parse cache by the git object
+     * identifier, without reading the file. Files that are not tracked by git are not scanned.
+     */
+    git_index_verify,
+    //! Same as \c git_index_verify, but the working tree is assumed to match the index, so the file status is not checked
+    git_index_trust
+};
+
 //! Filesystem scanner parameters
 struct scan_params
 {
@@ -37,8 +64,35 @@ struct scan_params
     std::vector< std::string > blacklist_wildcards;
     std::vector< std::string > cxx_wildcards;
     std::vector< boost::filesystem::path > skip_root_dirs;
+    //! The rules that prune directories and files within Boost root at any depth. Not used by \c scan_entry_points.
+    prune_rules prune;
     std::vector< boost::filesystem::path > include_dirs;
     bool create_reverse_dependencies;
+    //! Name of the top level node to put the scanned files outside Boost root to. If empty, such files are not added to the tree.
+    std::string external_root;
+    //! If not \c NULL, the cache of the extracted include directives, keyed by file content
+    parse_cache* cache;
+    /*!
+     * Whether the file attributes are stored in the attributes of the tree: the file size, the modification time, the line count, the content hash
+     * and the parse time of the parsed files. The attributes are only collected from what scanning obtains anyway, e.g. the sizes of the files
+     * that are not parsed are only known if the files are enumerated from the git index or read from a source pack.
+     */
+    bool collect_attributes;
+    //! Whether the file list is read from the git index
+    git_index_mode git_index;
+    /*!
+     * If not \c NULL, the source pack to read the directories and files within its mount point from, instead of the filesystem.
+     * Cannot be combined with the git index.
+     */
+    source_pack const* pack;
+    /*!
+     * The scanned files are partitioned into \c shard_count shards by their paths, only the files of the shard \c shard_index are added
+     * to the tree. The directories are added to every shard. Merging the trees of all shards with \c merge gives the same nodes and edges as the
+     * full scan. The output may still differ in the order of the dependencies, which follows the order the nodes were created in.
+     * The partition is the same in every process, so the shards can be scanned by independent processes. Not used by \c scan_entry_points.
+     */
+    unsigned int shard_index;
+    unsigned int shard_count;
 
     scan_params();
 
@@ -49,4 +103,51 @@ struct scan_params
 //! The function scans Boost directory tree and builds header dependency tree. The function optionally detects Boost sublibraries and returns the nodes that correspond to the sublib directories.
 void scan_filesystem_tree(boost::filesystem::path const& dir, scan_params const& params, dep_tree& root, std::vector< dep_node* >* sublibs = NULL);
 
+/*!
+ * Scanning session, which allows to scan multiple directories into the same tree. The directories share the state that is needed
+ * for scanning: the filesystem index and the resolved includes, so scanning multiple directories in one session is about as
+ * expensive as scanning them all at once. Every file is parsed at most once, even if the scanned directories are nested.
+ *
+ * Unlike \c scan_filesystem_tree, the directory nodes are created relative to Boost root, so the nodes of every scanned directory
+ * are placed under the node that corresponds to the directory. The scanned directories must be within Boost root.
+ */
+class scan_session
+{
+private:
+    struct implementation;
+
+private:
+    boost::scoped_ptr< implementation > m_impl;
+
+public:
+    scan_session(scan_params const& params, dep_tree& root);
+    ~scan_session();
+
+    //! Scans the directory and adds the found files to the tree. Returns the node that corresponds to the directory.
+    dep_node* scan_directory(boost::filesystem::path const& dir, std::vector< dep_node* >* sublibs = NULL);
+
+    BOOST_DELETED_FUNCTION(scan_session(scan_session const&))
+    BOOST_DELETED_FUNCTION(scan_session& operator=(scan_session const&))
+};
+
+//! Entry point for the demand-driven scanning
+struct scan_entry
+{
+    //! The file to start scanning from
+    boost::filesystem::path file;
+    //! Directories to search included headers in, before the ones specified in scanning parameters
+    std::vector< boost::filesystem::path > include_dirs;
+
+    scan_entry() {}
+    explicit scan_entry(boost::filesystem::path const& f) : file(f) {}
+};
+
+/*!
+ * The function builds header dependency tree for the files reachable from the entry files through the resolved includes.
+ * Unlike \c scan_filesystem_tree, only the reachable files are parsed, each at most once. A file reachable from multiple entries is parsed
+ * with the include directories of the entry it was first reached from. If \a entry_nodes is not \c NULL, the nodes of the entry files
+ * are appended to it, in the order of the entries and without duplicates.
+ */
+void scan_entry_points(std::vector< scan_entry > const& entries, scan_params const& params, dep_tree& root, std::vector< dep_node* >* entry_nodes = NULL);
+
 #endif // BOOST_PKG_DEP_TREE_FILESYSTEM_SCANNER_HPP_INCLUDED_
@@ -0,0 +1,100 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for tracking library dependencies through the git history
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_GIT_HISTORY_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_GIT_HISTORY_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <content_digest.hpp>
+
+class parse_cache;
+
+//! History scanning parameters
+struct history_params
+{
+    //! The git directory of the repository
+    boost::filesystem::path git_dir;
+    //! The commit the history starts after. If empty, the history starts with the root commit.
+    std::string from;
+    //! The last commit of the history
+    std::string to;
+    //! If not 0, only this number of the latest commits is reported
+    std::size_t max_count;
+    //! The files matching these wildcards are parsed as C++
+    std::vector< std::string > cxx_wildcards;
+    //! Whether the files of submodules are scanned. The submodule objects are read from the modules directory of the git directory.
+    bool follow_submodules;
+    //! If not \c NULL, the cache of the extracted include directives, keyed by git object identifiers
+    parse_cache* cache;
+
+    history_params();
+};
+
+//! Dependency between libraries
+struct library_edge
+{
+    //! The dependent library name, which is the path of the library directory relative to \c libs
+    std::string from;
+    //! The library \c from depends on
+    std::string to;
+
+    library_edge() {}
+    library_edge(std::string const& f, std::string const& t) : from(f), to(t) {}
+};
+
+//! Changes of library dependencies made by a commit
+struct history_commit
+{
+    git_object_id id;
+    //! Commit time, in seconds since the epoch
+    boost::int64_t time;
+    //! The first line of the commit message
+    std::string summary;
+    //! Dependencies that appear in this commit, ordered
+    std::vector< library_edge > added;
+    //! Dependencies that disappear in this commit, ordered
+    std::vector< library_edge > removed;
+
+    history_commit() : time(0) { id.fill(0u); }
+};
+
+//! History scanning statistics
+struct history_stats
+{
+    //! Number of distinct file contents parsed
+    std::size_t parsed_blobs;
+    //! Number of file contents that were found in the parse cache
+    std::size_t cached_blobs;
+    //! Number of submodule commits that were not found in the submodule repositories, which were scanned as empty directories
+    std::size_t missing_submodule_commits;
+
+    history_stats() : parsed_blobs(0u), cached_blobs(0u), missing_submodule_commits(0u) {}
+};
+
+/*!
+ * The function follows the first parent history from \c params.to to \c params.from and reports the library dependencies added and
+ * removed by every commit, the oldest commit first. The objects are read from the repository directly, nothing is checked out.
+ *
+ * The state of the repository is maintained incrementally: only the trees that differ from the previous commit are read, only the file
+ * contents that have not been seen before are parsed, and only the files whose includes may resolve differently are re-resolved.
+ * The libraries are the directories under \c libs that have an \c include subdirectory, like in \c build_library_graph. The included
+ * headers are looked up in the include directories of the libraries. Quoted includes are first looked up relative to the including file.
+ */
+void scan_history(history_params const& params, std::vector< history_commit >& commits, history_stats* stats = NULL);
+
+//! The function writes the history in JSON format
+void serialize_history_json(std::vector< history_commit > const& commits, std::ostream& strm, bool pretty_print = true, const char* indent = "\t");
+
+#endif // BOOST_PKG_DEP_TREE_GIT_HISTORY_HPP_INCLUDED_
@@ -0,0 +1,109 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for reading git index files
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_GIT_INDEX_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_GIT_INDEX_HPP_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <content_digest.hpp>
+
+//! Git index entry
+struct git_index_entry
+{
+    //! File type bits of the mode
+    static const boost::uint32_t type_mask = 0170000u;
+    static const boost::uint32_t regular_file_type = 0100000u;
+    static const boost::uint32_t symlink_type = 0120000u;
+    static const boost::uint32_t gitlink_type = 0160000u;
+
+    //! File path relative to the working tree root, with '/' separators
+    std::string path;
+    //! Object identifier of the file content
+    git_object_id id;
+    //! File mode
+    boost::uint32_t mode;
+    //! File status at the time the file was added to the index. The values are truncated to 32 bits, as stored in the index.
+    boost::uint32_t ctime_sec, ctime_nsec, mtime_sec, mtime_nsec, ino, size;
+    //! \c true if git is told not to check the file for modifications (the assume-unchanged flag)
+    bool assume_unchanged;
+    //! \c true if the file is not present in the working tree (sparse checkout)
+    bool skip_worktree;
+    //! \c true if the object identifier does not describe the file content: the file is added with "git add -N" or it has merge conflicts
+    bool unknown_content;
+    //! \c true if the file was modified close to the time the index was written, so the file status is not enough to detect further modifications
+    bool racy;
+
+    git_index_entry();
+
+    bool is_regular_file() const { return (mode & type_mask) == regular_file_type; }
+    bool is_symlink() const { return (mode & type_mask) == symlink_type; }
+    //! Returns \c true if the entry is a submodule
+    bool is_gitlink() const { return (mode & type_mask) == gitlink_type; }
+};
+
+/*!
+ * The function reads the git index file. Index versions 2 to 4 of SHA-1 repositories are supported. The entries are appended to \a entries
+ * in the index order, which is the order of paths. Merge conflicts are reported as one entry per path. Does nothing if the file does not exist.
+ */
+void read_git_index(boost::filesystem::path const& index_file, std::vector< git_index_entry >& entries);
+
+//! The function returns the git directory of the working tree root or an empty path if the directory is not a working tree root. The \c .git file of submodules and linked working trees is followed.
+boost::filesystem::path find_git_dir(boost::filesystem::path const& worktree);
+
+//! The function returns the root of the git working tree that contains the directory or an empty path if the directory is not in a working tree
+boost::filesystem::path find_git_worktree(boost::filesystem::path const& dir);
+
+/*!
+ * Files of a git working tree, as recorded in the git index. The files of the checked out submodules are included, as if they were part
+ * of the working tree. This allows to enumerate the files and to detect the modified files without walking the directory tree and
+ * reading the files. Files that are not tracked by git are not included.
+ */
+class git_worktree
+{
+public:
+    typedef std::vector< git_index_entry > entries;
+
+    //! File state compared to the index
+    enum file_state
+    {
+        file_unmodified,
+        //! The file may have been modified, its content must be read
+        file_modified,
+        file_missing
+    };
+
+private:
+    boost::filesystem::path m_root;
+    //! Entries, ordered by path
+    entries m_entries;
+
+public:
+    //! Reads the index of the working tree. Throws if the directory is not a working tree root.
+    explicit git_worktree(boost::filesystem::path const& root);
+
+    boost::filesystem::path const& root() const { return m_root; }
+    entries const& get_entries() const { return m_entries; }
+
+    //! Returns the entries of the files in the directory and its subdirectories. The directory is relative to the working tree root, an empty string denotes the root.
+    std::pair< entries::const_iterator, entries::const_iterator > find_directory(std::string const& dir) const;
+
+    //! Checks if the file has been modified since it was added to the index. The file status is compared with the one stored in the index, the file content is not read.
+    file_state get_file_state(git_index_entry const& entry) const;
+
+private:
+    //! Reads the index of the working tree or submodule and its nested submodules
+    void load(boost::filesystem::path const& worktree, std::string const& prefix);
+};
+
+#endif // BOOST_PKG_DEP_TREE_GIT_INDEX_HPP_INCLUDED_
@@ -0,0 +1,140 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for reading objects from git repositories
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_GIT_OBJECTS_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_GIT_OBJECTS_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/path.hpp>
+#include <content_digest.hpp>
+#include <git_index.hpp>
+
+//! Git object types, as numbered in pack files
+enum git_object_type
+{
+    git_no_object = 0,
+    git_commit_object = 1,
+    git_tree_object = 2,
+    git_blob_object = 3,
+    git_tag_object = 4
+};
+
+//! Git object
+struct git_object
+{
+    git_object_type type;
+    std::string data;
+
+    git_object() : type(git_no_object) {}
+};
+
+//! Commit description
+struct git_commit
+{
+    //! The root tree of the commit
+    git_object_id tree;
+    //! Parent commits, the first parent first
+    std::vector< git_object_id > parents;
+    //! Commit time, in seconds since the epoch
+    boost::int64_t time;
+    //! The first line of the commit message
+    std::string summary;
+
+    git_commit() : time(0) { tree.fill(0u); }
+};
+
+//! Git tree entry
+struct git_tree_entry
+{
+    static const boost::uint32_t tree_type = 0040000u;
+
+    //! File mode, the file type bits are the same as in the git index
+    boost::uint32_t mode;
+    std::string name;
+    git_object_id id;
+
+    git_tree_entry() : mode(0u) {}
+
+    bool is_tree() const { return (mode & git_index_entry::type_mask) == tree_type; }
+    bool is_regular_file() const { return (mode & git_index_entry::type_mask) == git_index_entry::regular_file_type; }
+    bool is_symlink() const { return (mode & git_index_entry::type_mask) == git_index_entry::symlink_type; }
+    //! Returns \c true if the entry is a submodule commit
+    bool is_gitlink() const { return (mode & git_index_entry::type_mask) == git_index_entry::gitlink_type; }
+};
+
+//! The function parses the commit object
+void parse_git_commit(boost::string_ref const& data, git_commit& commit);
+//! The function parses the tree object. The entries are appended to \a entries in the tree order.
+void parse_git_tree(boost::string_ref const& data, std::vector< git_tree_entry >& entries);
+
+/*!
+ * Object database of a git repository. Both loose objects and pack files (version 2 pack indices) are supported, including
+ * deltified objects. The pack files are mapped into memory. The recently used delta bases are cached, so reading the objects
+ * of consecutive commits does not decompress the same delta chains over and over. Alternate object databases are not supported.
+ *
+ * The object store is not thread-safe.
+ */
+class git_object_store
+{
+private:
+    struct pack_file;
+
+    typedef std::pair< std::size_t, boost::uint64_t > pack_position;
+    typedef boost::unordered_map< pack_position, git_object > object_cache;
+
+private:
+    boost::filesystem::path m_git_dir;
+    //! The directory with the objects and the shared references, which differs from \c m_git_dir for linked working trees
+    boost::filesystem::path m_common_dir;
+    std::vector< boost::shared_ptr< pack_file > > m_packs;
+    //! Delta bases, keyed by the pack index and the object offset in the pack
+    object_cache m_delta_bases;
+    std::size_t m_delta_bases_size;
+
+public:
+    //! Opens the object database of the git directory. Throws if the directory is not a git directory.
+    explicit git_object_store(boost::filesystem::path const& git_dir);
+    ~git_object_store();
+
+    boost::filesystem::path const& git_dir() const { return m_git_dir; }
+
+    //! Reads the object. Returns \c false if there is no such object in the repository.
+    bool read_object(git_object_id const& id, git_object& obj);
+    //! Reads the object of the specified type. Throws if there is no such object or it has a different type. Annotated tags are followed when a commit or a tree is requested.
+    void read_object(git_object_id const& id, git_object_type type, git_object& obj);
+
+    /*!
+     * Returns the object identifier for the revision. The revision is either a full hex object identifier or a reference name, which is
+     * looked up in the same order as git does: as is (e.g. HEAD), in refs, refs/tags, refs/heads, refs/remotes. The name may be followed
+     * with ~N (the N-th first parent ancestor) and ^N (the N-th parent) suffixes, as in git. Throws if not found.
+     */
+    git_object_id resolve_revision(std::string const& revision);
+
+    BOOST_DELETED_FUNCTION(git_object_store(git_object_store const&))
+    BOOST_DELETED_FUNCTION(git_object_store& operator=(git_object_store const&))
+
+private:
+    bool read_packed_object(git_object_id const& id, git_object& obj);
+    void read_pack_entry(std::size_t pack, boost::uint64_t offset, git_object& obj);
+    bool read_loose_object(git_object_id const& id, git_object& obj);
+    git_object_id resolve_name(std::string const& name) const;
+    git_object_id get_parent(git_object_id const& id, std::size_t parent, std::string const& revision);
+    bool resolve_reference(std::string const& name, git_object_id& id, unsigned int depth) const;
+};
+
+#endif // BOOST_PKG_DEP_TREE_GIT_OBJECTS_HPP_INCLUDED_
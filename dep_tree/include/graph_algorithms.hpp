@@ -0,0 +1,42 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the generic directed graph algorithms
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_GRAPH_ALGORITHMS_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_GRAPH_ALGORITHMS_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <dep_tree.hpp>
+
+//! Directed graph. For every vertex, the list contains the indices of the vertices it has edges to.
+typedef std::vector< std::vector< std::size_t > > adjacency_list;
+
+/*!
+ * The function finds strongly connected components of the graph. The components are ordered so that every component follows
+ * the components reachable from it, i.e. dependencies come first. Vertices of every component are ordered by index.
+ * \a vertex_components receives the component index of every vertex.
+ */
+void find_strongly_connected_components(adjacency_list const& graph, std::vector< std::vector< std::size_t > >& components, std::vector< std::size_t >& vertex_components);
+
+/*!
+ * The function removes the edges that are implied by other paths in the graph, so that the reachability between vertices is preserved.
+ * The edge lists must be ordered and must not contain duplicates.
+ *
+ * The edges within strongly connected components are preserved, since there is no unique reduction for cycles. Of multiple edges
+ * between the same pair of components, only the first one (in the order of vertex and edge indices) is preserved. The reachability
+ * is computed with bitsets, components that don't depend on each other are processed in parallel. If \a thread_count is 0, the number
+ * of threads is selected automatically.
+ */
+void reduce_transitive_edges(adjacency_list& graph, unsigned int thread_count = 0);
+
+//! The function removes the dependencies between the tree nodes that are implied by other dependencies. Reverse dependencies are updated accordingly.
+void reduce_dependencies(dep_tree& root, unsigned int thread_count = 0);
+
+#endif // BOOST_PKG_DEP_TREE_GRAPH_ALGORITHMS_HPP_INCLUDED_
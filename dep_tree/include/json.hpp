@@ -11,10 +11,37 @@
 #ifndef BOOST_PKG_DEP_TREE_JSON_HPP_INCLUDED_
 #define BOOST_PKG_DEP_TREE_JSON_HPP_INCLUDED_
 
+#include <vector>
+#include <istream>
 #include <ostream>
 #include <dep_tree.hpp>
 
-//! Serializes the tree into JSON format
-void serialize_json(dep_tree const& root, std::ostream& strm, bool with_rdeps = true, bool pretty_print = true, const char* indent = "\t");
+/*!
+ * Serializes the tree into JSON format. The node attributes, if any, are written in the "attrs" object of the node. If \a thread_count is not 1, the tree is split into subtrees that are serialized concurrently
+ * and written to the stream in order, so the output is the same regardless of the number of threads. If \a thread_count is 0,
+ * the number of threads is selected automatically.
+ */
+void serialize_json(dep_tree const& root, std::ostream& strm, bool with_rdeps = true, bool pretty_print = true, const char* indent = "\t", unsigned int thread_count = 0);
+
+/*!
+ * Serializes a part of the tree into JSON format: the subtree of \a node, except the subtrees of the \a excluded nodes. The document has
+ * the same structure as the document of the whole tree, the ancestors of \a node are written without their dependencies.
+ */
+void serialize_json_subtree(dep_node const& node, std::vector< dep_node const* > const& excluded, std::ostream& strm, bool with_rdeps = true, bool pretty_print = true, const char* indent = "\t");
+
+/*!
+ * Serializes the tree into the compact JSON format. Instead of nesting the nodes and naming the dependencies by full paths, the document
+ * has a table of the nodes, in which every node refers to its parent by index, and the dependencies are arrays of the node indices.
+ * The nodes are numbered in preorder. The node attributes, if any, are written in columns, which are arrays of the attribute values by node index.
+ */
+void serialize_compact_json(dep_tree const& root, std::ostream& strm, bool with_rdeps = true, bool pretty_print = true, const char* indent = "\t");
+
+/*!
+ * Reads the tree in JSON format, as written by \c serialize_json or \c serialize_compact_json, and adds the nodes to \a root. The format is
+ * detected by the document content. The nodes that already exist in the tree are merged with the read ones, so multiple parts of a tree
+ * can be read into one tree. The node attributes are read as well. The read tree has the same nodes and edges as the written one, but the nodes
+ * are created in a different order, so serializing it again may list the dependencies in a different order.
+ */
+void parse_json(std::istream& strm, dep_tree& root);
 
 #endif // BOOST_PKG_DEP_TREE_JSON_HPP_INCLUDED_
@@ -0,0 +1,86 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for writing the dependency tree in multiple JSON files, one per library, and loading them on demand
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_JSON_SHARDS_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_JSON_SHARDS_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/config.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/path.hpp>
+#include <dep_tree.hpp>
+
+//! Name of the shard index file in the output directory
+extern const char shard_index_file_name[];
+
+//! A part of the dependency tree that is stored in a separate file
+struct json_shard
+{
+    /*!
+     * Node path prefix of the shard, e.g. "libs/filesystem". The shard contains the nodes with this path prefix, except the nodes
+     * of the shards with longer prefixes. The shard with an empty prefix contains all nodes that don't belong to other shards.
+     */
+    std::string prefix;
+    //! File name, relative to the output directory
+    std::string file_name;
+};
+
+/*!
+ * The function writes the tree in JSON format to the directory: one file per library, one file for the nodes outside libraries and the index
+ * file that maps node path prefixes to the files. The file names are the library paths with \a suffix appended, the files are compressed
+ * if the suffix ends with .gz or .zst. The files are written concurrently. If \a thread_count is 0, the number of threads is selected automatically.
+ */
+void write_json_shards(dep_tree& root, boost::filesystem::path const& dir, std::string const& suffix = ".json", unsigned int thread_count = 0);
+
+/*!
+ * Dependency tree, which is written with \c write_json_shards and is loaded one shard at a time, as the nodes are requested. A loaded shard
+ * contains the dependencies and the dependents of all its nodes, the nodes they refer to are added to the tree without loading their shards.
+ */
+class sharded_dep_tree
+{
+private:
+    boost::filesystem::path m_dir;
+    //! Shards, ordered by prefix
+    std::vector< json_shard > m_shards;
+    std::vector< bool > m_loaded;
+    dep_tree m_root;
+
+public:
+    //! Reads the shard index in the directory. No shards are loaded.
+    explicit sharded_dep_tree(boost::filesystem::path const& dir);
+
+    //! Returns the shards
+    std::vector< json_shard > const& get_shards() const BOOST_NOEXCEPT { return m_shards; }
+    //! Returns the index of the shard that contains the node with the specified path
+    std::size_t find_shard(boost::string_ref const& path) const BOOST_NOEXCEPT;
+    //! Checks if the shard is loaded
+    bool is_loaded(std::size_t shard) const { return m_loaded[shard]; }
+
+    //! Loads the shard, if it is not loaded yet
+    void load_shard(std::size_t shard);
+    //! Loads all shards
+    void load_all();
+
+    /*!
+     * Returns the node with the specified path, with its dependencies and dependents, or \c NULL if there is no such node. The shard of
+     * the node is loaded, if needed. The children of the node are only complete if the node is within a library or if all shards are loaded.
+     */
+    dep_node* find_node(boost::string_ref const& path);
+
+    //! Returns the loaded part of the tree
+    dep_tree& get_tree() BOOST_NOEXCEPT { return m_root; }
+
+    BOOST_DELETED_FUNCTION(sharded_dep_tree(sharded_dep_tree const&))
+    BOOST_DELETED_FUNCTION(sharded_dep_tree& operator=(sharded_dep_tree const&))
+};
+
+#endif // BOOST_PKG_DEP_TREE_JSON_SHARDS_HPP_INCLUDED_
@@ -0,0 +1,72 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the library dependency graph
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_LIBRARY_GRAPH_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_LIBRARY_GRAPH_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/filesystem/path.hpp>
+#include <dep_tree.hpp>
+
+//! Name of the top level node that contains Boost libraries
+extern const char libraries_root_name[];
+
+/*!
+ * Library dependency graph. A library is a directory under \c libs that has an \c include subdirectory, like \c libs/filesystem or
+ * \c libs/numeric/conversion. The library depends on another library if any of its files depends on a file of the other library.
+ */
+struct library_graph
+{
+    //! Library description
+    struct library
+    {
+        //! Library name, which is the path of the library directory relative to \c libs, e.g. "numeric/conversion"
+        std::string name;
+        //! The library directory node
+        dep_node* node;
+        //! Indices of the libraries this library depends on, ordered and without duplicates
+        std::vector< std::size_t > dependencies;
+
+        library() : node(NULL) {}
+        library(std::string const& n, dep_node* nd) : name(n), node(nd) {}
+    };
+
+    //! Libraries, ordered by name
+    std::vector< library > libraries;
+    //! The index of the library every node of the library directories belongs to
+    boost::unordered_map< dep_node const*, std::size_t > node_libraries;
+
+    //! Returns the index of the library the node belongs to or -1 if the node does not belong to a library
+    std::size_t find_library(dep_node const* node) const
+    {
+        boost::unordered_map< dep_node const*, std::size_t >::const_iterator it = node_libraries.find(node);
+        if (it != node_libraries.end())
+            return it->second;
+        return static_cast< std::size_t >(-1);
+    }
+};
+
+//! The function detects libraries in the tree and builds the graph of dependencies between them
+void build_library_graph(dep_tree& root, library_graph& graph);
+
+//! The function stores the name of the library every node of the library directories belongs to in the \c library attribute
+void assign_library_attributes(library_graph const& graph, node_attributes& attributes);
+
+//! The function removes the dependencies between libraries that are implied by other dependencies. If \a thread_count is 0, the number of threads is selected automatically.
+void reduce_library_dependencies(library_graph& graph, unsigned int thread_count = 0);
+
+//! The function computes the total size of the files of every library, in bytes. The tree nodes are assumed to be named relative to \a boost_root.
+std::vector< boost::uintmax_t > compute_library_sizes(library_graph const& graph, boost::filesystem::path const& boost_root);
+
+#endif // BOOST_PKG_DEP_TREE_LIBRARY_GRAPH_HPP_INCLUDED_
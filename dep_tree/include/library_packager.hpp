@@ -0,0 +1,60 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for packaging the files of every library into an archive
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_LIBRARY_PACKAGER_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_LIBRARY_PACKAGER_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <library_graph.hpp>
+#include <compressed_stream.hpp>
+
+//! Packaging parameters
+struct package_params
+{
+    boost::filesystem::path boost_root;
+    //! The directory to create the packages in
+    boost::filesystem::path target_dir;
+    //! Compression of the archives
+    compression_format compression;
+    //! If 0, the number of threads is selected automatically
+    unsigned int thread_count;
+
+    package_params() : compression(no_compression), thread_count(0u) {}
+};
+
+//! Packaging statistics
+struct package_stats
+{
+    std::size_t libraries;
+    std::size_t files;
+    boost::uintmax_t bytes;
+    //! The bytes that were copied into the archives by the kernel, without passing through the user space
+    boost::uintmax_t sent_bytes;
+
+    package_stats() : libraries(0u), files(0u), bytes(0u), sent_bytes(0u) {}
+};
+
+//! Returns the package name of the library, which is the library name with the path separators replaced with underscores, e.g. "numeric_conversion"
+std::string make_package_name(std::string const& library_name);
+
+/*!
+ * The function creates a package for every library in the target directory: a tar archive of the library files, named after the package
+ * (e.g. "numeric_conversion.tar.gz"), and a JSON manifest with the list of the archived files and the libraries the library depends on
+ * (e.g. "numeric_conversion.json"). The files are archived with their paths relative to Boost root. The tree nodes are assumed to be
+ * named relative to \c params.boost_root.
+ *
+ * The libraries are packaged concurrently. The file data of uncompressed archives is copied by the kernel, when possible.
+ */
+void package_libraries(library_graph const& graph, package_params const& params, package_stats& stats);
+
+#endif // BOOST_PKG_DEP_TREE_LIBRARY_PACKAGER_HPP_INCLUDED_
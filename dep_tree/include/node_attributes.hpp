@@ -0,0 +1,129 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the per-node attributes of the dependency tree
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_NODE_ATTRIBUTES_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_NODE_ATTRIBUTES_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <content_digest.hpp>
+
+/*!
+ * Column of a node attribute, indexed by the node identifier. The values are stored densely, so they can be aggregated by iterating over
+ * \c values. The nodes that don't have the attribute have default-constructed values, which are marked as absent.
+ */
+template< typename T >
+class attribute_column
+{
+public:
+    typedef T value_type;
+
+private:
+    std::vector< T > m_values;
+    std::vector< bool > m_present;
+    std::size_t m_count;
+
+public:
+    attribute_column() : m_count(0u) {}
+
+    //! Returns the values for all node identifiers up to \c size
+    std::vector< T > const& values() const { return m_values; }
+    //! Returns the number of node identifiers the column covers
+    std::size_t size() const { return m_values.size(); }
+    //! Returns the number of nodes that have the attribute
+    std::size_t count() const { return m_count; }
+    //! Returns \c true if no node has the attribute
+    bool empty() const { return m_count == 0u; }
+
+    //! Checks if the node has the attribute
+    bool has(std::size_t id) const { return id < m_present.size() && m_present[id]; }
+    //! Returns the attribute value of the node. The node must have the attribute.
+    T const& get(std::size_t id) const
+    {
+        BOOST_ASSERT(has(id));
+        return m_values[id];
+    }
+
+    //! Sets the attribute value of the node
+    void set(std::size_t id, T const& value)
+    {
+        if (id >= m_values.size())
+        {
+            m_values.resize(id + 1u);
+            m_present.resize(id + 1u);
+        }
+        if (!m_present[id])
+        {
+            m_present[id] = true;
+            ++m_count;
+        }
+        m_values[id] = value;
+    }
+
+    //! Removes the attribute value of the node
+    void reset(std::size_t id)
+    {
+        if (has(id))
+        {
+            m_present[id] = false;
+            m_values[id] = T();
+            --m_count;
+        }
+    }
+};
+
+/*!
+ * Attributes of the tree nodes, stored in columns indexed by the node identifier (see \c dep_node::get_id). Every tree has its attributes,
+ * which are filled by scanning, if requested, and are written to and read from the JSON formats. All attributes are optional.
+ *
+ * The attributes are not thread-safe, like the tree.
+ */
+class node_attributes
+{
+public:
+    //! File size, in bytes
+    attribute_column< boost::uint64_t > file_size;
+    //! The number of lines in the file
+    attribute_column< boost::uint32_t > line_count;
+    //! File modification time, in seconds since the epoch
+    attribute_column< boost::int64_t > mtime;
+    //! File content digest
+    attribute_column< content_digest > content_hash;
+    //! Index of the name of the library the node belongs to, see \c get_library_name
+    attribute_column< boost::uint32_t > library;
+    //! Time spent on reading and lexing the file, in microseconds
+    attribute_column< boost::uint32_t > parse_time;
+
+private:
+    std::vector< std::string > m_library_names;
+    boost::unordered_map< std::string, boost::uint32_t > m_library_indices;
+
+public:
+    //! Returns \c true if no node has any attributes
+    bool empty() const;
+    //! Checks if the node has any attributes
+    bool has_any(std::size_t id) const;
+
+    //! Returns the library name by the index stored in \c library
+    std::string const& get_library_name(boost::uint32_t index) const { return m_library_names[index]; }
+    //! Returns the names of the libraries, by index
+    std::vector< std::string > const& get_library_names() const { return m_library_names; }
+    //! Sets the library of the node, by name
+    void set_library(std::size_t id, std::string const& name);
+
+    //! Copies the attributes of the node \a from_id from another set of attributes to the node \a to_id. The attributes the source node doesn't have are preserved.
+    void copy_node(node_attributes const& from, std::size_t from_id, std::size_t to_id);
+};
+
+#endif // BOOST_PKG_DEP_TREE_NODE_ATTRIBUTES_HPP_INCLUDED_
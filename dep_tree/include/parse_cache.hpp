@@ -0,0 +1,70 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the cache of the C++ parsing results
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_PARSE_CACHE_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_PARSE_CACHE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <boost/unordered_map.hpp>
+#include <boost/filesystem/path.hpp>
+#include <content_digest.hpp>
+#include <cxx_parser.hpp>
+
+/*!
+ * The cache of include directives extracted from C++ files. The cache is keyed by the file content digest, so it does not depend
+ * on the file location and can be shared between different trees and Boost versions, as long as they are parsed with the same
+ * lexer version. A cache file written with a different lexer version or format is discarded on loading. Resolving the include
+ * directives to files depends on the file location and is not cached.
+ *
+ * The files that are known to be unmodified since they were added to a git index can also be looked up by the git object identifier
+ * of their content, which does not require reading the file.
+ *
+ * The cache is not thread-safe.
+ */
+class parse_cache
+{
+public:
+    //! Include directives of a file
+    typedef std::vector< cxx_include_directive > includes;
+
+private:
+    typedef boost::unordered_map< content_digest, includes, content_digest_hash > entries;
+    typedef boost::unordered_map< git_object_id, includes, content_digest_hash > object_entries;
+
+private:
+    entries m_entries;
+    object_entries m_object_entries;
+    bool m_modified;
+
+public:
+    parse_cache();
+
+    //! Looks up the include directives for the file content. Returns \c true if the content is found in the cache.
+    bool find(content_digest const& digest, includes& incs) const;
+    //! Adds the include directives for the file content
+    void insert(content_digest const& digest, includes const& incs);
+    //! Looks up the include directives for the file content by its git object identifier. Returns \c true if the content is found in the cache.
+    bool find(git_object_id const& id, includes& incs) const;
+    //! Adds the include directives for the file content with the git object identifier
+    void insert(git_object_id const& id, includes const& incs);
+
+    //! Returns the number of files in the cache
+    std::size_t size() const { return m_entries.size() + m_object_entries.size(); }
+    //! Returns \c true if the cache has been modified since the last load or save
+    bool is_modified() const { return m_modified; }
+
+    //! Loads the cache from the file. The loaded entries are added to the cache. Does nothing if the file does not exist or was written by a different version.
+    void load(boost::filesystem::path const& path);
+    //! Saves the cache to the file. The entries that are already stored in the file are preserved, so the file can be shared between runs.
+    void save(boost::filesystem::path const& path);
+};
+
+#endif // BOOST_PKG_DEP_TREE_PARSE_CACHE_HPP_INCLUDED_
@@ -0,0 +1,94 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for recommending precompiled headers
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_PCH_ADVISOR_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_PCH_ADVISOR_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <dep_tree.hpp>
+
+//! Precompiled header recommendation parameters
+struct pch_params
+{
+    //! Boost root directory, the tree nodes are named relative to it
+    boost::filesystem::path boost_root;
+    //! Name of the top level node that contains the files outside Boost root
+    std::string external_root;
+    //! Maximum total size of the headers in the precompiled header, including the headers they include, in bytes
+    boost::uintmax_t budget;
+    //! The number of the best scored headers to report
+    std::size_t top_header_count;
+
+    pch_params() : budget(16u * 1024u * 1024u), top_header_count(20u) {}
+};
+
+//! Header statistics
+struct pch_header
+{
+    dep_node const* node;
+    //! The number of translation units that include the header, directly or indirectly
+    std::size_t fan_in;
+    //! Total size of the header and all headers it includes, each header is counted once
+    boost::uintmax_t weight;
+    //! The number of bytes the header saves from parsing in all translation units. For the selected headers, only the headers not included by the previously selected headers are counted.
+    boost::uintmax_t gain;
+
+    pch_header() : node(NULL), fan_in(0u), weight(0u), gain(0u) {}
+};
+
+//! Translation unit statistics
+struct pch_translation_unit
+{
+    dep_node const* node;
+    //! Total size of all headers included by the translation unit, directly or indirectly
+    boost::uintmax_t included_bytes;
+    //! Total size of the included headers that are in the precompiled header and don't need to be parsed
+    boost::uintmax_t saved_bytes;
+
+    pch_translation_unit() : node(NULL), included_bytes(0u), saved_bytes(0u) {}
+};
+
+//! Precompiled header recommendation
+struct pch_recommendation
+{
+    //! Budget that was used for the recommendation
+    boost::uintmax_t budget;
+    //! The headers to put in the precompiled header, in the order of selection
+    std::vector< pch_header > headers;
+    //! Total size of the headers in the precompiled header, including the headers they include
+    boost::uintmax_t size;
+    //! Total size of the headers that don't need to be parsed, in all translation units
+    boost::uintmax_t saved_bytes;
+    //! The best scored headers, regardless of the budget. The score is the fan-in multiplied by the weight.
+    std::vector< pch_header > top_headers;
+    //! Statistics of every translation unit
+    std::vector< pch_translation_unit > translation_units;
+
+    pch_recommendation() : budget(0u), size(0u), saved_bytes(0u) {}
+};
+
+/*!
+ * The function recommends a set of headers to precompile for the translation units. The headers are scored by fan-in (the number of
+ * translation units that include the header) multiplied by weight (the total size of the header with the headers it includes).
+ * The headers are selected greedily by the number of bytes they save from parsing across all translation units, considering the
+ * headers that are already selected, until the budget is exhausted. Only the headers included by at least two translation units are
+ * considered.
+ */
+void recommend_pch(std::vector< dep_node* > const& translation_units, pch_params const& params, pch_recommendation& result);
+
+//! Serializes the precompiled header recommendation into JSON format
+void serialize_pch_recommendation_json(pch_recommendation const& recommendation, std::ostream& strm, bool pretty_print = true, const char* indent = "\t");
+
+#endif // BOOST_PKG_DEP_TREE_PCH_ADVISOR_HPP_INCLUDED_
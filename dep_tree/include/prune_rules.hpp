@@ -0,0 +1,102 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the rules that prune directories and files from scanning
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_PRUNE_RULES_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_PRUNE_RULES_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/path.hpp>
+
+/*!
+ * Path pattern rules that exclude directories and files from scanning. Every rule is a path relative to Boost root, with '/' separators.
+ * A path component may contain '*', which matches any number of characters, and '?', which matches one character. A "**" component
+ * matches any number of path components, including none. A rule without separators matches the directory or file name at any depth,
+ * as if it was preceded with a "**" component. A rule starting with '!' is a negation: the matching paths are not pruned, even if they
+ * are within a pruned directory. The last matching rule wins, and the paths that no rule matches inherit the decision of their parent
+ * directory.
+ *
+ * The rules are compiled into a trie of path components, which is matched incrementally as the directories are descended, so checking
+ * a directory entry takes one step from the state of its directory. A pruned directory is not descended into, unless a negation rule
+ * may match a path within it.
+ */
+class prune_rules
+{
+public:
+    //! Matching state for a path
+    struct state
+    {
+        //! The active trie nodes, ordered
+        std::vector< std::size_t > nodes;
+        //! Whether the path is pruned
+        bool pruned;
+
+        state() : pruned(false) {}
+    };
+
+private:
+    //! Trie node, which corresponds to a path component pattern
+    struct trie_node
+    {
+        //! Children by literal component
+        std::vector< std::pair< std::string, std::size_t > > literal_children;
+        //! Children by component wildcard
+        std::vector< std::pair< std::string, std::size_t > > wildcard_children;
+        //! The "**" child or -1
+        std::size_t globstar_child;
+        //! Whether the node is a "**" component, which loops on any component
+        bool is_globstar;
+        //! The index of the last rule ending at the node or -1
+        std::size_t rule;
+        bool negated;
+        //! Whether a negation rule may match a path below the paths that match the node
+        bool negation_below;
+
+        trie_node() : globstar_child(static_cast< std::size_t >(-1)), is_globstar(false), rule(static_cast< std::size_t >(-1)), negated(false), negation_below(false) {}
+    };
+
+private:
+    std::vector< trie_node > m_nodes;
+    std::size_t m_rule_count;
+
+public:
+    prune_rules();
+
+    //! Returns \c true if there are no rules
+    bool empty() const { return m_rule_count == 0u; }
+
+    //! Adds a rule. Empty rules and comments, starting with '#', are ignored.
+    void add_rule(std::string const& rule);
+    //! Reads the rules from a file, one rule per line
+    void load(boost::filesystem::path const& file);
+
+    //! Returns the state for Boost root
+    void start(state& s) const;
+    //! Computes the state of the directory entry \a name from the state of the directory
+    void step(state const& from, boost::string_ref const& name, state& to) const;
+    //! Checks if the directory with the state is pruned together with everything within it
+    bool is_subtree_pruned(state const& s) const;
+
+    /*!
+     * Computes the state of the path relative to Boost root. Returns \c false if the path is within a directory that is pruned
+     * together with everything within it, which means the path is never reached by scanning.
+     */
+    bool match(boost::string_ref const& path, state& s) const;
+
+private:
+    std::size_t add_child(std::size_t parent, std::string const& component);
+    void close_globstars(std::vector< std::size_t >& nodes) const;
+    bool update_negation_below(std::size_t node);
+};
+
+#endif // BOOST_PKG_DEP_TREE_PRUNE_RULES_HPP_INCLUDED_
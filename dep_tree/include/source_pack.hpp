@@ -0,0 +1,199 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for the single-file source pack, which stores a scanned source tree
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_SOURCE_PACK_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_SOURCE_PACK_HPP_INCLUDED_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/config.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <filesystem_ext.hpp>
+#include <prune_rules.hpp>
+
+//! Source pack creation parameters
+struct source_pack_params
+{
+    //! The directory to pack, normally Boost root
+    boost::filesystem::path boost_root;
+    //! The directories in the packed directory that are not packed
+    std::vector< boost::filesystem::path > skip_root_dirs;
+    //! The rules that prune directories and files from the pack
+    prune_rules prune;
+    //! The contents are stored for the files that are parsed as C++ with these wildcards, only the sizes are stored for other files
+    std::vector< std::string > cxx_wildcards;
+
+    source_pack_params();
+};
+
+//! Source pack creation statistics
+struct source_pack_stats
+{
+    std::size_t directories;
+    std::size_t files;
+    std::size_t symlinks;
+    //! The total size of the stored file contents
+    boost::uintmax_t content_bytes;
+    //! The size of the pack file
+    boost::uintmax_t pack_bytes;
+
+    source_pack_stats() : directories(0u), files(0u), symlinks(0u), content_bytes(0u), pack_bytes(0u) {}
+};
+
+/*!
+ * The function packs the directory tree into a single file. The pack contains the directories, the regular files and the symlinks,
+ * without following them. The pack consists of a header, the table of the entries, the names of the entries and the contents of
+ * the files, stored back to back. The entries are numbered in breadth-first order, so the entries of every directory are adjacent
+ * and ordered by name, and every directory is looked up by binary search. The pack is written in the native byte order
+ * and is meant to be mapped into memory, on the host it was created on or a host with the same byte order.
+ */
+void create_source_pack(source_pack_params const& params, boost::filesystem::path const& pack_file, source_pack_stats& stats);
+
+/*!
+ * Memory mapped source pack. The pack is mounted at a directory, which is Boost root the pack was created from, unless the pack
+ * is mounted elsewhere, and the paths within the mount point are looked up in the pack instead of the filesystem. The pack
+ * does not have to be mounted at an existing directory.
+ *
+ * The pack is immutable, so it can be used from multiple threads concurrently.
+ */
+class source_pack
+{
+public:
+    //! Entry identifier
+    typedef boost::uint32_t entry_id;
+
+    //! Entry identifier that does not refer to an entry
+    static BOOST_CONSTEXPR_OR_CONST entry_id invalid_entry = static_cast< entry_id >(-1);
+    //! Identifier of the root directory
+    static BOOST_CONSTEXPR_OR_CONST entry_id root_entry = 0u;
+
+    //! Entry type
+    enum entry_type
+    {
+        directory = 1,
+        regular_file = 2,
+        symlink = 3
+    };
+
+    //! Entry record, as stored in the pack
+    struct entry_record
+    {
+        //! The offset of the content or the symlink target in the data section
+        boost::uint64_t data_offset;
+        //! The file size, or the size of the symlink target
+        boost::uint64_t size;
+        //! The offset of the name in the names section
+        boost::uint32_t name_offset;
+        boost::uint32_t name_size;
+        //! The directory containing the entry
+        entry_id parent;
+        //! The entries of the directory
+        entry_id first_child;
+        boost::uint32_t child_count;
+        //! The value of \c entry_type
+        boost::uint8_t type;
+        //! Entry flags, see \c has_content_flag
+        boost::uint8_t flags;
+        boost::uint16_t reserved;
+    };
+
+    //! Pack header
+    struct header
+    {
+        char magic[8];
+        boost::uint32_t version;
+        //! The value of \c byte_order_mark, as written by the host that created the pack
+        boost::uint32_t byte_order;
+        boost::uint32_t entry_count;
+        //! The size of the path of the packed directory, which is stored at the beginning of the names section
+        boost::uint32_t root_size;
+        boost::uint64_t entries_offset;
+        boost::uint64_t names_offset;
+        boost::uint64_t names_size;
+        boost::uint64_t data_offset;
+        boost::uint64_t data_size;
+    };
+
+    //! The flag of the regular files with the content stored in the pack
+    static BOOST_CONSTEXPR_OR_CONST boost::uint8_t has_content_flag = 1u;
+    static BOOST_CONSTEXPR_OR_CONST boost::uint32_t current_version = 1u;
+    static BOOST_CONSTEXPR_OR_CONST boost::uint32_t byte_order_mark = 0x01020304u;
+
+private:
+    boost::filesystem::path m_file;
+    boost::iostreams::mapped_file_source m_mapping;
+    header const* m_header;
+    entry_record const* m_entries;
+    const char* m_names;
+    const char* m_data;
+    boost::filesystem::path m_root;
+    canonical_root m_mount_point;
+
+public:
+    //! Opens and validates the pack. The pack is mounted at the directory it was created from.
+    explicit source_pack(boost::filesystem::path const& file);
+
+    //! Returns the path of the directory the pack was created from
+    boost::filesystem::path const& root() const { return m_root; }
+    //! Returns the directory the pack is mounted at
+    canonical_root const& mount_point() const { return m_mount_point; }
+    //! Mounts the pack at the directory
+    void mount(boost::filesystem::path const& dir) { m_mount_point = canonical_root(dir); }
+
+    //! Returns the number of entries, including the root directory
+    std::size_t size() const { return m_header->entry_count; }
+
+    //! Checks if the path is within the mount point. The path must be absolute and normalized.
+    bool contains(boost::string_ref const& path) const { return m_mount_point.contains(path); }
+    /*!
+     * Looks up the path, which must be absolute, normalized and within the mount point. The symlinks within the pack are followed,
+     * except the last element of the path if \a follow_last is \c false. Returns \c invalid_entry if the path is not found or
+     * leads outside the pack.
+     */
+    entry_id find(boost::string_ref const& path, bool follow_last = true) const;
+    //! Looks up the path relative to the mount point, like \c find
+    entry_id find_relative(boost::string_ref const& relative_path, bool follow_last = true) const;
+
+    entry_type type(entry_id id) const { return static_cast< entry_type >(m_entries[id].type); }
+    //! Returns the file type of the entry, as it would be reported by \c boost::filesystem::symlink_status
+    boost::filesystem::file_type file_type(entry_id id) const;
+    boost::string_ref name(entry_id id) const { return boost::string_ref(m_names + m_entries[id].name_offset, m_entries[id].name_size); }
+    entry_id parent(entry_id id) const { return m_entries[id].parent; }
+    //! Returns the first entry of the directory. The entries of the directory are adjacent and ordered by name.
+    entry_id first_child(entry_id id) const { return m_entries[id].first_child; }
+    std::size_t child_count(entry_id id) const { return m_entries[id].child_count; }
+
+    //! Returns the size of the file
+    boost::uintmax_t file_size(entry_id id) const { return m_entries[id].size; }
+    //! Checks if the content of the file is stored in the pack
+    bool has_content(entry_id id) const { return (m_entries[id].flags & has_content_flag) != 0u; }
+    //! Returns the content of the file. The content is only valid while the pack is alive.
+    boost::string_ref content(entry_id id) const { return boost::string_ref(m_data + m_entries[id].data_offset, static_cast< std::size_t >(m_entries[id].size)); }
+    //! Returns the target of the symlink
+    boost::string_ref symlink_target(entry_id id) const { return content(id); }
+
+    BOOST_DELETED_FUNCTION(source_pack(source_pack const&))
+    BOOST_DELETED_FUNCTION(source_pack& operator=(source_pack const&))
+
+private:
+    //! Looks up the child of the directory by name
+    entry_id find_child(entry_id dir, boost::string_ref const& name) const;
+    //! Returns the path of the entry relative to the pack root
+    std::string relative_path(entry_id id) const;
+    //! Checks that the offsets and sizes in the pack are within the pack file
+    void validate() const;
+};
+
+#endif // BOOST_PKG_DEP_TREE_SOURCE_PACK_HPP_INCLUDED_
@@ -0,0 +1,108 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for tracing the time spent in the processing stages
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_TRACE_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_TRACE_HPP_INCLUDED_
+
+#include <string>
+#include <ostream>
+#include <boost/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/atomic/atomic.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/path.hpp>
+
+//! The flag indicates whether trace events are collected
+extern boost::atomic< bool > trace_enabled;
+
+//! Returns \c true if trace events are collected
+inline bool is_tracing_enabled()
+{
+    return trace_enabled.load(boost::memory_order_relaxed);
+}
+
+//! Starts collecting trace events
+void enable_tracing();
+
+//! Returns the trace timestamp, in microseconds since tracing was enabled
+boost::uint64_t get_trace_timestamp();
+
+//! Records the event in the buffer of the calling thread. The category and name must be string literals.
+void record_trace_event(const char* category, const char* name, std::string const& detail, boost::uint64_t start, boost::uint64_t end);
+
+//! Sets the name of the calling thread, as it is displayed in the trace
+void set_trace_thread_name(std::string const& name);
+
+/*!
+ * Stops collecting trace events and writes the collected events in Chrome trace event format. Every thread has its own timeline.
+ * Must not be called while other threads are recording events.
+ */
+void write_trace_json(std::ostream& strm);
+
+/*!
+ * Scoped trace span. If tracing is enabled, the time between construction and destruction of the span is recorded as a trace event
+ * of the calling thread. The spans are cheap when tracing is disabled, the detail string is not constructed in this case.
+ */
+class trace_span
+{
+private:
+    const char* m_category;
+    const char* m_name;
+    std::string m_detail;
+    boost::uint64_t m_start;
+    bool m_enabled;
+
+public:
+    trace_span(const char* category, const char* name) : m_category(category), m_name(name), m_start(0u), m_enabled(is_tracing_enabled())
+    {
+        if (m_enabled)
+            m_start = get_trace_timestamp();
+    }
+
+    //! Creates a span with a detail string, such as the processed file name
+    trace_span(const char* category, const char* name, boost::string_ref const& detail) : m_category(category), m_name(name), m_start(0u), m_enabled(is_tracing_enabled())
+    {
+        if (m_enabled)
+        {
+            m_detail.assign(detail.data(), detail.size());
+            m_start = get_trace_timestamp();
+        }
+    }
+
+    trace_span(const char* category, const char* name, std::string const& detail) : m_category(category), m_name(name), m_start(0u), m_enabled(is_tracing_enabled())
+    {
+        if (m_enabled)
+        {
+            m_detail = detail;
+            m_start = get_trace_timestamp();
+        }
+    }
+
+    //! Creates a span for processing a file or directory
+    trace_span(const char* category, const char* name, boost::filesystem::path const& detail) : m_category(category), m_name(name), m_start(0u), m_enabled(is_tracing_enabled())
+    {
+        if (m_enabled)
+        {
+            m_detail = detail.string();
+            m_start = get_trace_timestamp();
+        }
+    }
+
+    ~trace_span()
+    {
+        if (m_enabled)
+            record_trace_event(m_category, m_name, m_detail, m_start, get_trace_timestamp());
+    }
+
+    BOOST_DELETED_FUNCTION(trace_span(trace_span const&))
+    BOOST_DELETED_FUNCTION(trace_span& operator=(trace_span const&))
+};
+
+#endif // BOOST_PKG_DEP_TREE_TRACE_HPP_INCLUDED_
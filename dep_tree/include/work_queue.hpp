@@ -0,0 +1,65 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines interface for processing independent work items in a pool of worker threads
+ */
+
+#ifndef BOOST_PKG_DEP_TREE_WORK_QUEUE_HPP_INCLUDED_
+#define BOOST_PKG_DEP_TREE_WORK_QUEUE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <boost/config.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic/atomic.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+/*!
+ * The class hands out the indices of the work items to the worker threads. Every worker takes the items with \c pop until there are no more items left.
+ * When a worker throws, the remaining items are skipped and the first exception is rethrown from \c run after all workers have stopped.
+ */
+class work_queue
+{
+public:
+    //! Worker thread function
+    typedef boost::function< void () > worker_function;
+
+private:
+    const std::size_t m_item_count;
+    boost::atomic< std::size_t > m_next;
+    boost::mutex m_mutex;
+    boost::exception_ptr m_error;
+
+public:
+    explicit work_queue(std::size_t item_count) : m_item_count(item_count), m_next(0u)
+    {
+    }
+
+    //! Returns the number of the work items
+    std::size_t size() const { return m_item_count; }
+
+    //! Takes the next work item. Returns \c false if there are no more items.
+    bool pop(std::size_t& index)
+    {
+        index = m_next.fetch_add(1u, boost::memory_order_relaxed);
+        return index < m_item_count;
+    }
+
+    /*!
+     * Runs the worker function in the worker threads and waits for them to complete. If \a thread_count is 0, the number of threads is selected
+     * automatically. No more threads than the work items are started. If \a thread_name is not \c NULL, it is displayed in the trace for the worker threads.
+     */
+    void run(unsigned int thread_count, const char* thread_name, worker_function const& worker);
+
+    BOOST_DELETED_FUNCTION(work_queue(work_queue const&))
+    BOOST_DELETED_FUNCTION(work_queue& operator=(work_queue const&))
+
+private:
+    void run_worker(const char* thread_name, worker_function const& worker);
+};
+
+#endif // BOOST_PKG_DEP_TREE_WORK_QUEUE_HPP_INCLUDED_
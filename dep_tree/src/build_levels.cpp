@@ -0,0 +1,212 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of computing library build order
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/assert.hpp>
+#include <boost/lexical_cast.hpp>
+#include <build_levels.hpp>
+#include <graph_algorithms.hpp>
+
+namespace {
+
+const std::size_t invalid_index = static_cast< std::size_t >(-1);
+
+//! Finds groups of libraries that depend on each other. The components are ordered so that dependencies come first, which is the build order.
+void find_components(library_graph const& graph, build_levels& levels)
+{
+    adjacency_list library_deps;
+    library_deps.reserve(graph.libraries.size());
+    for (std::vector< library_graph::library >::const_iterator it = graph.libraries.begin(), end = graph.libraries.end(); it != end; ++it)
+        library_deps.push_back(it->dependencies);
+
+    find_strongly_connected_components(library_deps, levels.components, levels.library_components);
+}
+
+//! Appends the member libraries of the components to the list
+void append_component_libraries(build_levels const& levels, std::vector< std::size_t > const& components, std::vector< std::size_t >& libs)
+{
+    for (std::vector< std::size_t >::const_iterator it = components.begin(), end = components.end(); it != end; ++it)
+    {
+        std::vector< std::size_t > const& members = levels.components[*it];
+        libs.insert(libs.end(), members.begin(), members.end());
+    }
+}
+
+//! Serializes a list of library names
+void serialize_library_list(library_graph const& graph, std::vector< std::size_t > const& libs, std::string const& newline_indent, std::string const& indent, std::string& strm)
+{
+    std::string nested_newline_indent = newline_indent + indent;
+
+    strm.append(newline_indent).append(1, '[');
+
+    bool is_first = true;
+    for (std::vector< std::size_t >::const_iterator it = libs.begin(), end = libs.end(); it != end; ++it)
+    {
+        if (!is_first)
+            strm.push_back(',');
+        else
+            is_first = false;
+        strm.append(nested_newline_indent).append(1, '"').append(graph.libraries[*it].name).append(1, '"');
+    }
+
+    strm.append(newline_indent).append(1, ']');
+}
+
+} // namespace
+
+//! The function computes the build levels and the critical path for the library graph
+void compute_build_levels(library_graph const& graph, std::vector< boost::uintmax_t > const& weights, build_levels& levels)
+{
+    BOOST_ASSERT(weights.empty() || weights.size() == graph.libraries.size());
+
+    levels = build_levels();
+    find_components(graph, levels);
+
+    if (weights.empty())
+        levels.library_weights.assign(graph.libraries.size(), 1u);
+    else
+        levels.library_weights = weights;
+
+    const std::size_t component_count = levels.components.size();
+    levels.component_dependencies.resize(component_count);
+    levels.component_levels.assign(component_count, 0u);
+    levels.component_weights.assign(component_count, 0u);
+
+    // Critical path lengths, including the component itself, and the next component in the path towards the first component to build
+    std::vector< boost::uintmax_t > path_weights(component_count, 0u);
+    std::vector< std::size_t > path_next(component_count, invalid_index);
+    std::size_t path_end = invalid_index;
+
+    // Components are ordered so that dependencies come first, so a single pass is enough
+    for (std::size_t component = 0; component < component_count; ++component)
+    {
+        std::vector< std::size_t > const& members = levels.components[component];
+        std::vector< std::size_t >& component_deps = levels.component_dependencies[component];
+        for (std::vector< std::size_t >::const_iterator it = members.begin(), end = members.end(); it != end; ++it)
+        {
+            levels.component_weights[component] += levels.library_weights[*it];
+
+            std::vector< std::size_t > const& deps = graph.libraries[*it].dependencies;
+            for (std::vector< std::size_t >::const_iterator dep_it = deps.begin(), dep_end = deps.end(); dep_it != dep_end; ++dep_it)
+            {
+                const std::size_t dep_component = levels.library_components[*dep_it];
+                if (dep_component != component)
+                    component_deps.push_back(dep_component);
+            }
+        }
+
+        std::sort(component_deps.begin(), component_deps.end());
+        component_deps.erase(std::unique(component_deps.begin(), component_deps.end()), component_deps.end());
+
+        std::size_t& level = levels.component_levels[component];
+        for (std::vector< std::size_t >::const_iterator it = component_deps.begin(), end = component_deps.end(); it != end; ++it)
+        {
+            BOOST_ASSERT(*it < component);
+            level = (std::max)(level, levels.component_levels[*it] + 1u);
+            if (path_next[component] == invalid_index || path_weights[*it] > path_weights[path_next[component]])
+                path_next[component] = *it;
+        }
+
+        path_weights[component] = levels.component_weights[component];
+        if (path_next[component] != invalid_index)
+            path_weights[component] += path_weights[path_next[component]];
+
+        if (path_end == invalid_index || path_weights[component] > path_weights[path_end])
+            path_end = component;
+
+        if (levels.levels.size() <= level)
+            levels.levels.resize(level + 1u);
+        levels.levels[level].push_back(component);
+    }
+
+    if (path_end != invalid_index)
+    {
+        levels.critical_path_weight = path_weights[path_end];
+        for (std::size_t component = path_end; component != invalid_index; component = path_next[component])
+            levels.critical_path.push_back(component);
+        std::reverse(levels.critical_path.begin(), levels.critical_path.end());
+    }
+}
+
+//! Serializes the build levels into JSON format
+void serialize_build_levels_json(library_graph const& graph, build_levels const& levels, std::ostream& strm, bool pretty_print, const char* indent)
+{
+    std::string nl_ind, ind;
+    const char* space = "";
+    if (pretty_print)
+    {
+        ind = indent;
+        nl_ind = "\n" + ind;
+        space = " ";
+    }
+    std::string nl_ind2 = nl_ind + ind, nl_ind3 = nl_ind2 + ind;
+
+    std::string text;
+    text.append(1, '{');
+
+    // Every library with its dependencies, so that the builder is able to start building a library as soon as its dependencies are built
+    text.append(nl_ind).append("\"libraries\":").append(nl_ind).append(1, '{');
+    for (std::size_t i = 0, n = graph.libraries.size(); i < n; ++i)
+    {
+        library_graph::library const& lib = graph.libraries[i];
+        if (i > 0u)
+            text.push_back(',');
+        text.append(nl_ind2).append(1, '"').append(lib.name).append("\":").append(nl_ind2).append(1, '{');
+        text.append(nl_ind3).append("\"level\":").append(space).append(boost::lexical_cast< std::string >(levels.component_levels[levels.library_components[i]])).append(1, ',');
+        text.append(nl_ind3).append("\"weight\":").append(space).append(boost::lexical_cast< std::string >(levels.library_weights[i])).append(1, ',');
+        text.append(nl_ind3).append("\"deps\":");
+        serialize_library_list(graph, lib.dependencies, nl_ind3, ind, text);
+        text.append(nl_ind2).append(1, '}');
+    }
+    text.append(nl_ind).append("},");
+
+    text.append(nl_ind).append("\"levels\":").append(nl_ind).append(1, '[');
+    std::vector< std::size_t > libs;
+    for (std::vector< std::vector< std::size_t > >::const_iterator it = levels.levels.begin(), end = levels.levels.end(); it != end; ++it)
+    {
+        if (it != levels.levels.begin())
+            text.push_back(',');
+        libs.clear();
+        append_component_libraries(levels, *it, libs);
+        std::sort(libs.begin(), libs.end());
+        serialize_library_list(graph, libs, nl_ind2, ind, text);
+    }
+    text.append(nl_ind).append("],");
+
+    // Libraries that have to be built together
+    text.append(nl_ind).append("\"cycles\":").append(nl_ind).append(1, '[');
+    bool is_first = true;
+    for (std::vector< std::vector< std::size_t > >::const_iterator it = levels.components.begin(), end = levels.components.end(); it != end; ++it)
+    {
+        if (it->size() > 1u)
+        {
+            if (!is_first)
+                text.push_back(',');
+            else
+                is_first = false;
+            serialize_library_list(graph, *it, nl_ind2, ind, text);
+        }
+    }
+    text.append(nl_ind).append("],");
+
+    text.append(nl_ind).append("\"critical_path\":").append(nl_ind).append(1, '{');
+    text.append(nl_ind2).append("\"weight\":").append(space).append(boost::lexical_cast< std::string >(levels.critical_path_weight)).append(1, ',');
+    text.append(nl_ind2).append("\"libraries\":");
+    libs.clear();
+    append_component_libraries(levels, levels.critical_path, libs);
+    serialize_library_list(graph, libs, nl_ind2, ind, text);
+    text.append(nl_ind).append(1, '}');
+
+    text.append(pretty_print ? "\n}\n" : "}");
+    strm.write(text.data(), text.size());
+}
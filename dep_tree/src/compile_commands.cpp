@@ -0,0 +1,165 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation for reading compilation databases (compile_commands.json)
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <boost/optional.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/info.hpp>
+#include <boost/exception/enable_error_info.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <compile_commands.hpp>
+#include <cxx_parser.hpp>
+#include <filesystem_ext.hpp>
+#include <compressed_stream.hpp>
+
+namespace {
+
+//! Splits the command line into arguments, following the shell quoting rules
+void split_command_line(std::string const& command, std::vector< std::string >& args)
+{
+    std::string arg;
+    bool has_arg = false;
+    const char* p = command.c_str(), * const end = p + command.size();
+    while (p != end)
+    {
+        char c = *p++;
+        switch (c)
+        {
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            if (has_arg)
+            {
+                args.push_back(arg);
+                arg.clear();
+                has_arg = false;
+            }
+            break;
+
+        case '\'':
+            has_arg = true;
+            while (p != end && *p != '\'')
+                arg.push_back(*p++);
+            if (p != end)
+                ++p;
+            break;
+
+        case '"':
+            has_arg = true;
+            while (p != end && *p != '"')
+            {
+                c = *p++;
+                if (c == '\\' && p != end && (*p == '"' || *p == '\\'))
+                    c = *p++;
+                arg.push_back(c);
+            }
+            if (p != end)
+                ++p;
+            break;
+
+        case '\\':
+            has_arg = true;
+            if (p != end)
+                arg.push_back(*p++);
+            break;
+
+        default:
+            has_arg = true;
+            arg.push_back(c);
+            break;
+        }
+    }
+
+    if (has_arg)
+        args.push_back(arg);
+}
+
+//! Extracts include directories from the compiler arguments
+void extract_include_dirs(std::vector< std::string > const& args, boost::filesystem::path const& dir, std::vector< boost::filesystem::path >& include_dirs)
+{
+    static const char* const include_options[] =
+    {
+        "-I",
+        "-isystem",
+        "-iquote",
+        "-idirafter"
+    };
+
+    for (std::vector< std::string >::const_iterator it = args.begin(), end = args.end(); it != end; ++it)
+    {
+        std::string const& arg = *it;
+        for (std::size_t i = 0; i < sizeof(include_options) / sizeof(*include_options); ++i)
+        {
+            std::size_t option_len = std::strlen(include_options[i]);
+            if (arg.compare(0, option_len, include_options[i]) == 0)
+            {
+                std::string include_dir;
+                if (arg.size() > option_len)
+                    include_dir = arg.substr(option_len);
+                else if ((it + 1) != end)
+                    include_dir = *++it;
+                else
+                    break;
+
+                include_dirs.push_back(normalize_path(boost::filesystem::absolute(include_dir, dir)));
+                break;
+            }
+        }
+    }
+}
+
+} // namespace
+
+//! The function reads the compilation database and returns the scanning entries for the translation units described in it
+std::vector< scan_entry > read_compile_commands(boost::filesystem::path const& path)
+{
+    std::string path_str = path.string();
+    try
+    {
+        decompressing_ifstream file(path);
+        boost::property_tree::ptree database;
+        boost::property_tree::read_json(file, database);
+
+        std::vector< scan_entry > entries;
+        std::vector< std::string > args;
+        for (boost::property_tree::ptree::const_iterator it = database.begin(), end = database.end(); it != end; ++it)
+        {
+            boost::property_tree::ptree const& command = it->second;
+            boost::filesystem::path dir = boost::filesystem::absolute(command.get< std::string >("directory"), boost::filesystem::absolute(path).parent_path());
+
+            args.clear();
+            boost::optional< boost::property_tree::ptree const& > arguments = command.get_child_optional("arguments");
+            if (arguments)
+            {
+                for (boost::property_tree::ptree::const_iterator arg_it = arguments->begin(), arg_end = arguments->end(); arg_it != arg_end; ++arg_it)
+                    args.push_back(arg_it->second.data());
+            }
+            else
+            {
+                split_command_line(command.get< std::string >("command"), args);
+            }
+
+            entries.push_back(scan_entry(normalize_path(boost::filesystem::absolute(command.get< std::string >("file"), dir))));
+            extract_include_dirs(args, dir, entries.back().include_dirs);
+        }
+
+        return entries;
+    }
+    catch (boost::property_tree::ptree_error& e)
+    {
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error(std::string("Failed to read compilation database: ") + e.what())) << file_name_info(path_str));
+    }
+}
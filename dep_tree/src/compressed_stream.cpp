@@ -0,0 +1,244 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of reading and writing compressed files
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ios>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/version.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#if BOOST_VERSION >= 107000
+// zstd filters were added in Boost 1.70
+#include <boost/iostreams/filter/zstd.hpp>
+#define BOOST_PKG_DEP_TREE_HAS_ZSTD
+#endif
+#include <compressed_stream.hpp>
+#include <trace.hpp>
+
+namespace {
+
+//! The size of the blocks passed to the compression thread
+const std::size_t block_size = 1024u * 1024u;
+//! Maximum number of blocks waiting for compression. Limits memory consumption if compression is slower than producing the data.
+const std::size_t max_queued_blocks = 4u;
+
+} // namespace
+
+//! The function detects the compression format by the file name extension
+compression_format compression_from_file_name(boost::filesystem::path const& path)
+{
+    std::string ext = path.extension().string();
+    if (ext == ".gz")
+        return gzip_compression;
+    if (ext == ".zst")
+        return zstd_compression;
+    return no_compression;
+}
+
+//! Opens the file and starts the compression thread
+pipelined_compressor_buf::pipelined_compressor_buf(boost::filesystem::path const& path, compression_format format) : m_finished(false)
+{
+    std::string path_str = path.string();
+    boost::iostreams::file_sink sink(path_str, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!sink.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open output file: " + path_str));
+
+    switch (format)
+    {
+    case gzip_compression:
+        m_compressor.push(boost::iostreams::gzip_compressor());
+        break;
+    case zstd_compression:
+#if defined(BOOST_PKG_DEP_TREE_HAS_ZSTD)
+        m_compressor.push(boost::iostreams::zstd_compressor());
+        break;
+#else
+        BOOST_THROW_EXCEPTION(std::runtime_error("zstd compression requires Boost 1.70 or newer: " + path_str));
+#endif
+    default:
+        break;
+    }
+    m_compressor.push(sink);
+
+    m_current.resize(block_size);
+    setp(&m_current[0], &m_current[0] + m_current.size());
+
+    m_thread = boost::thread(boost::bind(&pipelined_compressor_buf::compress_blocks, this));
+}
+
+//! Finishes writing the file, if not finished yet
+pipelined_compressor_buf::~pipelined_compressor_buf()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+//! Writes the remaining data, finishes the compressed stream and closes the file
+void pipelined_compressor_buf::close()
+{
+    if (m_thread.joinable())
+    {
+        submit_block();
+        setp(NULL, NULL);
+
+        {
+            boost::lock_guard< boost::mutex > lock(m_mutex);
+            m_finished = true;
+            m_cond.notify_all();
+        }
+
+        m_thread.join();
+    }
+
+    if (m_error)
+        boost::rethrow_exception(m_error);
+}
+
+pipelined_compressor_buf::int_type pipelined_compressor_buf::overflow(int_type c)
+{
+    if (!m_thread.joinable() || !submit_block())
+        return traits_type::eof();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+int pipelined_compressor_buf::sync()
+{
+    // Don't flush the compressor as that would degrade compression, just pass the data to the compression thread
+    if (!m_thread.joinable())
+        return 0;
+    return submit_block() ? 0 : -1;
+}
+
+//! Passes the current block to the compression thread
+bool pipelined_compressor_buf::submit_block()
+{
+    const std::size_t size = pptr() - pbase();
+    if (size > 0u)
+    {
+        boost::unique_lock< boost::mutex > lock(m_mutex);
+        while (m_queue.size() >= max_queued_blocks && !m_error)
+            m_cond.wait(lock);
+        if (m_error)
+            return false;
+
+        m_current.resize(size);
+        m_queue.push_back(block());
+        m_queue.back().swap(m_current);
+        if (!m_free_blocks.empty())
+        {
+            m_current.swap(m_free_blocks.back());
+            m_free_blocks.pop_back();
+        }
+        m_cond.notify_all();
+    }
+
+    m_current.resize(block_size);
+    setp(&m_current[0], &m_current[0] + m_current.size());
+
+    // The compression thread may fail concurrently
+    boost::lock_guard< boost::mutex > lock(m_mutex);
+    return !m_error;
+}
+
+//! Compression thread function
+void pipelined_compressor_buf::compress_blocks()
+{
+    set_trace_thread_name("compression");
+    try
+    {
+        block data;
+        while (true)
+        {
+            {
+                boost::unique_lock< boost::mutex > lock(m_mutex);
+                while (m_queue.empty() && !m_finished)
+                    m_cond.wait(lock);
+                if (m_queue.empty())
+                    break;
+
+                data.swap(m_queue.front());
+                m_queue.pop_front();
+                m_cond.notify_all();
+            }
+
+            {
+                trace_span span("serialize", "compress_block");
+                m_compressor.write(&data[0], data.size());
+            }
+            if (!m_compressor)
+                BOOST_THROW_EXCEPTION(std::runtime_error("Failed to write output file"));
+
+            {
+                boost::lock_guard< boost::mutex > lock(m_mutex);
+                m_free_blocks.push_back(block());
+                m_free_blocks.back().swap(data);
+            }
+        }
+
+        // Finish the compressed stream and close the file
+        m_compressor.reset();
+    }
+    catch (...)
+    {
+        boost::lock_guard< boost::mutex > lock(m_mutex);
+        m_error = boost::current_exception();
+        m_cond.notify_all();
+    }
+}
+
+compressed_ofstream::compressed_ofstream(boost::filesystem::path const& path, compression_format format) :
+    std::ostream(NULL),
+    m_buf(path, format)
+{
+    rdbuf(&m_buf);
+}
+
+//! Opens the file
+decompressing_ifstream::decompressing_ifstream(boost::filesystem::path const& path)
+{
+    std::string path_str = path.string();
+    boost::iostreams::file_source source(path_str, std::ios::in | std::ios::binary);
+    if (!source.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open file: " + path_str));
+
+    // Detect the compression format by the magic bytes
+    unsigned char magic[4] = {};
+    std::streamsize size = source.read(reinterpret_cast< char* >(magic), sizeof(magic));
+    source.seek(0, std::ios::beg);
+
+    if (size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        push(boost::iostreams::gzip_decompressor());
+    else if (size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+    {
+#if defined(BOOST_PKG_DEP_TREE_HAS_ZSTD)
+        push(boost::iostreams::zstd_decompressor());
+#else
+        BOOST_THROW_EXCEPTION(std::runtime_error("zstd decompression requires Boost 1.70 or newer: " + path_str));
+#endif
+    }
+    push(source);
+}
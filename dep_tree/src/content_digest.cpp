@@ -0,0 +1,181 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of content digests
+ */
+
+#include <cstddef>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <content_digest.hpp>
+
+namespace {
+
+inline boost::uint64_t rotl(boost::uint64_t x, unsigned int n)
+{
+    return (x << n) | (x >> (64u - n));
+}
+
+inline boost::uint64_t load_le64(const unsigned char* p)
+{
+    boost::uint64_t x = 0;
+    for (unsigned int i = 8; i > 0; --i)
+        x = (x << 8) | p[i - 1];
+    return x;
+}
+
+inline boost::uint64_t fmix64(boost::uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+//! MurmurHash3 x64 128-bit hash function
+void murmur3_128(const unsigned char* data, std::size_t size, boost::uint64_t seed, boost::uint64_t& h1, boost::uint64_t& h2)
+{
+    const boost::uint64_t c1 = 0x87c37b91114253d5ull;
+    const boost::uint64_t c2 = 0x4cf5ad432745937full;
+
+    h1 = seed;
+    h2 = seed;
+
+    const std::size_t block_count = size / 16u;
+    for (std::size_t i = 0; i < block_count; ++i, data += 16)
+    {
+        boost::uint64_t k1 = load_le64(data);
+        boost::uint64_t k2 = load_le64(data + 8);
+
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5u + 0x52dce729u;
+
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5u + 0x38495ab5u;
+    }
+
+    boost::uint64_t k1 = 0, k2 = 0;
+    switch (size & 15u)
+    {
+    case 15: k2 ^= static_cast< boost::uint64_t >(data[14]) << 48; // fallthrough
+    case 14: k2 ^= static_cast< boost::uint64_t >(data[13]) << 40; // fallthrough
+    case 13: k2 ^= static_cast< boost::uint64_t >(data[12]) << 32; // fallthrough
+    case 12: k2 ^= static_cast< boost::uint64_t >(data[11]) << 24; // fallthrough
+    case 11: k2 ^= static_cast< boost::uint64_t >(data[10]) << 16; // fallthrough
+    case 10: k2 ^= static_cast< boost::uint64_t >(data[9]) << 8; // fallthrough
+    case 9: k2 ^= static_cast< boost::uint64_t >(data[8]);
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        // fallthrough
+    case 8: k1 ^= static_cast< boost::uint64_t >(data[7]) << 56; // fallthrough
+    case 7: k1 ^= static_cast< boost::uint64_t >(data[6]) << 48; // fallthrough
+    case 6: k1 ^= static_cast< boost::uint64_t >(data[5]) << 40; // fallthrough
+    case 5: k1 ^= static_cast< boost::uint64_t >(data[4]) << 32; // fallthrough
+    case 4: k1 ^= static_cast< boost::uint64_t >(data[3]) << 24; // fallthrough
+    case 3: k1 ^= static_cast< boost::uint64_t >(data[2]) << 16; // fallthrough
+    case 2: k1 ^= static_cast< boost::uint64_t >(data[1]) << 8; // fallthrough
+    case 1: k1 ^= static_cast< boost::uint64_t >(data[0]);
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+}
+
+inline int hex_digit_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+template< std::size_t N >
+std::string bytes_to_hex_string(boost::array< unsigned char, N > const& bytes)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    std::string str;
+    str.reserve(N * 2u);
+    for (typename boost::array< unsigned char, N >::const_iterator it = bytes.begin(), end = bytes.end(); it != end; ++it)
+    {
+        str.push_back(hex_digits[*it >> 4]);
+        str.push_back(hex_digits[*it & 15u]);
+    }
+    return str;
+}
+
+template< std::size_t N >
+bool bytes_from_hex_string(boost::string_ref const& str, boost::array< unsigned char, N >& bytes)
+{
+    if (str.size() != N * 2u)
+        return false;
+
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        int hi = hex_digit_value(str[i * 2u]), lo = hex_digit_value(str[i * 2u + 1u]);
+        if (hi < 0 || lo < 0)
+            return false;
+        bytes[i] = static_cast< unsigned char >((hi << 4) | lo);
+    }
+
+    return true;
+}
+
+} // namespace
+
+//! Computes the digest of the file content
+content_digest compute_content_digest(boost::string_ref const& content)
+{
+    boost::uint64_t h1, h2;
+    murmur3_128(reinterpret_cast< const unsigned char* >(content.data()), content.size(), 0u, h1, h2);
+
+    content_digest digest;
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        digest[i] = static_cast< unsigned char >(h1 >> (56u - i * 8u));
+        digest[i + 8] = static_cast< unsigned char >(h2 >> (56u - i * 8u));
+    }
+    return digest;
+}
+
+//! Converts the digest to a hex string
+std::string to_hex_string(content_digest const& digest)
+{
+    return bytes_to_hex_string(digest);
+}
+
+//! Converts the git object identifier to a hex string
+std::string to_hex_string(git_object_id const& id)
+{
+    return bytes_to_hex_string(id);
+}
+
+//! Parses the digest from a hex string. Returns \c false if the string is not a valid digest.
+bool from_hex_string(boost::string_ref const& str, content_digest& digest)
+{
+    return bytes_from_hex_string(str, digest);
+}
+
+//! Parses the git object identifier from a hex string. Returns \c false if the string is not a valid identifier.
+bool from_hex_string(boost::string_ref const& str, git_object_id& id)
+{
+    return bytes_from_hex_string(str, id);
+}
@@ -11,6 +11,7 @@
 #include <cstring>
 #include <stdexcept>
 #include <algorithm>
+#include <boost/assert.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/exception/info.hpp>
 #include <boost/exception/enable_error_info.hpp>
@@ -18,9 +19,24 @@
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/exceptions.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/system/error_code.hpp>
 #include <cxx_parser.hpp>
+#include <node_attributes.hpp>
+#include <parse_cache.hpp>
+#include <content_digest.hpp>
+#include <filesystem_index.hpp>
 #include <filesystem_ext.hpp>
+#include <source_pack.hpp>
+#include <trace.hpp>
+#if !defined(BOOST_WINDOWS)
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 
 namespace {
 
@@ -75,68 +91,299 @@ inline const char* skip_spaces(const char* p, const char* end)
     return p;
 }
 
+//! Skips spaces and block comments within a preprocessor directive, the comments are equivalent to spaces
+inline const char* skip_directive_spaces(const char* p, const char* end)
+{
+    while (true)
+    {
+        p = skip_spaces(p, end);
+        if ((end - p) < 2 || p[0] != '/' || p[1] != '*')
+            return p;
+        p = skip_multi_line_comment(p + 2, end);
+    }
+}
+
 inline const char* find_closing_quote(const char* p, const char* end, char quote_char)
 {
     const char* res = static_cast< const char* >(std::memchr(p, quote_char, end - p));
     return res ? res : end;
 }
 
+//! Finds the closing quote of a string or character literal. The literal cannot span multiple lines, unless the line break is escaped, so an unterminated literal ends at the line break.
 inline const char* find_closing_quote_with_escapes(const char* p, const char* end, char quote_char)
 {
-    while (true)
+    while (p != end)
     {
-        const char* q = find_closing_quote(p, end, quote_char);
-        if (q != end && q > p && (*q - 1) == '\\')
+        char c = *p;
+        if (c == quote_char || c == '\n')
+            return p;
+
+        ++p;
+        if (c == '\\' && p != end)
         {
-            p = q + 1;
-            continue;
+            // Skip the escaped character, which may also be a line break
+            if (*p == '\r' && (end - p) > 1 && p[1] == '\n')
+                ++p;
+            ++p;
         }
+    }
+
+    return end;
+}
+
+inline bool is_identifier_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+//! Checks if the quote at \a p is a digit separator in a numeric literal (e.g. 1'000'000)
+inline bool is_digit_separator(const char* begin, const char* p)
+{
+    const char* q = p;
+    while (q != begin && (is_identifier_char(*(q - 1)) || *(q - 1) == '\'' || *(q - 1) == '.'))
+        --q;
+
+    return q != p && *q >= '0' && *q <= '9';
+}
+
+//! Checks if the double quote at \a p starts a raw string literal, i.e. it is preceded with an R, u8R, uR, UR or LR prefix
+inline bool is_raw_string_start(const char* begin, const char* p)
+{
+    if (p == begin || *(p - 1) != 'R')
+        return false;
+
+    const char* q = p - 1;
+    if ((q - begin) >= 2 && *(q - 1) == '8' && *(q - 2) == 'u')
+        q -= 2;
+    else if (q != begin && (*(q - 1) == 'u' || *(q - 1) == 'U' || *(q - 1) == 'L'))
+        --q;
+
+    return q == begin || !is_identifier_char(*(q - 1));
+}
+
+//! Skips a raw string literal. \a p must point after the opening quote. Returns the pointer after the closing quote.
+inline const char* skip_raw_string(const char* p, const char* end)
+{
+    // The delimiter is at most 16 characters long and cannot contain spaces, parentheses or backslashes
+    const char* delim = p;
+    while (p != end && *p != '(')
+    {
+        char c = *p;
+        if (c == ' ' || c == ')' || c == '\\' || c == '\t' || c == '\n' || (p - delim) >= 16)
+            return p;
+        ++p;
+    }
+
+    if (p == end)
+        return end;
+
+    const std::size_t delim_size = p - delim;
+    ++p;
+    while (true)
+    {
+        p = find_closing_quote(p, end, ')');
+        if (p == end)
+            return end;
+
+        ++p;
+        if (static_cast< std::size_t >(end - p) > delim_size && std::memcmp(p, delim, delim_size) == 0 && p[delim_size] == '"')
+            return p + delim_size + 1;
+    }
+}
 
-        return q;
+//! Adds the node with the path from the root node, with the insertion cursor if one is provided
+inline dep_node* add_node(boost::string_ref const& node_path, dep_tree& root, cxx_parser_params const& params)
+{
+    if (params.node_cursor)
+    {
+        BOOST_ASSERT(params.node_cursor->get_base() == &root);
+        return params.node_cursor->add_nested_child(node_path);
     }
+    return root.add_nested_child(node_path);
 }
 
-void add_include(boost::string_ref const& included_header, dep_tree& root, dep_node& node, boost::filesystem::path const& header_dir, bool use_header_dir, cxx_parser_params const& params)
+//! Looks for the included file and follows the symlinks in its path. The files outside Boost root have their symlinks resolved from the filesystem root.
+inline bool find_included_file(boost::filesystem::path const& path, cxx_parser_params const& params, boost::filesystem::path& found_path)
 {
-    boost::filesystem::path path(included_header.to_string());
-    boost::filesystem::path full_path;
+    if (!boost::filesystem::exists(path))
+        return false;
+
+    boost::filesystem::path root_path;
+    if (is_descendant(params.boost_root, path))
+        root_path = params.boost_root;
+    else
+        root_path = boost::filesystem::system_complete(path).root_path();
 
-    bool found = false;
     boost::filesystem::file_status file_stat;
-    if (use_header_dir)
+    found_path = recursive_peel_symlinks(root_path, path, &file_stat);
+    return boost::filesystem::is_regular_file(file_stat);
+}
+
+/*!
+ * Returns the tree node path for the normalized absolute file path or an empty string if the file is not represented in the tree.
+ * The result refers to either \a path or \a buffer. Does not allocate memory, unless the buffer needs to grow.
+ */
+boost::string_ref make_node_path(boost::string_ref const& path, cxx_parser_params const& params, std::string& buffer)
+{
+    if (params.canonical_boost_root.contains(path))
+        return params.canonical_boost_root.make_relative(path);
+
+    if (!params.external_root.empty())
     {
-        full_path = header_dir / path;
-        if (boost::filesystem::exists(full_path))
+        // The external files are named relative to the filesystem root
+        boost::string_ref relative_path = make_root_relative_part(path);
+        buffer.assign(params.external_root);
+        buffer.push_back(dep_node::default_node_separator);
+        buffer.append(relative_path.data(), relative_path.size());
+        return buffer;
+    }
+
+    return boost::string_ref();
+}
+
+//! Returns the buffer for composing tree node paths, which is reused by the calling thread
+std::string& get_node_path_buffer()
+{
+    static boost::thread_specific_ptr< std::string > buffer;
+    std::string* p = buffer.get();
+    if (!p)
+    {
+        p = new std::string();
+        buffer.reset(p);
+    }
+    return *p;
+}
+
+void add_include(boost::string_ref const& included_header, dep_tree& root, dep_node* node, boost::filesystem::path const& header_dir, bool use_header_dir, cxx_parser_params const& params, std::vector< boost::filesystem::path >* included_files)
+{
+    // The paths found with the filesystem index are referenced where they are stored in the index, without copying
+    boost::filesystem::path found_path;
+    boost::filesystem::path const* full_path = &found_path;
+    bool found = false;
+    if (params.fs_index)
+    {
+        if (use_header_dir)
+            full_path = &params.fs_index->find_regular_file(params.boost_root, header_dir, included_header);
+        if (full_path->empty())
+            full_path = &params.fs_index->find_in_search_path(params.include_search_path, params.boost_root, included_header);
+        found = !full_path->empty();
+    }
+    else
+    {
+        boost::filesystem::path path(included_header.to_string());
+        if (use_header_dir)
+            found = find_included_file(header_dir / path, params, found_path);
+
+        std::vector< boost::filesystem::path >::const_iterator it = params.include_dirs.begin(), end = params.include_dirs.end();
+        for (; it != end && !found; ++it)
         {
-            full_path = recursive_peel_symlinks(params.boost_root, full_path, &file_stat);
-            found = boost::filesystem::is_regular_file(file_stat);
+            found = find_included_file(*it / path, params, found_path);
         }
     }
 
-    std::vector< boost::filesystem::path >::const_iterator it = params.include_dirs.begin(), end = params.include_dirs.end();
-    for (; it != end && !found; ++it)
+    if (found)
     {
-        full_path = *it / path;
-        if (boost::filesystem::exists(full_path))
+        if (node)
         {
-            full_path = recursive_peel_symlinks(params.boost_root, full_path, &file_stat);
-            found = boost::filesystem::is_regular_file(file_stat);
+            // The paths found with the filesystem index are normalized, so the node path can be produced without building new paths
+            std::string node_path_storage;
+            boost::string_ref node_path;
+            if (params.fs_index && !params.canonical_boost_root.empty())
+            {
+                node_path = make_node_path(full_path->string(), params, get_node_path_buffer());
+            }
+            else
+            {
+                node_path_storage = make_node_path(*full_path, params);
+                node_path = node_path_storage;
+            }
+
+            if (!node_path.empty())
+            {
+                dep_node* other = add_node(node_path, root, params);
+                node->add_dependency(other);
+                if (params.create_reverse_dependencies)
+                {
+                    other->add_dependent(node);
+                }
+            }
         }
+
+        if (included_files)
+            included_files->push_back(*full_path);
     }
+}
+
+//! Returns the number of lines in the file content, including the last line without a line terminator
+boost::uint32_t count_lines(boost::string_ref const& source)
+{
+    std::size_t count = std::count(source.begin(), source.end(), '\n');
+    if (!source.empty() && source.back() != '\n')
+        ++count;
+    return static_cast< boost::uint32_t >(count);
+}
 
-    if (found && is_descendant(params.boost_root, full_path))
+//! Returns the file size and, if \a mtime is not \c NULL, the modification time. Both are obtained with one syscall, where possible.
+boost::uintmax_t get_file_size(std::string const& path, boost::int64_t* mtime)
+{
+#if !defined(BOOST_WINDOWS)
+    if (mtime)
     {
-        dep_node* other = root.add_nested_child(make_relative(params.boost_root, full_path).string());
-        node.add_dependency(other);
-        if (params.create_reverse_dependencies)
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
         {
-            other->add_dependent(&node);
+            const int err = errno;
+            BOOST_THROW_EXCEPTION(boost::filesystem::filesystem_error("Failed to get file status", path, boost::system::error_code(err, boost::system::system_category())));
         }
+        *mtime = static_cast< boost::int64_t >(st.st_mtime);
+        return static_cast< boost::uintmax_t >(st.st_size);
     }
+#else
+    if (mtime)
+        *mtime = static_cast< boost::int64_t >(boost::filesystem::last_write_time(path));
+#endif
+    return boost::filesystem::file_size(path);
 }
 
-//! The function creates a node for a header and fills its dependencies depending on the header contents
-void parse_cxx_source(boost::string_ref const& source, dep_tree& root, dep_node& node, boost::filesystem::path const& header_dir, cxx_parser_params const& params)
+/*!
+ * Extracts include directives from the file content, using the parse cache if it is enabled. If \a attributes is not \c NULL,
+ * the line count and the content hash of the file are stored in the attributes of the node \a id.
+ */
+void parse_source(boost::string_ref const& source, cxx_parser_params const& params, std::vector< cxx_include_directive >& includes, node_attributes* attributes, std::size_t id)
+{
+    content_digest digest;
+    if (params.cache || attributes)
+    {
+        trace_span span("parse", "digest");
+        digest = compute_content_digest(source);
+    }
+
+    if (attributes)
+    {
+        attributes->content_hash.set(id, digest);
+        attributes->line_count.set(id, count_lines(source));
+    }
+
+    if (params.cache)
+    {
+        if (!params.cache->find(digest, includes))
+        {
+            trace_span span("parse", "lex");
+            parse_cxx_includes(source, includes);
+            params.cache->insert(digest, includes);
+        }
+    }
+    else
+    {
+        trace_span span("parse", "lex");
+        parse_cxx_includes(source, includes);
+    }
+}
+
+} // namespace
+
+//! The function extracts include directives from the C++ source. Increment \c cxx_lexer_version when changing the results.
+void parse_cxx_includes(boost::string_ref const& source, std::vector< cxx_include_directive >& includes)
 {
     bool first_char_in_line = true;
     const char* p = source.data(), * const end = p + source.size();
@@ -154,23 +401,29 @@ void parse_cxx_source(boost::string_ref const& source, dep_tree& root, dep_node&
                 ++p;
                 if (first_char_in_line)
                 {
-                    p = skip_spaces(p, end);
-                    if ((end - p) > sizeof("include<>") && std::memcmp(p, "include", sizeof("include") - 1) == 0)
+                    p = skip_directive_spaces(p, end);
+                    if (static_cast< std::size_t >(end - p) >= sizeof("include") - 1 && std::memcmp(p, "include", sizeof("include") - 1) == 0)
                     {
-                        p = skip_spaces(p + sizeof("include") - 1, end);
+                        p = skip_directive_spaces(p + sizeof("include") - 1, end);
                         if (p != end)
                         {
-                            const char* q;
-                            c = *p++;
-                            if (c == '<')
-                                q = find_closing_quote(p, end, '>');
-                            else if (c == '"')
-                                q = find_closing_quote(p, end, '"');
-                            else
+                            c = *p;
+                            if (c != '<' && c != '"')
                                 break;
 
-                            add_include(boost::string_ref(p, q - p), root, node, header_dir, c == '"', params);
-                            p = q + 1;
+                            // The header name must be closed on the same line
+                            ++p;
+                            const char* line_end = find_closing_quote(p, end, '\n');
+                            const char* q = find_closing_quote(p, line_end, c == '<' ? '>' : '"');
+                            if (q != line_end)
+                            {
+                                includes.push_back(cxx_include_directive(boost::string_ref(p, q - p), c == '"'));
+                                p = q + 1;
+                            }
+                            else
+                            {
+                                p = line_end;
+                            }
                         }
                     }
                 }
@@ -190,7 +443,11 @@ void parse_cxx_source(boost::string_ref const& source, dep_tree& root, dep_node&
                         continue;
                     }
                     else if (c == '*')
+                    {
+                        // The comment is equivalent to a space, so it does not affect whether a directive starts the line
                         p = skip_multi_line_comment(p, end);
+                        continue;
+                    }
                 }
             }
             break;
@@ -215,9 +472,24 @@ void parse_cxx_source(boost::string_ref const& source, dep_tree& root, dep_node&
             continue;
 
         case '"':
+            if (is_raw_string_start(source.data(), p))
+            {
+                p = skip_raw_string(p + 1, end);
+                break;
+            }
+            p = find_closing_quote_with_escapes(p + 1, end, c);
+            if (p != end && *p == c)
+                ++p;
+            break;
+
         case '\'':
+            if (is_digit_separator(source.data(), p))
+            {
+                ++p;
+                break;
+            }
             p = find_closing_quote_with_escapes(p + 1, end, c);
-            if (p != end)
+            if (p != end && *p == c)
                 ++p;
             break;
 
@@ -235,34 +507,126 @@ void parse_cxx_source(boost::string_ref const& source, dep_tree& root, dep_node&
     }
 }
 
-} // namespace
+cxx_parser_params::cxx_parser_params() : create_reverse_dependencies(false), cache(NULL), collect_attributes(false), node_cursor(NULL), fs_index(NULL), include_search_path(0u), pack(NULL)
+{
+}
 
-cxx_parser_params::cxx_parser_params() : create_reverse_dependencies(false)
+//! The function returns the tree node path for the file or an empty string if the file is not represented in the tree
+std::string make_node_path(boost::filesystem::path const& path, cxx_parser_params const& params)
 {
+    if (is_descendant(params.boost_root, path))
+        return make_relative(params.boost_root, path).string();
+
+    if (!params.external_root.empty())
+        return params.external_root + dep_node::default_node_separator + boost::filesystem::system_complete(path).relative_path().string();
+
+    return std::string();
+}
+
+//! The function returns the file path for the tree node path
+boost::filesystem::path make_file_path(std::string const& node_path, boost::filesystem::path const& boost_root, std::string const& external_root)
+{
+    if (!external_root.empty() && node_path.size() > external_root.size() && node_path.compare(0, external_root.size(), external_root) == 0 &&
+        node_path[external_root.size()] == dep_node::default_node_separator)
+    {
+        // The external files are named relative to the filesystem root
+        return boost::filesystem::system_complete(boost::filesystem::path(node_path.substr(external_root.size())));
+    }
+
+    return boost_root / node_path;
 }
 
 //! The function creates a node for a header and fills its dependencies depending on the header contents
-void parse_cxx(boost::filesystem::path const& path, cxx_parser_params const& params, dep_tree& root)
+dep_node* parse_cxx(boost::filesystem::path const& path, cxx_parser_params const& params, dep_tree& root, std::vector< boost::filesystem::path >* included_files, git_object_id const* object_id)
 {
     std::string path_str = path.string();
+    trace_span file_span("parse", "parse_file", path_str);
     try
     {
-        std::string node_path = make_relative(params.boost_root, path).string();
+        std::string node_path = make_node_path(path, params);
+        dep_node* node = NULL;
+        if (!node_path.empty())
+        {
+            trace_span span("tree", "insert_node");
+            node = add_node(node_path, root, params);
+        }
+
+        // The attributes are only collected for the files represented in the tree
+        node_attributes* attributes = params.collect_attributes && node ? &root.get_attributes() : NULL;
+        const std::size_t node_id = node ? node->get_id() : 0u;
 
-        if (boost::filesystem::file_size(path) > 0)
+        std::vector< cxx_include_directive > includes;
+        if (!object_id || !params.cache || !params.cache->find(*object_id, includes))
         {
-            boost::interprocess::file_mapping file(path_str.c_str(), boost::interprocess::read_only);
-            boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+            trace_span read_span("parse", "read_file");
+            boost::chrono::steady_clock::time_point start_time;
+            if (attributes)
+                start_time = boost::chrono::steady_clock::now();
+
+            std::string packed_path;
+            if (params.pack)
+            {
+                packed_path = boost::filesystem::system_complete(path).string();
+                normalize_path_in_place(packed_path);
+            }
+
+            if (params.pack && params.pack->contains(packed_path))
+            {
+                // The content is taken from the pack mapping, without accessing the file
+                source_pack::entry_id id = params.pack->find(packed_path);
+                if (id == source_pack::invalid_entry || params.pack->type(id) != source_pack::regular_file)
+                    BOOST_THROW_EXCEPTION(std::runtime_error("File not found in the source pack"));
+                if (params.pack->file_size(id) > 0u && !params.pack->has_content(id))
+                    BOOST_THROW_EXCEPTION(std::runtime_error("File content is not stored in the source pack"));
+
+                if (attributes)
+                    attributes->file_size.set(node_id, params.pack->file_size(id));
+                parse_source(params.pack->content(id), params, includes, attributes, node_id);
+            }
+            else
+            {
+                // The modification time is obtained together with the file size
+                boost::int64_t mtime = 0;
+                boost::uintmax_t size = get_file_size(path_str, attributes ? &mtime : NULL);
+                if (attributes)
+                {
+                    attributes->file_size.set(node_id, size);
+                    attributes->mtime.set(node_id, mtime);
+                }
 
-            dep_node* node = root.add_nested_child(node_path);
+                if (size > 0)
+                {
+                    // We can't map files of zero size, but we don't need to parse them either
+                    boost::interprocess::file_mapping file(path_str.c_str(), boost::interprocess::read_only);
+                    boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
 
-            parse_cxx_source(boost::string_ref(static_cast< const char* >(region.get_address()), region.get_size()), root, *node, path.parent_path(), params);
+                    parse_source(boost::string_ref(static_cast< const char* >(region.get_address()), region.get_size()), params, includes, attributes, node_id);
+                }
+                else if (attributes)
+                {
+                    attributes->line_count.set(node_id, 0u);
+                    attributes->content_hash.set(node_id, compute_content_digest(boost::string_ref()));
+                }
+            }
+
+            if (attributes)
+            {
+                boost::chrono::microseconds parse_time = boost::chrono::duration_cast< boost::chrono::microseconds >(boost::chrono::steady_clock::now() - start_time);
+                attributes->parse_time.set(node_id, static_cast< boost::uint32_t >(parse_time.count()));
+            }
+
+            if (object_id && params.cache)
+                params.cache->insert(*object_id, includes);
         }
-        else
+
+        trace_span span("resolve", "resolve_includes");
+        boost::filesystem::path header_dir = path.parent_path();
+        for (std::vector< cxx_include_directive >::const_iterator it = includes.begin(), end = includes.end(); it != end; ++it)
         {
-            // We can't map files of zero size, but we don't need to parse them either
-            root.add_nested_child(node_path);
+            add_include(it->header, root, node, header_dir, it->is_quoted, params, included_files);
         }
+
+        return node;
     }
     catch (boost::interprocess::interprocess_exception& e)
     {
@@ -1,25 +1,67 @@
 #include <cstddef>
+#include <vector>
 #include <utility>
+#include <iterator>
 #include <algorithm>
+#include <exception>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
 #include <boost/assert.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/exception_ptr.hpp>
 #include <boost/checked_delete.hpp>
 #include <boost/move/utility.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <dep_tree.hpp>
+#include <node_attributes.hpp>
 #include <path_iterator.hpp>
 
 BOOST_CONSTEXPR_OR_CONST char dep_node::default_node_separator;
 
-dep_node::dep_node() : m_parent(NULL)
+//! The data shared by all nodes of the tree
+struct dep_node::tree_data
+{
+    //! The number of the allocated node identifiers
+    std::size_t node_count;
+    node_attributes attributes;
+
+    tree_data() : node_count(1u) {}
+};
+
+dep_node::dep_node() : m_parent(NULL), m_tree(new tree_data()), m_id(0u)
 {
 }
 
-dep_node::dep_node(dep_node* parent, boost::string_ref const& name) : m_parent(parent), m_name(name.data(), name.size())
+dep_node::dep_node(dep_node* parent, boost::string_ref const& name) : m_parent(parent), m_tree(parent->m_tree), m_id(parent->m_tree->node_count++), m_name(name.data(), name.size())
 {
 }
 
 dep_node::~dep_node()
 {
     m_children.clear_and_dispose(boost::checked_deleter< dep_node >());
+    if (!m_parent)
+        delete m_tree;
+}
+
+//! Returns the number of the allocated node identifiers in the tree
+std::size_t dep_node::get_node_count() const BOOST_NOEXCEPT
+{
+    return m_tree->node_count;
+}
+
+//! Returns the attributes of the nodes of the tree
+node_attributes& dep_node::get_attributes() BOOST_NOEXCEPT
+{
+    return m_tree->attributes;
+}
+
+//! Returns the attributes of the nodes of the tree
+node_attributes const& dep_node::get_attributes() const BOOST_NOEXCEPT
+{
+    return m_tree->attributes;
 }
 
 //! Returns the root node
@@ -47,6 +89,25 @@ std::string dep_node::get_full_name(char separator) const
     return boost::move(full_name);
 }
 
+//! Returns the node path from the root node
+std::string dep_node::get_path(char separator) const
+{
+    std::string path;
+    if (m_parent)
+    {
+        path = m_name;
+        const dep_node* p = m_parent;
+        while (p->m_parent)
+        {
+            path.insert(0, 1, separator);
+            path.insert(0, p->m_name);
+            p = p->m_parent;
+        }
+    }
+
+    return boost::move(path);
+}
+
 //! Returns an immediate child node with the specified name
 dep_node* dep_node::get_child(boost::string_ref const& name) BOOST_NOEXCEPT
 {
@@ -92,6 +153,21 @@ dep_node* dep_node::add_child(boost::string_ref const& name)
     return &*res.first;
 }
 
+//! Adds a child node or returns the existing node if one exists, using the insertion hint
+dep_node* dep_node::add_child(node_set::const_iterator hint, boost::string_ref const& name)
+{
+    BOOST_ASSERT(!name.empty());
+
+    node_set::insert_commit_data commit_data;
+    std::pair< node_set::iterator, bool > res = m_children.insert_check(hint, name, order_by_name(), commit_data);
+    if (res.second)
+    {
+        dep_node* node = new dep_node(this, name);
+        res.first = m_children.insert_commit(*node, commit_data);
+    }
+    return &*res.first;
+}
+
 //! Adds a possibly nested child node or returns the existing node if one exists
 dep_node* dep_node::add_nested_child(boost::string_ref const& path, char separator)
 {
@@ -110,6 +186,59 @@ dep_node* dep_node::add_nested_child(boost::string_ref const& path, char separat
     return node;
 }
 
+//! Adds a possibly nested child node or returns the existing node if one exists, reusing the nodes of the common prefix with the last added path
+dep_node* dep_node::insertion_cursor::add_nested_child(boost::string_ref const& path)
+{
+    BOOST_ASSERT(!path.empty());
+
+    const std::size_t common_size = std::mismatch(path.begin(), path.begin() + (std::min)(path.size(), m_path.size()), m_path.begin()).first - path.begin();
+
+    // The nodes of the components within the common prefix are reused if the components end at the same place in the new path
+    std::size_t reused = m_chain.size();
+    while (reused > 0u)
+    {
+        chain_entry const& entry = m_chain[reused - 1u];
+        if (entry.path_end <= common_size && (entry.path_end == path.size() || path[entry.path_end] == m_separator))
+            break;
+        --reused;
+    }
+
+    dep_node* node = m_base;
+    boost::string_ref rest = path;
+    if (reused > 0u)
+    {
+        node = m_chain[reused - 1u].node;
+        rest.remove_prefix((std::min)(m_chain[reused - 1u].path_end + 1u, path.size()));
+    }
+
+    // The first new component follows the previously added node at the same level if the paths are added in order
+    dep_node* prev_sibling = reused < m_chain.size() ? m_chain[reused].node : NULL;
+    m_chain.resize(reused, chain_entry(NULL, 0u));
+
+    path_iterator p(rest, m_separator);
+    boost::string_ref name = *p;
+    while (!name.empty())
+    {
+        if (prev_sibling)
+        {
+            node_set::const_iterator hint = node_set::s_iterator_to(*prev_sibling);
+            node = node->add_child(++hint, name);
+            prev_sibling = NULL;
+        }
+        else
+        {
+            node = node->add_child(name);
+        }
+
+        m_chain.push_back(chain_entry(node, name.data() + name.size() - path.data()));
+        ++p;
+        name = *p;
+    }
+
+    m_path.assign(path.data(), path.size());
+    return node;
+}
+
 //! Adds a dependency node
 void dep_node::add_dependency(dep_node* node)
 {
@@ -117,7 +246,7 @@ void dep_node::add_dependency(dep_node* node)
 
     if (node != this)
     {
-        nodes::iterator it = std::lower_bound(m_dependencies.begin(), m_dependencies.end(), node);
+        nodes::iterator it = std::lower_bound(m_dependencies.begin(), m_dependencies.end(), node, order_by_id());
         if (it == m_dependencies.end() || node != *it)
             m_dependencies.insert(it, node);
     }
@@ -129,6 +258,26 @@ void dep_node::add_dependency(boost::string_ref const& path, char separator)
     add_dependency(get_root()->add_nested_child(path, separator));
 }
 
+//! Replaces all dependencies of the node
+void dep_node::set_dependencies(nodes const& deps)
+{
+    nodes new_deps(deps);
+    std::sort(new_deps.begin(), new_deps.end(), order_by_id());
+    new_deps.erase(std::unique(new_deps.begin(), new_deps.end()), new_deps.end());
+    new_deps.erase(std::remove(new_deps.begin(), new_deps.end(), this), new_deps.end());
+    m_dependencies.swap(new_deps);
+}
+
+//! Replaces all dependents of the node
+void dep_node::set_dependents(nodes const& rdeps)
+{
+    nodes new_rdeps(rdeps);
+    std::sort(new_rdeps.begin(), new_rdeps.end(), order_by_id());
+    new_rdeps.erase(std::unique(new_rdeps.begin(), new_rdeps.end()), new_rdeps.end());
+    new_rdeps.erase(std::remove(new_rdeps.begin(), new_rdeps.end(), this), new_rdeps.end());
+    m_dependents.swap(new_rdeps);
+}
+
 //! Adds a dependent node
 void dep_node::add_dependent(dep_node* node)
 {
@@ -136,7 +285,7 @@ void dep_node::add_dependent(dep_node* node)
 
     if (node != this)
     {
-        nodes::iterator it = std::lower_bound(m_dependents.begin(), m_dependents.end(), node);
+        nodes::iterator it = std::lower_bound(m_dependents.begin(), m_dependents.end(), node, order_by_id());
         if (it == m_dependents.end() || node != *it)
             m_dependents.insert(it, node);
     }
@@ -148,16 +297,361 @@ void dep_node::add_dependent(boost::string_ref const& path, char separator)
     add_dependent(get_root()->add_nested_child(path, separator));
 }
 
+namespace {
+
+//! Minimum number of nodes to build the reverse dependencies concurrently
+const std::size_t min_parallel_node_count = 4096u;
+
+typedef boost::unordered_map< dep_node const*, std::size_t > node_index_map;
+
+void collect_nodes(dep_node& node, std::vector< dep_node* >& nodes, node_index_map& node_indices)
+{
+    node_indices[&node] = nodes.size();
+    nodes.push_back(&node);
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+    {
+        collect_nodes(const_cast< dep_node& >(*it), nodes, node_indices);
+    }
+}
+
+//! Splits the range described by the offsets into parts with roughly equal number of elements. Returns the indices of the part boundaries.
+std::vector< std::size_t > split_by_offsets(std::vector< std::size_t > const& offsets, unsigned int part_count)
+{
+    const std::size_t count = offsets.size() - 1u, total = offsets.back();
+    std::vector< std::size_t > bounds(1u, 0u);
+    for (unsigned int i = 1; i < part_count; ++i)
+    {
+        std::size_t bound = std::lower_bound(offsets.begin(), offsets.end(), total / part_count * i) - offsets.begin();
+        bounds.push_back((std::max)((std::min)(bound, count), bounds.back()));
+    }
+    bounds.push_back(count);
+    return bounds;
+}
+
+/*!
+ * The class builds the reverse dependencies of all nodes in bulk. The first pass counts the dependents of every node, the prefix sum of the counts
+ * gives the location of the dependents of every node in one array, the second pass scatters the edges to their locations. Every pass is a sequential
+ * sweep over the edges, so the passes can be split between threads.
+ */
+class reverse_edge_builder
+{
+private:
+    typedef void (reverse_edge_builder::*pass_function)(std::size_t, std::size_t);
+
+private:
+    std::vector< dep_node* > const& m_nodes;
+    node_index_map const& m_node_indices;
+    const unsigned int m_thread_count;
+
+    //! The offsets of the dependencies of every node in \c m_edge_targets
+    std::vector< std::size_t > m_edge_offsets;
+    //! The indices of the dependencies of all nodes
+    std::vector< std::size_t > m_edge_targets;
+    //! The number of dependents of every node, which is then used as the position to put the next dependent to
+    boost::scoped_array< boost::atomic< std::size_t > > m_counters;
+    //! The offsets of the dependents of every node in \c m_sources
+    std::vector< std::size_t > m_source_offsets;
+    //! The dependents of all nodes
+    dep_node::nodes m_sources;
+    //! The resulting dependents of every node
+    std::vector< dep_node::nodes >& m_dependents;
+
+    boost::mutex m_mutex;
+    boost::exception_ptr m_error;
+
+public:
+    reverse_edge_builder(std::vector< dep_node* > const& nodes, node_index_map const& node_indices, unsigned int thread_count, std::vector< dep_node::nodes >& dependents) :
+        m_nodes(nodes),
+        m_node_indices(node_indices),
+        m_thread_count(thread_count),
+        m_dependents(dependents)
+    {
+    }
+
+    void build()
+    {
+        const std::size_t node_count = m_nodes.size();
+
+        m_edge_offsets.resize(node_count + 1u);
+        m_edge_offsets[0] = 0u;
+        for (std::size_t i = 0; i < node_count; ++i)
+            m_edge_offsets[i + 1u] = m_edge_offsets[i] + m_nodes[i]->get_dependencies().size();
+
+        m_edge_targets.resize(m_edge_offsets.back());
+        m_counters.reset(new boost::atomic< std::size_t >[node_count]);
+        for (std::size_t i = 0; i < node_count; ++i)
+            m_counters[i].store(0u, boost::memory_order_relaxed);
+
+        run(&reverse_edge_builder::count_edges, m_edge_offsets);
+
+        m_source_offsets.resize(node_count + 1u);
+        m_source_offsets[0] = 0u;
+        for (std::size_t i = 0; i < node_count; ++i)
+        {
+            const std::size_t count = m_counters[i].load(boost::memory_order_relaxed);
+            m_counters[i].store(m_source_offsets[i], boost::memory_order_relaxed);
+            m_source_offsets[i + 1u] = m_source_offsets[i] + count;
+        }
+
+        m_sources.resize(m_source_offsets.back());
+        run(&reverse_edge_builder::scatter_edges, m_edge_offsets);
+
+        m_dependents.resize(node_count);
+        run(&reverse_edge_builder::merge_dependents, m_source_offsets);
+    }
+
+private:
+    //! Runs the pass over all nodes, the nodes are split between threads by the number of edges
+    void run(pass_function pass, std::vector< std::size_t > const& offsets)
+    {
+        if (m_thread_count <= 1u)
+        {
+            (this->*pass)(0u, m_nodes.size());
+            return;
+        }
+
+        std::vector< std::size_t > bounds = split_by_offsets(offsets, m_thread_count);
+        boost::thread_group workers;
+        for (std::size_t i = 0, n = bounds.size() - 1u; i < n; ++i)
+            workers.create_thread(boost::bind(&reverse_edge_builder::run_range, this, pass, bounds[i], bounds[i + 1u]));
+        workers.join_all();
+
+        if (m_error)
+            boost::rethrow_exception(m_error);
+    }
+
+    //! Worker thread function
+    void run_range(pass_function pass, std::size_t begin, std::size_t end)
+    {
+        try
+        {
+            (this->*pass)(begin, end);
+        }
+        catch (...)
+        {
+            boost::lock_guard< boost::mutex > lock(m_mutex);
+            if (!m_error)
+                m_error = boost::current_exception();
+        }
+    }
+
+    //! Resolves the dependencies to node indices and counts the dependents of every node
+    void count_edges(std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            dep_node::nodes const& deps = m_nodes[i]->get_dependencies();
+            std::size_t* targets = &m_edge_targets[0] + m_edge_offsets[i];
+            for (std::size_t j = 0, n = deps.size(); j < n; ++j)
+            {
+                node_index_map::const_iterator it = m_node_indices.find(deps[j]);
+                BOOST_ASSERT(it != m_node_indices.end());
+                targets[j] = it->second;
+                m_counters[it->second].fetch_add(1u, boost::memory_order_relaxed);
+            }
+        }
+    }
+
+    //! Puts every node to the dependents of its dependencies
+    void scatter_edges(std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            for (std::size_t j = m_edge_offsets[i], n = m_edge_offsets[i + 1u]; j < n; ++j)
+            {
+                const std::size_t pos = m_counters[m_edge_targets[j]].fetch_add(1u, boost::memory_order_relaxed);
+                m_sources[pos] = m_nodes[i];
+            }
+        }
+    }
+
+    //! Orders the dependents of every node and merges them with the existing dependents
+    void merge_dependents(std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            dep_node::nodes::iterator sources_begin = m_sources.begin() + m_source_offsets[i], sources_end = m_sources.begin() + m_source_offsets[i + 1u];
+            std::sort(sources_begin, sources_end, dep_node::order_by_id());
+
+            dep_node::nodes const& existing = m_nodes[i]->get_dependents();
+            dep_node::nodes& dependents = m_dependents[i];
+            dependents.reserve(existing.size() + (sources_end - sources_begin));
+            std::set_union(existing.begin(), existing.end(), sources_begin, sources_end, std::back_inserter(dependents), dep_node::order_by_id());
+        }
+    }
+};
+
+} // namespace
+
 //! The function reconstructs reverse dependencies between the tree nodes
-void reconstruct_reverse_dependencies(dep_tree& root)
+void reconstruct_reverse_dependencies(dep_tree& root, unsigned int thread_count)
+{
+    std::vector< dep_node* > nodes;
+    node_index_map node_indices;
+    collect_nodes(root, nodes, node_indices);
+
+    if (thread_count == 0u)
+        thread_count = boost::thread::hardware_concurrency();
+    if (nodes.size() < min_parallel_node_count || thread_count == 0u)
+        thread_count = 1u;
+
+    std::vector< dep_node::nodes > dependents;
+    reverse_edge_builder builder(nodes, node_indices, thread_count, dependents);
+    builder.build();
+
+    for (std::size_t i = 0, n = nodes.size(); i < n; ++i)
+        nodes[i]->m_dependents.swap(dependents[i]);
+}
+
+namespace {
+
+//! Copies the dependencies, the attributes and the children of the node
+void copy_node(dep_node const& from, dep_node& to, dep_tree::insertion_cursor& target_cursor)
 {
-    for (dep_node::node_set::const_iterator it = root.get_children().begin(), end = root.get_children().end(); it != end; ++it)
+    node_attributes const& from_attributes = from.get_attributes();
+    if (from_attributes.has_any(from.get_id()))
+        to.get_attributes().copy_node(from_attributes, from.get_id(), to.get_id());
+
+    for (dep_node::nodes::const_iterator it = from.get_dependencies().begin(), end = from.get_dependencies().end(); it != end; ++it)
+    {
+        to.add_dependency(target_cursor.add_nested_child((*it)->get_path()));
+    }
+    for (dep_node::nodes::const_iterator it = from.get_dependents().begin(), end = from.get_dependents().end(); it != end; ++it)
     {
-        reconstruct_reverse_dependencies(const_cast< dep_node& >(*it));
+        to.add_dependent(target_cursor.add_nested_child((*it)->get_path()));
     }
 
-    for (dep_node::nodes::const_iterator it = root.get_dependencies().begin(), end = root.get_dependencies().end(); it != end; ++it)
+    for (dep_node::node_set::const_iterator it = from.get_children().begin(), end = from.get_children().end(); it != end; ++it)
     {
-        (*it)->add_dependent(&root);
+        copy_node(*it, *to.add_child(it->get_name()), target_cursor);
     }
 }
+
+//! Mapping of the nodes of the merged tree to the nodes of the target tree
+typedef boost::unordered_map< dep_node const*, dep_node* > node_map;
+
+//! Unifies the children of the nodes. The nodes that have dependencies or dependents are collected, so that the edges are merged afterwards.
+void merge_children(dep_node const& from, dep_node& into, node_map& nodes, std::vector< dep_node const* >& nodes_with_edges)
+{
+    nodes[&from] = &into;
+    if (!from.get_dependencies().empty() || !from.get_dependents().empty())
+        nodes_with_edges.push_back(&from);
+
+    // Both child sets are ordered by name, so the position of every next child in the target set follows the position of the previous one
+    dep_node::node_set const& into_children = into.get_children();
+    dep_node::node_set::const_iterator pos = into_children.begin(), into_end = into_children.end();
+    for (dep_node::node_set::const_iterator it = from.get_children().begin(), end = from.get_children().end(); it != end; ++it)
+    {
+        while (pos != into_end && pos->get_name() < it->get_name())
+            ++pos;
+
+        dep_node* child;
+        if (pos != into_end && pos->get_name() == it->get_name())
+            child = const_cast< dep_node* >(&*pos);
+        else
+            child = into.add_child(pos, it->get_name());
+
+        merge_children(*it, *child, nodes, nodes_with_edges);
+    }
+}
+
+//! An edge of the merged tree, with the source and the target nodes mapped to the target tree
+typedef std::pair< dep_node*, dep_node* > mapped_edge;
+
+//! Maps the edges of the merged tree node to the target tree and appends them to the list
+void map_edges(dep_node* source, dep_node::nodes const& targets, node_map const& nodes, std::vector< mapped_edge >& edges)
+{
+    for (dep_node::nodes::const_iterator it = targets.begin(), end = targets.end(); it != end; ++it)
+    {
+        node_map::const_iterator node_it = nodes.find(*it);
+        BOOST_ASSERT(node_it != nodes.end());
+        edges.push_back(mapped_edge(source, node_it->second));
+    }
+}
+
+//! Distributes the edges by the node identifier selected with \a key with counting sort. The relative order of the edges with the same key is preserved.
+void distribute_edges(std::vector< mapped_edge > const& edges, std::size_t node_count, dep_node* mapped_edge::* key, std::vector< mapped_edge >& result)
+{
+    std::vector< std::size_t > offsets(node_count + 1u, 0u);
+    for (std::vector< mapped_edge >::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+        ++offsets[((*it).*key)->get_id() + 1u];
+    for (std::size_t i = 1; i <= node_count; ++i)
+        offsets[i] += offsets[i - 1u];
+
+    result.resize(edges.size());
+    for (std::vector< mapped_edge >::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+        result[offsets[((*it).*key)->get_id()]++] = *it;
+}
+
+/*!
+ * Unites the edges with the edge lists of their source nodes, which are selected with \a list. The edges are distributed by the target first
+ * and then by the source, so the targets of every source end up ordered by identifier and are united with the ordered list in one pass.
+ * The time is linear in the number of the nodes and the edges.
+ */
+void unite_edges(std::vector< mapped_edge > const& edges, std::size_t node_count, dep_node::nodes dep_node::* list)
+{
+    std::vector< mapped_edge > by_target, by_source;
+    distribute_edges(edges, node_count, &mapped_edge::second, by_target);
+    distribute_edges(by_target, node_count, &mapped_edge::first, by_source);
+
+    dep_node::nodes targets, united;
+    for (std::vector< mapped_edge >::const_iterator it = by_source.begin(), end = by_source.end(); it != end;)
+    {
+        dep_node* source = it->first;
+        targets.clear();
+        for (; it != end && it->first == source; ++it)
+            targets.push_back(it->second);
+
+        // The mapping of the nodes is one to one, so the targets are unique and never refer to the source itself
+        dep_node::nodes& existing = source->*list;
+        united.clear();
+        united.reserve(existing.size() + targets.size());
+        std::set_union(existing.begin(), existing.end(), targets.begin(), targets.end(), std::back_inserter(united), dep_node::order_by_id());
+        existing.swap(united);
+    }
+}
+
+} // namespace
+
+//! The function merges one tree into another
+void merge(dep_tree& into, dep_tree const& from)
+{
+    BOOST_ASSERT(into.get_parent() == NULL && from.get_parent() == NULL);
+
+    node_map nodes;
+    std::vector< dep_node const* > nodes_with_edges;
+    merge_children(from, into, nodes, nodes_with_edges);
+
+    node_attributes const& from_attributes = from.get_attributes();
+    if (!from_attributes.empty())
+    {
+        node_attributes& into_attributes = into.get_attributes();
+        for (node_map::const_iterator it = nodes.begin(), end = nodes.end(); it != end; ++it)
+        {
+            if (from_attributes.has_any(it->first->get_id()))
+                into_attributes.copy_node(from_attributes, it->first->get_id(), it->second->get_id());
+        }
+    }
+
+    std::vector< mapped_edge > dependencies, dependents;
+    for (std::vector< dep_node const* >::const_iterator it = nodes_with_edges.begin(), end = nodes_with_edges.end(); it != end; ++it)
+    {
+        dep_node const& from_node = **it;
+        dep_node* into_node = nodes[&from_node];
+        map_edges(into_node, from_node.get_dependencies(), nodes, dependencies);
+        map_edges(into_node, from_node.get_dependents(), nodes, dependents);
+    }
+
+    unite_edges(dependencies, into.get_node_count(), &dep_node::m_dependencies);
+    unite_edges(dependents, into.get_node_count(), &dep_node::m_dependents);
+}
+
+//! The function copies the node with all its children to another tree, at the same path
+dep_node* copy_subtree(dep_node const& node, dep_tree& target_root)
+{
+    std::string path = node.get_path();
+    dep_tree::insertion_cursor target_cursor(target_root);
+    dep_node* copy = path.empty() ? &target_root : target_cursor.add_nested_child(path);
+    copy_node(node, *copy, target_cursor);
+    return copy;
+}
@@ -0,0 +1,506 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of finding the includes that pull the most into the dependency closures of libraries
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <dependency_breakers.hpp>
+#include <graph_algorithms.hpp>
+#include <node_attributes.hpp>
+#include <trace.hpp>
+#include <work_queue.hpp>
+
+namespace {
+
+const std::size_t invalid_index = static_cast< std::size_t >(-1);
+
+//! Include graph of the files that are reachable from the library files
+struct file_graph
+{
+    std::vector< dep_node const* > nodes;
+    //! The library of every file or -1 if the file does not belong to a library
+    std::vector< std::size_t > libraries;
+    std::vector< boost::uintmax_t > sizes;
+    adjacency_list deps;
+    //! The files of every library
+    std::vector< std::vector< std::size_t > > library_files;
+};
+
+//! Builds the include graph of the library files and the files they include
+void build_file_graph(library_graph const& graph, boost::filesystem::path const& boost_root, file_graph& files)
+{
+    boost::unordered_map< dep_node const*, std::size_t > indices;
+    files.library_files.resize(graph.libraries.size());
+    for (boost::unordered_map< dep_node const*, std::size_t >::const_iterator it = graph.node_libraries.begin(), end = graph.node_libraries.end(); it != end; ++it)
+    {
+        if (it->first->get_children().empty())
+        {
+            indices[it->first] = files.nodes.size();
+            files.nodes.push_back(it->first);
+        }
+    }
+
+    for (std::size_t i = 0; i < files.nodes.size(); ++i)
+    {
+        files.deps.push_back(std::vector< std::size_t >());
+        dep_node::nodes const& deps = files.nodes[i]->get_dependencies();
+        for (dep_node::nodes::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            std::pair< boost::unordered_map< dep_node const*, std::size_t >::iterator, bool > res = indices.insert(std::make_pair(*it, files.nodes.size()));
+            if (res.second)
+                files.nodes.push_back(*it);
+            files.deps[i].push_back(res.first->second);
+        }
+    }
+
+    files.libraries.resize(files.nodes.size());
+    files.sizes.resize(files.nodes.size());
+    for (std::size_t i = 0, n = files.nodes.size(); i < n; ++i)
+    {
+        std::size_t library = graph.find_library(files.nodes[i]);
+        files.libraries[i] = library;
+        if (library != invalid_index)
+            files.library_files[library].push_back(i);
+
+        node_attributes const& attributes = files.nodes[i]->get_attributes();
+        if (attributes.file_size.has(files.nodes[i]->get_id()))
+        {
+            files.sizes[i] = attributes.file_size.get(files.nodes[i]->get_id());
+            continue;
+        }
+
+        boost::system::error_code ec;
+        boost::uintmax_t size = boost::filesystem::file_size(boost_root / files.nodes[i]->get_path(), ec);
+        files.sizes[i] = ec ? 0u : size;
+    }
+}
+
+//! Orders the breakers so that the ones that remove the most from the closure come first
+class order_by_gain
+{
+private:
+    library_graph const& m_graph;
+
+public:
+    typedef bool result_type;
+
+    explicit order_by_gain(library_graph const& graph) : m_graph(graph) {}
+
+    result_type operator() (dependency_breaker const& left, dependency_breaker const& right) const
+    {
+        if (left.libraries.size() != right.libraries.size())
+            return left.libraries.size() > right.libraries.size();
+        if (left.files != right.files)
+            return left.files > right.files;
+        if (left.bytes != right.bytes)
+            return left.bytes > right.bytes;
+        if (left.library != right.library)
+            return m_graph.libraries[left.library].name < m_graph.libraries[right.library].name;
+        if (left.from != right.from)
+            return left.from->get_path() < right.from->get_path();
+        return left.to->get_path() < right.to->get_path();
+    }
+};
+
+//! The class analyzes the closures of the libraries concurrently
+class breaker_finder
+{
+private:
+    //! Per-thread state for building the dominator trees
+    struct dominator_state
+    {
+        //! The vertex of every file, or -1 if the file is not in the closure
+        std::vector< std::size_t > file_vertices;
+        //! The file of every vertex, or -1 for the root and the virtual vertices
+        std::vector< std::size_t > vertex_files;
+        //! The include of every virtual vertex
+        std::vector< std::pair< std::size_t, std::size_t > > vertex_includes;
+        adjacency_list successors;
+        adjacency_list predecessors;
+        std::vector< std::size_t > postorder_numbers;
+        std::vector< std::size_t > reverse_postorder;
+        std::vector< std::size_t > idoms;
+        //! Children of every vertex in the dominator tree
+        adjacency_list dominated;
+        //! The number of files of every library in the closure
+        std::vector< std::size_t > library_file_counts;
+        std::vector< std::size_t > stack;
+        std::vector< std::size_t > removed_libraries;
+    };
+
+private:
+    file_graph const& m_files;
+    std::vector< library_closure >& m_closures;
+    std::vector< std::vector< dependency_breaker > >& m_breakers;
+
+    work_queue m_queue;
+
+public:
+    breaker_finder(file_graph const& files, std::vector< library_closure >& closures, std::vector< std::vector< dependency_breaker > >& breakers) :
+        m_files(files),
+        m_closures(closures),
+        m_breakers(breakers),
+        m_queue(files.library_files.size())
+    {
+    }
+
+    void find(unsigned int thread_count)
+    {
+        m_queue.run(thread_count, "dependency breaker finder", boost::bind(&breaker_finder::find_breakers, this));
+    }
+
+private:
+    //! Worker thread function
+    void find_breakers()
+    {
+        dominator_state state;
+        state.file_vertices.resize(m_files.nodes.size(), invalid_index);
+        state.library_file_counts.resize(m_files.library_files.size(), 0u);
+        std::size_t library;
+        while (m_queue.pop(library))
+            analyze_library(library, state);
+    }
+
+    static std::size_t add_vertex(dominator_state& state, std::size_t file)
+    {
+        std::size_t vertex = state.vertex_files.size();
+        state.vertex_files.push_back(file);
+        state.vertex_includes.push_back(std::pair< std::size_t, std::size_t >(invalid_index, invalid_index));
+        state.successors.resize(vertex + 1u);
+        state.successors[vertex].clear();
+        if (file != invalid_index)
+            state.file_vertices[file] = vertex;
+        return vertex;
+    }
+
+    static std::size_t get_file_vertex(dominator_state& state, std::size_t file)
+    {
+        std::size_t vertex = state.file_vertices[file];
+        if (vertex == invalid_index)
+            vertex = add_vertex(state, file);
+        return vertex;
+    }
+
+    //! Builds the closure of the library, with the includes of other libraries split with virtual vertices. Vertex 0 is the root.
+    void build_closure(std::size_t library, dominator_state& state)
+    {
+        add_vertex(state, invalid_index);
+        std::vector< std::size_t > const& library_files = m_files.library_files[library];
+        for (std::vector< std::size_t >::const_iterator it = library_files.begin(), end = library_files.end(); it != end; ++it)
+        {
+            std::size_t vertex = get_file_vertex(state, *it);
+            state.successors[0].push_back(vertex);
+        }
+
+        // The vertices are added while the closure is walked breadth-first
+        for (std::size_t vertex = 1u; vertex < state.vertex_files.size(); ++vertex)
+        {
+            std::size_t file = state.vertex_files[vertex];
+            if (file == invalid_index)
+                continue;
+
+            bool is_library_file = m_files.libraries[file] == library;
+            std::vector< std::size_t > const& deps = m_files.deps[file];
+            for (std::vector< std::size_t >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+            {
+                std::size_t dep_library = m_files.libraries[*it];
+                std::size_t dep_vertex = get_file_vertex(state, *it);
+                if (is_library_file && dep_library != library && dep_library != invalid_index)
+                {
+                    std::size_t include_vertex = add_vertex(state, invalid_index);
+                    state.vertex_includes[include_vertex] = std::make_pair(file, *it);
+                    state.successors[include_vertex].push_back(dep_vertex);
+                    state.successors[vertex].push_back(include_vertex);
+                }
+                else
+                {
+                    state.successors[vertex].push_back(dep_vertex);
+                }
+            }
+        }
+    }
+
+    //! Numbers the vertices in depth-first postorder from the root
+    static void number_vertices(dominator_state& state)
+    {
+        std::size_t vertex_count = state.vertex_files.size();
+        state.postorder_numbers.assign(vertex_count, invalid_index);
+        state.reverse_postorder.clear();
+
+        // The stack holds the vertex and the index of its next successor to visit
+        std::vector< std::pair< std::size_t, std::size_t > > stack;
+        std::vector< bool > visited(vertex_count, false);
+        stack.push_back(std::pair< std::size_t, std::size_t >(0u, 0u));
+        visited[0] = true;
+        while (!stack.empty())
+        {
+            std::pair< std::size_t, std::size_t >& top = stack.back();
+            std::vector< std::size_t > const& successors = state.successors[top.first];
+            if (top.second < successors.size())
+            {
+                std::size_t successor = successors[top.second++];
+                if (!visited[successor])
+                {
+                    visited[successor] = true;
+                    stack.push_back(std::pair< std::size_t, std::size_t >(successor, 0u));
+                }
+            }
+            else
+            {
+                state.postorder_numbers[top.first] = state.reverse_postorder.size();
+                state.reverse_postorder.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+
+        std::reverse(state.reverse_postorder.begin(), state.reverse_postorder.end());
+    }
+
+    static std::size_t intersect(dominator_state const& state, std::size_t left, std::size_t right)
+    {
+        while (left != right)
+        {
+            while (state.postorder_numbers[left] < state.postorder_numbers[right])
+                left = state.idoms[left];
+            while (state.postorder_numbers[right] < state.postorder_numbers[left])
+                right = state.idoms[right];
+        }
+        return left;
+    }
+
+    //! Builds the dominator tree with the iterative algorithm of Cooper, Harvey and Kennedy
+    static void build_dominator_tree(dominator_state& state)
+    {
+        std::size_t vertex_count = state.vertex_files.size();
+        state.predecessors.resize(vertex_count);
+        for (std::size_t i = 0; i < vertex_count; ++i)
+            state.predecessors[i].clear();
+        for (std::size_t i = 0; i < vertex_count; ++i)
+        {
+            std::vector< std::size_t > const& successors = state.successors[i];
+            for (std::vector< std::size_t >::const_iterator it = successors.begin(), end = successors.end(); it != end; ++it)
+                state.predecessors[*it].push_back(i);
+        }
+
+        state.idoms.assign(vertex_count, invalid_index);
+        state.idoms[0] = 0u;
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (std::vector< std::size_t >::const_iterator it = state.reverse_postorder.begin() + 1, end = state.reverse_postorder.end(); it != end; ++it)
+            {
+                std::size_t idom = invalid_index;
+                std::vector< std::size_t > const& predecessors = state.predecessors[*it];
+                for (std::vector< std::size_t >::const_iterator pred_it = predecessors.begin(), pred_end = predecessors.end(); pred_it != pred_end; ++pred_it)
+                {
+                    if (state.idoms[*pred_it] != invalid_index)
+                        idom = idom == invalid_index ? *pred_it : intersect(state, *pred_it, idom);
+                }
+
+                if (state.idoms[*it] != idom)
+                {
+                    state.idoms[*it] = idom;
+                    changed = true;
+                }
+            }
+        }
+
+        state.dominated.resize(vertex_count);
+        for (std::size_t i = 0; i < vertex_count; ++i)
+            state.dominated[i].clear();
+        for (std::size_t i = 1; i < vertex_count; ++i)
+            state.dominated[state.idoms[i]].push_back(i);
+    }
+
+    void analyze_library(std::size_t library, dominator_state& state)
+    {
+        state.vertex_files.clear();
+        state.vertex_includes.clear();
+        build_closure(library, state);
+        number_vertices(state);
+        build_dominator_tree(state);
+
+        std::size_t vertex_count = state.vertex_files.size();
+        library_closure& closure = m_closures[library];
+        for (std::size_t i = 1; i < vertex_count; ++i)
+        {
+            std::size_t file = state.vertex_files[i];
+            if (file == invalid_index || m_files.libraries[file] == library)
+                continue;
+
+            ++closure.files;
+            closure.bytes += m_files.sizes[file];
+            std::size_t file_library = m_files.libraries[file];
+            if (file_library != invalid_index && state.library_file_counts[file_library]++ == 0u)
+                ++closure.libraries;
+        }
+
+        // Only the files of the other libraries are dominated by the virtual vertices, since the library files are all reachable from the root
+        std::vector< dependency_breaker >& breakers = m_breakers[library];
+        for (std::size_t i = 1; i < vertex_count; ++i)
+        {
+            std::pair< std::size_t, std::size_t > const& include = state.vertex_includes[i];
+            if (include.first == invalid_index)
+                continue;
+
+            breakers.push_back(dependency_breaker());
+            dependency_breaker& breaker = breakers.back();
+            breaker.library = library;
+            breaker.from = m_files.nodes[include.first];
+            breaker.to = m_files.nodes[include.second];
+            breaker.to_library = m_files.libraries[include.second];
+
+            state.removed_libraries.clear();
+            state.stack.assign(state.dominated[i].begin(), state.dominated[i].end());
+            while (!state.stack.empty())
+            {
+                std::size_t vertex = state.stack.back();
+                state.stack.pop_back();
+                state.stack.insert(state.stack.end(), state.dominated[vertex].begin(), state.dominated[vertex].end());
+
+                std::size_t file = state.vertex_files[vertex];
+                if (file == invalid_index)
+                    continue;
+
+                ++breaker.files;
+                breaker.bytes += m_files.sizes[file];
+                if (m_files.libraries[file] != invalid_index)
+                    state.removed_libraries.push_back(m_files.libraries[file]);
+            }
+
+            // A library leaves the closure if all its files in the closure do
+            std::sort(state.removed_libraries.begin(), state.removed_libraries.end());
+            for (std::vector< std::size_t >::const_iterator it = state.removed_libraries.begin(), end = state.removed_libraries.end(); it != end;)
+            {
+                std::vector< std::size_t >::const_iterator next = std::upper_bound(it, end, *it);
+                if (static_cast< std::size_t >(next - it) == state.library_file_counts[*it])
+                    breaker.libraries.push_back(*it);
+                it = next;
+            }
+        }
+
+        // Reset the state for the next library
+        for (std::size_t i = 1; i < vertex_count; ++i)
+        {
+            std::size_t file = state.vertex_files[i];
+            if (file != invalid_index)
+            {
+                state.file_vertices[file] = invalid_index;
+                std::size_t file_library = m_files.libraries[file];
+                if (file_library != invalid_index)
+                    state.library_file_counts[file_library] = 0u;
+            }
+        }
+    }
+};
+
+void append_node_path(dep_node const* node, std::string& text)
+{
+    text.append(1, '"').append(node->get_path()).append(1, '"');
+}
+
+} // namespace
+
+//! The function ranks the includes between libraries by how much of the dependency closure of the including library would go away if the include was removed
+void find_dependency_breakers(library_graph const& graph, boost::filesystem::path const& boost_root, dependency_breakers& result, unsigned int thread_count)
+{
+    trace_span span("analysis", "find_dependency_breakers");
+
+    file_graph files;
+    build_file_graph(graph, boost_root, files);
+
+    result.closures.assign(graph.libraries.size(), library_closure());
+    std::vector< std::vector< dependency_breaker > > library_breakers(graph.libraries.size());
+
+    breaker_finder finder(files, result.closures, library_breakers);
+    finder.find(thread_count);
+
+    result.breakers.clear();
+    for (std::vector< std::vector< dependency_breaker > >::const_iterator it = library_breakers.begin(), end = library_breakers.end(); it != end; ++it)
+        result.breakers.insert(result.breakers.end(), it->begin(), it->end());
+    std::sort(result.breakers.begin(), result.breakers.end(), order_by_gain(graph));
+}
+
+//! Serializes the dependency breaker analysis results into JSON format
+void serialize_dependency_breakers_json(library_graph const& graph, dependency_breakers const& breakers, std::ostream& strm, bool pretty_print, const char* indent)
+{
+    std::string nl_ind, ind;
+    const char* space = "";
+    if (pretty_print)
+    {
+        ind = indent;
+        nl_ind = "\n" + ind;
+        space = " ";
+    }
+    std::string nl_ind2 = nl_ind + ind, nl_ind3 = nl_ind2 + ind;
+
+    std::string text;
+    text.append(1, '{');
+
+    // The closures give the scale for the gains of the breakers
+    text.append(nl_ind).append("\"libraries\":").append(nl_ind).append(1, '{');
+    for (std::size_t i = 0, n = graph.libraries.size(); i < n; ++i)
+    {
+        library_closure const& closure = breakers.closures[i];
+        if (i > 0u)
+            text.push_back(',');
+        text.append(nl_ind2).append(1, '"').append(graph.libraries[i].name).append("\":").append(nl_ind2).append(1, '{');
+        text.append(nl_ind3).append("\"libraries\":").append(space).append(boost::lexical_cast< std::string >(closure.libraries)).append(1, ',');
+        text.append(nl_ind3).append("\"files\":").append(space).append(boost::lexical_cast< std::string >(closure.files)).append(1, ',');
+        text.append(nl_ind3).append("\"bytes\":").append(space).append(boost::lexical_cast< std::string >(closure.bytes));
+        text.append(nl_ind2).append(1, '}');
+    }
+    text.append(nl_ind).append("},");
+
+    text.append(nl_ind).append("\"breakers\":").append(nl_ind).append(1, '[');
+    for (std::vector< dependency_breaker >::const_iterator it = breakers.breakers.begin(), end = breakers.breakers.end(); it != end; ++it)
+    {
+        if (it != breakers.breakers.begin())
+            text.push_back(',');
+        text.append(nl_ind2).append(1, '{');
+        text.append(nl_ind3).append("\"library\":").append(space).append(1, '"').append(graph.libraries[it->library].name).append("\",");
+        text.append(nl_ind3).append("\"from\":").append(space);
+        append_node_path(it->from, text);
+        text.append(1, ',');
+        text.append(nl_ind3).append("\"to\":").append(space);
+        append_node_path(it->to, text);
+        text.append(1, ',');
+        text.append(nl_ind3).append("\"to_library\":").append(space).append(1, '"').append(graph.libraries[it->to_library].name).append("\",");
+        text.append(nl_ind3).append("\"files\":").append(space).append(boost::lexical_cast< std::string >(it->files)).append(1, ',');
+        text.append(nl_ind3).append("\"bytes\":").append(space).append(boost::lexical_cast< std::string >(it->bytes)).append(1, ',');
+        text.append(nl_ind3).append("\"libraries\":").append(space).append(1, '[');
+        for (std::vector< std::size_t >::const_iterator lib_it = it->libraries.begin(), lib_end = it->libraries.end(); lib_it != lib_end; ++lib_it)
+        {
+            if (lib_it != it->libraries.begin())
+                text.append(1, ',').append(space);
+            text.append(1, '"').append(graph.libraries[*lib_it].name).append(1, '"');
+        }
+        text.append("]");
+        text.append(nl_ind2).append(1, '}');
+
+        if (text.size() >= 65536u)
+        {
+            strm.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    text.append(nl_ind).append(1, ']');
+    text.append(pretty_print ? "\n}\n" : "}");
+
+    strm.write(text.data(), text.size());
+}
@@ -0,0 +1,322 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of extracting the subset of Boost files needed by a set of headers
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <boost/bind.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <file_extractor.hpp>
+#include <library_graph.hpp>
+#include <cxx_parser.hpp>
+#include <trace.hpp>
+#include <work_queue.hpp>
+#include <file_descriptor.hpp>
+#if !defined(BOOST_WINDOWS)
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#endif
+#endif
+
+namespace {
+
+const char include_dir_name[] = "include";
+
+//! The way the file was created
+enum extract_result
+{
+    file_linked,
+    file_cloned,
+    file_copied
+};
+
+//! File to extract
+struct extract_job
+{
+    boost::filesystem::path from;
+    boost::filesystem::path to;
+};
+
+#if !defined(BOOST_WINDOWS)
+
+//! Copies the file data with read/write
+void copy_data(int from_fd, int to_fd)
+{
+    char buf[64u * 1024u];
+    while (true)
+    {
+        ssize_t n = ::read(from_fd, buf, sizeof(buf));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw_system_error("Failed to read file");
+        }
+        if (n == 0)
+            break;
+
+        write_data(to_fd, buf, static_cast< std::size_t >(n));
+    }
+}
+
+extract_result extract_file(extract_job const& job, extract_method method, boost::uintmax_t& copied_bytes)
+{
+    if (::unlink(job.to.c_str()) != 0 && errno != ENOENT)
+        throw_system_error("Failed to remove the existing file");
+
+    if (method == extract_link)
+    {
+        if (::link(job.from.c_str(), job.to.c_str()) == 0)
+            return file_linked;
+        if (!is_not_supported(errno))
+            throw_system_error("Failed to create hardlink");
+    }
+
+    int from_fd = ::open(job.from.c_str(), O_RDONLY);
+    if (from_fd < 0)
+        throw_system_error("Failed to open file");
+    file_descriptor_guard from_guard(from_fd);
+
+    struct stat from_stat;
+    if (::fstat(from_fd, &from_stat) != 0)
+        throw_system_error("Failed to read file status");
+
+    int to_fd = ::open(job.to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, from_stat.st_mode & 0777);
+    if (to_fd < 0)
+        throw_system_error("Failed to create file");
+    file_descriptor_guard to_guard(to_fd);
+
+#if defined(FICLONE)
+    if (method != extract_copy)
+    {
+        if (::ioctl(to_fd, FICLONE, from_fd) == 0)
+            return file_cloned;
+        if (errno != ENOTTY && !is_not_supported(errno))
+            throw_system_error("Failed to clone file");
+    }
+#endif
+
+    // The kernel may still copy the data without moving it through the user space, or even share the data blocks on some filesystems
+    boost::uintmax_t size = static_cast< boost::uintmax_t >(from_stat.st_size);
+#if defined(BOOST_PKG_DEP_TREE_HAS_COPY_FILE_RANGE)
+    boost::uintmax_t copied = 0u;
+    while (copied < size)
+    {
+        ssize_t n = ::copy_file_range(from_fd, NULL, to_fd, NULL, size - copied, 0u);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (copied == 0u && is_not_supported(errno))
+                break;
+            throw_system_error("Failed to copy file");
+        }
+        if (n == 0)
+            break;
+        copied += static_cast< boost::uintmax_t >(n);
+    }
+
+    if (copied == 0u)
+        copy_data(from_fd, to_fd);
+#else
+    copy_data(from_fd, to_fd);
+#endif
+
+    copied_bytes += size;
+    return file_copied;
+}
+
+#else // !defined(BOOST_WINDOWS)
+
+extract_result extract_file(extract_job const& job, extract_method method, boost::uintmax_t& copied_bytes)
+{
+    boost::filesystem::remove(job.to);
+
+    if (method == extract_link)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::create_hard_link(job.from, job.to, ec);
+        if (!ec)
+            return file_linked;
+    }
+
+    boost::filesystem::copy_file(job.from, job.to);
+    copied_bytes += boost::filesystem::file_size(job.to);
+    return file_copied;
+}
+
+#endif // !defined(BOOST_WINDOWS)
+
+//! The class creates the files concurrently
+class file_extractor
+{
+private:
+    std::vector< extract_job > const& m_jobs;
+    const extract_method m_method;
+    work_queue m_queue;
+    boost::mutex m_mutex;
+    extract_stats m_stats;
+
+public:
+    file_extractor(std::vector< extract_job > const& jobs, extract_method method) : m_jobs(jobs), m_method(method), m_queue(jobs.size())
+    {
+    }
+
+    void extract(unsigned int thread_count, extract_stats& stats)
+    {
+        m_queue.run(thread_count, "file extractor", boost::bind(&file_extractor::extract_files, this));
+        stats = m_stats;
+    }
+
+private:
+    //! Worker thread function
+    void extract_files()
+    {
+        extract_stats stats;
+        std::size_t i;
+        while (m_queue.pop(i))
+        {
+            extract_job const& job = m_jobs[i];
+            try
+            {
+                switch (extract_file(job, m_method, stats.copied_bytes))
+                {
+                case file_linked:
+                    ++stats.linked_files;
+                    break;
+                case file_cloned:
+                    ++stats.cloned_files;
+                    break;
+                default:
+                    ++stats.copied_files;
+                    break;
+                }
+            }
+            catch (boost::exception& e)
+            {
+                e << file_name_info(job.from.string());
+                throw;
+            }
+        }
+
+        boost::lock_guard< boost::mutex > lock(m_mutex);
+        m_stats.linked_files += stats.linked_files;
+        m_stats.cloned_files += stats.cloned_files;
+        m_stats.copied_files += stats.copied_files;
+        m_stats.copied_bytes += stats.copied_bytes;
+    }
+};
+
+//! Returns the path of the extracted file relative to the target directory
+std::string make_target_path(dep_node const* node, library_graph const* graph)
+{
+    if (graph)
+    {
+        std::size_t library = graph->find_library(node);
+        dep_node const* include_dir = library != static_cast< std::size_t >(-1) ? graph->libraries[library].node->get_child(include_dir_name) : NULL;
+        if (include_dir)
+        {
+            // Check if the node is in the include directory of the library
+            std::vector< dep_node const* > path;
+            for (dep_node const* p = node; p != NULL && p != include_dir; p = p->get_parent())
+                path.push_back(p);
+
+            if (!path.empty() && path.back()->get_parent() == include_dir)
+            {
+                std::string target_path;
+                for (std::vector< dep_node const* >::const_reverse_iterator it = path.rbegin(), end = path.rend(); it != end; ++it)
+                {
+                    if (!target_path.empty())
+                        target_path.push_back(dep_node::default_node_separator);
+                    target_path.append((*it)->get_name());
+                }
+                return target_path;
+            }
+        }
+    }
+
+    return node->get_path();
+}
+
+} // namespace
+
+//! The function collects the nodes reachable from the entry nodes through dependencies, including the entry nodes themselves
+void collect_dependency_closure(std::vector< dep_node* > const& entries, std::vector< dep_node const* >& closure)
+{
+    closure.clear();
+    boost::unordered_set< dep_node const* > visited;
+    for (std::vector< dep_node* >::const_iterator it = entries.begin(), end = entries.end(); it != end; ++it)
+    {
+        if (visited.insert(*it).second)
+            closure.push_back(*it);
+    }
+
+    for (std::size_t i = 0; i < closure.size(); ++i)
+    {
+        dep_node::nodes const& deps = closure[i]->get_dependencies();
+        for (dep_node::nodes::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            if (visited.insert(*it).second)
+                closure.push_back(*it);
+        }
+    }
+}
+
+//! The function creates the files of the nodes in the target directory
+void extract_files(std::vector< dep_node const* > const& nodes, dep_tree& root, extract_params const& params, extract_stats& stats)
+{
+    trace_span span("extract", "extract_files", params.target_dir);
+    stats = extract_stats();
+
+    library_graph graph;
+    if (params.merge_include_dirs)
+        build_library_graph(root, graph);
+
+    // Different libraries may have files with the same paths in their include directories, the first one wins
+    std::vector< extract_job > jobs;
+    std::vector< boost::filesystem::path > dirs;
+    boost::unordered_set< std::string > target_paths;
+    for (std::vector< dep_node const* >::const_iterator it = nodes.begin(), end = nodes.end(); it != end; ++it)
+    {
+        std::string target_path = make_target_path(*it, params.merge_include_dirs ? &graph : NULL);
+        if (!target_paths.insert(target_path).second)
+            continue;
+
+        extract_job job;
+        job.from = params.boost_root / (*it)->get_path();
+        job.to = params.target_dir / target_path;
+        dirs.push_back(job.to.parent_path());
+        jobs.push_back(job);
+    }
+
+    // Create the directories beforehand, so that the worker threads don't race creating them
+    std::sort(dirs.begin(), dirs.end());
+    dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+    for (std::vector< boost::filesystem::path >::const_iterator it = dirs.begin(), end = dirs.end(); it != end; ++it)
+        boost::filesystem::create_directories(*it);
+
+    file_extractor extractor(jobs, params.method);
+    extractor.extract(params.thread_count, stats);
+}
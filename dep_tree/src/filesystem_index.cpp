@@ -0,0 +1,416 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the in-memory filesystem index
+ */
+
+#include <cstddef>
+#include <string>
+#include <algorithm>
+#include <boost/assert.hpp>
+#include <boost/system/error_code.hpp>
+#include <filesystem_index.hpp>
+#include <filesystem_ext.hpp>
+#include <source_pack.hpp>
+#include <trace.hpp>
+
+namespace {
+
+//! Maximum number of symlinks to follow while resolving a path, to protect against symlink loops
+const unsigned int max_symlink_depth = 40u;
+
+//! Ordering predicate for the directory entries
+struct order_by_name
+{
+    typedef bool result_type;
+
+    result_type operator() (filesystem_index::entry const& left, filesystem_index::entry const& right) const
+    {
+        return left.first < right.first;
+    }
+    result_type operator() (filesystem_index::entry const& left, std::string const& right) const
+    {
+        return left.first < right;
+    }
+    result_type operator() (std::string const& left, filesystem_index::entry const& right) const
+    {
+        return left < right.first;
+    }
+    result_type operator() (filesystem_index::entry const& left, boost::string_ref const& right) const
+    {
+        return boost::string_ref(left.first) < right;
+    }
+    result_type operator() (boost::string_ref const& left, filesystem_index::entry const& right) const
+    {
+        return left < boost::string_ref(right.first);
+    }
+};
+
+inline boost::filesystem::path make_normalized(boost::filesystem::path const& path)
+{
+    return normalize_path(boost::filesystem::system_complete(path));
+}
+
+//! Splits the normalized absolute path into the parent directory and the file name. Returns \c false if the path is the filesystem root.
+inline bool split_normalized_path(boost::string_ref const& path, boost::string_ref& parent, boost::string_ref& name)
+{
+    const std::size_t root_size = path.size() - make_root_relative_part(path).size();
+    if (root_size >= path.size())
+        return false;
+
+    std::size_t pos = path.size();
+    while (pos > root_size && !is_path_separator(path[pos - 1u]))
+        --pos;
+
+    name = path.substr(pos);
+    parent = path.substr(0u, pos > root_size ? pos - 1u : root_size);
+    return true;
+}
+
+//! Appends the path element to the path, adding a separator if needed
+inline void append_path_element(std::string& path, boost::string_ref const& element)
+{
+    if (!path.empty() && !is_path_separator(path[path.size() - 1u]))
+        path.push_back(boost::filesystem::path::preferred_separator);
+    path.append(element.data(), element.size());
+}
+
+} // namespace
+
+//! Returns the entries of the directory. Returns an empty list if the directory does not exist.
+filesystem_index::entries const& filesystem_index::list_directory(boost::filesystem::path const& dir)
+{
+    return list_normalized_directory(make_normalized(dir).string());
+}
+
+//! Returns the entries of the directory, which is specified by a normalized path
+filesystem_index::entries const& filesystem_index::list_normalized_directory(boost::string_ref const& dir)
+{
+    directory_map::iterator it = m_directories.find(dir, string_hash(), string_equal());
+    if (it != m_directories.end())
+        return it->second;
+
+    std::string key(dir.data(), dir.size());
+    trace_span span("fs", "list_directory", key);
+    entries dir_entries;
+    boost::filesystem::path dir_path(key);
+    if (m_pack && m_pack->contains(key))
+    {
+        // The entries of the packed directory are already ordered by name
+        source_pack::entry_id dir_id = m_pack->find(key);
+        if (dir_id != source_pack::invalid_entry && m_pack->type(dir_id) == source_pack::directory)
+        {
+            for (source_pack::entry_id id = m_pack->first_child(dir_id), end = static_cast< source_pack::entry_id >(id + m_pack->child_count(dir_id)); id != end; ++id)
+            {
+                boost::string_ref name = m_pack->name(id);
+                dir_entries.push_back(entry(std::string(name.data(), name.size()), m_pack->file_type(id)));
+            }
+        }
+    }
+    else if (!dir_path.has_parent_path() || boost::filesystem::is_directory(status(dir_path)))
+    {
+        boost::system::error_code ec;
+        boost::filesystem::directory_iterator dir_it(dir_path, ec), dir_end;
+        for (; !ec && dir_it != dir_end; dir_it.increment(ec))
+        {
+            // The file type is normally known from the directory listing
+            boost::filesystem::file_type type = dir_it->symlink_status(ec).type();
+            if (ec || type == boost::filesystem::status_error || type == boost::filesystem::status_unknown)
+                type = boost::filesystem::symlink_status(dir_it->path(), ec).type();
+            dir_entries.push_back(entry(dir_it->path().filename().string(), type));
+        }
+
+        std::sort(dir_entries.begin(), dir_entries.end(), order_by_name());
+    }
+
+    // Note that the recursive calls above may have added other directories to the map, so the iterator is not reused
+    return m_directories.insert(directory_map::value_type(key, dir_entries)).first->second;
+}
+
+//! Returns the file type, without following symlinks. The path must be absolute and normalized.
+boost::filesystem::file_type filesystem_index::normalized_symlink_type(boost::string_ref const& path)
+{
+    if (m_pack && m_pack->contains(path))
+    {
+        source_pack::entry_id id = m_pack->find(path, false);
+        return id != source_pack::invalid_entry ? m_pack->file_type(id) : boost::filesystem::file_not_found;
+    }
+
+    boost::string_ref parent, name;
+    if (!split_normalized_path(path, parent, name))
+        return boost::filesystem::directory_file;
+
+    entries const& dir_entries = list_normalized_directory(parent);
+    entries::const_iterator it = std::lower_bound(dir_entries.begin(), dir_entries.end(), name, order_by_name());
+    if (it != dir_entries.end() && it->first == name)
+        return it->second;
+
+    return boost::filesystem::file_not_found;
+}
+
+//! Returns the symlink target. The path must be absolute and normalized.
+boost::filesystem::path const& filesystem_index::read_normalized_symlink(boost::string_ref const& path)
+{
+    symlink_map::iterator it = m_symlinks.find(path, string_hash(), string_equal());
+    if (it == m_symlinks.end())
+    {
+        std::string key(path.data(), path.size());
+        boost::filesystem::path target;
+        source_pack::entry_id id = source_pack::invalid_entry;
+        if (m_pack && m_pack->contains(path))
+            id = m_pack->find(path, false);
+        if (id != source_pack::invalid_entry && m_pack->type(id) == source_pack::symlink)
+        {
+            boost::string_ref target_str = m_pack->symlink_target(id);
+            target = boost::filesystem::path(target_str.begin(), target_str.end());
+        }
+        else
+        {
+            target = boost::filesystem::read_symlink(key);
+        }
+        it = m_symlinks.insert(symlink_map::value_type(key, target)).first;
+    }
+
+    return it->second;
+}
+
+//! Follows the symlinks of the last element of the normalized path, in place, and returns the file type of the resulting path
+boost::filesystem::file_type filesystem_index::peel_normalized_symlinks(std::string& path)
+{
+    boost::filesystem::file_type type = normalized_symlink_type(path);
+    unsigned int depth = 0;
+    while (type == boost::filesystem::symlink_file && depth++ < max_symlink_depth)
+    {
+        boost::filesystem::path const& referred_path = read_normalized_symlink(path);
+        std::string const& referred_str = referred_path.string();
+        if (referred_path.is_relative())
+        {
+            boost::string_ref parent, name;
+            split_normalized_path(path, parent, name);
+            path.resize(parent.size());
+            append_path_element(path, referred_str);
+        }
+        else
+        {
+            path = referred_str;
+        }
+        normalize_path_in_place(path);
+        type = normalized_symlink_type(path);
+    }
+
+    return type;
+}
+
+//! Follows the symlinks of every element of \a path after the \a root_size leading characters. The result is composed in \a resolved_path.
+boost::filesystem::file_type filesystem_index::recursive_peel_normalized_symlinks(boost::string_ref const& path, std::size_t root_size, std::string& resolved_path)
+{
+    resolved_path.assign(path.data(), root_size);
+    normalize_path_in_place(resolved_path);
+
+    boost::filesystem::file_type type = boost::filesystem::status_unknown;
+    for (std::size_t pos = root_size, size = path.size(); pos < size;)
+    {
+        std::size_t element_end = pos;
+        while (element_end < size && !is_path_separator(path[element_end]))
+            ++element_end;
+
+        if (element_end > pos)
+        {
+            append_path_element(resolved_path, path.substr(pos, element_end - pos));
+            normalize_path_in_place(resolved_path);
+            type = peel_normalized_symlinks(resolved_path);
+        }
+
+        pos = element_end + 1u;
+    }
+
+    return type;
+}
+
+//! Returns the file status, without following symlinks
+boost::filesystem::file_status filesystem_index::symlink_status(boost::filesystem::path const& path)
+{
+    return boost::filesystem::file_status(normalized_symlink_type(make_normalized(path).string()));
+}
+
+//! Returns the file status, following symlinks
+boost::filesystem::file_status filesystem_index::status(boost::filesystem::path const& path)
+{
+    std::string p = make_normalized(path).string();
+    boost::filesystem::file_type type = peel_normalized_symlinks(p);
+    if (type == boost::filesystem::symlink_file)
+        type = boost::filesystem::file_not_found;
+
+    return boost::filesystem::file_status(type);
+}
+
+//! Returns the symlink target
+boost::filesystem::path const& filesystem_index::read_symlink(boost::filesystem::path const& path)
+{
+    return read_normalized_symlink(make_normalized(path).string());
+}
+
+//! Follows all symlinks and returns the path that is referred to by the symlinks
+boost::filesystem::path filesystem_index::peel_symlinks(boost::filesystem::path path, boost::filesystem::file_status* status)
+{
+    std::string p = make_normalized(path).string();
+    boost::filesystem::file_type type = peel_normalized_symlinks(p);
+    if (status)
+        *status = boost::filesystem::file_status(type);
+    return boost::filesystem::path(p);
+}
+
+//! Follows all symlinks, for all directories up to the root path as well
+boost::filesystem::path filesystem_index::recursive_peel_symlinks(boost::filesystem::path const& root_path, boost::filesystem::path const& path, boost::filesystem::file_status* status)
+{
+    std::string root = boost::filesystem::system_complete(root_path).string();
+    std::string p = boost::filesystem::system_complete(path).string();
+    if (!is_within_directory(root, p))
+        return root_path;
+
+    std::string resolved_path;
+    boost::filesystem::file_type type = recursive_peel_normalized_symlinks(p, root.size(), resolved_path);
+    if (status && type != boost::filesystem::status_unknown)
+        *status = boost::filesystem::file_status(type);
+    return boost::filesystem::path(resolved_path);
+}
+
+//! Looks for a regular file in the directory and returns the path with all symlinks peeled
+boost::filesystem::path const& filesystem_index::find_regular_file(boost::filesystem::path const& root_path, boost::filesystem::path const& dir, boost::string_ref const& relative_path)
+{
+    static const boost::filesystem::path empty_path;
+
+    // Most lookups are for files that don't exist, don't waste memory on caching them
+    lookup_result res = quick_lookup(dir, relative_path);
+    if (res == not_found)
+        return empty_path;
+
+    // Compose the key in the buffer, the same way as "dir / relative_path" would
+    std::string& key = m_path_buffer;
+    key = dir.string();
+    append_path_element(key, relative_path);
+
+    file_map::iterator it = m_files.find(boost::string_ref(key), string_hash(), string_equal());
+    if (it == m_files.end())
+    {
+        // The directories are normally absolute already, so the path is resolved in the buffers
+        boost::string_ref path = key;
+        std::string complete_path;
+        if (make_root_relative_part(path).size() == path.size())
+        {
+            complete_path = boost::filesystem::system_complete(key).string();
+            path = complete_path;
+        }
+
+        boost::filesystem::path resolved_path;
+        std::string& resolved = m_resolve_buffer;
+        resolved.assign(path.data(), path.size());
+        normalize_path_in_place(resolved);
+        boost::filesystem::file_type type = peel_normalized_symlinks(resolved);
+        if (type != boost::filesystem::file_not_found && type != boost::filesystem::symlink_file && type != boost::filesystem::status_error)
+        {
+            if (m_root_path.native() != root_path.native())
+            {
+                m_root_path = root_path;
+                m_root_string = boost::filesystem::system_complete(root_path).string();
+            }
+
+            // Symlinks are peeled starting from the root path if the file is within it, or from the filesystem root otherwise
+            std::size_t root_size = path.size() - make_root_relative_part(path).size();
+            if (is_within_directory(m_root_string, path))
+                root_size = m_root_string.size();
+
+            if (recursive_peel_normalized_symlinks(path, root_size, resolved) == boost::filesystem::regular_file)
+                resolved_path = resolved;
+        }
+
+        it = m_files.insert(file_map::value_type(key, resolved_path)).first;
+    }
+
+    return it->second;
+}
+
+//! Registers a search path
+filesystem_index::search_path_id filesystem_index::add_search_path(std::vector< boost::filesystem::path > const& dirs)
+{
+    std::vector< boost::filesystem::path > normalized_dirs;
+    for (std::vector< boost::filesystem::path >::const_iterator it = dirs.begin(), end = dirs.end(); it != end; ++it)
+        normalized_dirs.push_back(make_normalized(*it));
+
+    // Translation units from a compilation database typically share the include directories, let them share the cache as well
+    for (search_path_id id = 0u, n = m_search_paths.size(); id < n; ++id)
+    {
+        if (m_search_paths[id].dirs == normalized_dirs)
+            return id;
+    }
+
+    m_search_paths.push_back(search_path());
+    m_search_paths.back().dirs.swap(normalized_dirs);
+
+    return m_search_paths.size() - 1u;
+}
+
+//! Looks for a regular file in the search path directories
+boost::filesystem::path const& filesystem_index::find_in_search_path(search_path_id id, boost::filesystem::path const& root_path, boost::string_ref const& relative_path)
+{
+    BOOST_ASSERT(id < m_search_paths.size());
+    search_path& sp = m_search_paths[id];
+
+    file_map::iterator it = sp.found_files.find(relative_path, string_hash(), string_equal());
+    if (it == sp.found_files.end())
+    {
+        std::string key(relative_path.data(), relative_path.size());
+        boost::filesystem::path found_path;
+        for (std::vector< boost::filesystem::path >::const_iterator dir_it = sp.dirs.begin(), dir_end = sp.dirs.end(); dir_it != dir_end && found_path.empty(); ++dir_it)
+        {
+            found_path = find_regular_file(root_path, *dir_it, relative_path);
+        }
+
+        it = sp.found_files.insert(file_map::value_type(key, found_path)).first;
+    }
+
+    return it->second;
+}
+
+//! Checks if the file exists, without building paths
+filesystem_index::lookup_result filesystem_index::quick_lookup(boost::filesystem::path const& dir, boost::string_ref const& relative_path)
+{
+    std::string& current_dir = m_lookup_buffer;
+    current_dir = dir.string();
+
+    std::size_t pos = 0u;
+    while (true)
+    {
+        boost::string_ref name = relative_path.substr(pos);
+        std::size_t sep_pos = name.find('/');
+        if (sep_pos != boost::string_ref::npos)
+        {
+            name = name.substr(0u, sep_pos);
+            sep_pos += pos;
+        }
+        if (name.empty() || name == "." || name == ".." || name.find('\\') != boost::string_ref::npos)
+            return unknown;
+
+        entries const& dir_entries = list_normalized_directory(current_dir);
+        entries::const_iterator it = std::lower_bound(dir_entries.begin(), dir_entries.end(), name, order_by_name());
+        if (it == dir_entries.end() || it->first != name)
+            return not_found;
+
+        if (it->second == boost::filesystem::symlink_file)
+            return unknown;
+
+        if (sep_pos == boost::string_ref::npos)
+            return it->second == boost::filesystem::regular_file ? found : not_found;
+
+        if (it->second != boost::filesystem::directory_file)
+            return not_found;
+
+        current_dir.push_back('/');
+        current_dir.append(name.data(), name.size());
+        pos = sep_pos + 1u;
+    }
+}
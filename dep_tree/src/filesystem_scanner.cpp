@@ -10,15 +10,24 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <string>
 #include <stdexcept>
 #include <algorithm>
 #include <boost/config.hpp>
 #include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/throw_exception.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <filesystem_scanner.hpp>
 #include <cxx_parser.hpp>
 #include <filesystem_ext.hpp>
+#include <filesystem_index.hpp>
+#include <git_index.hpp>
+#include <node_attributes.hpp>
+#include <source_pack.hpp>
+#include <trace.hpp>
 
 namespace {
 
@@ -75,46 +84,111 @@ bool filename_match_any(std::string const& filename, std::vector< std::string >
     return false;
 }
 
-
-//! The function detects if the file should be parsed as C++
-bool is_cxx_file(boost::filesystem::path const& path, std::vector< std::string > const& cxx_wildcards)
+//! Checks if the file belongs to the scanned shard
+bool is_in_shard(boost::filesystem::path const& path, scan_params const& params, cxx_parser_params const& cxx_params)
 {
-    std::string filename = path.filename().string();
-    for (std::vector< std::string >::const_iterator it = cxx_wildcards.begin(), end = cxx_wildcards.end(); it != end; ++it)
+    if (params.shard_count <= 1u)
+        return true;
+
+    // The files are partitioned by their paths relative to Boost root, so that the partition does not depend on where Boost is located.
+    // FNV-1a hash is used because it is the same in every process and on every host, unlike std::hash or boost::hash.
+    std::string const& str = path.string();
+    boost::string_ref key = str;
+    if (cxx_params.canonical_boost_root.contains(key))
+        key = cxx_params.canonical_boost_root.make_relative(key);
+
+    boost::uint64_t hash = 14695981039346656037ull;
+    for (boost::string_ref::const_iterator it = key.begin(), end = key.end(); it != end; ++it)
     {
-        if (filename_match(filename, *it))
-            return true;
+        hash ^= static_cast< unsigned char >(*it);
+        hash *= 1099511628211ull;
     }
 
-    // Consider everything in 'include/boost' directory C++. This is needed for boost/compatibility and boost/tr1 - headers in there are difficult to match.
-    // This hack should probably be a customization point.
-    std::string str = path.string();
-    return std::strstr(str.c_str(), "include/boost") != NULL
-#if defined(BOOST_WINDOWS)
-        || std::strstr(str.c_str(), "include\\boost") != NULL
-#endif
-    ;
+    return hash % params.shard_count == params.shard_index;
+}
+
+/*!
+ * Computes the prune rules state of the directory. Returns \c false if the directory is pruned with its contents or if there are no rules
+ * to check for the directory, which is the case for the directories outside Boost root.
+ */
+bool match_prune_rules(boost::filesystem::path const& dir, scan_params const& params, cxx_parser_params const& cxx_params, prune_rules::state& state, bool& subtree_pruned)
+{
+    subtree_pruned = false;
+    if (params.prune.empty())
+        return false;
+
+    std::string const& str = dir.string();
+    if (!cxx_params.canonical_boost_root.contains(str))
+        return false;
+
+    subtree_pruned = !params.prune.match(cxx_params.canonical_boost_root.make_relative(str), state) || params.prune.is_subtree_pruned(state);
+    return !subtree_pruned;
+}
+
+//! Stores the size of the file from the source pack in the node attributes
+void set_packed_file_size(boost::filesystem::path const& path, scan_params const& params, dep_node& node)
+{
+    std::string path_str = path.string();
+    normalize_path_in_place(path_str);
+    if (!params.pack->contains(path_str))
+        return;
+    source_pack::entry_id id = params.pack->find(path_str);
+    if (id != source_pack::invalid_entry && params.pack->type(id) == source_pack::regular_file)
+        node.get_attributes().file_size.set(node.get_id(), params.pack->file_size(id));
+}
+
+//! Stores the file size and the modification time from the git index in the node attributes, unless they are obtained from the file by parsing
+void set_index_file_status(git_index_entry const& entry, dep_node& node)
+{
+    node_attributes& attributes = node.get_attributes();
+    if (!attributes.file_size.has(node.get_id()))
+        attributes.file_size.set(node.get_id(), entry.size);
+    if (!attributes.mtime.has(node.get_id()))
+        attributes.mtime.set(node.get_id(), entry.mtime_sec);
 }
 
 //! The function scans Boost directory tree and builds header dependency tree. The function optionally detects Boost sublibraries and returns the nodes that correspond to the sublib directories.
-void scan_directory(boost::filesystem::path const& dir, scan_params const& params, cxx_parser_params const& cxx_params, dep_tree& root, dep_node& node, std::vector< dep_node* >* sublibs, bool top_level)
+void scan_directory(boost::filesystem::path const& dir, scan_params const& params, cxx_parser_params const& cxx_params, dep_tree& root, dep_node& node, std::vector< dep_node* >* sublibs, bool top_level, boost::unordered_set< std::string > const* skip_dirs = NULL)
 {
-    boost::filesystem::directory_iterator dir_it(dir), dir_end;
-    for (; dir_it != dir_end; ++dir_it)
+    trace_span span("scan", "scan_directory", dir);
+
+    // The prune rules state of every entry is one step from the state of the directory
+    prune_rules::state dir_prune_state, prune_state;
+    bool subtree_pruned = false;
+    const bool check_prune_rules = match_prune_rules(dir, params, cxx_params, dir_prune_state, subtree_pruned);
+    if (subtree_pruned)
+        return;
+
+    filesystem_index& fs_index = *cxx_params.fs_index;
+    filesystem_index::entries const& entries = fs_index.list_directory(dir);
+    for (filesystem_index::entries::const_iterator it = entries.begin(), end = entries.end(); it != end; ++it)
     {
-        boost::filesystem::path path = *dir_it;
-        std::string filename = path.filename().string();
-        boost::filesystem::file_status status = boost::filesystem::status(path);
+        std::string const& filename = it->first;
+        boost::filesystem::path path = dir / filename;
+        boost::filesystem::file_status status(it->second);
+        if (boost::filesystem::is_symlink(status))
+            status = fs_index.status(path);
+
+        if (check_prune_rules)
+            params.prune.step(dir_prune_state, filename, prune_state);
+
         if (boost::filesystem::is_directory(status))
         {
             if (top_level && std::find(params.skip_root_dirs.begin(), params.skip_root_dirs.end(), filename) != params.skip_root_dirs.end())
                 continue;
+            if (skip_dirs && skip_dirs->find(path.string()) != skip_dirs->end())
+                continue;
+            if (check_prune_rules && params.prune.is_subtree_pruned(prune_state))
+                continue;
 
-            scan_directory(path, params, cxx_params, root, *node.add_child(filename), sublibs, false);
+            scan_directory(path, params, cxx_params, root, *node.add_child(filename), sublibs, false, skip_dirs);
         }
         else if (boost::filesystem::is_regular(status))
         {
-            if (filename_match_any(filename, params.whitelist_wildcards) && !filename_match_any(filename, params.blacklist_wildcards))
+            if (check_prune_rules && prune_state.pruned)
+                continue;
+
+            if (filename_match_any(filename, params.whitelist_wildcards) && !filename_match_any(filename, params.blacklist_wildcards) && is_in_shard(path, params, cxx_params))
             {
                 if (is_cxx_file(path, params.cxx_wildcards))
                 {
@@ -122,13 +196,188 @@ void scan_directory(boost::filesystem::path const& dir, scan_params const& param
                 }
                 else
                 {
-                    node.add_child(filename);
+                    dep_node* file_node = node.add_child(filename);
+                    if (params.collect_attributes && params.pack)
+                        set_packed_file_size(path, params, *file_node);
+                }
+            }
+        }
+    }
+}
+
+//! Checks if the path is within any of the directories. The directory paths end with a slash, the directory entry itself (e.g. a symlink or a gitlink) also matches.
+bool is_within_any(std::string const& path, std::vector< std::string > const& dir_prefixes)
+{
+    for (std::vector< std::string >::const_iterator it = dir_prefixes.begin(), end = dir_prefixes.end(); it != end; ++it)
+    {
+        if (path.compare(0, it->size(), *it) == 0 || (path.size() + 1u == it->size() && it->compare(0, path.size(), path) == 0))
+            return true;
+    }
+    return false;
+}
+
+//! The function scans the directory like \c scan_directory, but the files are enumerated from the git index instead of walking the directory tree
+void scan_git_directory(boost::filesystem::path const& dir, git_worktree const& worktree, scan_params const& params, cxx_parser_params const& cxx_params, dep_tree& root, dep_node& node,
+    std::vector< dep_node* >* sublibs, bool top_level, boost::unordered_set< std::string > const* skip_dirs = NULL)
+{
+    trace_span span("scan", "scan_git_directory", dir);
+    filesystem_index& fs_index = *cxx_params.fs_index;
+
+    // Index paths are relative to the working tree root
+    std::string prefix = make_relative(worktree.root(), dir).generic_string();
+    if (!prefix.empty())
+        prefix.push_back('/');
+
+    std::vector< std::string > skip_prefixes;
+    if (top_level)
+    {
+        for (std::vector< boost::filesystem::path >::const_iterator it = params.skip_root_dirs.begin(), end = params.skip_root_dirs.end(); it != end; ++it)
+            skip_prefixes.push_back(prefix + it->generic_string() + '/');
+    }
+    if (skip_dirs)
+    {
+        for (boost::unordered_set< std::string >::const_iterator it = skip_dirs->begin(), end = skip_dirs->end(); it != end; ++it)
+        {
+            boost::filesystem::path skip_dir(*it);
+            if (skip_dir != dir && is_within_directory(dir.string(), skip_dir.string()))
+                skip_prefixes.push_back(make_relative(worktree.root(), skip_dir).generic_string() + '/');
+        }
+    }
+
+    std::pair< git_worktree::entries::const_iterator, git_worktree::entries::const_iterator > range =
+        worktree.find_directory(prefix.empty() ? prefix : prefix.substr(0, prefix.size() - 1u));
+
+    // The entries are ordered by path, so the files of the same directory follow each other
+    std::string last_dir;
+    dep_node* dir_node = &node;
+    dep_node::insertion_cursor dir_cursor(node, '/');
+    prune_rules::state dir_prune_state, prune_state;
+    bool dir_pruned = false;
+    bool check_prune_rules = match_prune_rules(dir, params, cxx_params, dir_prune_state, dir_pruned);
+    for (; range.first != range.second; ++range.first)
+    {
+        git_index_entry const& entry = *range.first;
+        if (entry.skip_worktree || is_within_any(entry.path, skip_prefixes))
+            continue;
+
+        boost::string_ref relative_path(entry.path);
+        relative_path.remove_prefix(prefix.size());
+        std::size_t pos = relative_path.rfind('/');
+        boost::string_ref relative_dir, filename = relative_path;
+        if (pos != boost::string_ref::npos)
+        {
+            relative_dir = relative_path.substr(0, pos);
+            filename = relative_path.substr(pos + 1u);
+        }
+
+        if (relative_dir != last_dir)
+        {
+            last_dir.assign(relative_dir.data(), relative_dir.size());
+            check_prune_rules = match_prune_rules(relative_dir.empty() ? dir : dir / last_dir, params, cxx_params, dir_prune_state, dir_pruned);
+            if (!dir_pruned)
+                dir_node = relative_dir.empty() ? &node : dir_cursor.add_nested_child(relative_dir);
+        }
+
+        // The directories pruned with their contents are not added to the tree
+        if (dir_pruned)
+            continue;
+        if (check_prune_rules)
+            params.prune.step(dir_prune_state, filename, prune_state);
+
+        boost::filesystem::path path = worktree.root() / entry.path;
+        if (entry.is_gitlink())
+        {
+            // A submodule that is not checked out, otherwise its files follow
+            if (boost::filesystem::is_directory(fs_index.status(path)))
+                dir_node->add_child(filename);
+            continue;
+        }
+
+        const git_object_id* object_id = NULL;
+        if (entry.is_symlink())
+        {
+            // The symlink target is not recorded in the index
+            boost::filesystem::file_status status = fs_index.status(path);
+            if (boost::filesystem::is_directory(status))
+            {
+                scan_directory(path, params, cxx_params, root, *dir_node->add_child(filename), sublibs, false, skip_dirs);
+                continue;
+            }
+            else if (!boost::filesystem::is_regular(status))
+            {
+                continue;
+            }
+        }
+        else if (!entry.is_regular_file())
+        {
+            continue;
+        }
+        else
+        {
+            object_id = &entry.id;
+        }
+
+        if (check_prune_rules && prune_state.pruned)
+            continue;
+
+        std::string filename_str(filename.data(), filename.size());
+        if (filename_match_any(filename_str, params.whitelist_wildcards) && !filename_match_any(filename_str, params.blacklist_wildcards) && is_in_shard(path, params, cxx_params))
+        {
+            if (is_cxx_file(path, params.cxx_wildcards))
+            {
+                // Only the files that are modified since they were added to the index need to be read
+                if (object_id)
+                {
+                    git_worktree::file_state state = git_worktree::file_unmodified;
+                    if (params.git_index != git_index_trust)
+                        state = worktree.get_file_state(entry);
+                    else if (entry.unknown_content || entry.racy)
+                        state = git_worktree::file_modified;
+
+                    if (state == git_worktree::file_missing)
+                        continue;
+                    if (state != git_worktree::file_unmodified)
+                        object_id = NULL;
                 }
+
+                dep_node* file_node = parse_cxx(path, cxx_params, root, NULL, object_id);
+                if (file_node && params.collect_attributes && !entry.is_symlink())
+                    set_index_file_status(entry, *file_node);
+            }
+            else
+            {
+                dep_node* file_node = dir_node->add_child(filename);
+                if (params.collect_attributes && !entry.is_symlink())
+                    set_index_file_status(entry, *file_node);
             }
         }
     }
 }
 
+//! Returns the root of the git working tree that contains the directory. Throws if the directory is not in a working tree.
+boost::filesystem::path find_working_tree(boost::filesystem::path const& dir)
+{
+    boost::filesystem::path worktree_root = find_git_worktree(dir);
+    if (worktree_root.empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Scanned directory is not in a git working tree: " + dir.string()));
+    return worktree_root;
+}
+
+//! Creates the parser parameters from the scanning parameters
+cxx_parser_params make_cxx_parser_params(scan_params const& params)
+{
+    cxx_parser_params cxx_params;
+    cxx_params.boost_root = params.boost_root;
+    cxx_params.include_dirs = params.include_dirs;
+    cxx_params.create_reverse_dependencies = params.create_reverse_dependencies;
+    cxx_params.external_root = params.external_root;
+    cxx_params.cache = params.cache;
+    cxx_params.collect_attributes = params.collect_attributes;
+    cxx_params.pack = params.pack;
+    cxx_params.canonical_boost_root = canonical_root(params.boost_root);
+    return cxx_params;
+}
+
 } // namespace
 
 //! The function returns a wildcard that matches all files
@@ -171,7 +420,33 @@ std::vector< std::string > default_cxx_wildcards()
     return std::vector< std::string >(wildcards, wildcards + sizeof(wildcards) / sizeof(*wildcards));
 }
 
-scan_params::scan_params() : create_reverse_dependencies(false)
+//! The function detects if the file should be parsed as C++
+bool is_cxx_file(boost::filesystem::path const& path, std::vector< std::string > const& cxx_wildcards)
+{
+    std::string filename = path.filename().string();
+    for (std::vector< std::string >::const_iterator it = cxx_wildcards.begin(), end = cxx_wildcards.end(); it != end; ++it)
+    {
+        if (filename_match(filename, *it))
+            return true;
+    }
+
+    // Consider everything in 'include/boost' directory C++. This is needed for boost/compatibility and boost/tr1 - headers in there are difficult to match.
+    // This hack should probably be a customization point.
+    std::string str = path.string();
+    return std::strstr(str.c_str(), "include/boost") != NULL
+#if defined(BOOST_WINDOWS)
+        || std::strstr(str.c_str(), "include\\boost") != NULL
+#endif
+    ;
+}
+
+//! The function checks if the filename matches any of the wildcards
+bool match_wildcards(std::string const& filename, std::vector< std::string > const& wildcards)
+{
+    return filename_match_any(filename, wildcards);
+}
+
+scan_params::scan_params() : create_reverse_dependencies(false), cache(NULL), collect_attributes(false), git_index(git_index_none), pack(NULL), shard_index(0u), shard_count(1u)
 {
 }
 
@@ -194,11 +469,158 @@ void scan_filesystem_tree(boost::filesystem::path const& dir, scan_params const&
 {
     BOOST_ASSERT(dir.is_absolute());
 
+    filesystem_index fs_index(params.pack);
+    dep_tree::insertion_cursor node_cursor(root);
+    cxx_parser_params cxx_params = make_cxx_parser_params(params);
+    cxx_params.fs_index = &fs_index;
+    cxx_params.include_search_path = fs_index.add_search_path(cxx_params.include_dirs);
+    cxx_params.node_cursor = &node_cursor;
+    // Reverse dependencies are built in bulk after scanning, which is much faster than inserting them one by one
+    cxx_params.create_reverse_dependencies = false;
+    if (params.git_index != git_index_none)
+    {
+        git_worktree worktree(find_working_tree(dir));
+        scan_git_directory(dir, worktree, params, cxx_params, root, root, sublibs, true);
+    }
+    else
+    {
+        scan_directory(dir, params, cxx_params, root, root, sublibs, true);
+    }
+
+    if (params.create_reverse_dependencies)
+        reconstruct_reverse_dependencies(root);
+}
+
+//! Scanning session implementation
+struct scan_session::implementation
+{
+    scan_params params;
+    dep_tree& root;
+    filesystem_index fs_index;
+    dep_tree::insertion_cursor node_cursor;
     cxx_parser_params cxx_params;
-    cxx_params.boost_root = params.boost_root;
-    cxx_params.include_dirs = params.include_dirs;
-    cxx_params.create_reverse_dependencies = params.create_reverse_dependencies;
-    scan_directory(dir, params, cxx_params, root, root, sublibs, true);
+    //! The directories that have been scanned
+    boost::unordered_set< std::string > scanned_dirs;
+    //! The git working tree of the last scanned directory, if the git index is used
+    boost::scoped_ptr< git_worktree > worktree;
+
+    implementation(scan_params const& p, dep_tree& r) : params(p), root(r), fs_index(p.pack), node_cursor(r), cxx_params(make_cxx_parser_params(p))
+    {
+        cxx_params.fs_index = &fs_index;
+        cxx_params.include_search_path = fs_index.add_search_path(cxx_params.include_dirs);
+        cxx_params.node_cursor = &node_cursor;
+    }
+};
+
+scan_session::scan_session(scan_params const& params, dep_tree& root) : m_impl(new implementation(params, root))
+{
+}
+
+scan_session::~scan_session()
+{
+}
+
+//! Scans the directory and adds the found files to the tree
+dep_node* scan_session::scan_directory(boost::filesystem::path const& dir, std::vector< dep_node* >* sublibs)
+{
+    boost::filesystem::path normalized_dir = normalize_path(boost::filesystem::system_complete(dir));
+    std::string node_path = make_node_path(normalized_dir, m_impl->cxx_params);
+    if (node_path.empty() && !is_descendant(m_impl->params.boost_root, normalized_dir))
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Scanned directory is outside Boost root: " + normalized_dir.string()));
+
+    dep_node* node = node_path.empty() ? &m_impl->root : m_impl->root.add_nested_child(node_path);
+
+    // Skip the directory if it has already been scanned as part of another directory
+    for (boost::filesystem::path p = normalized_dir; !p.empty(); p = p.parent_path())
+    {
+        if (m_impl->scanned_dirs.find(p.string()) != m_impl->scanned_dirs.end())
+            return node;
+        if (!p.has_relative_path())
+            break;
+    }
+
+    // The nested directories that have already been scanned will be skipped
+    m_impl->scanned_dirs.insert(normalized_dir.string());
+    const bool top_level = normalized_dir == m_impl->params.boost_root;
+    if (m_impl->params.git_index != git_index_none)
+    {
+        // The directories are typically in the same working tree, which includes the submodules, so the index is only read again if the working tree changes
+        if (!m_impl->worktree || !is_within_directory(m_impl->worktree->root().string(), normalized_dir.string()))
+            m_impl->worktree.reset(new git_worktree(find_working_tree(normalized_dir)));
+
+        scan_git_directory(normalized_dir, *m_impl->worktree, m_impl->params, m_impl->cxx_params, m_impl->root, *node, sublibs, top_level, &m_impl->scanned_dirs);
+    }
+    else
+    {
+        ::scan_directory(normalized_dir, m_impl->params, m_impl->cxx_params, m_impl->root, *node, sublibs, top_level, &m_impl->scanned_dirs);
+    }
+
+    return node;
+}
+
+//! The function builds header dependency tree for the files reachable from the entry files through the resolved includes
+void scan_entry_points(std::vector< scan_entry > const& entries, scan_params const& params, dep_tree& root, std::vector< dep_node* >* entry_nodes)
+{
+    // Files that have been queued for parsing, either as an entry or as an included file
+    boost::unordered_set< std::string > visited;
+    std::vector< boost::filesystem::path > worklist, included_files;
+    filesystem_index fs_index(params.pack);
+    dep_tree::insertion_cursor node_cursor(root);
+
+    for (std::vector< scan_entry >::const_iterator it = entries.begin(), end = entries.end(); it != end; ++it)
+    {
+        boost::filesystem::path entry_file = normalize_path(boost::filesystem::system_complete(it->file));
+        cxx_parser_params cxx_params = make_cxx_parser_params(params);
+
+        // Peel the symlinks the same way as for the included files, so that the entry and the file included elsewhere are one node
+        boost::filesystem::path const& resolved_entry_file = fs_index.find_regular_file(cxx_params.boost_root, entry_file.parent_path(), entry_file.filename().string());
+        if (!resolved_entry_file.empty())
+            entry_file = resolved_entry_file;
+
+        if (entry_nodes)
+        {
+            // The entry file may have already been parsed as included from another entry
+            std::string node_path = make_node_path(entry_file, cxx_params);
+            if (!node_path.empty())
+            {
+                dep_node* node = root.add_nested_child(node_path);
+                if (std::find(entry_nodes->begin(), entry_nodes->end(), node) == entry_nodes->end())
+                    entry_nodes->push_back(node);
+            }
+        }
+
+        if (!visited.insert(entry_file.string()).second)
+            continue;
+
+        cxx_params.fs_index = &fs_index;
+        cxx_params.node_cursor = &node_cursor;
+        cxx_params.create_reverse_dependencies = false;
+        cxx_params.include_dirs.insert(cxx_params.include_dirs.begin(), it->include_dirs.begin(), it->include_dirs.end());
+        cxx_params.include_search_path = fs_index.add_search_path(cxx_params.include_dirs);
+
+        worklist.push_back(entry_file);
+        while (!worklist.empty())
+        {
+            boost::filesystem::path path;
+            path.swap(worklist.back());
+            worklist.pop_back();
+
+            included_files.clear();
+            parse_cxx(path, cxx_params, root, &included_files);
+
+            for (std::vector< boost::filesystem::path >::iterator file_it = included_files.begin(), file_end = included_files.end(); file_it != file_end; ++file_it)
+            {
+                if (visited.insert(file_it->string()).second)
+                {
+                    worklist.push_back(boost::filesystem::path());
+                    worklist.back().swap(*file_it);
+                }
+            }
+        }
+    }
+
+    if (params.create_reverse_dependencies)
+        reconstruct_reverse_dependencies(root);
 }
 
 //! The function finds Boost root directory
@@ -0,0 +1,758 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of tracking library dependencies through the git history
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <git_history.hpp>
+#include <git_objects.hpp>
+#include <parse_cache.hpp>
+#include <cxx_parser.hpp>
+#include <library_graph.hpp>
+#include <filesystem_scanner.hpp>
+#include <trace.hpp>
+
+namespace {
+
+const char include_dir_name[] = "include";
+const std::size_t no_library = static_cast< std::size_t >(-1);
+
+typedef std::pair< std::size_t, std::size_t > edge;
+typedef boost::shared_ptr< const parse_cache::includes > includes_ptr;
+
+//! File of the current repository state
+struct tracked_file
+{
+    std::string path;
+    git_object_id id;
+    //! Include directives of the file content, shared between the files with the same content. \c NULL if the file is not C++.
+    includes_ptr includes;
+    //! The library the file was attributed to when its includes were last resolved
+    std::size_t library;
+    //! The libraries the included headers belong to, one element per include directive of another library
+    std::vector< std::size_t > targets;
+    //! The lookup keys (header names and file paths) the resolution of the includes depends on
+    std::vector< std::string > keys;
+
+    tracked_file() : library(no_library) {}
+};
+
+//! Orders library edges by names
+struct order_by_names
+{
+    typedef bool result_type;
+
+    result_type operator() (library_edge const& left, library_edge const& right) const
+    {
+        int res = left.from.compare(right.from);
+        return res < 0 || (res == 0 && left.to < right.to);
+    }
+};
+
+//! Orders tree entries by names
+struct order_by_entry_name
+{
+    typedef bool result_type;
+
+    result_type operator() (git_tree_entry const& left, git_tree_entry const& right) const
+    {
+        return left.name < right.name;
+    }
+};
+
+/*!
+ * Splits the path of a file in the include directory of a library into the library directory and the header name, e.g.
+ * libs/config/include/boost/config.hpp into libs/config and boost/config.hpp. Returns \c false if the file is not in an include directory.
+ */
+bool split_include_path(std::string const& path, std::string& dir, std::string& name)
+{
+    std::size_t prefix_size = std::strlen(libraries_root_name);
+    if (path.compare(0, prefix_size, libraries_root_name) != 0 || path.size() <= prefix_size || path[prefix_size] != '/')
+        return false;
+
+    for (std::size_t pos = prefix_size + 1u, slash = path.find('/', pos); slash != std::string::npos; pos = slash + 1u, slash = path.find('/', pos))
+    {
+        if (pos > prefix_size + 1u && path.compare(pos, slash - pos, include_dir_name) == 0)
+        {
+            dir.assign(path, 0, pos - 1u);
+            name.assign(path, slash + 1u, std::string::npos);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//! Removes the '.' and '..' elements from the relative path. Returns \c false if the path refers outside the root.
+bool normalize_relative_path(std::string& path)
+{
+    std::string result;
+    result.reserve(path.size());
+    for (std::size_t pos = 0u; pos <= path.size();)
+    {
+        std::size_t slash = path.find('/', pos);
+        if (slash == std::string::npos)
+            slash = path.size();
+
+        boost::string_ref element(path.data() + pos, slash - pos);
+        if (element == "..")
+        {
+            if (result.empty())
+                return false;
+            std::size_t parent = result.rfind('/');
+            result.resize(parent == std::string::npos ? 0u : parent);
+        }
+        else if (!element.empty() && element != ".")
+        {
+            if (!result.empty())
+                result.push_back('/');
+            result.append(element.data(), element.size());
+        }
+
+        pos = slash + 1u;
+    }
+
+    path.swap(result);
+    return true;
+}
+
+//! The class maintains the state of the repository and the library dependencies while the commits are applied one after another
+class history_scanner
+{
+private:
+    typedef boost::unordered_map< std::string, tracked_file > file_map;
+    typedef boost::unordered_map< std::string, boost::unordered_set< tracked_file* > > key_index;
+    //! The files of the include directories that provide the header, by the header name. The first one wins.
+    typedef boost::unordered_map< std::string, std::set< std::string > > provider_map;
+    typedef boost::unordered_map< git_object_id, includes_ptr, content_digest_hash > blob_map;
+
+    //! Directory that is a library as long as there are files in its include directory
+    struct library_dir
+    {
+        std::size_t index;
+        std::size_t file_count;
+
+        library_dir() : index(no_library), file_count(0u) {}
+    };
+
+private:
+    history_params const& m_params;
+    history_stats& m_stats;
+    git_object_store m_store;
+    //! Object stores of the submodules, by the submodule path. \c NULL if the submodule repository is not available.
+    boost::unordered_map< std::string, boost::shared_ptr< git_object_store > > m_submodule_stores;
+    //! Include directives of the parsed file contents
+    blob_map m_blobs;
+
+    file_map m_files;
+    //! The files that need to be re-resolved when a file with the path or a header with the name appears or disappears
+    key_index m_key_index;
+    provider_map m_providers;
+    boost::unordered_map< std::string, library_dir > m_library_dirs;
+    std::vector< std::string > m_library_names;
+    //! The number of include directives that make up every library dependency
+    boost::unordered_map< edge, std::size_t > m_edges;
+    //! The edges modified by the current commit and whether they existed before the commit
+    boost::unordered_map< edge, bool > m_touched_edges;
+
+    //! The files that need to be re-resolved at the end of the current commit
+    boost::unordered_set< tracked_file* > m_dirty_files;
+    //! \c true if the set of libraries is changed by the current commit, so all files need to be re-resolved
+    bool m_libraries_changed;
+
+public:
+    history_scanner(history_params const& params, history_stats& stats) :
+        m_params(params),
+        m_stats(stats),
+        m_store(params.git_dir),
+        m_libraries_changed(false)
+    {
+    }
+
+    void scan(std::vector< history_commit >& commits)
+    {
+        // The first parent chain, the latest commit first
+        std::vector< std::pair< git_object_id, git_commit > > chain;
+        git_object_id id = m_store.resolve_revision(m_params.to.empty() ? std::string("HEAD") : m_params.to);
+        git_object_id from_id;
+        bool has_from = !m_params.from.empty();
+        if (has_from)
+            from_id = m_store.resolve_revision(m_params.from);
+
+        {
+            trace_span span("history", "read_commits");
+            git_object obj;
+            while (!has_from || id != from_id)
+            {
+                m_store.read_object(id, git_commit_object, obj);
+                chain.push_back(std::make_pair(id, git_commit()));
+                parse_git_commit(obj.data, chain.back().second);
+                if (chain.back().second.parents.empty())
+                {
+                    if (has_from)
+                        BOOST_THROW_EXCEPTION(std::invalid_argument("Commit " + m_params.from + " is not in the first parent history of " + m_params.to));
+                    break;
+                }
+                id = chain.back().second.parents.front();
+            }
+        }
+
+        // The state before the first reported commit is the baseline, the changes to it are not reported
+        git_object_id baseline_tree;
+        bool has_baseline = false;
+        if (m_params.max_count > 0u && chain.size() > m_params.max_count)
+        {
+            baseline_tree = chain[m_params.max_count].second.tree;
+            has_baseline = true;
+            chain.resize(m_params.max_count);
+        }
+        else if (has_from)
+        {
+            git_object obj;
+            m_store.read_object(from_id, git_commit_object, obj);
+            git_commit from_commit;
+            parse_git_commit(obj.data, from_commit);
+            baseline_tree = from_commit.tree;
+            has_baseline = true;
+        }
+
+        if (has_baseline)
+        {
+            trace_span span("history", "baseline", to_hex_string(baseline_tree));
+            diff_trees(m_store, std::string(), NULL, &baseline_tree, std::string());
+            history_commit baseline;
+            finish_commit(baseline);
+        }
+
+        const git_object_id* prev_tree = has_baseline ? &baseline_tree : NULL;
+        commits.reserve(commits.size() + chain.size());
+        for (std::vector< std::pair< git_object_id, git_commit > >::const_reverse_iterator it = chain.rbegin(), end = chain.rend(); it != end; ++it)
+        {
+            trace_span span("history", "commit", to_hex_string(it->first));
+            diff_trees(m_store, std::string(), prev_tree, &it->second.tree, std::string());
+            prev_tree = &it->second.tree;
+
+            commits.push_back(history_commit());
+            history_commit& commit = commits.back();
+            commit.id = it->first;
+            commit.time = it->second.time;
+            commit.summary = it->second.summary;
+            finish_commit(commit);
+        }
+    }
+
+private:
+    //! Applies the changes between the trees to the state. Either tree may be \c NULL, which denotes an empty tree.
+    void diff_trees(git_object_store& store, std::string const& repo_prefix, const git_object_id* old_tree, const git_object_id* new_tree, std::string const& prefix)
+    {
+        // Unchanged subtrees are shared between the commits and are not read
+        if (old_tree && new_tree && *old_tree == *new_tree)
+            return;
+
+        std::vector< git_tree_entry > old_entries, new_entries;
+        read_tree(store, old_tree, old_entries);
+        read_tree(store, new_tree, new_entries);
+
+        std::vector< git_tree_entry >::const_iterator old_it = old_entries.begin(), old_end = old_entries.end();
+        std::vector< git_tree_entry >::const_iterator new_it = new_entries.begin(), new_end = new_entries.end();
+        while (old_it != old_end || new_it != new_end)
+        {
+            int res = old_it == old_end ? 1 : (new_it == new_end ? -1 : old_it->name.compare(new_it->name));
+            if (res < 0)
+            {
+                remove_entry(store, repo_prefix, *old_it, prefix);
+                ++old_it;
+            }
+            else if (res > 0)
+            {
+                add_entry(store, repo_prefix, *new_it, prefix);
+                ++new_it;
+            }
+            else
+            {
+                if (old_it->is_tree() && new_it->is_tree())
+                {
+                    diff_trees(store, repo_prefix, &old_it->id, &new_it->id, prefix + new_it->name + '/');
+                }
+                else if (old_it->is_gitlink() && new_it->is_gitlink())
+                {
+                    diff_submodule(store, repo_prefix, prefix + new_it->name, &old_it->id, &new_it->id);
+                }
+                else if (!old_it->is_tree() && !old_it->is_gitlink() && !new_it->is_tree() && !new_it->is_gitlink())
+                {
+                    if (old_it->id != new_it->id || old_it->is_regular_file() != new_it->is_regular_file())
+                        modify_file(store, prefix + new_it->name, *new_it);
+                }
+                else
+                {
+                    remove_entry(store, repo_prefix, *old_it, prefix);
+                    add_entry(store, repo_prefix, *new_it, prefix);
+                }
+                ++old_it;
+                ++new_it;
+            }
+        }
+    }
+
+    void read_tree(git_object_store& store, const git_object_id* tree, std::vector< git_tree_entry >& entries)
+    {
+        if (!tree)
+            return;
+
+        git_object obj;
+        store.read_object(*tree, git_tree_object, obj);
+        parse_git_tree(obj.data, entries);
+
+        // The tree order places the subtrees as if their names ended with '/', the entries are matched by name
+        std::sort(entries.begin(), entries.end(), order_by_entry_name());
+    }
+
+    void remove_entry(git_object_store& store, std::string const& repo_prefix, git_tree_entry const& entry, std::string const& prefix)
+    {
+        if (entry.is_tree())
+            diff_trees(store, repo_prefix, &entry.id, NULL, prefix + entry.name + '/');
+        else if (entry.is_gitlink())
+            diff_submodule(store, repo_prefix, prefix + entry.name, &entry.id, NULL);
+        else
+            remove_file(prefix + entry.name);
+    }
+
+    void add_entry(git_object_store& store, std::string const& repo_prefix, git_tree_entry const& entry, std::string const& prefix)
+    {
+        if (entry.is_tree())
+            diff_trees(store, repo_prefix, NULL, &entry.id, prefix + entry.name + '/');
+        else if (entry.is_gitlink())
+            diff_submodule(store, repo_prefix, prefix + entry.name, NULL, &entry.id);
+        else
+            add_file(store, prefix + entry.name, entry);
+    }
+
+    //! Applies the changes between the submodule commits. Either commit may be \c NULL.
+    void diff_submodule(git_object_store& store, std::string const& repo_prefix, std::string const& path, const git_object_id* old_commit, const git_object_id* new_commit)
+    {
+        if (!m_params.follow_submodules || (old_commit && new_commit && *old_commit == *new_commit))
+            return;
+
+        git_object_store* submodule_store = get_submodule_store(store, repo_prefix, path);
+        if (!submodule_store)
+            return;
+
+        git_object_id old_tree, new_tree;
+        bool has_old_tree = old_commit && read_submodule_tree(*submodule_store, *old_commit, old_tree, false);
+        bool has_new_tree = new_commit && read_submodule_tree(*submodule_store, *new_commit, new_tree, true);
+        diff_trees(*submodule_store, path + '/', has_old_tree ? &old_tree : NULL, has_new_tree ? &new_tree : NULL, path + '/');
+    }
+
+    //! Returns the object store of the submodule or \c NULL if the submodule repository is not available
+    git_object_store* get_submodule_store(git_object_store& store, std::string const& repo_prefix, std::string const& path)
+    {
+        std::pair< boost::unordered_map< std::string, boost::shared_ptr< git_object_store > >::iterator, bool > res =
+            m_submodule_stores.insert(std::make_pair(path, boost::shared_ptr< git_object_store >()));
+        if (res.second)
+        {
+            // The submodule repositories are stored in the modules directory of the superproject git directory, by the submodule name,
+            // which is assumed to be the same as the submodule path
+            boost::filesystem::path git_dir = store.git_dir() / "modules" / path.substr(repo_prefix.size());
+            if (boost::filesystem::is_directory(git_dir / "objects"))
+                res.first->second = boost::make_shared< git_object_store >(git_dir);
+        }
+        return res.first->second.get();
+    }
+
+    //! Reads the tree of the submodule commit. Returns \c false if the commit is not in the submodule repository.
+    bool read_submodule_tree(git_object_store& store, git_object_id const& commit_id, git_object_id& tree, bool count_missing)
+    {
+        git_object obj;
+        if (!store.read_object(commit_id, obj) || obj.type != git_commit_object)
+        {
+            if (count_missing)
+                ++m_stats.missing_submodule_commits;
+            return false;
+        }
+
+        git_commit commit;
+        parse_git_commit(obj.data, commit);
+        tree = commit.tree;
+        return true;
+    }
+
+    void add_file(git_object_store& store, std::string const& path, git_tree_entry const& entry)
+    {
+        tracked_file& file = m_files[path];
+        file.path = path;
+        file.id = entry.id;
+        file.includes = parse_blob(store, path, entry);
+        m_dirty_files.insert(&file);
+        update_file_presence(path, true);
+    }
+
+    void modify_file(git_object_store& store, std::string const& path, git_tree_entry const& entry)
+    {
+        file_map::iterator it = m_files.find(path);
+        if (it == m_files.end())
+        {
+            add_file(store, path, entry);
+            return;
+        }
+
+        tracked_file& file = it->second;
+        file.id = entry.id;
+        file.includes = parse_blob(store, path, entry);
+        m_dirty_files.insert(&file);
+    }
+
+    void remove_file(std::string const& path)
+    {
+        file_map::iterator it = m_files.find(path);
+        if (it == m_files.end())
+            return;
+
+        tracked_file& file = it->second;
+        remove_contribution(file);
+        m_dirty_files.erase(&file);
+        m_files.erase(it);
+        update_file_presence(path, false);
+    }
+
+    //! Returns the include directives of the file content, parsing it if it has not been seen before
+    includes_ptr parse_blob(git_object_store& store, std::string const& path, git_tree_entry const& entry)
+    {
+        if (!entry.is_regular_file())
+            return includes_ptr();
+
+        std::size_t pos = path.rfind('/');
+        std::string filename = pos == std::string::npos ? path : path.substr(pos + 1u);
+        if (!match_wildcards(filename, m_params.cxx_wildcards))
+            return includes_ptr();
+
+        std::pair< blob_map::iterator, bool > res = m_blobs.insert(blob_map::value_type(entry.id, includes_ptr()));
+        if (!res.second)
+            return res.first->second;
+
+        boost::shared_ptr< parse_cache::includes > includes = boost::make_shared< parse_cache::includes >();
+        if (m_params.cache && m_params.cache->find(entry.id, *includes))
+        {
+            ++m_stats.cached_blobs;
+        }
+        else
+        {
+            git_object obj;
+            store.read_object(entry.id, git_blob_object, obj);
+            parse_cxx_includes(obj.data, *includes);
+            ++m_stats.parsed_blobs;
+            if (m_params.cache)
+                m_params.cache->insert(entry.id, *includes);
+        }
+
+        res.first->second = includes;
+        return includes;
+    }
+
+    //! Updates the header lookup structures when a file appears or disappears
+    void update_file_presence(std::string const& path, bool present)
+    {
+        mark_dirty(path);
+
+        std::string dir, name;
+        if (!split_include_path(path, dir, name))
+            return;
+
+        library_dir& library = m_library_dirs[dir];
+        if (library.index == no_library)
+        {
+            library.index = m_library_names.size();
+            m_library_names.push_back(dir.substr(std::strlen(libraries_root_name) + 1u));
+        }
+
+        if (present)
+        {
+            if (library.file_count++ == 0u)
+                m_libraries_changed = true;
+            m_providers[name].insert(path);
+        }
+        else
+        {
+            if (--library.file_count == 0u)
+                m_libraries_changed = true;
+            provider_map::iterator it = m_providers.find(name);
+            if (it != m_providers.end())
+            {
+                it->second.erase(path);
+                if (it->second.empty())
+                    m_providers.erase(it);
+            }
+        }
+
+        mark_dirty(name);
+    }
+
+    //! Marks the files whose includes depend on the key for re-resolving
+    void mark_dirty(std::string const& key)
+    {
+        key_index::const_iterator it = m_key_index.find(key);
+        if (it != m_key_index.end())
+            m_dirty_files.insert(it->second.begin(), it->second.end());
+    }
+
+    //! Returns the library of the file: the innermost library directory that contains the file, include directories don't contain nested libraries
+    std::size_t find_file_library(std::string const& path) const
+    {
+        std::size_t prefix_size = std::strlen(libraries_root_name);
+        if (path.compare(0, prefix_size, libraries_root_name) != 0 || path.size() <= prefix_size || path[prefix_size] != '/')
+            return no_library;
+
+        std::size_t library = no_library;
+        std::string dir;
+        for (std::size_t pos = prefix_size + 1u, slash = path.find('/', pos); slash != std::string::npos; pos = slash + 1u, slash = path.find('/', pos))
+        {
+            if (library != no_library && path.compare(pos, slash - pos, include_dir_name) == 0)
+                break;
+
+            dir.assign(path, 0u, slash);
+            boost::unordered_map< std::string, library_dir >::const_iterator it = m_library_dirs.find(dir);
+            if (it != m_library_dirs.end() && it->second.file_count > 0u)
+                library = it->second.index;
+        }
+
+        return library;
+    }
+
+    //! Resolves the includes of the file and adds its dependencies
+    void resolve(tracked_file& file)
+    {
+        remove_contribution(file);
+
+        file.library = find_file_library(file.path);
+        if (file.library == no_library || !file.includes)
+            return;
+
+        std::string dir(file.path, 0u, file.path.rfind('/') + 1u);
+        std::string relative_path;
+        for (parse_cache::includes::const_iterator it = file.includes->begin(), end = file.includes->end(); it != end; ++it)
+        {
+            std::size_t target = no_library;
+            bool found = false;
+            if (it->is_quoted)
+            {
+                relative_path = dir + it->header;
+                if (normalize_relative_path(relative_path))
+                {
+                    add_key(file, relative_path);
+                    if (m_files.find(relative_path) != m_files.end())
+                    {
+                        target = find_file_library(relative_path);
+                        found = true;
+                    }
+                }
+            }
+
+            if (!found)
+            {
+                add_key(file, it->header);
+                provider_map::const_iterator provider = m_providers.find(it->header);
+                if (provider != m_providers.end())
+                    target = find_file_library(*provider->second.begin());
+            }
+
+            if (target != no_library && target != file.library)
+            {
+                file.targets.push_back(target);
+                update_edge(edge(file.library, target), true);
+            }
+        }
+    }
+
+    void add_key(tracked_file& file, std::string const& key)
+    {
+        file.keys.push_back(key);
+        m_key_index[key].insert(&file);
+    }
+
+    //! Removes the dependencies of the file
+    void remove_contribution(tracked_file& file)
+    {
+        for (std::vector< std::size_t >::const_iterator it = file.targets.begin(), end = file.targets.end(); it != end; ++it)
+            update_edge(edge(file.library, *it), false);
+        file.targets.clear();
+
+        for (std::vector< std::string >::const_iterator it = file.keys.begin(), end = file.keys.end(); it != end; ++it)
+        {
+            key_index::iterator index_it = m_key_index.find(*it);
+            if (index_it != m_key_index.end())
+            {
+                index_it->second.erase(&file);
+                if (index_it->second.empty())
+                    m_key_index.erase(index_it);
+            }
+        }
+        file.keys.clear();
+    }
+
+    void update_edge(edge const& e, bool increment)
+    {
+        boost::unordered_map< edge, std::size_t >::iterator it = m_edges.find(e);
+        m_touched_edges.insert(std::make_pair(e, it != m_edges.end()));
+        if (increment)
+        {
+            if (it == m_edges.end())
+                m_edges.insert(std::make_pair(e, 1u));
+            else
+                ++it->second;
+        }
+        else if (it != m_edges.end() && --it->second == 0u)
+        {
+            m_edges.erase(it);
+        }
+    }
+
+    //! Re-resolves the affected files and reports the library dependencies changed by the commit
+    void finish_commit(history_commit& commit)
+    {
+        if (m_libraries_changed)
+        {
+            for (file_map::iterator it = m_files.begin(), end = m_files.end(); it != end; ++it)
+                m_dirty_files.insert(&it->second);
+            m_libraries_changed = false;
+        }
+
+        for (boost::unordered_set< tracked_file* >::const_iterator it = m_dirty_files.begin(), end = m_dirty_files.end(); it != end; ++it)
+            resolve(**it);
+        m_dirty_files.clear();
+
+        for (boost::unordered_map< edge, bool >::const_iterator it = m_touched_edges.begin(), end = m_touched_edges.end(); it != end; ++it)
+        {
+            bool exists = m_edges.find(it->first) != m_edges.end();
+            if (exists != it->second)
+            {
+                library_edge e(m_library_names[it->first.first], m_library_names[it->first.second]);
+                (exists ? commit.added : commit.removed).push_back(e);
+            }
+        }
+        m_touched_edges.clear();
+
+        std::sort(commit.added.begin(), commit.added.end(), order_by_names());
+        std::sort(commit.removed.begin(), commit.removed.end(), order_by_names());
+    }
+};
+
+//! Appends the string to the JSON text, escaping the special characters
+void append_json_string(std::string const& str, std::string& text)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    text.push_back('"');
+    for (std::string::const_iterator it = str.begin(), end = str.end(); it != end; ++it)
+    {
+        unsigned char c = static_cast< unsigned char >(*it);
+        if (c == '"' || c == '\\')
+        {
+            text.push_back('\\');
+            text.push_back(c);
+        }
+        else if (c < 0x20u)
+        {
+            text.append("\\u00");
+            text.push_back(hex_digits[c >> 4]);
+            text.push_back(hex_digits[c & 15u]);
+        }
+        else
+        {
+            text.push_back(c);
+        }
+    }
+    text.push_back('"');
+}
+
+void serialize_edges(std::vector< library_edge > const& edges, std::string const& nl_ind, std::string const& ind, std::string& text)
+{
+    text.append(nl_ind).append(1, '[');
+    for (std::vector< library_edge >::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+    {
+        if (it != edges.begin())
+            text.push_back(',');
+        text.append(nl_ind).append(ind).append("[\"").append(it->from).append("\", \"").append(it->to).append("\"]");
+    }
+    text.append(nl_ind).append(1, ']');
+}
+
+} // namespace
+
+history_params::history_params() : max_count(0u), follow_submodules(true), cache(NULL)
+{
+}
+
+//! The function follows the first parent history and reports the library dependencies added and removed by every commit
+void scan_history(history_params const& params, std::vector< history_commit >& commits, history_stats* stats)
+{
+    trace_span span("history", "scan_history", params.git_dir.string());
+
+    history_stats local_stats;
+    history_scanner scanner(params, stats ? *stats : local_stats);
+    scanner.scan(commits);
+}
+
+//! The function writes the history in JSON format
+void serialize_history_json(std::vector< history_commit > const& commits, std::ostream& strm, bool pretty_print, const char* indent)
+{
+    std::string nl_ind, ind;
+    const char* space = "";
+    if (pretty_print)
+    {
+        ind = indent;
+        nl_ind = "\n" + ind;
+        space = " ";
+    }
+    std::string nl_ind2 = nl_ind + ind, nl_ind3 = nl_ind2 + ind;
+
+    std::string text;
+    text.append(1, '{');
+    text.append(nl_ind).append("\"commits\":").append(nl_ind).append(1, '[');
+    for (std::vector< history_commit >::const_iterator it = commits.begin(), end = commits.end(); it != end; ++it)
+    {
+        if (it != commits.begin())
+            text.push_back(',');
+        text.append(nl_ind2).append(1, '{');
+        text.append(nl_ind3).append("\"commit\":").append(space).append(1, '"').append(to_hex_string(it->id)).append("\",");
+        text.append(nl_ind3).append("\"time\":").append(space).append(boost::lexical_cast< std::string >(it->time)).append(1, ',');
+        text.append(nl_ind3).append("\"summary\":").append(space);
+        append_json_string(it->summary, text);
+        text.append(1, ',');
+        text.append(nl_ind3).append("\"added\":");
+        serialize_edges(it->added, nl_ind3, ind, text);
+        text.append(1, ',');
+        text.append(nl_ind3).append("\"removed\":");
+        serialize_edges(it->removed, nl_ind3, ind, text);
+        text.append(nl_ind2).append(1, '}');
+
+        // Flush the text periodically, the history may be long
+        if (text.size() >= 65536u)
+        {
+            strm.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    text.append(nl_ind).append(1, ']');
+    text.append(pretty_print ? "\n}\n" : "}");
+
+    strm.write(text.data(), text.size());
+}
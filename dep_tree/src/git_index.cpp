@@ -0,0 +1,414 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of reading git index files
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/config.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <git_index.hpp>
+#include <filesystem_ext.hpp>
+#include <trace.hpp>
+#if !defined(BOOST_WINDOWS)
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+//! Index file signature
+const char index_signature[] = "DIRC";
+//! The size of the fixed part of the index entry: file status, object identifier and flags
+const std::size_t entry_header_size = 62u;
+
+//! Entry flags
+const boost::uint32_t assume_valid_flag = 0x8000u;
+const boost::uint32_t extended_flag = 0x4000u;
+const boost::uint32_t stage_mask = 0x3000u;
+//! Extended entry flags
+const boost::uint32_t skip_worktree_flag = 0x4000u;
+const boost::uint32_t intent_to_add_flag = 0x2000u;
+
+//! File status fields that are stored in the index
+struct file_stat
+{
+    boost::uint32_t ctime_sec, ctime_nsec, mtime_sec, mtime_nsec, ino, size;
+
+    file_stat() : ctime_sec(0u), ctime_nsec(0u), mtime_sec(0u), mtime_nsec(0u), ino(0u), size(0u) {}
+};
+
+//! Reads the file status without following symlinks. Returns \c false if the file does not exist.
+bool get_file_stat(boost::filesystem::path const& path, file_stat& st)
+{
+#if defined(BOOST_WINDOWS)
+    boost::system::error_code ec;
+    boost::filesystem::file_status status = boost::filesystem::symlink_status(path, ec);
+    if (!boost::filesystem::exists(status))
+        return false;
+
+    st.mtime_sec = static_cast< boost::uint32_t >(boost::filesystem::last_write_time(path, ec));
+    if (boost::filesystem::is_regular_file(status))
+        st.size = static_cast< boost::uint32_t >(boost::filesystem::file_size(path, ec));
+#else
+    struct stat buf;
+    if (::lstat(path.c_str(), &buf) != 0)
+        return false;
+
+    st.ctime_sec = static_cast< boost::uint32_t >(buf.st_ctime);
+    st.mtime_sec = static_cast< boost::uint32_t >(buf.st_mtime);
+#if defined(__APPLE__)
+    st.ctime_nsec = static_cast< boost::uint32_t >(buf.st_ctimespec.tv_nsec);
+    st.mtime_nsec = static_cast< boost::uint32_t >(buf.st_mtimespec.tv_nsec);
+#else
+    st.ctime_nsec = static_cast< boost::uint32_t >(buf.st_ctim.tv_nsec);
+    st.mtime_nsec = static_cast< boost::uint32_t >(buf.st_mtim.tv_nsec);
+#endif
+    st.ino = static_cast< boost::uint32_t >(buf.st_ino);
+    st.size = static_cast< boost::uint32_t >(buf.st_size);
+#endif
+    return true;
+}
+
+//! Compares the file status with the one stored in the index, similarly to how git does it
+bool is_same_stat(git_index_entry const& entry, file_stat const& st)
+{
+    if (entry.mtime_sec != st.mtime_sec || entry.size != st.size)
+        return false;
+
+#if !defined(BOOST_WINDOWS)
+    if (entry.ctime_sec != st.ctime_sec || entry.ino != st.ino)
+        return false;
+
+    // Git can be built without support for nanosecond timestamps, in which case it stores zeros
+    if (entry.mtime_nsec != 0u && (entry.mtime_nsec != st.mtime_nsec || entry.ctime_nsec != st.ctime_nsec))
+        return false;
+#endif
+
+    return true;
+}
+
+inline boost::uint32_t load_be32(const unsigned char* p)
+{
+    return (static_cast< boost::uint32_t >(p[0]) << 24) | (static_cast< boost::uint32_t >(p[1]) << 16) |
+        (static_cast< boost::uint32_t >(p[2]) << 8) | static_cast< boost::uint32_t >(p[3]);
+}
+
+inline boost::uint32_t load_be16(const unsigned char* p)
+{
+    return (static_cast< boost::uint32_t >(p[0]) << 8) | static_cast< boost::uint32_t >(p[1]);
+}
+
+//! Decodes the variable length integer that is used for path compression in index version 4. Returns \c false if the data is invalid.
+bool decode_varint(const unsigned char*& p, const unsigned char* end, std::size_t& value)
+{
+    if (p == end)
+        return false;
+
+    unsigned char c = *p++;
+    value = c & 127u;
+    while ((c & 128u) != 0u)
+    {
+        if (p == end || value >= (static_cast< std::size_t >(-1) >> 8))
+            return false;
+
+        c = *p++;
+        value = ((value + 1u) << 7) | (c & 127u);
+    }
+
+    return true;
+}
+
+//! Throws if the repository uses an object format other than SHA-1
+void check_object_format(boost::filesystem::path const& git_dir)
+{
+    boost::filesystem::path config_file = git_dir / "config";
+    std::ifstream file(config_file.string().c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::string key;
+        for (std::string::const_iterator it = line.begin(), end = line.end(); it != end; ++it)
+        {
+            if (*it != ' ' && *it != '\t')
+                key.push_back(*it >= 'A' && *it <= 'Z' ? static_cast< char >(*it - 'A' + 'a') : *it);
+        }
+
+        if (key.compare(0, 13, "objectformat=") == 0 && key != "objectformat=sha1")
+            BOOST_THROW_EXCEPTION(std::runtime_error("Unsupported git object format in repository: " + git_dir.string()));
+    }
+}
+
+//! Orders index entries by path
+struct order_by_path
+{
+    typedef bool result_type;
+
+    result_type operator() (git_index_entry const& left, git_index_entry const& right) const
+    {
+        return left.path < right.path;
+    }
+
+    result_type operator() (git_index_entry const& left, std::string const& right) const
+    {
+        return left.path < right;
+    }
+};
+
+} // namespace
+
+git_index_entry::git_index_entry() :
+    mode(0u),
+    ctime_sec(0u),
+    ctime_nsec(0u),
+    mtime_sec(0u),
+    mtime_nsec(0u),
+    ino(0u),
+    size(0u),
+    assume_unchanged(false),
+    skip_worktree(false),
+    unknown_content(false),
+    racy(false)
+{
+    id.fill(0u);
+}
+
+//! The function reads the git index file
+void read_git_index(boost::filesystem::path const& index_file, std::vector< git_index_entry >& entries)
+{
+    std::string path_str = index_file.string();
+    file_stat index_stat;
+    if (!get_file_stat(index_file, index_stat))
+        return;
+
+    std::vector< unsigned char > data;
+    {
+        std::ifstream file(path_str.c_str(), std::ios::in | std::ios::binary);
+        if (!file.is_open())
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open git index file: " + path_str));
+        data.assign(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+    }
+
+    // The index consists of the header, the entries, optional extensions and the checksum of the index content
+    if (data.size() < 12u + git_object_id::static_size || std::memcmp(&data[0], index_signature, 4u) != 0)
+        BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git index file: " + path_str));
+
+    const boost::uint32_t version = load_be32(&data[4]);
+    if (version < 2u || version > 4u)
+        BOOST_THROW_EXCEPTION(std::runtime_error("Unsupported git index version in file: " + path_str));
+
+    const boost::uint32_t count = load_be32(&data[8]);
+    const unsigned char* p = &data[12];
+    const unsigned char* const end = &data[0] + data.size() - git_object_id::static_size;
+
+    std::string path;
+    entries.reserve(entries.size() + count);
+    for (boost::uint32_t i = 0; i < count; ++i)
+    {
+        const unsigned char* const entry_start = p;
+        if (static_cast< std::size_t >(end - p) < entry_header_size)
+            BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git index file: " + path_str));
+
+        git_index_entry entry;
+        entry.ctime_sec = load_be32(p);
+        entry.ctime_nsec = load_be32(p + 4);
+        entry.mtime_sec = load_be32(p + 8);
+        entry.mtime_nsec = load_be32(p + 12);
+        entry.ino = load_be32(p + 20);
+        entry.mode = load_be32(p + 24);
+        entry.size = load_be32(p + 36);
+        std::memcpy(entry.id.data(), p + 40, git_object_id::static_size);
+        const boost::uint32_t flags = load_be16(p + 60);
+        p += entry_header_size;
+
+        boost::uint32_t extended_flags = 0u;
+        if ((flags & extended_flag) != 0u)
+        {
+            if (version < 3u || end - p < 2)
+                BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git index file: " + path_str));
+            extended_flags = load_be16(p);
+            p += 2;
+        }
+
+        // Version 4 stores the number of characters to remove from the end of the previous path, followed by the characters to append
+        std::size_t strip_size = 0u;
+        if (version >= 4u)
+        {
+            if (!decode_varint(p, end, strip_size) || strip_size > path.size())
+                BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git index file: " + path_str));
+        }
+
+        const unsigned char* name_end = static_cast< const unsigned char* >(std::memchr(p, 0, end - p));
+        if (!name_end)
+            BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git index file: " + path_str));
+
+        if (version >= 4u)
+        {
+            path.resize(path.size() - strip_size);
+            path.append(reinterpret_cast< const char* >(p), name_end - p);
+            p = name_end + 1;
+        }
+        else
+        {
+            path.assign(reinterpret_cast< const char* >(p), name_end - p);
+
+            // The entries are padded with 1 to 8 zero bytes to a multiple of 8 bytes
+            std::size_t entry_size = ((name_end - entry_start) + 8u) & ~static_cast< std::size_t >(7u);
+            if (static_cast< std::size_t >(end - entry_start) < entry_size)
+                BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git index file: " + path_str));
+            p = entry_start + entry_size;
+        }
+
+        entry.assume_unchanged = (flags & assume_valid_flag) != 0u;
+        entry.skip_worktree = (extended_flags & skip_worktree_flag) != 0u;
+        entry.unknown_content = (extended_flags & intent_to_add_flag) != 0u || (flags & stage_mask) != 0u;
+        entry.racy = entry.mtime_sec > index_stat.mtime_sec ||
+            (entry.mtime_sec == index_stat.mtime_sec && (index_stat.mtime_nsec == 0u || entry.mtime_nsec >= index_stat.mtime_nsec));
+
+        // Merge conflicts are stored as multiple entries with the same path, one per merge stage
+        if ((flags & stage_mask) != 0u && !entries.empty() && entries.back().path == path)
+        {
+            entries.back().unknown_content = true;
+            continue;
+        }
+
+        entry.path = path;
+        entries.push_back(entry);
+    }
+
+    // Split index stores most of the entries in a separate file, which is referenced by the "link" extension
+    while (end - p >= 8)
+    {
+        if (std::memcmp(p, "link", 4u) == 0)
+            BOOST_THROW_EXCEPTION(std::runtime_error("Split git index is not supported: " + path_str));
+
+        const boost::uint32_t size = load_be32(p + 4);
+        p += 8;
+        if (static_cast< std::size_t >(end - p) < size)
+            break;
+        p += size;
+    }
+}
+
+//! The function returns the git directory of the working tree root
+boost::filesystem::path find_git_dir(boost::filesystem::path const& worktree)
+{
+    boost::filesystem::path dot_git = worktree / ".git";
+    boost::system::error_code ec;
+    boost::filesystem::file_status status = boost::filesystem::status(dot_git, ec);
+    if (boost::filesystem::is_directory(status))
+        return dot_git;
+
+    if (boost::filesystem::is_regular_file(status))
+    {
+        // Submodules and linked working trees have a file that refers to the git directory
+        std::string dot_git_str = dot_git.string();
+        std::ifstream file(dot_git_str.c_str());
+        std::string line;
+        if (!std::getline(file, line) || line.compare(0, 8, "gitdir: ") != 0)
+            BOOST_THROW_EXCEPTION(std::runtime_error("Invalid git file: " + dot_git_str));
+
+        while (!line.empty() && (line[line.size() - 1u] == '\r' || line[line.size() - 1u] == ' '))
+            line.resize(line.size() - 1u);
+
+        boost::filesystem::path git_dir = line.substr(8);
+        if (git_dir.is_relative())
+            git_dir = worktree / git_dir;
+        return normalize_path(git_dir);
+    }
+
+    return boost::filesystem::path();
+}
+
+//! The function returns the root of the git working tree that contains the directory
+boost::filesystem::path find_git_worktree(boost::filesystem::path const& dir)
+{
+    for (boost::filesystem::path p = dir; !p.empty(); p = p.parent_path())
+    {
+        if (!find_git_dir(p).empty())
+            return p;
+        if (!p.has_relative_path())
+            break;
+    }
+
+    return boost::filesystem::path();
+}
+
+//! Reads the index of the working tree
+git_worktree::git_worktree(boost::filesystem::path const& root) : m_root(root)
+{
+    if (find_git_dir(root).empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Directory is not a git working tree: " + root.string()));
+
+    trace_span span("git", "read_git_index", root);
+    load(root, std::string());
+
+    // The submodule files need to be merged with the superproject files
+    std::sort(m_entries.begin(), m_entries.end(), order_by_path());
+}
+
+//! Returns the entries of the files in the directory and its subdirectories
+std::pair< git_worktree::entries::const_iterator, git_worktree::entries::const_iterator > git_worktree::find_directory(std::string const& dir) const
+{
+    if (dir.empty())
+        return std::make_pair(m_entries.begin(), m_entries.end());
+
+    // All paths in the directory are ordered between "dir/" and "dir0", as '0' follows '/'
+    std::string lower = dir + '/', upper = dir + static_cast< char >('/' + 1);
+    return std::make_pair(
+        std::lower_bound(m_entries.begin(), m_entries.end(), lower, order_by_path()),
+        std::lower_bound(m_entries.begin(), m_entries.end(), upper, order_by_path()));
+}
+
+//! Checks if the file has been modified since it was added to the index
+git_worktree::file_state git_worktree::get_file_state(git_index_entry const& entry) const
+{
+    if (entry.assume_unchanged && !entry.unknown_content)
+        return file_unmodified;
+
+    file_stat st;
+    if (!get_file_stat(m_root / entry.path, st))
+        return file_missing;
+
+    if (entry.unknown_content || entry.racy || !is_same_stat(entry, st))
+        return file_modified;
+
+    return file_unmodified;
+}
+
+//! Reads the index of the working tree or submodule and its nested submodules
+void git_worktree::load(boost::filesystem::path const& worktree, std::string const& prefix)
+{
+    boost::filesystem::path git_dir = find_git_dir(worktree);
+    check_object_format(git_dir);
+
+    const std::size_t first = m_entries.size();
+    read_git_index(git_dir / "index", m_entries);
+    for (std::size_t i = first, n = m_entries.size(); i < n; ++i)
+    {
+        if (!prefix.empty())
+            m_entries[i].path.insert(0, prefix);
+
+        if (m_entries[i].is_gitlink() && !m_entries[i].skip_worktree)
+        {
+            // Submodules that are not checked out don't have the git directory
+            std::string submodule = m_entries[i].path;
+            boost::filesystem::path submodule_worktree = m_root / submodule;
+            if (!find_git_dir(submodule_worktree).empty())
+                load(submodule_worktree, submodule + '/');
+        }
+    }
+}
@@ -0,0 +1,660 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of reading objects from git repositories
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/exception/info.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <git_objects.hpp>
+#include <filesystem_ext.hpp>
+#include <cxx_parser.hpp>
+
+namespace {
+
+//! Maximum total size of the cached delta bases
+const std::size_t max_delta_bases_size = 64u * 1024u * 1024u;
+//! Maximum nesting of symbolic references
+const unsigned int max_reference_depth = 8u;
+//! Pack file object types that are not objects themselves
+const unsigned int ofs_delta_type = 6u;
+const unsigned int ref_delta_type = 7u;
+//! Size of the object identifier in the binary form
+const std::size_t object_id_size = 20u;
+
+const char* const object_type_names[] = { "", "commit", "tree", "blob", "tag" };
+
+BOOST_NORETURN void throw_corrupted(const char* what, boost::filesystem::path const& path)
+{
+    BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error(what)) << file_name_info(path.string()));
+}
+
+inline boost::uint32_t read_be32(const unsigned char* p)
+{
+    return (static_cast< boost::uint32_t >(p[0]) << 24) | (static_cast< boost::uint32_t >(p[1]) << 16) | (static_cast< boost::uint32_t >(p[2]) << 8) | static_cast< boost::uint32_t >(p[3]);
+}
+
+inline boost::uint64_t read_be64(const unsigned char* p)
+{
+    return (static_cast< boost::uint64_t >(read_be32(p)) << 32) | read_be32(p + 4);
+}
+
+/*!
+ * Decompresses the zlib stream of the object data. The compressed stream is followed by other data, so the decompression stops after
+ * \a size bytes are produced. Returns \c false if the stream ends prematurely or is corrupted.
+ */
+bool inflate_object(const unsigned char* data, std::size_t data_size, boost::uint64_t size, std::string& out)
+{
+    out.resize(static_cast< std::size_t >(size));
+    if (size == 0u)
+        return true;
+
+    boost::iostreams::filtering_istream strm;
+    strm.push(boost::iostreams::zlib_decompressor());
+    strm.push(boost::iostreams::array_source(reinterpret_cast< const char* >(data), data_size));
+    strm.read(&out[0], static_cast< std::streamsize >(size));
+    return static_cast< boost::uint64_t >(strm.gcount()) == size;
+}
+
+//! Reads the variable length size of the delta format
+bool read_delta_size(const unsigned char*& p, const unsigned char* end, boost::uint64_t& size)
+{
+    size = 0u;
+    unsigned int shift = 0u;
+    while (p != end && shift < 64u)
+    {
+        unsigned int c = *p++;
+        size |= static_cast< boost::uint64_t >(c & 0x7Fu) << shift;
+        if ((c & 0x80u) == 0u)
+            return true;
+        shift += 7u;
+    }
+    return false;
+}
+
+//! Reconstructs the object from the delta and the base object. Returns \c false if the delta is corrupted.
+bool apply_delta(std::string const& base, std::string const& delta, std::string& out)
+{
+    const unsigned char* p = reinterpret_cast< const unsigned char* >(delta.data());
+    const unsigned char* end = p + delta.size();
+
+    boost::uint64_t base_size = 0u, result_size = 0u;
+    if (!read_delta_size(p, end, base_size) || !read_delta_size(p, end, result_size) || base_size != base.size())
+        return false;
+
+    out.clear();
+    out.reserve(static_cast< std::size_t >(result_size));
+    while (p != end)
+    {
+        unsigned int op = *p++;
+        if ((op & 0x80u) != 0u)
+        {
+            // Copy from the base object, the bits of the opcode tell which bytes of the offset and the size follow
+            boost::uint64_t offset = 0u, size = 0u;
+            for (unsigned int i = 0u; i < 4u; ++i)
+            {
+                if ((op & (1u << i)) != 0u)
+                {
+                    if (p == end)
+                        return false;
+                    offset |= static_cast< boost::uint64_t >(*p++) << (i * 8u);
+                }
+            }
+            for (unsigned int i = 0u; i < 3u; ++i)
+            {
+                if ((op & (0x10u << i)) != 0u)
+                {
+                    if (p == end)
+                        return false;
+                    size |= static_cast< boost::uint64_t >(*p++) << (i * 8u);
+                }
+            }
+            if (size == 0u)
+                size = 0x10000u;
+
+            if (offset + size > base.size())
+                return false;
+            out.append(base, static_cast< std::size_t >(offset), static_cast< std::size_t >(size));
+        }
+        else if (op != 0u)
+        {
+            // Insert the literal data
+            if (static_cast< std::size_t >(end - p) < op)
+                return false;
+            out.append(reinterpret_cast< const char* >(p), op);
+            p += op;
+        }
+        else
+        {
+            // Reserved opcode
+            return false;
+        }
+    }
+
+    return out.size() == result_size;
+}
+
+//! Reads the first line of the file. Returns \c false if the file cannot be opened.
+bool read_first_line(boost::filesystem::path const& path, std::string& line)
+{
+    std::string path_str = path.string();
+    std::ifstream file(path_str.c_str());
+    if (!file.is_open() || !std::getline(file, line))
+        return false;
+
+    while (!line.empty() && (line[line.size() - 1u] == '\r' || line[line.size() - 1u] == ' '))
+        line.resize(line.size() - 1u);
+    return true;
+}
+
+//! Returns the hex object identifier that starts the object data, after the keyword
+bool parse_object_id_field(boost::string_ref data, boost::string_ref const& keyword, git_object_id& id)
+{
+    if (!data.starts_with(keyword))
+        return false;
+    data.remove_prefix(keyword.size());
+    return data.size() >= object_id_size * 2u && from_hex_string(data.substr(0, object_id_size * 2u), id);
+}
+
+} // namespace
+
+//! Mapped pack file and its index
+struct git_object_store::pack_file
+{
+    boost::filesystem::path index_path;
+    boost::filesystem::path pack_path;
+    boost::iostreams::mapped_file_source index;
+    boost::iostreams::mapped_file_source pack;
+    boost::uint32_t count;
+    const unsigned char* fanout;
+    const unsigned char* ids;
+    const unsigned char* offsets;
+    const unsigned char* large_offsets;
+    std::size_t large_offset_count;
+
+    pack_file(boost::filesystem::path const& idx, boost::filesystem::path const& pck) :
+        index_path(idx),
+        pack_path(pck),
+        index(idx.string()),
+        pack(pck.string()),
+        count(0u),
+        fanout(NULL),
+        ids(NULL),
+        offsets(NULL),
+        large_offsets(NULL),
+        large_offset_count(0u)
+    {
+        // Version 2 index: header, 256 fanout entries, object identifiers, CRC32 checksums, 32-bit offsets, 64-bit offsets, checksums
+        const unsigned char* p = reinterpret_cast< const unsigned char* >(index.data());
+        std::size_t size = index.size();
+        const std::size_t header_size = 8u + 256u * 4u, trailer_size = 2u * object_id_size;
+        if (size < header_size + trailer_size || std::memcmp(p, "\377tOc", 4u) != 0 || read_be32(p + 4u) != 2u)
+            throw_corrupted("Unsupported git pack index format", index_path);
+
+        fanout = p + 8u;
+        count = read_be32(fanout + 255u * 4u);
+        ids = fanout + 256u * 4u;
+        offsets = ids + count * (object_id_size + 4u);
+        large_offsets = offsets + count * 4u;
+        std::size_t min_size = header_size + count * (object_id_size + 8u) + trailer_size;
+        if (size < min_size || (size - min_size) % 8u != 0u)
+            throw_corrupted("Corrupted git pack index", index_path);
+        large_offset_count = (size - min_size) / 8u;
+
+        if (pack.size() < 12u + object_id_size || std::memcmp(pack.data(), "PACK", 4u) != 0)
+            throw_corrupted("Unsupported git pack file format", pack_path);
+    }
+
+    //! Looks up the object offset in the pack
+    bool find(git_object_id const& id, boost::uint64_t& offset) const
+    {
+        std::size_t begin = id[0] > 0u ? read_be32(fanout + (id[0] - 1u) * 4u) : 0u, end = read_be32(fanout + id[0] * 4u);
+        while (begin < end)
+        {
+            std::size_t middle = begin + (end - begin) / 2u;
+            int res = std::memcmp(ids + middle * object_id_size, id.data(), object_id_size);
+            if (res < 0)
+                begin = middle + 1u;
+            else if (res > 0)
+                end = middle;
+            else
+            {
+                boost::uint32_t small_offset = read_be32(offsets + middle * 4u);
+                if ((small_offset & 0x80000000u) == 0u)
+                {
+                    offset = small_offset;
+                }
+                else
+                {
+                    std::size_t large_index = small_offset & 0x7FFFFFFFu;
+                    if (large_index >= large_offset_count)
+                        throw_corrupted("Corrupted git pack index", index_path);
+                    offset = read_be64(large_offsets + large_index * 8u);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+//! The function parses the commit object
+void parse_git_commit(boost::string_ref const& data, git_commit& commit)
+{
+    commit.parents.clear();
+    commit.time = 0;
+    commit.summary.clear();
+
+    boost::string_ref rest = data;
+    bool has_tree = false;
+    while (!rest.empty())
+    {
+        std::size_t pos = rest.find('\n');
+        boost::string_ref line = rest.substr(0, pos);
+        rest.remove_prefix(pos == boost::string_ref::npos ? rest.size() : pos + 1u);
+        if (line.empty())
+            break;
+
+        git_object_id id;
+        if (parse_object_id_field(line, "tree ", id))
+        {
+            commit.tree = id;
+            has_tree = true;
+        }
+        else if (parse_object_id_field(line, "parent ", id))
+        {
+            commit.parents.push_back(id);
+        }
+        else if (line.starts_with("committer "))
+        {
+            // The time follows the committer e-mail and is followed by the time zone
+            std::size_t email_end = line.rfind('>');
+            if (email_end != boost::string_ref::npos)
+            {
+                boost::int64_t time = 0;
+                for (boost::string_ref::const_iterator it = line.begin() + email_end + 1u, end = line.end(); it != end; ++it)
+                {
+                    if (*it >= '0' && *it <= '9')
+                        time = time * 10 + (*it - '0');
+                    else if (*it != ' ' || time != 0)
+                        break;
+                }
+                commit.time = time;
+            }
+        }
+    }
+
+    if (!has_tree)
+        BOOST_THROW_EXCEPTION(std::runtime_error("Corrupted git commit object"));
+
+    std::size_t pos = rest.find('\n');
+    boost::string_ref summary = rest.substr(0, pos);
+    while (!summary.empty() && summary.back() == '\r')
+        summary.remove_suffix(1u);
+    commit.summary.assign(summary.data(), summary.size());
+}
+
+//! The function parses the tree object
+void parse_git_tree(boost::string_ref const& data, std::vector< git_tree_entry >& entries)
+{
+    const char* p = data.data(), *end = p + data.size();
+    while (p != end)
+    {
+        git_tree_entry entry;
+        for (; p != end && *p != ' '; ++p)
+        {
+            if (*p < '0' || *p > '7')
+                BOOST_THROW_EXCEPTION(std::runtime_error("Corrupted git tree object"));
+            entry.mode = (entry.mode << 3) | static_cast< boost::uint32_t >(*p - '0');
+        }
+        if (p == end)
+            BOOST_THROW_EXCEPTION(std::runtime_error("Corrupted git tree object"));
+
+        const char* name = ++p;
+        p = static_cast< const char* >(std::memchr(p, 0, end - p));
+        if (!p || static_cast< std::size_t >(end - p) <= object_id_size)
+            BOOST_THROW_EXCEPTION(std::runtime_error("Corrupted git tree object"));
+        entry.name.assign(name, p);
+        ++p;
+
+        std::memcpy(entry.id.data(), p, object_id_size);
+        p += object_id_size;
+        entries.push_back(entry);
+    }
+}
+
+//! Opens the object database of the git directory
+git_object_store::git_object_store(boost::filesystem::path const& git_dir) : m_git_dir(git_dir), m_common_dir(git_dir), m_delta_bases_size(0u)
+{
+    // Linked working trees share the objects with the main working tree
+    std::string line;
+    if (read_first_line(git_dir / "commondir", line))
+    {
+        boost::filesystem::path common_dir = line;
+        if (common_dir.is_relative())
+            common_dir = git_dir / common_dir;
+        m_common_dir = normalize_path(common_dir);
+    }
+
+    boost::filesystem::path objects_dir = m_common_dir / "objects";
+    if (!boost::filesystem::is_directory(objects_dir))
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Not a git directory: " + git_dir.string()));
+
+    boost::filesystem::path pack_dir = objects_dir / "pack";
+    if (boost::filesystem::is_directory(pack_dir))
+    {
+        std::vector< boost::filesystem::path > indices;
+        for (boost::filesystem::directory_iterator it(pack_dir), end; it != end; ++it)
+        {
+            if (it->path().extension() == ".idx")
+                indices.push_back(it->path());
+        }
+
+        std::sort(indices.begin(), indices.end());
+        for (std::vector< boost::filesystem::path >::const_iterator it = indices.begin(), end = indices.end(); it != end; ++it)
+        {
+            // The index is written before the pack, so a pack may be incomplete while it is being received
+            boost::filesystem::path pack_path = *it;
+            pack_path.replace_extension(".pack");
+            if (boost::filesystem::is_regular_file(pack_path))
+                m_packs.push_back(boost::make_shared< pack_file >(*it, pack_path));
+        }
+    }
+}
+
+git_object_store::~git_object_store()
+{
+}
+
+//! Reads the object
+bool git_object_store::read_object(git_object_id const& id, git_object& obj)
+{
+    return read_packed_object(id, obj) || read_loose_object(id, obj);
+}
+
+//! Reads the object of the specified type
+void git_object_store::read_object(git_object_id const& id, git_object_type type, git_object& obj)
+{
+    git_object_id object_id = id;
+    for (unsigned int depth = 0u; true; ++depth)
+    {
+        if (!read_object(object_id, obj))
+            BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Git object not found: " + to_hex_string(object_id))) << file_name_info(m_git_dir.string()));
+
+        if (obj.type != git_tag_object || type == git_tag_object || depth >= max_reference_depth)
+            break;
+
+        // Annotated tag, which refers to the tagged object
+        if (!parse_object_id_field(obj.data, "object ", object_id))
+            BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Corrupted git tag object: " + to_hex_string(object_id))) << file_name_info(m_git_dir.string()));
+    }
+
+    if (obj.type != type)
+    {
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error(std::string("Git object is not a ") + object_type_names[type] + ": " + to_hex_string(id)))
+            << file_name_info(m_git_dir.string()));
+    }
+}
+
+//! Returns the object identifier for the revision
+git_object_id git_object_store::resolve_revision(std::string const& revision)
+{
+    std::size_t pos = revision.find_first_of("~^");
+    git_object_id id = resolve_name(revision.substr(0, pos));
+    while (pos != std::string::npos)
+    {
+        char suffix = revision[pos++];
+        std::size_t number_end = revision.find_first_not_of("0123456789", pos);
+        if (number_end == std::string::npos)
+            number_end = revision.size();
+        if (number_end != revision.size() && revision[number_end] != '~' && revision[number_end] != '^')
+            BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported git revision: " + revision));
+
+        std::size_t number = number_end > pos ? boost::lexical_cast< std::size_t >(revision.substr(pos, number_end - pos)) : 1u;
+        if (suffix == '~')
+        {
+            for (; number > 0u; --number)
+                id = get_parent(id, 1u, revision);
+        }
+        else if (number > 0u)
+        {
+            id = get_parent(id, number, revision);
+        }
+
+        pos = number_end < revision.size() ? number_end : std::string::npos;
+    }
+
+    return id;
+}
+
+git_object_id git_object_store::resolve_name(std::string const& name) const
+{
+    git_object_id id;
+    if (name.size() == object_id_size * 2u && from_hex_string(name, id))
+        return id;
+
+    static const char* const prefixes[] = { "", "refs/", "refs/tags/", "refs/heads/", "refs/remotes/" };
+    for (std::size_t i = 0; i < sizeof(prefixes) / sizeof(*prefixes); ++i)
+    {
+        if (resolve_reference(prefixes[i] + name, id, 0u))
+            return id;
+    }
+    if (resolve_reference("refs/remotes/" + name + "/HEAD", id, 0u))
+        return id;
+
+    BOOST_THROW_EXCEPTION(boost::enable_error_info(std::invalid_argument("Unknown git revision: " + name)) << file_name_info(m_git_dir.string()));
+}
+
+//! Returns the parent of the commit, the parents are numbered from 1
+git_object_id git_object_store::get_parent(git_object_id const& id, std::size_t parent, std::string const& revision)
+{
+    git_object obj;
+    read_object(id, git_commit_object, obj);
+    git_commit commit;
+    parse_git_commit(obj.data, commit);
+    if (parent > commit.parents.size())
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::invalid_argument("Git revision does not exist: " + revision)) << file_name_info(m_git_dir.string()));
+    return commit.parents[parent - 1u];
+}
+
+bool git_object_store::read_packed_object(git_object_id const& id, git_object& obj)
+{
+    for (std::size_t i = 0, n = m_packs.size(); i < n; ++i)
+    {
+        boost::uint64_t offset = 0u;
+        if (m_packs[i]->find(id, offset))
+        {
+            read_pack_entry(i, offset, obj);
+            return true;
+        }
+    }
+    return false;
+}
+
+void git_object_store::read_pack_entry(std::size_t pack, boost::uint64_t offset, git_object& obj)
+{
+    pack_file const& file = *m_packs[pack];
+    const unsigned char* data = reinterpret_cast< const unsigned char* >(file.pack.data());
+    const unsigned char* end = data + file.pack.size() - object_id_size;
+    if (offset < 12u || offset >= static_cast< boost::uint64_t >(end - data))
+        throw_corrupted("Corrupted git pack file", file.pack_path);
+
+    // Object header: type and size of the (possibly delta) data
+    const unsigned char* p = data + offset;
+    unsigned int c = *p++;
+    unsigned int type = (c >> 4) & 7u;
+    boost::uint64_t size = c & 15u;
+    for (unsigned int shift = 4u; (c & 0x80u) != 0u; shift += 7u)
+    {
+        if (p == end || shift >= 64u)
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+        c = *p++;
+        size |= static_cast< boost::uint64_t >(c & 0x7Fu) << shift;
+    }
+
+    if (type >= git_commit_object && type <= git_tag_object)
+    {
+        obj.type = static_cast< git_object_type >(type);
+        if (!inflate_object(p, end - p, size, obj.data))
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+        return;
+    }
+
+    std::string delta;
+    if (type == ofs_delta_type)
+    {
+        // The base object precedes the delta in the same pack
+        if (p == end)
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+        c = *p++;
+        boost::uint64_t base_distance = c & 0x7Fu;
+        while ((c & 0x80u) != 0u)
+        {
+            if (p == end)
+                throw_corrupted("Corrupted git pack file", file.pack_path);
+            c = *p++;
+            base_distance = ((base_distance + 1u) << 7) | (c & 0x7Fu);
+        }
+        if (base_distance == 0u || base_distance > offset)
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+
+        if (!inflate_object(p, end - p, size, delta))
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+
+        pack_position base_position(pack, offset - base_distance);
+        object_cache::const_iterator base_it = m_delta_bases.find(base_position);
+        if (base_it == m_delta_bases.end())
+        {
+            git_object base;
+            read_pack_entry(pack, base_position.second, base);
+            if (m_delta_bases_size + base.data.size() > max_delta_bases_size)
+            {
+                m_delta_bases.clear();
+                m_delta_bases_size = 0u;
+            }
+            m_delta_bases_size += base.data.size();
+            base_it = m_delta_bases.insert(object_cache::value_type(base_position, base)).first;
+        }
+
+        if (!apply_delta(base_it->second.data, delta, obj.data))
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+        obj.type = base_it->second.type;
+    }
+    else if (type == ref_delta_type)
+    {
+        // The base object is referred to by its identifier
+        if (static_cast< std::size_t >(end - p) < object_id_size)
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+        git_object_id base_id;
+        std::memcpy(base_id.data(), p, object_id_size);
+        p += object_id_size;
+
+        if (!inflate_object(p, end - p, size, delta))
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+
+        git_object base;
+        if (!read_object(base_id, base) || !apply_delta(base.data, delta, obj.data))
+            throw_corrupted("Corrupted git pack file", file.pack_path);
+        obj.type = base.type;
+    }
+    else
+    {
+        throw_corrupted("Corrupted git pack file", file.pack_path);
+    }
+}
+
+bool git_object_store::read_loose_object(git_object_id const& id, git_object& obj)
+{
+    std::string hex = to_hex_string(id);
+    boost::filesystem::path path = m_common_dir / "objects" / hex.substr(0, 2) / hex.substr(2);
+    std::string path_str = path.string();
+    std::ifstream file(path_str.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    // The loose object is compressed along with the header: the object type and size followed by a zero byte
+    std::string data;
+    try
+    {
+        boost::iostreams::filtering_istream strm;
+        strm.push(boost::iostreams::zlib_decompressor());
+        strm.push(file);
+        boost::iostreams::copy(strm, boost::iostreams::back_inserter(data));
+    }
+    catch (std::exception&)
+    {
+        throw_corrupted("Corrupted git object file", path);
+    }
+
+    std::size_t space = data.find(' '), header_end = data.find('\0');
+    if (space == std::string::npos || header_end == std::string::npos || space > header_end)
+        throw_corrupted("Corrupted git object file", path);
+
+    obj.type = git_no_object;
+    for (std::size_t i = git_commit_object; i <= git_tag_object; ++i)
+    {
+        if (data.compare(0, space, object_type_names[i]) == 0)
+            obj.type = static_cast< git_object_type >(i);
+    }
+    if (obj.type == git_no_object)
+        throw_corrupted("Corrupted git object file", path);
+
+    obj.data.assign(data, header_end + 1u, std::string::npos);
+    return true;
+}
+
+bool git_object_store::resolve_reference(std::string const& name, git_object_id& id, unsigned int depth) const
+{
+    if (depth > max_reference_depth)
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Too deeply nested git reference: " + name)) << file_name_info(m_git_dir.string()));
+
+    // Per-worktree references (e.g. HEAD) are in the git directory, the shared references are in the common directory
+    std::string line;
+    if (read_first_line(m_git_dir / name, line) || (m_common_dir != m_git_dir && read_first_line(m_common_dir / name, line)))
+    {
+        if (line.compare(0, 5, "ref: ") == 0)
+            return resolve_reference(line.substr(5), id, depth + 1u);
+        return line.size() == object_id_size * 2u && from_hex_string(line, id);
+    }
+
+    // Packed references: lines of the object identifier and the reference name. Peeled tags and comments are ignored.
+    std::string packed_refs_str = (m_common_dir / "packed-refs").string();
+    std::ifstream packed_refs(packed_refs_str.c_str());
+    while (std::getline(packed_refs, line))
+    {
+        if (line.size() > object_id_size * 2u + 1u && line[0] != '#' && line[0] != '^' && line[object_id_size * 2u] == ' ')
+        {
+            boost::string_ref ref_name(line);
+            ref_name.remove_prefix(object_id_size * 2u + 1u);
+            while (!ref_name.empty() && (ref_name.back() == '\r' || ref_name.back() == ' '))
+                ref_name.remove_suffix(1u);
+            if (ref_name == name)
+                return from_hex_string(boost::string_ref(line).substr(0, object_id_size * 2u), id);
+        }
+    }
+
+    return false;
+}
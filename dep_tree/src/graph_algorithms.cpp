@@ -0,0 +1,317 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the generic directed graph algorithms
+ */
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <boost/ref.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <graph_algorithms.hpp>
+#include <work_queue.hpp>
+
+namespace {
+
+const std::size_t invalid_index = static_cast< std::size_t >(-1);
+
+//! Minimum number of components in a level that is worth processing in parallel
+const std::size_t min_parallel_level_size = 256u;
+
+//! Bitset word type
+typedef boost::uint64_t bitset_word;
+const std::size_t bitset_word_bits = 64u;
+
+/*!
+ * Transitive reduction of a DAG of components. Components are ordered so that the dependencies come first, so the set of components
+ * reachable from a component only contains components with lower indices and the bitset for component \c c only needs \c c bits.
+ */
+class dag_reducer
+{
+private:
+    adjacency_list const& m_dag;
+    adjacency_list& m_reduced;
+    std::vector< std::vector< bitset_word > > m_reachable;
+
+public:
+    dag_reducer(adjacency_list const& dag, adjacency_list& reduced) : m_dag(dag), m_reduced(reduced), m_reachable(dag.size())
+    {
+        m_reduced.resize(dag.size());
+    }
+
+    void reduce(unsigned int thread_count)
+    {
+        // Components of the same level don't depend on each other and can be processed concurrently
+        std::vector< std::vector< std::size_t > > levels;
+        std::vector< std::size_t > component_levels(m_dag.size(), 0u);
+        for (std::size_t component = 0, n = m_dag.size(); component < n; ++component)
+        {
+            std::size_t& level = component_levels[component];
+            std::vector< std::size_t > const& deps = m_dag[component];
+            for (std::vector< std::size_t >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+                level = (std::max)(level, component_levels[*it] + 1u);
+
+            if (levels.size() <= level)
+                levels.resize(level + 1u);
+            levels[level].push_back(component);
+        }
+
+        for (std::vector< std::vector< std::size_t > >::const_iterator it = levels.begin(), end = levels.end(); it != end; ++it)
+        {
+            if (thread_count > 1u && it->size() >= min_parallel_level_size)
+            {
+                work_queue queue(it->size());
+                queue.run(thread_count, NULL, boost::bind(&dag_reducer::reduce_level, this, boost::ref(queue), boost::cref(*it)));
+            }
+            else
+            {
+                for (std::vector< std::size_t >::const_iterator component_it = it->begin(), component_end = it->end(); component_it != component_end; ++component_it)
+                    reduce_component(*component_it);
+            }
+        }
+    }
+
+private:
+    //! Worker thread function
+    void reduce_level(work_queue& queue, std::vector< std::size_t > const& level)
+    {
+        std::size_t i;
+        while (queue.pop(i))
+            reduce_component(level[i]);
+    }
+
+    //! Computes the reachable set of the component and removes the redundant edges
+    void reduce_component(std::size_t component)
+    {
+        std::vector< bitset_word >& reachable = m_reachable[component];
+        reachable.assign((component + bitset_word_bits - 1u) / bitset_word_bits, 0u);
+
+        // A direct dependency is redundant if it is reachable through another direct dependency
+        std::vector< std::size_t > const& deps = m_dag[component];
+        for (std::vector< std::size_t >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            std::vector< bitset_word > const& dep_reachable = m_reachable[*it];
+            for (std::size_t i = 0, n = dep_reachable.size(); i < n; ++i)
+                reachable[i] |= dep_reachable[i];
+        }
+
+        std::vector< std::size_t >& reduced_deps = m_reduced[component];
+        for (std::vector< std::size_t >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            if ((reachable[*it / bitset_word_bits] & (static_cast< bitset_word >(1u) << (*it % bitset_word_bits))) == 0u)
+                reduced_deps.push_back(*it);
+        }
+
+        for (std::vector< std::size_t >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+            reachable[*it / bitset_word_bits] |= static_cast< bitset_word >(1u) << (*it % bitset_word_bits);
+    }
+};
+
+//! Collects all nodes of the tree
+void collect_nodes(dep_node& node, std::vector< dep_node* >& nodes, boost::unordered_map< dep_node const*, std::size_t >& node_indices)
+{
+    node_indices[&node] = nodes.size();
+    nodes.push_back(&node);
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+    {
+        collect_nodes(const_cast< dep_node& >(*it), nodes, node_indices);
+    }
+}
+
+} // namespace
+
+//! The function finds strongly connected components of the graph
+void find_strongly_connected_components(adjacency_list const& graph, std::vector< std::vector< std::size_t > >& components, std::vector< std::size_t >& vertex_components)
+{
+    // Tarjan's algorithm. The components are discovered after all components reachable from them.
+    // The algorithm is iterative to not depend on the stack size.
+    const std::size_t vertex_count = graph.size();
+    std::vector< std::size_t > indices(vertex_count, invalid_index), lowlinks(vertex_count, 0u);
+    std::vector< bool > on_stack(vertex_count, false);
+    std::vector< std::size_t > stack;
+    // Vertices being visited and the position of the next edge to visit
+    std::vector< std::pair< std::size_t, std::size_t > > call_stack;
+    std::size_t next_index = 0u;
+
+    components.clear();
+    vertex_components.assign(vertex_count, invalid_index);
+
+    for (std::size_t start = 0; start < vertex_count; ++start)
+    {
+        if (indices[start] != invalid_index)
+            continue;
+
+        call_stack.push_back(std::make_pair(start, 0u));
+        indices[start] = lowlinks[start] = next_index++;
+        stack.push_back(start);
+        on_stack[start] = true;
+
+        while (!call_stack.empty())
+        {
+            const std::size_t vertex = call_stack.back().first;
+            std::vector< std::size_t > const& edges = graph[vertex];
+            std::size_t& edge_pos = call_stack.back().second;
+            if (edge_pos < edges.size())
+            {
+                const std::size_t target = edges[edge_pos++];
+                if (indices[target] == invalid_index)
+                {
+                    indices[target] = lowlinks[target] = next_index++;
+                    stack.push_back(target);
+                    on_stack[target] = true;
+                    call_stack.push_back(std::make_pair(target, 0u));
+                }
+                else if (on_stack[target])
+                {
+                    lowlinks[vertex] = (std::min)(lowlinks[vertex], indices[target]);
+                }
+                continue;
+            }
+
+            call_stack.pop_back();
+            if (!call_stack.empty())
+            {
+                const std::size_t parent = call_stack.back().first;
+                lowlinks[parent] = (std::min)(lowlinks[parent], lowlinks[vertex]);
+            }
+
+            if (lowlinks[vertex] == indices[vertex])
+            {
+                const std::size_t component = components.size();
+                components.push_back(std::vector< std::size_t >());
+                std::vector< std::size_t >& members = components.back();
+                std::size_t member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = false;
+                    vertex_components[member] = component;
+                    members.push_back(member);
+                }
+                while (member != vertex);
+
+                std::sort(members.begin(), members.end());
+            }
+        }
+    }
+}
+
+//! The function removes the edges that are implied by other paths in the graph
+void reduce_transitive_edges(adjacency_list& graph, unsigned int thread_count)
+{
+    std::vector< std::vector< std::size_t > > components;
+    std::vector< std::size_t > vertex_components;
+    find_strongly_connected_components(graph, components, vertex_components);
+
+    // Build the condensed DAG
+    const std::size_t component_count = components.size();
+    adjacency_list dag(component_count);
+    for (std::size_t vertex = 0, n = graph.size(); vertex < n; ++vertex)
+    {
+        const std::size_t component = vertex_components[vertex];
+        std::vector< std::size_t > const& edges = graph[vertex];
+        for (std::vector< std::size_t >::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+        {
+            const std::size_t target_component = vertex_components[*it];
+            if (target_component != component)
+                dag[component].push_back(target_component);
+        }
+    }
+
+    for (adjacency_list::iterator it = dag.begin(), end = dag.end(); it != end; ++it)
+    {
+        std::sort(it->begin(), it->end());
+        it->erase(std::unique(it->begin(), it->end()), it->end());
+    }
+
+    if (thread_count == 0u)
+        thread_count = boost::thread::hardware_concurrency();
+
+    adjacency_list reduced_dag;
+    {
+        dag_reducer reducer(dag, reduced_dag);
+        reducer.reduce(thread_count);
+    }
+    adjacency_list().swap(dag);
+
+    // Map the preserved component edges back to the graph edges. The preserved edges are removed from reduced_dag as they are used,
+    // so that only the first of the edges between the same components is preserved.
+    std::vector< std::size_t > reduced_edges;
+    for (std::size_t vertex = 0, n = graph.size(); vertex < n; ++vertex)
+    {
+        const std::size_t component = vertex_components[vertex];
+        std::vector< std::size_t >& component_edges = reduced_dag[component];
+        std::vector< std::size_t >& edges = graph[vertex];
+
+        reduced_edges.clear();
+        for (std::vector< std::size_t >::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+        {
+            const std::size_t target_component = vertex_components[*it];
+            if (target_component == component)
+            {
+                reduced_edges.push_back(*it);
+            }
+            else
+            {
+                std::vector< std::size_t >::iterator edge_it = std::lower_bound(component_edges.begin(), component_edges.end(), target_component);
+                if (edge_it != component_edges.end() && *edge_it == target_component)
+                {
+                    reduced_edges.push_back(*it);
+                    component_edges.erase(edge_it);
+                }
+            }
+        }
+
+        edges.swap(reduced_edges);
+    }
+}
+
+//! The function removes the dependencies between the tree nodes that are implied by other dependencies
+void reduce_dependencies(dep_tree& root, unsigned int thread_count)
+{
+    std::vector< dep_node* > nodes;
+    boost::unordered_map< dep_node const*, std::size_t > node_indices;
+    collect_nodes(root, nodes, node_indices);
+
+    bool has_dependents = false;
+    adjacency_list graph(nodes.size());
+    for (std::size_t i = 0, n = nodes.size(); i < n; ++i)
+    {
+        dep_node::nodes const& deps = nodes[i]->get_dependencies();
+        std::vector< std::size_t >& edges = graph[i];
+        edges.reserve(deps.size());
+        for (dep_node::nodes::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+            edges.push_back(node_indices[*it]);
+        std::sort(edges.begin(), edges.end());
+
+        has_dependents |= !nodes[i]->get_dependents().empty();
+    }
+
+    reduce_transitive_edges(graph, thread_count);
+
+    dep_node::nodes deps;
+    for (std::size_t i = 0, n = nodes.size(); i < n; ++i)
+    {
+        std::vector< std::size_t > const& edges = graph[i];
+        deps.clear();
+        for (std::vector< std::size_t >::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+            deps.push_back(nodes[*it]);
+        nodes[i]->set_dependencies(deps);
+
+        if (has_dependents)
+            nodes[i]->clear_dependents();
+    }
+
+    if (has_dependents)
+        reconstruct_reverse_dependencies(root, thread_count);
+}
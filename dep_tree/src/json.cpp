@@ -9,39 +9,214 @@
  */
 
 #include <cstddef>
+#include <cstring>
 #include <string>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <exception>
+#include <stdexcept>
 #include <boost/assert.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/atomic.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
 #include <json.hpp>
+#include <node_attributes.hpp>
+#include <content_digest.hpp>
+#include <trace.hpp>
 
 namespace {
 
 const char meta_tag[] = "$meta";
 const char deps_tag[] = "deps";
 const char rdeps_tag[] = "rdeps";
+const char format_tag[] = "$format";
+const char nodes_tag[] = "nodes";
+const char attrs_tag[] = "attrs";
+//! The format identifier of the compact documents
+const char compact_format[] = "compact-1";
 
-void serialize_meta(dep_node const& node, std::string const& newline_indent, std::string const& indent, bool with_rdeps, std::ostream& strm)
+//! Minimum weight of a subtree that is worth serializing in a separate chunk
+const std::size_t min_chunk_weight = 1024u;
+//! The number of chunks per thread to balance the load between threads
+const std::size_t chunks_per_thread = 16u;
+
+//! Node attribute kinds, in the order they are written
+enum attribute_kind
+{
+    size_attribute,
+    lines_attribute,
+    mtime_attribute,
+    hash_attribute,
+    library_attribute,
+    parse_time_attribute,
+    attribute_kind_count
+};
+
+//! Attribute names in the documents, by kind
+const char* const attribute_tags[attribute_kind_count] = { "size", "lines", "mtime", "hash", "library", "parse_us" };
+
+//! Returns the attribute kind by name or \c attribute_kind_count if the name is unknown
+attribute_kind find_attribute_kind(boost::string_ref const& tag)
+{
+    for (unsigned int i = 0u; i < attribute_kind_count; ++i)
+    {
+        if (tag == attribute_tags[i])
+            return static_cast< attribute_kind >(i);
+    }
+    return attribute_kind_count;
+}
+
+inline void append_number(std::string& text, boost::uintmax_t n)
+{
+    char buf[24];
+    char* p = buf + sizeof(buf);
+    do
+    {
+        *--p = static_cast< char >('0' + n % 10u);
+        n /= 10u;
+    }
+    while (n > 0u);
+    text.append(p, buf + sizeof(buf));
+}
+
+//! Checks if the node has the attribute
+bool has_attribute(node_attributes const& attributes, attribute_kind kind, std::size_t id)
+{
+    switch (kind)
+    {
+    case size_attribute:
+        return attributes.file_size.has(id);
+    case lines_attribute:
+        return attributes.line_count.has(id);
+    case mtime_attribute:
+        return attributes.mtime.has(id);
+    case hash_attribute:
+        return attributes.content_hash.has(id);
+    case library_attribute:
+        return attributes.library.has(id);
+    case parse_time_attribute:
+        return attributes.parse_time.has(id);
+    default:
+        return false;
+    }
+}
+
+//! Appends the attribute value of the node as a JSON value. The node must have the attribute.
+void append_attribute(node_attributes const& attributes, attribute_kind kind, std::size_t id, std::string& text)
+{
+    switch (kind)
+    {
+    case size_attribute:
+        append_number(text, attributes.file_size.get(id));
+        break;
+    case lines_attribute:
+        append_number(text, attributes.line_count.get(id));
+        break;
+    case mtime_attribute:
+        {
+            boost::int64_t mtime = attributes.mtime.get(id);
+            if (mtime < 0)
+                text.push_back('-');
+            append_number(text, mtime < 0 ? static_cast< boost::uintmax_t >(-(mtime + 1)) + 1u : static_cast< boost::uintmax_t >(mtime));
+        }
+        break;
+    case hash_attribute:
+        text.append(1, '"').append(to_hex_string(attributes.content_hash.get(id))).append(1, '"');
+        break;
+    case library_attribute:
+        text.append(1, '"').append(attributes.get_library_name(attributes.library.get(id))).append(1, '"');
+        break;
+    case parse_time_attribute:
+        append_number(text, attributes.parse_time.get(id));
+        break;
+    default:
+        break;
+    }
+}
+
+//! Sets the attribute of the node from the text of the JSON value, which is the unquoted string for the string values
+void set_attribute(node_attributes& attributes, attribute_kind kind, std::size_t id, std::string const& value)
+{
+    try
+    {
+        switch (kind)
+        {
+        case size_attribute:
+            attributes.file_size.set(id, boost::lexical_cast< boost::uint64_t >(value));
+            break;
+        case lines_attribute:
+            attributes.line_count.set(id, boost::lexical_cast< boost::uint32_t >(value));
+            break;
+        case mtime_attribute:
+            attributes.mtime.set(id, boost::lexical_cast< boost::int64_t >(value));
+            break;
+        case hash_attribute:
+            {
+                content_digest digest;
+                if (!from_hex_string(value, digest))
+                    BOOST_THROW_EXCEPTION(std::runtime_error("Failed to read dependency tree: incorrect content hash: " + value));
+                attributes.content_hash.set(id, digest);
+            }
+            break;
+        case library_attribute:
+            attributes.set_library(id, value);
+            break;
+        case parse_time_attribute:
+            attributes.parse_time.set(id, boost::lexical_cast< boost::uint32_t >(value));
+            break;
+        default:
+            break;
+        }
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error(std::string("Failed to read dependency tree: incorrect value of attribute ") + attribute_tags[kind] + ": " + value));
+    }
+}
+
+inline bool has_meta(dep_node const& node, bool with_rdeps)
+{
+    return !node.get_dependencies().empty() || !(with_rdeps && node.get_dependents().empty()) || node.get_attributes().has_any(node.get_id());
+}
+
+void serialize_meta(dep_node const& node, std::string const& newline_indent, std::string const& indent, bool with_rdeps, std::string& strm)
 {
     std::string nested_newline_indent = newline_indent + indent;
     std::string nested_nested_newline_indent = nested_newline_indent + indent;
 
-    strm << newline_indent << '"' << meta_tag << "\":" << newline_indent << '{';
+    strm.append(newline_indent).append(1, '"').append(meta_tag).append("\":").append(newline_indent).append(1, '{');
 
     bool is_first = true;
     dep_node::nodes const& deps = node.get_dependencies();
     if (!deps.empty())
     {
-        strm << nested_newline_indent << '"' << deps_tag << "\":" << nested_newline_indent << '[';
+        strm.append(nested_newline_indent).append(1, '"').append(deps_tag).append("\":").append(nested_newline_indent).append(1, '[');
 
         for (dep_node::nodes::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
         {
             if (!is_first)
-                strm << ',';
+                strm.push_back(',');
             else
                 is_first = false;
-            strm << nested_nested_newline_indent << '"' << (*it)->get_full_name() << '"';
+            strm.append(nested_nested_newline_indent).append(1, '"').append((*it)->get_full_name()).append(1, '"');
         }
 
-        strm << nested_newline_indent << ']';
+        strm.append(nested_newline_indent).append(1, ']');
     }
 
     if (with_rdeps)
@@ -50,71 +225,861 @@ void serialize_meta(dep_node const& node, std::string const& newline_indent, std
         if (!rdeps.empty())
         {
             if (!is_first)
-                strm << ',';
-            strm << nested_newline_indent << '"' << rdeps_tag << "\":" << nested_newline_indent << '[';
+                strm.push_back(',');
+            strm.append(nested_newline_indent).append(1, '"').append(rdeps_tag).append("\":").append(nested_newline_indent).append(1, '[');
 
             is_first = true;
             for (dep_node::nodes::const_iterator it = rdeps.begin(), end = rdeps.end(); it != end; ++it)
             {
                 if (!is_first)
-                    strm << ',';
+                    strm.push_back(',');
                 else
                     is_first = false;
-                strm << nested_nested_newline_indent << '"' << (*it)->get_full_name() << '"';
+                strm.append(nested_nested_newline_indent).append(1, '"').append((*it)->get_full_name()).append(1, '"');
             }
 
-            strm << nested_newline_indent << ']';
+            strm.append(nested_newline_indent).append(1, ']');
         }
     }
 
-    strm << newline_indent << '}';
+    node_attributes const& attributes = node.get_attributes();
+    if (attributes.has_any(node.get_id()))
+    {
+        if (!is_first)
+            strm.push_back(',');
+        strm.append(nested_newline_indent).append(1, '"').append(attrs_tag).append("\":").append(nested_newline_indent).append(1, '{');
+
+        is_first = true;
+        for (unsigned int i = 0u; i < attribute_kind_count; ++i)
+        {
+            attribute_kind kind = static_cast< attribute_kind >(i);
+            if (!has_attribute(attributes, kind, node.get_id()))
+                continue;
+            if (!is_first)
+                strm.push_back(',');
+            else
+                is_first = false;
+            strm.append(nested_nested_newline_indent).append(1, '"').append(attribute_tags[i]).append(newline_indent.empty() ? "\":" : "\": ");
+            append_attribute(attributes, kind, node.get_id(), strm);
+        }
+
+        strm.append(nested_newline_indent).append(1, '}');
+    }
+
+    strm.append(newline_indent).append(1, '}');
 }
 
-void serialize_node(dep_node const& node, std::string const& newline_indent, std::string const& indent, bool with_rdeps, std::ostream& strm)
+//! Set of nodes whose subtrees are not serialized
+typedef boost::unordered_set< dep_node const* > node_filter;
+
+void serialize_node(dep_node const& node, std::string const& newline_indent, std::string const& indent, bool with_rdeps, std::string& strm, node_filter const* excluded = NULL)
 {
     std::string nested_newline_indent = newline_indent + indent;
 
-    strm << newline_indent << '"' << node.get_name() << "\":";
+    strm.append(newline_indent).append(1, '"').append(node.get_name()).append("\":");
 
-    if (!node.get_children().empty() || !node.get_dependencies().empty() || !(with_rdeps && node.get_dependents().empty()))
+    if (!node.get_children().empty() || has_meta(node, with_rdeps))
     {
-        strm << newline_indent << '{';
+        strm.append(newline_indent).append(1, '{');
 
         bool is_first = true;
         for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
         {
+            if (excluded && excluded->count(&*it) > 0u)
+                continue;
             if (!is_first)
-                strm << ',';
+                strm.push_back(',');
             else
                 is_first = false;
-            serialize_node(*it, nested_newline_indent, indent, with_rdeps, strm);
+            serialize_node(*it, nested_newline_indent, indent, with_rdeps, strm, excluded);
         }
 
-        if (!node.get_dependencies().empty() || !(with_rdeps && node.get_dependents().empty()))
+        if (has_meta(node, with_rdeps))
         {
             if (!is_first)
-                strm << ',';
+                strm.push_back(',');
             else
                 is_first = false;
             serialize_meta(node, nested_newline_indent, indent, with_rdeps, strm);
         }
 
-        strm << newline_indent << '}';
+        strm.append(newline_indent).append(1, '}');
     }
     else
     {
         // Conserve some space for empty nodes
-        strm << " {}";
+        strm.append(" {}");
+    }
+}
+
+//! A piece of the output document. The chunk is either a literal text or a subtree that has to be serialized.
+struct json_chunk
+{
+    dep_node const* node;
+    std::string newline_indent;
+    std::string text;
+    bool ready;
+
+    json_chunk() : node(NULL), ready(true) {}
+    json_chunk(dep_node const* n, std::string const& nl_ind) : node(n), newline_indent(nl_ind), ready(false) {}
+};
+
+//! The class splits the tree into chunks and serializes them concurrently
+class chunked_serializer
+{
+private:
+    typedef boost::unordered_map< dep_node const*, std::size_t > weight_map;
+
+private:
+    std::string const& m_indent;
+    const bool m_with_rdeps;
+    std::vector< json_chunk > m_chunks;
+    weight_map m_weights;
+
+    boost::atomic< std::size_t > m_next_chunk;
+    boost::mutex m_mutex;
+    boost::condition_variable m_chunk_ready;
+    boost::exception_ptr m_error;
+
+public:
+    chunked_serializer(std::string const& indent, bool with_rdeps) : m_indent(indent), m_with_rdeps(with_rdeps), m_next_chunk(0u)
+    {
+    }
+
+    //! Splits the tree into chunks of roughly equal size
+    void split(dep_tree const& root, std::string const& newline_indent, unsigned int thread_count)
+    {
+        std::size_t total_weight = compute_weight(root);
+        std::size_t chunk_weight = total_weight / (thread_count * chunks_per_thread);
+        if (chunk_weight < min_chunk_weight)
+            chunk_weight = min_chunk_weight;
+
+        m_chunks.push_back(json_chunk());
+        for (dep_node::node_set::const_iterator it = root.get_children().begin(), end = root.get_children().end(); it != end; ++it)
+        {
+            if (it != root.get_children().begin())
+                m_chunks.back().text.push_back(',');
+            split_node(*it, newline_indent, chunk_weight);
+        }
+    }
+
+    //! Serializes the chunks in the worker threads and writes them to the stream in order, as soon as they become ready
+    void write(std::ostream& strm, unsigned int thread_count)
+    {
+        boost::thread_group workers;
+        try
+        {
+            for (unsigned int i = 0; i < thread_count; ++i)
+                workers.create_thread(boost::bind(&chunked_serializer::serialize_chunks, this));
+
+            for (std::vector< json_chunk >::iterator it = m_chunks.begin(), end = m_chunks.end(); it != end; ++it)
+            {
+                {
+                    boost::unique_lock< boost::mutex > lock(m_mutex);
+                    while (!it->ready && !m_error)
+                        m_chunk_ready.wait(lock);
+                    if (m_error)
+                        break;
+                }
+
+                strm.write(it->text.data(), it->text.size());
+
+                // Release the memory as soon as possible
+                std::string().swap(it->text);
+            }
+        }
+        catch (...)
+        {
+            // Make the worker threads stop
+            m_next_chunk = m_chunks.size();
+            workers.join_all();
+            throw;
+        }
+
+        workers.join_all();
+        if (m_error)
+            boost::rethrow_exception(m_error);
+    }
+
+private:
+    std::size_t compute_weight(dep_node const& node)
+    {
+        std::size_t weight = 1u + node.get_dependencies().size();
+        if (m_with_rdeps)
+            weight += node.get_dependents().size();
+
+        for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+        {
+            weight += compute_weight(*it);
+        }
+
+        m_weights[&node] = weight;
+        return weight;
+    }
+
+    //! Appends chunks for the node. This must produce the same output as serialize_node.
+    void split_node(dep_node const& node, std::string const& newline_indent, std::size_t chunk_weight)
+    {
+        if (m_weights[&node] <= chunk_weight || node.get_children().empty())
+        {
+            m_chunks.push_back(json_chunk(&node, newline_indent));
+            m_chunks.push_back(json_chunk());
+            return;
+        }
+
+        std::string nested_newline_indent = newline_indent + m_indent;
+
+        std::string* text = &m_chunks.back().text;
+        text->append(newline_indent).append(1, '"').append(node.get_name()).append("\":").append(newline_indent).append(1, '{');
+
+        bool is_first = true;
+        for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+        {
+            if (!is_first)
+                m_chunks.back().text.push_back(',');
+            else
+                is_first = false;
+            split_node(*it, nested_newline_indent, chunk_weight);
+        }
+
+        text = &m_chunks.back().text;
+        if (has_meta(node, m_with_rdeps))
+        {
+            text->push_back(',');
+            serialize_meta(node, nested_newline_indent, m_indent, m_with_rdeps, *text);
+        }
+
+        text->append(newline_indent).append(1, '}');
+    }
+
+    //! Worker thread function
+    void serialize_chunks()
+    {
+        set_trace_thread_name("json serializer");
+        try
+        {
+            while (true)
+            {
+                std::size_t i = m_next_chunk.fetch_add(1u, boost::memory_order_relaxed);
+                if (i >= m_chunks.size())
+                    break;
+
+                json_chunk& chunk = m_chunks[i];
+                if (chunk.node)
+                {
+                    {
+                        trace_span span("serialize", "serialize_chunk", chunk.node->get_name());
+                        serialize_node(*chunk.node, chunk.newline_indent, m_indent, m_with_rdeps, chunk.text);
+                    }
+
+                    boost::lock_guard< boost::mutex > lock(m_mutex);
+                    chunk.ready = true;
+                    m_chunk_ready.notify_all();
+                }
+            }
+        }
+        catch (...)
+        {
+            boost::lock_guard< boost::mutex > lock(m_mutex);
+            if (!m_error)
+                m_error = boost::current_exception();
+            m_chunk_ready.notify_all();
+        }
+    }
+};
+
+//! Strips the leading separator of the full node name, which makes it a path from the root node
+inline boost::string_ref make_node_path(std::string const& full_name)
+{
+    boost::string_ref path = full_name;
+    if (!path.empty() && path[0] == dep_node::default_node_separator)
+        path.remove_prefix(1u);
+    return path;
+}
+
+//! Adds the node described by the JSON object and its children to the tree
+void parse_node(boost::property_tree::ptree const& tree, dep_node& node, dep_tree::insertion_cursor& root_cursor)
+{
+    for (boost::property_tree::ptree::const_iterator it = tree.begin(), end = tree.end(); it != end; ++it)
+    {
+        if (it->first != meta_tag)
+        {
+            parse_node(it->second, *node.add_child(it->first), root_cursor);
+            continue;
+        }
+
+        boost::property_tree::ptree const& meta = it->second;
+        boost::property_tree::ptree::const_assoc_iterator deps = meta.find(deps_tag);
+        if (deps != meta.not_found())
+        {
+            for (boost::property_tree::ptree::const_iterator dep_it = deps->second.begin(), dep_end = deps->second.end(); dep_it != dep_end; ++dep_it)
+                node.add_dependency(root_cursor.add_nested_child(make_node_path(dep_it->second.data())));
+        }
+
+        boost::property_tree::ptree::const_assoc_iterator rdeps = meta.find(rdeps_tag);
+        if (rdeps != meta.not_found())
+        {
+            for (boost::property_tree::ptree::const_iterator rdep_it = rdeps->second.begin(), rdep_end = rdeps->second.end(); rdep_it != rdep_end; ++rdep_it)
+                node.add_dependent(root_cursor.add_nested_child(make_node_path(rdep_it->second.data())));
+        }
+
+        boost::property_tree::ptree::const_assoc_iterator attrs = meta.find(attrs_tag);
+        if (attrs != meta.not_found())
+        {
+            for (boost::property_tree::ptree::const_iterator attr_it = attrs->second.begin(), attr_end = attrs->second.end(); attr_it != attr_end; ++attr_it)
+            {
+                attribute_kind kind = find_attribute_kind(attr_it->first);
+                if (kind != attribute_kind_count)
+                    set_attribute(node.get_attributes(), kind, node.get_id(), attr_it->second.data());
+            }
+        }
     }
 }
 
+
+//! Node indices in the compact format
+typedef boost::unordered_map< dep_node const*, std::size_t > node_index_map;
+
+//! Numbers the descendants of the node in preorder
+void number_nodes(dep_node const& node, node_index_map& indices, std::vector< dep_node const* >& nodes)
+{
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+    {
+        indices[&*it] = nodes.size();
+        nodes.push_back(&*it);
+        number_nodes(*it, indices, nodes);
+    }
+}
+
+//! Writes the array of the dependencies or the dependents of every node. Every element is an array of the node index followed by the indices of the nodes it refers to.
+void serialize_compact_edges(std::vector< dep_node const* > const& nodes, node_index_map const& indices, bool dependents,
+    std::string const& newline_indent, std::string const& indent, const char* separator, std::string& text, std::ostream& strm)
+{
+    std::string nested_newline_indent = newline_indent + indent;
+    text.append(newline_indent).append(1, '"').append(dependents ? rdeps_tag : deps_tag).append("\":").append(newline_indent).append(1, '[');
+
+    bool is_first = true;
+    std::vector< std::size_t > edge_indices;
+    for (std::size_t i = 0, n = nodes.size(); i < n; ++i)
+    {
+        dep_node::nodes const& edges = dependents ? nodes[i]->get_dependents() : nodes[i]->get_dependencies();
+        if (edges.empty())
+            continue;
+
+        // The indices are ordered to make the output stable
+        edge_indices.clear();
+        for (dep_node::nodes::const_iterator it = edges.begin(), end = edges.end(); it != end; ++it)
+        {
+            node_index_map::const_iterator index = indices.find(*it);
+            BOOST_ASSERT(index != indices.end());
+            edge_indices.push_back(index->second);
+        }
+        std::sort(edge_indices.begin(), edge_indices.end());
+
+        if (!is_first)
+            text.push_back(',');
+        else
+            is_first = false;
+        text.append(nested_newline_indent).append(1, '[');
+        append_number(text, i);
+        for (std::vector< std::size_t >::const_iterator it = edge_indices.begin(), end = edge_indices.end(); it != end; ++it)
+        {
+            text.append(separator);
+            append_number(text, *it);
+        }
+        text.append(1, ']');
+
+        if (text.size() >= 65536u)
+        {
+            strm.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+
+    text.append(newline_indent).append(1, ']');
+}
+
+//! Writes the attribute columns. Every column is an array of the attribute values of the nodes, by node index, with nulls for the nodes that don't have the attribute.
+void serialize_compact_attributes(std::vector< dep_node const* > const& nodes, node_attributes const& attributes,
+    std::string const& newline_indent, std::string const& indent, const char* separator, std::string& text, std::ostream& strm)
+{
+    std::string nested_newline_indent = newline_indent + indent;
+    text.append(newline_indent).append(1, '"').append(attrs_tag).append("\":").append(newline_indent).append(1, '{');
+
+    bool is_first = true;
+    for (unsigned int i = 0u; i < attribute_kind_count; ++i)
+    {
+        attribute_kind kind = static_cast< attribute_kind >(i);
+        std::size_t n = 0u;
+        while (n < nodes.size() && !has_attribute(attributes, kind, nodes[n]->get_id()))
+            ++n;
+        if (n == nodes.size())
+            continue;
+
+        if (!is_first)
+            text.push_back(',');
+        else
+            is_first = false;
+        text.append(nested_newline_indent).append(1, '"').append(attribute_tags[i]).append(newline_indent.empty() ? "\":[" : "\": [");
+        for (n = 0u; n < nodes.size(); ++n)
+        {
+            if (n > 0u)
+                text.append(separator);
+            if (has_attribute(attributes, kind, nodes[n]->get_id()))
+                append_attribute(attributes, kind, nodes[n]->get_id(), text);
+            else
+                text.append("null");
+
+            if (text.size() >= 65536u)
+            {
+                strm.write(text.data(), text.size());
+                text.clear();
+            }
+        }
+        text.push_back(']');
+    }
+
+    text.append(newline_indent).append(1, '}');
+}
+
+//! Checks if the document is in the compact format, i.e. starts with the format identifier
+bool is_compact_json(std::string const& text)
+{
+    const char* p = text.c_str();
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++p;
+    if (*p != '{')
+        return false;
+    ++p;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++p;
+    return *p == '"' && std::strncmp(p + 1, format_tag, sizeof(format_tag) - 1u) == 0 && p[sizeof(format_tag)] == '"';
+}
+
+//! The class parses documents in the compact format. Only the subset of JSON that is needed for the format is supported in the known fields, other fields are skipped.
+class compact_json_parser
+{
+private:
+    //! The node and the indices of the nodes it refers to
+    typedef std::pair< std::size_t, std::vector< std::size_t > > edge_list;
+
+    //! Attribute value of a node
+    struct attribute_value
+    {
+        attribute_kind kind;
+        std::size_t index;
+        std::string value;
+
+        attribute_value(attribute_kind k, std::size_t i) : kind(k), index(i) {}
+    };
+
+private:
+    const char* const m_begin;
+    const char* const m_end;
+    const char* m_pos;
+    std::vector< dep_node* > m_nodes;
+
+public:
+    explicit compact_json_parser(std::string const& text) : m_begin(text.data()), m_end(text.data() + text.size()), m_pos(text.data())
+    {
+    }
+
+    void parse(dep_tree& root)
+    {
+        std::vector< edge_list > deps, rdeps;
+        std::vector< attribute_value > attributes;
+        bool has_format = false;
+
+        expect('{');
+        if (!try_consume('}'))
+        {
+            do
+            {
+                std::string key;
+                parse_string(key);
+                expect(':');
+                if (key == format_tag)
+                {
+                    std::string format;
+                    parse_string(format);
+                    if (format != compact_format)
+                        throw_error("Unsupported format");
+                    has_format = true;
+                }
+                else if (key == nodes_tag)
+                    parse_nodes(root);
+                else if (key == deps_tag)
+                    parse_edges(deps);
+                else if (key == rdeps_tag)
+                    parse_edges(rdeps);
+                else if (key == attrs_tag)
+                    parse_attributes(attributes);
+                else
+                    skip_value();
+            }
+            while (try_consume(','));
+            expect('}');
+        }
+
+        skip_whitespace();
+        if (m_pos != m_end)
+            throw_error("Unexpected data after the document");
+        if (!has_format)
+            throw_error("Format is not specified");
+
+        // The edges are united with the existing ones
+        dep_node::nodes edges;
+        for (std::vector< edge_list >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            dep_node* node = get_node(it->first);
+            edges = node->get_dependencies();
+            for (std::vector< std::size_t >::const_iterator index_it = it->second.begin(), index_end = it->second.end(); index_it != index_end; ++index_it)
+                edges.push_back(get_node(*index_it));
+            node->set_dependencies(edges);
+        }
+
+        for (std::vector< edge_list >::const_iterator it = rdeps.begin(), end = rdeps.end(); it != end; ++it)
+        {
+            dep_node* node = get_node(it->first);
+            edges = node->get_dependents();
+            for (std::vector< std::size_t >::const_iterator index_it = it->second.begin(), index_end = it->second.end(); index_it != index_end; ++index_it)
+                edges.push_back(get_node(*index_it));
+            node->set_dependents(edges);
+        }
+
+        node_attributes& node_attrs = root.get_attributes();
+        for (std::vector< attribute_value >::const_iterator it = attributes.begin(), end = attributes.end(); it != end; ++it)
+            set_attribute(node_attrs, it->kind, get_node(it->index)->get_id(), it->value);
+    }
+
+private:
+    BOOST_NORETURN void throw_error(const char* what) const
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error(std::string("Failed to read dependency tree: ") + what + " at offset " + boost::lexical_cast< std::string >(m_pos - m_begin)));
+    }
+
+    dep_node* get_node(std::size_t index) const
+    {
+        if (index >= m_nodes.size())
+            throw_error("Incorrect node index");
+        return m_nodes[index];
+    }
+
+    void skip_whitespace()
+    {
+        while (m_pos != m_end && (*m_pos == ' ' || *m_pos == '\t' || *m_pos == '\n' || *m_pos == '\r'))
+            ++m_pos;
+    }
+
+    bool try_consume(char c)
+    {
+        skip_whitespace();
+        if (m_pos != m_end && *m_pos == c)
+        {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!try_consume(c))
+            throw_error("Unexpected character");
+    }
+
+    //! Parses an integer, which may be negative
+    std::ptrdiff_t parse_integer()
+    {
+        skip_whitespace();
+        bool negative = m_pos != m_end && *m_pos == '-';
+        if (negative)
+            ++m_pos;
+        if (m_pos == m_end || *m_pos < '0' || *m_pos > '9')
+            throw_error("Integer expected");
+
+        std::ptrdiff_t n = 0;
+        for (; m_pos != m_end && *m_pos >= '0' && *m_pos <= '9'; ++m_pos)
+            n = n * 10 + (*m_pos - '0');
+        return negative ? -n : n;
+    }
+
+    std::size_t parse_index()
+    {
+        std::ptrdiff_t n = parse_integer();
+        if (n < 0)
+            throw_error("Incorrect node index");
+        return static_cast< std::size_t >(n);
+    }
+
+    unsigned int parse_hex4()
+    {
+        if (m_end - m_pos < 4)
+            throw_error("Incorrect escape sequence");
+        unsigned int code = 0u;
+        for (const char* end = m_pos + 4; m_pos != end; ++m_pos)
+        {
+            char c = *m_pos;
+            code <<= 4u;
+            if (c >= '0' && c <= '9')
+                code |= static_cast< unsigned int >(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                code |= static_cast< unsigned int >(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                code |= static_cast< unsigned int >(c - 'A' + 10);
+            else
+                throw_error("Incorrect escape sequence");
+        }
+        return code;
+    }
+
+    static void append_utf8(std::string& str, unsigned int code)
+    {
+        if (code < 0x80u)
+        {
+            str.push_back(static_cast< char >(code));
+        }
+        else if (code < 0x800u)
+        {
+            str.push_back(static_cast< char >(0xC0u | (code >> 6u)));
+            str.push_back(static_cast< char >(0x80u | (code & 0x3Fu)));
+        }
+        else if (code < 0x10000u)
+        {
+            str.push_back(static_cast< char >(0xE0u | (code >> 12u)));
+            str.push_back(static_cast< char >(0x80u | ((code >> 6u) & 0x3Fu)));
+            str.push_back(static_cast< char >(0x80u | (code & 0x3Fu)));
+        }
+        else
+        {
+            str.push_back(static_cast< char >(0xF0u | (code >> 18u)));
+            str.push_back(static_cast< char >(0x80u | ((code >> 12u) & 0x3Fu)));
+            str.push_back(static_cast< char >(0x80u | ((code >> 6u) & 0x3Fu)));
+            str.push_back(static_cast< char >(0x80u | (code & 0x3Fu)));
+        }
+    }
+
+    void parse_string(std::string& str)
+    {
+        expect('"');
+        str.clear();
+        while (true)
+        {
+            const char* p = m_pos;
+            while (p != m_end && *p != '"' && *p != '\\')
+                ++p;
+            str.append(m_pos, p);
+            m_pos = p;
+            if (m_pos == m_end)
+                throw_error("Unterminated string");
+            if (*m_pos++ == '"')
+                break;
+
+            if (m_pos == m_end)
+                throw_error("Unterminated string");
+            char c = *m_pos++;
+            switch (c)
+            {
+            case 'b':
+                str.push_back('\b');
+                break;
+            case 'f':
+                str.push_back('\f');
+                break;
+            case 'n':
+                str.push_back('\n');
+                break;
+            case 'r':
+                str.push_back('\r');
+                break;
+            case 't':
+                str.push_back('\t');
+                break;
+            case 'u':
+                {
+                    unsigned int code = parse_hex4();
+                    if (code >= 0xD800u && code < 0xDC00u && m_end - m_pos >= 6 && m_pos[0] == '\\' && m_pos[1] == 'u')
+                    {
+                        m_pos += 2;
+                        unsigned int low = parse_hex4();
+                        if (low < 0xDC00u || low >= 0xE000u)
+                            throw_error("Incorrect escape sequence");
+                        code = 0x10000u + ((code - 0xD800u) << 10u) + (low - 0xDC00u);
+                    }
+                    append_utf8(str, code);
+                }
+                break;
+            default:
+                str.push_back(c);
+                break;
+            }
+        }
+    }
+
+    //! Parses the node table. Every node is an array of the parent index, or -1 for the top level nodes, and the node name.
+    void parse_nodes(dep_tree& root)
+    {
+        m_nodes.clear();
+        expect('[');
+        if (try_consume(']'))
+            return;
+
+        std::string name;
+        do
+        {
+            expect('[');
+            std::ptrdiff_t parent = parse_integer();
+            if (parent < -1 || parent >= static_cast< std::ptrdiff_t >(m_nodes.size()))
+                throw_error("Incorrect parent node index");
+            expect(',');
+            parse_string(name);
+            expect(']');
+
+            dep_node* parent_node = parent < 0 ? &root : m_nodes[parent];
+            m_nodes.push_back(parent_node->add_child(name));
+        }
+        while (try_consume(','));
+        expect(']');
+    }
+
+    void parse_edges(std::vector< edge_list >& edges)
+    {
+        expect('[');
+        if (try_consume(']'))
+            return;
+
+        do
+        {
+            expect('[');
+            edges.push_back(edge_list());
+            edges.back().first = parse_index();
+            while (try_consume(','))
+                edges.back().second.push_back(parse_index());
+            expect(']');
+        }
+        while (try_consume(','));
+        expect(']');
+    }
+
+    //! Parses the attribute columns. The values are applied after the node table is parsed.
+    void parse_attributes(std::vector< attribute_value >& attributes)
+    {
+        expect('{');
+        if (try_consume('}'))
+            return;
+
+        std::string key;
+        do
+        {
+            parse_string(key);
+            expect(':');
+            attribute_kind kind = find_attribute_kind(key);
+            if (kind == attribute_kind_count)
+            {
+                skip_value();
+                continue;
+            }
+
+            expect('[');
+            if (try_consume(']'))
+                continue;
+
+            std::size_t index = 0u;
+            do
+            {
+                skip_whitespace();
+                if (m_end - m_pos >= 4 && std::strncmp(m_pos, "null", 4u) == 0)
+                {
+                    m_pos += 4;
+                }
+                else
+                {
+                    attributes.push_back(attribute_value(kind, index));
+                    if (m_pos != m_end && *m_pos == '"')
+                    {
+                        parse_string(attributes.back().value);
+                    }
+                    else
+                    {
+                        const char* p = m_pos;
+                        while (m_pos != m_end && ((*m_pos >= '0' && *m_pos <= '9') || *m_pos == '-'))
+                            ++m_pos;
+                        if (m_pos == p)
+                            throw_error("Attribute value expected");
+                        attributes.back().value.assign(p, m_pos);
+                    }
+                }
+                ++index;
+            }
+            while (try_consume(','));
+            expect(']');
+        }
+        while (try_consume(','));
+        expect('}');
+    }
+
+    void skip_value()
+    {
+        skip_whitespace();
+        if (m_pos == m_end)
+            throw_error("Value expected");
+
+        switch (*m_pos)
+        {
+        case '"':
+            {
+                std::string str;
+                parse_string(str);
+            }
+            break;
+        case '{':
+            ++m_pos;
+            if (!try_consume('}'))
+            {
+                do
+                {
+                    std::string key;
+                    parse_string(key);
+                    expect(':');
+                    skip_value();
+                }
+                while (try_consume(','));
+                expect('}');
+            }
+            break;
+        case '[':
+            ++m_pos;
+            if (!try_consume(']'))
+            {
+                do
+                {
+                    skip_value();
+                }
+                while (try_consume(','));
+                expect(']');
+            }
+            break;
+        default:
+            {
+                const char* p = m_pos;
+                while (m_pos != m_end && (std::strchr("+-.0123456789eEaflnrstu", *m_pos) != NULL))
+                    ++m_pos;
+                if (m_pos == p)
+                    throw_error("Unexpected character");
+            }
+            break;
+        }
+    }
+};
+
 } // namespace
 
 //! Serializes the tree into JSON format
-void serialize_json(dep_tree const& root, std::ostream& strm, bool with_rdeps, bool pretty_print, const char* indent)
+void serialize_json(dep_tree const& root, std::ostream& strm, bool with_rdeps, bool pretty_print, const char* indent, unsigned int thread_count)
 {
     BOOST_ASSERT(root.get_parent() == NULL);
 
+    trace_span span("serialize", "serialize_json");
     std::string nl_ind, ind;
     if (pretty_print)
     {
@@ -122,11 +1087,28 @@ void serialize_json(dep_tree const& root, std::ostream& strm, bool with_rdeps, b
         nl_ind = "\n" + ind;
     }
 
+    if (thread_count == 0u)
+        thread_count = boost::thread::hardware_concurrency();
+
     strm << '{';
 
-    for (dep_node::node_set::const_iterator it = root.get_children().begin(), end = root.get_children().end(); it != end; ++it)
+    if (thread_count > 1u)
+    {
+        chunked_serializer serializer(ind, with_rdeps);
+        serializer.split(root, nl_ind, thread_count);
+        serializer.write(strm, thread_count);
+    }
+    else
     {
-        serialize_node(*it, nl_ind, ind, with_rdeps, strm);
+        std::string text;
+        for (dep_node::node_set::const_iterator it = root.get_children().begin(), end = root.get_children().end(); it != end; ++it)
+        {
+            if (it != root.get_children().begin())
+                text.push_back(',');
+            serialize_node(*it, nl_ind, ind, with_rdeps, text);
+            strm.write(text.data(), text.size());
+            text.clear();
+        }
     }
 
     if (pretty_print)
@@ -136,3 +1118,158 @@ void serialize_json(dep_tree const& root, std::ostream& strm, bool with_rdeps, b
         strm << '\n';
     strm << std::flush;
 }
+
+//! Serializes a part of the tree into JSON format
+void serialize_json_subtree(dep_node const& node, std::vector< dep_node const* > const& excluded, std::ostream& strm, bool with_rdeps, bool pretty_print, const char* indent)
+{
+    trace_span span("serialize", "serialize_json_subtree", node.get_path());
+    std::string nl_ind, ind;
+    if (pretty_print)
+    {
+        ind = indent;
+        nl_ind = "\n" + ind;
+    }
+
+    node_filter filter(excluded.begin(), excluded.end());
+
+    std::vector< dep_node const* > ancestors;
+    for (dep_node const* p = &node; p->get_parent() != NULL; p = p->get_parent())
+        ancestors.push_back(p);
+
+    std::string text;
+    text.push_back('{');
+    if (ancestors.empty())
+    {
+        bool is_first = true;
+        for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+        {
+            if (filter.count(&*it) > 0u)
+                continue;
+            if (!is_first)
+                text.push_back(',');
+            else
+                is_first = false;
+            serialize_node(*it, nl_ind, ind, with_rdeps, text, &filter);
+        }
+    }
+    else
+    {
+        // The ancestors are written without their dependencies, as they are not part of the subtree
+        std::string newline_indent = nl_ind;
+        for (std::size_t i = ancestors.size() - 1u; i > 0u; --i)
+        {
+            text.append(newline_indent).append(1, '"').append(ancestors[i]->get_name()).append("\":").append(newline_indent).append(1, '{');
+            newline_indent.append(ind);
+        }
+
+        serialize_node(node, newline_indent, ind, with_rdeps, text, &filter);
+
+        for (std::size_t i = ancestors.size() - 1u; i > 0u; --i)
+        {
+            newline_indent.resize(newline_indent.size() - ind.size());
+            text.append(newline_indent).append(1, '}');
+        }
+    }
+
+    text.append(pretty_print ? "\n}\n" : "}");
+    strm.write(text.data(), text.size());
+    strm.flush();
+}
+
+//! Serializes the tree into the compact JSON format
+void serialize_compact_json(dep_tree const& root, std::ostream& strm, bool with_rdeps, bool pretty_print, const char* indent)
+{
+    BOOST_ASSERT(root.get_parent() == NULL);
+
+    trace_span span("serialize", "serialize_compact_json");
+    std::string nl_ind, ind;
+    if (pretty_print)
+    {
+        ind = indent;
+        nl_ind = "\n" + ind;
+    }
+    std::string nl_ind2 = nl_ind + ind;
+    const char* separator = pretty_print ? ", " : ",";
+
+    node_index_map indices;
+    std::vector< dep_node const* > nodes;
+    number_nodes(root, indices, nodes);
+
+    std::string text;
+    text.push_back('{');
+    text.append(nl_ind).append(1, '"').append(format_tag).append("\":").append(pretty_print ? " " : "").append(1, '"').append(compact_format).append("\",");
+
+    text.append(nl_ind).append(1, '"').append(nodes_tag).append("\":").append(nl_ind).append(1, '[');
+    for (std::size_t i = 0, n = nodes.size(); i < n; ++i)
+    {
+        if (i > 0u)
+            text.push_back(',');
+        text.append(nl_ind2).append(1, '[');
+        dep_node const* parent = nodes[i]->get_parent();
+        if (parent == &root)
+            text.append("-1");
+        else
+            append_number(text, indices[parent]);
+        text.append(separator).append(1, '"').append(nodes[i]->get_name()).append("\"]");
+
+        if (text.size() >= 65536u)
+        {
+            strm.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    text.append(nl_ind).append("],");
+
+    serialize_compact_edges(nodes, indices, false, nl_ind, ind, separator, text, strm);
+    if (with_rdeps)
+    {
+        text.push_back(',');
+        serialize_compact_edges(nodes, indices, true, nl_ind, ind, separator, text, strm);
+    }
+
+    if (!root.get_attributes().empty())
+    {
+        text.push_back(',');
+        serialize_compact_attributes(nodes, root.get_attributes(), nl_ind, ind, separator, text, strm);
+    }
+
+    text.append(pretty_print ? "\n}\n" : "}");
+    strm.write(text.data(), text.size());
+    strm.flush();
+}
+
+//! Reads the tree in JSON format and adds the nodes to the tree
+void parse_json(std::istream& strm, dep_tree& root)
+{
+    BOOST_ASSERT(root.get_parent() == NULL);
+
+    trace_span span("parse", "parse_json");
+
+    std::string text;
+    {
+        char buf[64u * 1024u];
+        while (strm.read(buf, sizeof(buf)) || strm.gcount() > 0)
+            text.append(buf, static_cast< std::size_t >(strm.gcount()));
+    }
+
+    if (is_compact_json(text))
+    {
+        compact_json_parser parser(text);
+        parser.parse(root);
+        return;
+    }
+
+    boost::property_tree::ptree tree;
+    try
+    {
+        boost::iostreams::stream< boost::iostreams::array_source > text_strm(text.data(), text.size());
+        boost::property_tree::read_json(text_strm, tree);
+    }
+    catch (boost::property_tree::ptree_error& e)
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error(std::string("Failed to read dependency tree: ") + e.what()));
+    }
+
+    dep_tree::insertion_cursor root_cursor(root);
+    parse_node(tree, root, root_cursor);
+}
@@ -0,0 +1,276 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of writing the dependency tree in multiple JSON files, one per library, and loading them on demand
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <json_shards.hpp>
+#include <json.hpp>
+#include <library_graph.hpp>
+#include <compressed_stream.hpp>
+#include <cxx_parser.hpp>
+#include <trace.hpp>
+#include <work_queue.hpp>
+
+const char shard_index_file_name[] = "index.json";
+
+namespace {
+
+//! Format identifier of the shard index
+const char shard_index_format[] = "boost-dep shards 1";
+//! File name of the shard with the nodes that don't belong to libraries, without the suffix
+const char other_shard_name[] = "other";
+
+//! Shard to be written
+struct shard_job
+{
+    json_shard shard;
+    dep_node const* node;
+    //! The nodes of the nested shards
+    std::vector< dep_node const* > excluded;
+
+    shard_job() : node(NULL) {}
+};
+
+//! Orders shards by prefix
+struct order_by_prefix
+{
+    typedef bool result_type;
+
+    result_type operator() (json_shard const& left, json_shard const& right) const
+    {
+        return left.prefix < right.prefix;
+    }
+    result_type operator() (shard_job const& left, shard_job const& right) const
+    {
+        return left.shard.prefix < right.shard.prefix;
+    }
+};
+
+//! The class writes the shards concurrently
+class shard_writer
+{
+private:
+    boost::filesystem::path const& m_dir;
+    std::vector< shard_job > const& m_jobs;
+    work_queue m_queue;
+
+public:
+    shard_writer(boost::filesystem::path const& dir, std::vector< shard_job > const& jobs) : m_dir(dir), m_jobs(jobs), m_queue(jobs.size())
+    {
+    }
+
+    void write(unsigned int thread_count)
+    {
+        m_queue.run(thread_count, "shard writer", boost::bind(&shard_writer::write_shards, this));
+    }
+
+private:
+    //! Worker thread function
+    void write_shards()
+    {
+        std::size_t i;
+        while (m_queue.pop(i))
+            write_shard(m_jobs[i]);
+    }
+
+    void write_shard(shard_job const& job)
+    {
+        boost::filesystem::path path = m_dir / job.shard.file_name;
+        std::string path_str = path.string();
+        try
+        {
+            compression_format compression = compression_from_file_name(path);
+            if (compression != no_compression)
+            {
+                compressed_ofstream file(path, compression);
+                serialize_json_subtree(*job.node, job.excluded, file);
+                file.close();
+            }
+            else
+            {
+                std::ofstream file(path_str.c_str(), std::ios::out | std::ios::trunc);
+                if (!file.is_open())
+                    BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open output file"));
+                serialize_json_subtree(*job.node, job.excluded, file);
+                if (!file.good())
+                    BOOST_THROW_EXCEPTION(std::runtime_error("Failed to write output file"));
+            }
+        }
+        catch (boost::exception& e)
+        {
+            e << file_name_info(path_str);
+            throw;
+        }
+    }
+};
+
+void write_shard_index(std::vector< shard_job > const& jobs, boost::filesystem::path const& path)
+{
+    std::string text;
+    text.append("{\n\t\"format\": \"").append(shard_index_format).append("\",\n\t\"shards\":\n\t[");
+    for (std::vector< shard_job >::const_iterator it = jobs.begin(), end = jobs.end(); it != end; ++it)
+    {
+        if (it != jobs.begin())
+            text.push_back(',');
+        text.append("\n\t\t{\n\t\t\t\"prefix\": \"").append(it->shard.prefix).append("\",");
+        text.append("\n\t\t\t\"file\": \"").append(it->shard.file_name).append("\"\n\t\t}");
+    }
+    text.append("\n\t]\n}\n");
+
+    std::string path_str = path.string();
+    std::ofstream file(path_str.c_str(), std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open output file: " + path_str));
+    file.write(text.data(), text.size());
+}
+
+} // namespace
+
+//! The function writes the tree in JSON format to the directory, one file per library
+void write_json_shards(dep_tree& root, boost::filesystem::path const& dir, std::string const& suffix, unsigned int thread_count)
+{
+    trace_span span("output", "write_json_shards", dir);
+
+    library_graph graph;
+    build_library_graph(root, graph);
+
+    // Every library is written to its own shard, nested libraries are excluded from the enclosing ones
+    std::vector< shard_job > jobs(graph.libraries.size() + 1u);
+    jobs[0].shard.prefix.clear();
+    jobs[0].shard.file_name = other_shard_name + suffix;
+    jobs[0].node = &root;
+    for (std::size_t i = 0, n = graph.libraries.size(); i < n; ++i)
+    {
+        library_graph::library const& library = graph.libraries[i];
+        shard_job& job = jobs[i + 1u];
+        job.shard.prefix = library.node->get_path();
+        job.shard.file_name = job.shard.prefix + suffix;
+        job.node = library.node;
+        jobs[0].excluded.push_back(library.node);
+
+        dep_node const* parent = library.node->get_parent();
+        std::size_t parent_library = graph.find_library(parent);
+        if (parent_library != static_cast< std::size_t >(-1))
+            jobs[parent_library + 1u].excluded.push_back(library.node);
+    }
+
+    // Create the directories beforehand, so that the worker threads don't race creating them
+    boost::filesystem::create_directories(dir);
+    for (std::vector< shard_job >::const_iterator it = jobs.begin(), end = jobs.end(); it != end; ++it)
+    {
+        boost::filesystem::path parent_dir = (dir / it->shard.file_name).parent_path();
+        if (parent_dir != dir)
+            boost::filesystem::create_directories(parent_dir);
+    }
+
+    shard_writer writer(dir, jobs);
+    writer.write(thread_count);
+
+    std::sort(jobs.begin(), jobs.end(), order_by_prefix());
+    write_shard_index(jobs, dir / shard_index_file_name);
+}
+
+//! Reads the shard index in the directory
+sharded_dep_tree::sharded_dep_tree(boost::filesystem::path const& dir) : m_dir(dir)
+{
+    boost::filesystem::path index_path = dir / shard_index_file_name;
+    std::string index_path_str = index_path.string();
+    try
+    {
+        decompressing_ifstream file(index_path);
+        boost::property_tree::ptree index;
+        boost::property_tree::read_json(file, index);
+
+        if (index.get< std::string >("format") != shard_index_format)
+            BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Unsupported shard index format")) << file_name_info(index_path_str));
+
+        boost::property_tree::ptree const& shards = index.get_child("shards");
+        for (boost::property_tree::ptree::const_iterator it = shards.begin(), end = shards.end(); it != end; ++it)
+        {
+            json_shard shard;
+            shard.prefix = it->second.get< std::string >("prefix");
+            shard.file_name = it->second.get< std::string >("file");
+            m_shards.push_back(shard);
+        }
+    }
+    catch (boost::property_tree::ptree_error& e)
+    {
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error(std::string("Failed to read shard index: ") + e.what())) << file_name_info(index_path_str));
+    }
+
+    std::sort(m_shards.begin(), m_shards.end(), order_by_prefix());
+    m_loaded.resize(m_shards.size(), false);
+}
+
+//! Returns the index of the shard that contains the node with the specified path
+std::size_t sharded_dep_tree::find_shard(boost::string_ref const& path) const BOOST_NOEXCEPT
+{
+    // The longest matching prefix wins, the shards are ordered so that the longer prefixes follow the shorter ones
+    std::size_t found = static_cast< std::size_t >(-1);
+    for (std::size_t i = 0, n = m_shards.size(); i < n; ++i)
+    {
+        std::string const& prefix = m_shards[i].prefix;
+        if (prefix.empty() || (path.starts_with(prefix) && (path.size() == prefix.size() || path[prefix.size()] == dep_node::default_node_separator)))
+            found = i;
+    }
+
+    return found;
+}
+
+//! Loads the shard, if it is not loaded yet
+void sharded_dep_tree::load_shard(std::size_t shard)
+{
+    if (m_loaded[shard])
+        return;
+
+    boost::filesystem::path path = m_dir / m_shards[shard].file_name;
+    trace_span span("parse", "load_shard", path);
+    try
+    {
+        decompressing_ifstream file(path);
+        parse_json(file, m_root);
+    }
+    catch (boost::exception& e)
+    {
+        e << file_name_info(path.string());
+        throw;
+    }
+
+    m_loaded[shard] = true;
+}
+
+//! Loads all shards
+void sharded_dep_tree::load_all()
+{
+    for (std::size_t i = 0, n = m_shards.size(); i < n; ++i)
+        load_shard(i);
+}
+
+//! Returns the node with the specified path
+dep_node* sharded_dep_tree::find_node(boost::string_ref const& path)
+{
+    std::size_t shard = find_shard(path);
+    if (shard != static_cast< std::size_t >(-1))
+        load_shard(shard);
+
+    return m_root.navigate(path);
+}
@@ -0,0 +1,165 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the library dependency graph
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/system/error_code.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <library_graph.hpp>
+#include <graph_algorithms.hpp>
+#include <node_attributes.hpp>
+
+const char libraries_root_name[] = "libs";
+
+namespace {
+
+const char include_dir_name[] = "include";
+
+//! Assigns all nodes of the subtree to the library
+void assign_library(dep_node const& node, std::size_t library, library_graph& graph)
+{
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+    {
+        graph.node_libraries[&*it] = library;
+        assign_library(*it, library, graph);
+    }
+}
+
+//! Detects libraries in the directory and assigns the nodes to libraries
+void find_libraries(dep_node& node, std::string const& name_prefix, std::size_t current_library, library_graph& graph)
+{
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+    {
+        dep_node& child = const_cast< dep_node& >(*it);
+        if (current_library != static_cast< std::size_t >(-1) && child.get_name() == include_dir_name)
+        {
+            // Headers never contain nested libraries
+            graph.node_libraries[&child] = current_library;
+            assign_library(child, current_library, graph);
+            continue;
+        }
+
+        std::size_t child_library = current_library;
+        std::string child_name = name_prefix + child.get_name();
+        if (child.get_child(include_dir_name) != NULL)
+        {
+            child_library = graph.libraries.size();
+            graph.libraries.push_back(library_graph::library(child_name, &child));
+        }
+
+        if (child_library != static_cast< std::size_t >(-1))
+            graph.node_libraries[&child] = child_library;
+
+        // Libraries may have nested libraries, e.g. libs/numeric/conversion is nested in libs/numeric, so the descent continues into libraries
+        if (!child.get_children().empty())
+        {
+            child_name.push_back(dep_node::default_node_separator);
+            find_libraries(child, child_name, child_library, graph);
+        }
+    }
+}
+
+//! Sums the sizes of the files in the subtree. Nested libraries are not counted.
+boost::uintmax_t compute_subtree_size(dep_node const& node, boost::filesystem::path const& path, std::size_t library, library_graph const& graph)
+{
+    if (node.get_children().empty())
+    {
+        // The size collected on scanning saves a stat call per file
+        node_attributes const& attributes = node.get_attributes();
+        if (attributes.file_size.has(node.get_id()))
+            return attributes.file_size.get(node.get_id());
+
+        boost::system::error_code ec;
+        boost::uintmax_t size = boost::filesystem::file_size(path, ec);
+        return ec ? 0u : size;
+    }
+
+    boost::uintmax_t size = 0u;
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+    {
+        if (graph.find_library(&*it) == library)
+            size += compute_subtree_size(*it, path / it->get_name(), library, graph);
+    }
+
+    return size;
+}
+
+} // namespace
+
+//! The function stores the libraries of the nodes in the library attribute of the tree
+void assign_library_attributes(library_graph const& graph, node_attributes& attributes)
+{
+    for (boost::unordered_map< dep_node const*, std::size_t >::const_iterator it = graph.node_libraries.begin(), end = graph.node_libraries.end(); it != end; ++it)
+    {
+        attributes.set_library(it->first->get_id(), graph.libraries[it->second].name);
+    }
+}
+
+//! The function detects libraries in the tree and builds the graph of dependencies between them
+void build_library_graph(dep_tree& root, library_graph& graph)
+{
+    graph.libraries.clear();
+    graph.node_libraries.clear();
+
+    dep_node* libs = root.get_child(libraries_root_name);
+    if (!libs)
+        return;
+
+    std::string name_prefix;
+    find_libraries(*libs, name_prefix, static_cast< std::size_t >(-1), graph);
+
+    for (boost::unordered_map< dep_node const*, std::size_t >::const_iterator it = graph.node_libraries.begin(), end = graph.node_libraries.end(); it != end; ++it)
+    {
+        std::vector< std::size_t >& library_deps = graph.libraries[it->second].dependencies;
+        dep_node::nodes const& deps = it->first->get_dependencies();
+        for (dep_node::nodes::const_iterator dep_it = deps.begin(), dep_end = deps.end(); dep_it != dep_end; ++dep_it)
+        {
+            std::size_t dep_library = graph.find_library(*dep_it);
+            if (dep_library != static_cast< std::size_t >(-1) && dep_library != it->second)
+                library_deps.push_back(dep_library);
+        }
+    }
+
+    for (std::vector< library_graph::library >::iterator it = graph.libraries.begin(), end = graph.libraries.end(); it != end; ++it)
+    {
+        std::sort(it->dependencies.begin(), it->dependencies.end());
+        it->dependencies.erase(std::unique(it->dependencies.begin(), it->dependencies.end()), it->dependencies.end());
+    }
+}
+
+//! The function removes the dependencies between libraries that are implied by other dependencies
+void reduce_library_dependencies(library_graph& graph, unsigned int thread_count)
+{
+    adjacency_list library_deps;
+    library_deps.reserve(graph.libraries.size());
+    for (std::vector< library_graph::library >::const_iterator it = graph.libraries.begin(), end = graph.libraries.end(); it != end; ++it)
+        library_deps.push_back(it->dependencies);
+
+    reduce_transitive_edges(library_deps, thread_count);
+
+    for (std::size_t i = 0, n = graph.libraries.size(); i < n; ++i)
+        graph.libraries[i].dependencies.swap(library_deps[i]);
+}
+
+//! The function computes the total size of the files of every library, in bytes
+std::vector< boost::uintmax_t > compute_library_sizes(library_graph const& graph, boost::filesystem::path const& boost_root)
+{
+    std::vector< boost::uintmax_t > sizes;
+    sizes.reserve(graph.libraries.size());
+    for (std::size_t i = 0, n = graph.libraries.size(); i < n; ++i)
+    {
+        library_graph::library const& lib = graph.libraries[i];
+        sizes.push_back(compute_subtree_size(*lib.node, boost_root / libraries_root_name / lib.name, i, graph));
+    }
+
+    return sizes;
+}
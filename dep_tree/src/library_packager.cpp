@@ -0,0 +1,538 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of packaging the files of every library into an archive
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <exception>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/exception/get_error_info.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <library_packager.hpp>
+#include <cxx_parser.hpp>
+#include <trace.hpp>
+#include <work_queue.hpp>
+#include <file_descriptor.hpp>
+#if !defined(BOOST_WINDOWS)
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#endif
+
+namespace {
+
+const std::size_t tar_block_size = 512u;
+//! The maximum length of the file name and the file name prefix in the ustar header
+const std::size_t tar_name_size = 100u;
+const std::size_t tar_prefix_size = 155u;
+
+//! The file to add to the archive
+struct archived_file
+{
+    //! The file name in the archive
+    std::string name;
+    boost::uintmax_t size;
+    unsigned int mode;
+    boost::int64_t mtime;
+
+    archived_file() : size(0u), mode(0644u), mtime(0) {}
+};
+
+//! Writes the number in octal to the header field, terminated with a zero character
+void put_octal(char* field, std::size_t size, boost::uintmax_t value)
+{
+    field[size - 1u] = '\0';
+    for (std::size_t i = size - 1u; i > 0u; --i)
+    {
+        field[i - 1u] = static_cast< char >('0' + (value & 7u));
+        value >>= 3u;
+    }
+
+    if (value != 0u)
+        BOOST_THROW_EXCEPTION(std::invalid_argument("The value does not fit into the tar header"));
+}
+
+//! Fills the ustar header block. Returns \c false if the name does not fit into the header.
+bool fill_tar_header(char* block, std::string const& name, boost::uintmax_t size, unsigned int mode, boost::int64_t mtime, char type)
+{
+    std::memset(block, 0, tar_block_size);
+
+    // Long names are split into the prefix and the name at a path separator
+    bool name_fits = true;
+    if (name.size() <= tar_name_size)
+    {
+        std::memcpy(block, name.data(), name.size());
+    }
+    else
+    {
+        std::string::size_type pos = name.rfind('/', tar_prefix_size);
+        if (pos != std::string::npos && pos > 0u && name.size() - pos - 1u > 0u && name.size() - pos - 1u <= tar_name_size)
+        {
+            std::memcpy(block, name.data() + pos + 1u, name.size() - pos - 1u);
+            std::memcpy(block + 345, name.data(), pos);
+        }
+        else
+        {
+            std::memcpy(block, name.data(), tar_name_size);
+            name_fits = false;
+        }
+    }
+
+    put_octal(block + 100, 8u, mode & 07777u);
+    put_octal(block + 108, 8u, 0u);
+    put_octal(block + 116, 8u, 0u);
+    put_octal(block + 124, 12u, size);
+    put_octal(block + 136, 12u, mtime > 0 ? static_cast< boost::uintmax_t >(mtime) : 0u);
+    block[156] = type;
+    std::memcpy(block + 257, "ustar", 6u);
+    block[263] = '0';
+    block[264] = '0';
+
+    // The checksum is calculated with the checksum field filled with spaces
+    std::memset(block + 148, ' ', 8u);
+    unsigned int checksum = 0u;
+    for (std::size_t i = 0; i < tar_block_size; ++i)
+        checksum += static_cast< unsigned char >(block[i]);
+    put_octal(block + 148, 7u, checksum);
+
+    return name_fits;
+}
+
+//! Makes the pax extended header record of the path
+std::string make_pax_path_record(std::string const& name)
+{
+    // The record length includes the length of its own decimal representation
+    const std::size_t base_size = sizeof(" path=\n") - 1u + name.size();
+    std::size_t size = base_size + 1u;
+    while (boost::lexical_cast< std::string >(size).size() + base_size != size)
+        size = boost::lexical_cast< std::string >(size).size() + base_size;
+
+    return boost::lexical_cast< std::string >(size) + " path=" + name + "\n";
+}
+
+//! Writes the tar archive. The data is written to the file directly, unless compressed.
+class tar_writer
+{
+private:
+    boost::scoped_ptr< compressed_ofstream > m_stream;
+#if !defined(BOOST_WINDOWS)
+    int m_fd;
+#endif
+    std::vector< char > m_buffer;
+    boost::uintmax_t m_sent_bytes;
+
+public:
+    tar_writer(boost::filesystem::path const& path, compression_format compression) :
+#if !defined(BOOST_WINDOWS)
+        m_fd(-1),
+#endif
+        m_buffer(64u * 1024u),
+        m_sent_bytes(0u)
+    {
+#if !defined(BOOST_WINDOWS)
+        if (compression == no_compression)
+        {
+            m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (m_fd < 0)
+                throw_system_error("Failed to create file");
+            return;
+        }
+#endif
+        m_stream.reset(new compressed_ofstream(path, compression));
+    }
+
+    ~tar_writer()
+    {
+#if !defined(BOOST_WINDOWS)
+        if (m_fd >= 0)
+            ::close(m_fd);
+#endif
+    }
+
+    //! Returns the number of bytes that were copied by the kernel
+    boost::uintmax_t get_sent_bytes() const { return m_sent_bytes; }
+
+    /*!
+     * Adds the file to the archive with the specified name. Returns \c false and leaves the archive intact if the file is not
+     * a regular file. Otherwise returns \c true and the file size in \a size.
+     */
+    bool add_file(boost::filesystem::path const& path, std::string const& name, boost::uintmax_t& size)
+    {
+        archived_file file;
+        file.name = name;
+
+#if !defined(BOOST_WINDOWS)
+        int from_fd = ::open(path.c_str(), O_RDONLY);
+        if (from_fd < 0)
+            throw_system_error("Failed to open file");
+        file_descriptor_guard from_guard(from_fd);
+
+        struct stat from_stat;
+        if (::fstat(from_fd, &from_stat) != 0)
+            throw_system_error("Failed to read file status");
+        if (!S_ISREG(from_stat.st_mode))
+            return false;
+
+        file.size = static_cast< boost::uintmax_t >(from_stat.st_size);
+        file.mode = static_cast< unsigned int >(from_stat.st_mode);
+        file.mtime = static_cast< boost::int64_t >(from_stat.st_mtime);
+        write_header(file);
+
+        boost::uintmax_t copied = 0u;
+        if (m_fd >= 0)
+            copied = send_data(from_fd, file.size);
+
+        while (copied < file.size)
+        {
+            ssize_t n = ::read(from_fd, &m_buffer[0], static_cast< std::size_t >(std::min< boost::uintmax_t >(m_buffer.size(), file.size - copied)));
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw_system_error("Failed to read file");
+            }
+            if (n == 0)
+                break;
+            write(&m_buffer[0], static_cast< std::size_t >(n));
+            copied += static_cast< boost::uintmax_t >(n);
+        }
+#else
+        if (!boost::filesystem::is_regular_file(path))
+            return false;
+
+        std::string path_str = path.string();
+        std::ifstream from(path_str.c_str(), std::ios::in | std::ios::binary);
+        if (!from.is_open())
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open file"));
+
+        file.size = boost::filesystem::file_size(path);
+        file.mtime = static_cast< boost::int64_t >(boost::filesystem::last_write_time(path));
+        write_header(file);
+
+        boost::uintmax_t copied = 0u;
+        while (copied < file.size)
+        {
+            from.read(&m_buffer[0], static_cast< std::streamsize >(std::min< boost::uintmax_t >(m_buffer.size(), file.size - copied)));
+            std::streamsize n = from.gcount();
+            if (n <= 0)
+                break;
+            write(&m_buffer[0], static_cast< std::size_t >(n));
+            copied += static_cast< boost::uintmax_t >(n);
+        }
+#endif
+
+        // The header has already been written, so the file data must match it
+        if (copied != file.size)
+            BOOST_THROW_EXCEPTION(std::runtime_error("The file was modified while being archived"));
+
+        write_padding(file.size);
+        size = file.size;
+        return true;
+    }
+
+    //! Writes the end of the archive and closes the file
+    void close()
+    {
+        std::memset(&m_buffer[0], 0, tar_block_size * 2u);
+        write(&m_buffer[0], tar_block_size * 2u);
+
+#if !defined(BOOST_WINDOWS)
+        if (m_fd >= 0)
+        {
+            int fd = m_fd;
+            m_fd = -1;
+            if (::close(fd) != 0)
+                throw_system_error("Failed to write file");
+            return;
+        }
+#endif
+        m_stream->close();
+    }
+
+private:
+    void write(const char* data, std::size_t size)
+    {
+#if !defined(BOOST_WINDOWS)
+        if (m_fd >= 0)
+        {
+            write_data(m_fd, data, size);
+            return;
+        }
+#endif
+        m_stream->write(data, static_cast< std::streamsize >(size));
+        if (!m_stream->good())
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to write file"));
+    }
+
+    void write_header(archived_file const& file)
+    {
+        char block[tar_block_size];
+        if (!fill_tar_header(block, file.name, file.size, file.mode, file.mtime, '0'))
+        {
+            // The names that don't fit into the ustar header are stored in the pax extended header preceding the file header
+            std::string record = make_pax_path_record(file.name);
+            char pax_block[tar_block_size];
+            fill_tar_header(pax_block, "PaxHeader", record.size(), 0644u, file.mtime, 'x');
+            write(pax_block, tar_block_size);
+            write(record.data(), record.size());
+            write_padding(record.size());
+        }
+        write(block, tar_block_size);
+    }
+
+    void write_padding(boost::uintmax_t size)
+    {
+        std::size_t padding = static_cast< std::size_t >((tar_block_size - size % tar_block_size) % tar_block_size);
+        if (padding > 0u)
+        {
+            char zeros[tar_block_size] = {};
+            write(zeros, padding);
+        }
+    }
+
+#if !defined(BOOST_WINDOWS)
+    //! Copies the file data to the archive in the kernel. Returns the number of bytes copied, which may be less than requested if not supported.
+    boost::uintmax_t send_data(int from_fd, boost::uintmax_t size)
+    {
+        boost::uintmax_t copied = 0u;
+#if defined(BOOST_PKG_DEP_TREE_HAS_COPY_FILE_RANGE)
+        while (copied < size)
+        {
+            ssize_t n = ::copy_file_range(from_fd, NULL, m_fd, NULL, static_cast< std::size_t >(size - copied), 0u);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (is_not_supported(errno))
+                    break;
+                throw_system_error("Failed to copy file");
+            }
+            if (n == 0)
+                break;
+            copied += static_cast< boost::uintmax_t >(n);
+        }
+#endif
+#if defined(__linux__)
+        while (copied < size)
+        {
+            ssize_t n = ::sendfile(m_fd, from_fd, NULL, static_cast< std::size_t >(size - copied));
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (is_not_supported(errno))
+                    break;
+                throw_system_error("Failed to copy file");
+            }
+            if (n == 0)
+                break;
+            copied += static_cast< boost::uintmax_t >(n);
+        }
+#endif
+        m_sent_bytes += copied;
+        return copied;
+    }
+#endif // !defined(BOOST_WINDOWS)
+
+    BOOST_DELETED_FUNCTION(tar_writer(tar_writer const&))
+    BOOST_DELETED_FUNCTION(tar_writer& operator=(tar_writer const&))
+};
+
+//! Library to package
+struct package_job
+{
+    std::size_t library;
+    //! The library files, ordered by path
+    std::vector< std::string > files;
+};
+
+//! Orders the jobs so that the libraries with the most files are packaged first, which balances the load of the threads
+inline bool order_by_file_count(package_job const& left, package_job const& right)
+{
+    if (left.files.size() != right.files.size())
+        return left.files.size() > right.files.size();
+    return left.library < right.library;
+}
+
+const char* get_archive_extension(compression_format compression)
+{
+    switch (compression)
+    {
+    case gzip_compression:
+        return ".tar.gz";
+    case zstd_compression:
+        return ".tar.zst";
+    default:
+        return ".tar";
+    }
+}
+
+//! The class creates the packages concurrently
+class library_packager
+{
+private:
+    library_graph const& m_graph;
+    package_params const& m_params;
+    std::vector< package_job > const& m_jobs;
+    work_queue m_queue;
+    boost::mutex m_mutex;
+    package_stats m_stats;
+
+public:
+    library_packager(library_graph const& graph, package_params const& params, std::vector< package_job > const& jobs) :
+        m_graph(graph),
+        m_params(params),
+        m_jobs(jobs),
+        m_queue(jobs.size())
+    {
+    }
+
+    void package(unsigned int thread_count, package_stats& stats)
+    {
+        m_queue.run(thread_count, "library packager", boost::bind(&library_packager::package_libraries, this));
+        stats = m_stats;
+    }
+
+private:
+    //! Worker thread function
+    void package_libraries()
+    {
+        package_stats stats;
+        std::size_t i;
+        while (m_queue.pop(i))
+            package_library(m_jobs[i], stats);
+
+        boost::lock_guard< boost::mutex > lock(m_mutex);
+        m_stats.libraries += stats.libraries;
+        m_stats.files += stats.files;
+        m_stats.bytes += stats.bytes;
+        m_stats.sent_bytes += stats.sent_bytes;
+    }
+
+    void package_library(package_job const& job, package_stats& stats)
+    {
+        library_graph::library const& library = m_graph.libraries[job.library];
+        trace_span span("package", "package_library", library.name);
+
+        std::string package_name = make_package_name(library.name);
+        std::string archive_name = package_name + get_archive_extension(m_params.compression);
+
+        std::string manifest;
+        manifest.append("{\n\t\"name\": \"").append(library.name).append("\",\n\t\"archive\": \"").append(archive_name).append("\",\n\t\"dependencies\":\n\t[");
+        for (std::vector< std::size_t >::const_iterator it = library.dependencies.begin(), end = library.dependencies.end(); it != end; ++it)
+        {
+            if (it != library.dependencies.begin())
+                manifest.push_back(',');
+            manifest.append("\n\t\t\"").append(m_graph.libraries[*it].name).append("\"");
+        }
+        manifest.append("\n\t],\n\t\"files\":\n\t[");
+
+        boost::filesystem::path archive_path = m_params.target_dir / archive_name;
+        std::string archive_path_str = archive_path.string();
+        try
+        {
+            tar_writer archive(archive_path, m_params.compression);
+            bool first = true;
+            for (std::vector< std::string >::const_iterator it = job.files.begin(), end = job.files.end(); it != end; ++it)
+            {
+                boost::uintmax_t size = 0u;
+                try
+                {
+                    if (!archive.add_file(m_params.boost_root / *it, *it, size))
+                        continue;
+                }
+                catch (boost::exception& e)
+                {
+                    e << file_name_info((m_params.boost_root / *it).string());
+                    throw;
+                }
+
+                if (!first)
+                    manifest.push_back(',');
+                first = false;
+                manifest.append("\n\t\t{\n\t\t\t\"path\": \"").append(*it).append("\",\n\t\t\t\"size\": ").append(boost::lexical_cast< std::string >(size)).append("\n\t\t}");
+
+                ++stats.files;
+                stats.bytes += size;
+            }
+            archive.close();
+            stats.sent_bytes += archive.get_sent_bytes();
+        }
+        catch (boost::exception& e)
+        {
+            if (!boost::get_error_info< file_name_info >(e))
+                e << file_name_info(archive_path_str);
+            throw;
+        }
+
+        manifest.append("\n\t]\n}\n");
+
+        std::string manifest_path_str = (m_params.target_dir / (package_name + ".json")).string();
+        std::ofstream file(manifest_path_str.c_str(), std::ios::out | std::ios::trunc);
+        if (!file.is_open())
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open output file: " + manifest_path_str));
+        file.write(manifest.data(), manifest.size());
+        if (!file.good())
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to write output file: " + manifest_path_str));
+
+        ++stats.libraries;
+    }
+};
+
+} // namespace
+
+//! Returns the package name of the library
+std::string make_package_name(std::string const& library_name)
+{
+    std::string package_name = library_name;
+    std::replace(package_name.begin(), package_name.end(), '/', '_');
+    return package_name;
+}
+
+//! The function creates a package for every library in the target directory
+void package_libraries(library_graph const& graph, package_params const& params, package_stats& stats)
+{
+    trace_span span("package", "package_libraries", params.target_dir);
+    stats = package_stats();
+
+    std::vector< package_job > jobs(graph.libraries.size());
+    for (std::size_t i = 0, n = graph.libraries.size(); i < n; ++i)
+        jobs[i].library = i;
+    for (boost::unordered_map< dep_node const*, std::size_t >::const_iterator it = graph.node_libraries.begin(), end = graph.node_libraries.end(); it != end; ++it)
+    {
+        if (it->first->get_children().empty())
+            jobs[it->second].files.push_back(it->first->get_path());
+    }
+    for (std::vector< package_job >::iterator it = jobs.begin(), end = jobs.end(); it != end; ++it)
+        std::sort(it->files.begin(), it->files.end());
+    std::sort(jobs.begin(), jobs.end(), &order_by_file_count);
+
+    boost::filesystem::create_directories(params.target_dir);
+
+    library_packager packager(graph, params, jobs);
+    packager.package(params.thread_count, stats);
+}
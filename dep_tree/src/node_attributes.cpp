@@ -0,0 +1,62 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the per-node attributes of the dependency tree
+ */
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <node_attributes.hpp>
+
+namespace {
+
+//! Copies the column value, if the source node has it
+template< typename T >
+inline void copy_value(attribute_column< T > const& from, std::size_t from_id, attribute_column< T >& to, std::size_t to_id)
+{
+    if (from.has(from_id))
+        to.set(to_id, from.get(from_id));
+}
+
+} // namespace
+
+//! Returns \c true if no node has any attributes
+bool node_attributes::empty() const
+{
+    return file_size.empty() && line_count.empty() && mtime.empty() && content_hash.empty() && library.empty() && parse_time.empty();
+}
+
+//! Checks if the node has any attributes
+bool node_attributes::has_any(std::size_t id) const
+{
+    return file_size.has(id) || line_count.has(id) || mtime.has(id) || content_hash.has(id) || library.has(id) || parse_time.has(id);
+}
+
+//! Sets the library of the node, by name
+void node_attributes::set_library(std::size_t id, std::string const& name)
+{
+    std::pair< boost::unordered_map< std::string, boost::uint32_t >::iterator, bool > res =
+        m_library_indices.insert(std::make_pair(name, static_cast< boost::uint32_t >(m_library_names.size())));
+    if (res.second)
+        m_library_names.push_back(name);
+    library.set(id, res.first->second);
+}
+
+//! Copies the attributes of the node from another set of attributes
+void node_attributes::copy_node(node_attributes const& from, std::size_t from_id, std::size_t to_id)
+{
+    copy_value(from.file_size, from_id, file_size, to_id);
+    copy_value(from.line_count, from_id, line_count, to_id);
+    copy_value(from.mtime, from_id, mtime, to_id);
+    copy_value(from.content_hash, from_id, content_hash, to_id);
+    copy_value(from.parse_time, from_id, parse_time, to_id);
+
+    // The library names are indexed differently in every set of attributes
+    if (from.library.has(from_id))
+        set_library(to_id, from.get_library_name(from.library.get(from_id)));
+}
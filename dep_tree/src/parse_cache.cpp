@@ -0,0 +1,183 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the cache of the C++ parsing results
+ */
+
+#include <cstddef>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <parse_cache.hpp>
+
+namespace {
+
+//! The common prefix of the file signatures of all versions
+const char cache_file_signature_prefix[] = "boost-pkg parse cache ";
+//! The file format version. The signature also contains the lexer version, since the cached includes depend on it.
+const unsigned int cache_file_format_version = 3u;
+
+//! Returns the file signature for the current file format and lexer versions
+std::string make_cache_file_signature()
+{
+    std::ostringstream strm;
+    strm << cache_file_signature_prefix << cache_file_format_version << " lexer " << cxx_lexer_version;
+    return strm.str();
+}
+
+//! Writes the cache records to the file
+template< typename EntriesT >
+void write_entries(std::ostream& file, EntriesT const& entries)
+{
+    for (typename EntriesT::const_iterator it = entries.begin(), end = entries.end(); it != end; ++it)
+    {
+        file << to_hex_string(it->first) << ' ' << it->second.size() << '\n';
+        for (parse_cache::includes::const_iterator inc_it = it->second.begin(), inc_end = it->second.end(); inc_it != inc_end; ++inc_it)
+            file << (inc_it->is_quoted ? 'q' : 'a') << ' ' << inc_it->header.size() << ' ' << inc_it->header << '\n';
+    }
+}
+
+} // namespace
+
+parse_cache::parse_cache() : m_modified(false)
+{
+}
+
+//! Looks up the include directives for the file content. Returns \c true if the content is found in the cache.
+bool parse_cache::find(content_digest const& digest, includes& incs) const
+{
+    entries::const_iterator it = m_entries.find(digest);
+    if (it == m_entries.end())
+        return false;
+
+    incs = it->second;
+    return true;
+}
+
+//! Adds the include directives for the file content
+void parse_cache::insert(content_digest const& digest, includes const& incs)
+{
+    if (m_entries.insert(entries::value_type(digest, incs)).second)
+        m_modified = true;
+}
+
+//! Looks up the include directives for the file content by its git object identifier. Returns \c true if the content is found in the cache.
+bool parse_cache::find(git_object_id const& id, includes& incs) const
+{
+    object_entries::const_iterator it = m_object_entries.find(id);
+    if (it == m_object_entries.end())
+        return false;
+
+    incs = it->second;
+    return true;
+}
+
+//! Adds the include directives for the file content with the git object identifier
+void parse_cache::insert(git_object_id const& id, includes const& incs)
+{
+    if (m_object_entries.insert(object_entries::value_type(id, incs)).second)
+        m_modified = true;
+}
+
+//! Loads the cache from the file. The loaded entries are added to the cache. Does nothing if the file does not exist.
+void parse_cache::load(boost::filesystem::path const& path)
+{
+    std::string path_str = path.string();
+    std::ifstream file(path_str.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return;
+
+    // Each record has the following format:
+    //
+    // <digest> <number of includes>\n
+    // <q|a> <header length> <header>\n
+    // ...
+    //
+    // where q and a designate quoted and angle bracket includes, respectively. The digest is either the content digest or
+    // the git object identifier, which are distinguished by length.
+    std::string line;
+    if (!std::getline(file, line) || line.compare(0u, sizeof(cache_file_signature_prefix) - 1u, cache_file_signature_prefix) != 0)
+        BOOST_THROW_EXCEPTION(std::runtime_error("Invalid parse cache file: " + path_str));
+
+    // The files written with a different format or lexer version may have stale includes, so they are discarded and then overwritten on saving
+    if (line != make_cache_file_signature())
+        return;
+
+    const bool was_modified = m_modified;
+    std::string digest_str;
+    std::size_t count = 0;
+    includes incs;
+    while (file >> digest_str >> count)
+    {
+        content_digest digest;
+        git_object_id id;
+        const bool is_object_id = from_hex_string(digest_str, id);
+        if (!is_object_id && !from_hex_string(digest_str, digest))
+            BOOST_THROW_EXCEPTION(std::runtime_error("Invalid parse cache file: " + path_str));
+
+        incs.clear();
+        incs.resize(count);
+        for (includes::iterator it = incs.begin(), end = incs.end(); it != end; ++it)
+        {
+            char kind = 0;
+            std::size_t len = 0;
+            if (!(file >> kind >> len) || (kind != 'q' && kind != 'a') || file.get() != ' ')
+                BOOST_THROW_EXCEPTION(std::runtime_error("Invalid parse cache file: " + path_str));
+
+            it->is_quoted = kind == 'q';
+            it->header.resize(len);
+            if (len > 0 && !file.read(&it->header[0], len))
+                BOOST_THROW_EXCEPTION(std::runtime_error("Invalid parse cache file: " + path_str));
+        }
+
+        if (is_object_id)
+            m_object_entries.insert(object_entries::value_type(id, incs));
+        else
+            m_entries.insert(entries::value_type(digest, incs));
+    }
+
+    if (!file.eof())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Invalid parse cache file: " + path_str));
+
+    m_modified = was_modified;
+}
+
+//! Saves the cache to the file. The entries that are already stored in the file are preserved, so the file can be shared between runs.
+void parse_cache::save(boost::filesystem::path const& path)
+{
+    // Pick up the entries that were added to the file by other processes since we loaded it
+    load(path);
+
+    // Write to a temporary file first and then atomically replace the cache file, so that concurrent readers never see a partially written file
+    boost::filesystem::path temp_path = path;
+    temp_path += boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp");
+    std::string temp_path_str = temp_path.string();
+
+    {
+        std::ofstream file(temp_path_str.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!file.is_open())
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open parse cache file: " + temp_path_str));
+
+        file << make_cache_file_signature() << '\n';
+        write_entries(file, m_entries);
+        write_entries(file, m_object_entries);
+
+        file.close();
+        if (!file)
+        {
+            boost::filesystem::remove(temp_path);
+            BOOST_THROW_EXCEPTION(std::runtime_error("Failed to write parse cache file: " + temp_path_str));
+        }
+    }
+
+    boost::filesystem::rename(temp_path, path);
+    m_modified = false;
+}
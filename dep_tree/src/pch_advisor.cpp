@@ -0,0 +1,329 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of recommending precompiled headers
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <queue>
+#include <utility>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <pch_advisor.hpp>
+#include <cxx_parser.hpp>
+#include <node_attributes.hpp>
+
+namespace {
+
+//! Header dependency graph, reachable from the translation units
+struct header_graph
+{
+    std::vector< dep_node const* > nodes;
+    std::vector< std::vector< std::size_t > > dependencies;
+    std::vector< boost::uintmax_t > sizes;
+    boost::unordered_map< dep_node const*, std::size_t > node_indices;
+
+    //! Returns the node index, adds the node to the graph if needed
+    std::size_t add_node(dep_node const* node, pch_params const& params)
+    {
+        std::pair< boost::unordered_map< dep_node const*, std::size_t >::iterator, bool > res = node_indices.insert(std::make_pair(node, nodes.size()));
+        if (res.second)
+        {
+            nodes.push_back(node);
+            dependencies.push_back(std::vector< std::size_t >());
+
+            node_attributes const& attributes = node->get_attributes();
+            if (attributes.file_size.has(node->get_id()))
+            {
+                sizes.push_back(attributes.file_size.get(node->get_id()));
+            }
+            else
+            {
+                boost::system::error_code ec;
+                boost::uintmax_t size = boost::filesystem::file_size(make_file_path(node->get_path(), params.boost_root, params.external_root), ec);
+                sizes.push_back(ec ? 0u : size);
+            }
+        }
+        return res.first->second;
+    }
+};
+
+//! Collects the nodes reachable from the node, including the node itself
+void collect_reachable(header_graph const& graph, std::size_t start, std::vector< std::size_t >& visit_marks, std::size_t mark, std::vector< std::size_t >& reachable)
+{
+    reachable.clear();
+    reachable.push_back(start);
+    visit_marks[start] = mark;
+    for (std::size_t i = 0; i < reachable.size(); ++i)
+    {
+        std::vector< std::size_t > const& deps = graph.dependencies[reachable[i]];
+        for (std::vector< std::size_t >::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            if (visit_marks[*it] != mark)
+            {
+                visit_marks[*it] = mark;
+                reachable.push_back(*it);
+            }
+        }
+    }
+}
+
+//! Selection candidate
+struct candidate
+{
+    std::size_t header;
+    boost::uintmax_t gain;
+    //! The number of selected headers when the gain was computed
+    std::size_t selection_count;
+
+    candidate(std::size_t h, boost::uintmax_t g, std::size_t n) : header(h), gain(g), selection_count(n) {}
+
+    bool operator< (candidate const& that) const
+    {
+        // Prefer the lower index in case of equal gain for stable results
+        return gain < that.gain || (gain == that.gain && header > that.header);
+    }
+};
+
+//! Orders headers by descending score
+struct order_by_score
+{
+    typedef bool result_type;
+
+    result_type operator() (pch_header const& left, pch_header const& right) const
+    {
+        boost::uintmax_t left_score = left.fan_in * left.weight, right_score = right.fan_in * right.weight;
+        return left_score > right_score || (left_score == right_score && left.node->get_path() < right.node->get_path());
+    }
+};
+
+void serialize_header(pch_header const& header, bool with_score, std::string const& newline_indent, std::string const& indent, std::string& strm)
+{
+    std::string nested_newline_indent = newline_indent + indent;
+    const char* space = newline_indent.empty() ? "" : " ";
+
+    strm.append(newline_indent).append(1, '{');
+    strm.append(nested_newline_indent).append("\"header\":").append(space).append(1, '"').append(header.node->get_path()).append("\",");
+    strm.append(nested_newline_indent).append("\"fan_in\":").append(space).append(boost::lexical_cast< std::string >(header.fan_in)).append(1, ',');
+    strm.append(nested_newline_indent).append("\"weight\":").append(space).append(boost::lexical_cast< std::string >(header.weight)).append(1, ',');
+    if (with_score)
+        strm.append(nested_newline_indent).append("\"score\":").append(space).append(boost::lexical_cast< std::string >(header.fan_in * header.weight)).append(1, ',');
+    strm.append(nested_newline_indent).append("\"gain\":").append(space).append(boost::lexical_cast< std::string >(header.gain));
+    strm.append(newline_indent).append(1, '}');
+}
+
+void serialize_header_list(std::vector< pch_header > const& headers, bool with_score, std::string const& newline_indent, std::string const& indent, std::string& strm)
+{
+    strm.append(newline_indent).append(1, '[');
+    for (std::vector< pch_header >::const_iterator it = headers.begin(), end = headers.end(); it != end; ++it)
+    {
+        if (it != headers.begin())
+            strm.push_back(',');
+        serialize_header(*it, with_score, newline_indent + indent, indent, strm);
+    }
+    strm.append(newline_indent).append(1, ']');
+}
+
+} // namespace
+
+//! The function recommends a set of headers to precompile for the translation units
+void recommend_pch(std::vector< dep_node* > const& translation_units, pch_params const& params, pch_recommendation& result)
+{
+    result = pch_recommendation();
+    result.budget = params.budget;
+
+    // Build the graph of the headers reachable from the translation units
+    header_graph graph;
+    std::vector< std::size_t > unit_indices;
+    for (std::vector< dep_node* >::const_iterator it = translation_units.begin(), end = translation_units.end(); it != end; ++it)
+        unit_indices.push_back(graph.add_node(*it, params));
+
+    for (std::size_t i = 0; i < graph.nodes.size(); ++i)
+    {
+        dep_node::nodes const& deps = graph.nodes[i]->get_dependencies();
+        for (dep_node::nodes::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            std::size_t dep = graph.add_node(*it, params);
+            graph.dependencies[i].push_back(dep);
+        }
+    }
+
+    const std::size_t node_count = graph.nodes.size();
+    std::vector< std::size_t > visit_marks(node_count, static_cast< std::size_t >(-1));
+    std::size_t mark = 0u;
+    std::vector< std::size_t > reachable;
+
+    // Compute fan-in of every header
+    std::vector< std::size_t > fan_ins(node_count, 0u);
+    std::vector< bool > is_unit(node_count, false);
+    for (std::vector< std::size_t >::const_iterator it = unit_indices.begin(), end = unit_indices.end(); it != end; ++it)
+    {
+        is_unit[*it] = true;
+        collect_reachable(graph, *it, visit_marks, mark++, reachable);
+
+        pch_translation_unit unit;
+        unit.node = graph.nodes[*it];
+        for (std::vector< std::size_t >::const_iterator header_it = reachable.begin() + 1, header_end = reachable.end(); header_it != header_end; ++header_it)
+        {
+            ++fan_ins[*header_it];
+            unit.included_bytes += graph.sizes[*header_it];
+        }
+        result.translation_units.push_back(unit);
+    }
+
+    // Compute the weight of every candidate header and its gain if it was the only header in the precompiled header
+    std::vector< std::vector< std::size_t > > closures(node_count);
+    std::priority_queue< candidate > candidates;
+    std::vector< pch_header > headers;
+    for (std::size_t i = 0; i < node_count; ++i)
+    {
+        if (is_unit[i] || fan_ins[i] < 2u)
+            continue;
+
+        collect_reachable(graph, i, visit_marks, mark++, closures[i]);
+
+        pch_header header;
+        header.node = graph.nodes[i];
+        header.fan_in = fan_ins[i];
+        for (std::vector< std::size_t >::const_iterator it = closures[i].begin(), end = closures[i].end(); it != end; ++it)
+        {
+            header.weight += graph.sizes[*it];
+            header.gain += graph.sizes[*it] * fan_ins[*it];
+        }
+        headers.push_back(header);
+
+        candidates.push(candidate(i, header.gain, 0u));
+    }
+
+    std::sort(headers.begin(), headers.end(), order_by_score());
+    if (headers.size() > params.top_header_count)
+        headers.resize(params.top_header_count);
+    result.top_headers.swap(headers);
+
+    // Greedy selection. Adding headers to the precompiled header only reduces gains of other headers, so the gains are recomputed lazily,
+    // only for the header with the best previously computed gain.
+    std::vector< bool > in_pch(node_count, false);
+    std::size_t selection_count = 0u;
+    // The headers that did not fit in the budget. Adding headers also reduces the costs of other headers, so these are reconsidered after every selection.
+    std::vector< candidate > deferred;
+    while (!candidates.empty())
+    {
+        candidate c = candidates.top();
+        candidates.pop();
+
+        boost::uintmax_t gain = 0u, cost = 0u;
+        std::vector< std::size_t > const& closure = closures[c.header];
+        for (std::vector< std::size_t >::const_iterator it = closure.begin(), end = closure.end(); it != end; ++it)
+        {
+            if (!in_pch[*it])
+            {
+                gain += graph.sizes[*it] * fan_ins[*it];
+                cost += graph.sizes[*it];
+            }
+        }
+
+        if (gain == 0u)
+            continue;
+
+        if (result.size + cost > params.budget)
+        {
+            // The header itself is only added by selecting it, so the header is dropped if it alone does not fit
+            if (result.size + graph.sizes[c.header] <= params.budget)
+                deferred.push_back(candidate(c.header, gain, selection_count));
+            continue;
+        }
+
+        if (c.selection_count != selection_count && !candidates.empty() && gain < candidates.top().gain)
+        {
+            // The gain is outdated, reconsider the header later
+            candidates.push(candidate(c.header, gain, selection_count));
+            continue;
+        }
+
+        for (std::vector< std::size_t >::const_iterator it = closure.begin(), end = closure.end(); it != end; ++it)
+            in_pch[*it] = true;
+        ++selection_count;
+
+        pch_header header;
+        header.node = graph.nodes[c.header];
+        header.fan_in = fan_ins[c.header];
+        header.gain = gain;
+        for (std::vector< std::size_t >::const_iterator it = closure.begin(), end = closure.end(); it != end; ++it)
+            header.weight += graph.sizes[*it];
+        result.headers.push_back(header);
+
+        result.size += cost;
+        result.saved_bytes += gain;
+
+        // The computed gains of the deferred headers are still upper bounds, so the headers are recomputed when they reach the top of the queue
+        for (std::vector< candidate >::const_iterator it = deferred.begin(), end = deferred.end(); it != end; ++it)
+        {
+            if (result.size + graph.sizes[it->header] <= params.budget)
+                candidates.push(*it);
+        }
+        deferred.clear();
+    }
+
+    // Compute the savings for every translation unit
+    for (std::size_t i = 0, n = unit_indices.size(); i < n; ++i)
+    {
+        collect_reachable(graph, unit_indices[i], visit_marks, mark++, reachable);
+        for (std::vector< std::size_t >::const_iterator it = reachable.begin() + 1, end = reachable.end(); it != end; ++it)
+        {
+            if (in_pch[*it])
+                result.translation_units[i].saved_bytes += graph.sizes[*it];
+        }
+    }
+}
+
+//! Serializes the precompiled header recommendation into JSON format
+void serialize_pch_recommendation_json(pch_recommendation const& recommendation, std::ostream& strm, bool pretty_print, const char* indent)
+{
+    std::string nl_ind, ind;
+    const char* space = "";
+    if (pretty_print)
+    {
+        ind = indent;
+        nl_ind = "\n" + ind;
+        space = " ";
+    }
+    std::string nl_ind2 = nl_ind + ind, nl_ind3 = nl_ind2 + ind;
+
+    std::string text;
+    text.append(1, '{');
+    text.append(nl_ind).append("\"budget\":").append(space).append(boost::lexical_cast< std::string >(recommendation.budget)).append(1, ',');
+    text.append(nl_ind).append("\"size\":").append(space).append(boost::lexical_cast< std::string >(recommendation.size)).append(1, ',');
+    text.append(nl_ind).append("\"saved_bytes\":").append(space).append(boost::lexical_cast< std::string >(recommendation.saved_bytes)).append(1, ',');
+
+    text.append(nl_ind).append("\"headers\":");
+    serialize_header_list(recommendation.headers, false, nl_ind, ind, text);
+    text.push_back(',');
+
+    text.append(nl_ind).append("\"top_headers\":");
+    serialize_header_list(recommendation.top_headers, true, nl_ind, ind, text);
+    text.push_back(',');
+
+    text.append(nl_ind).append("\"translation_units\":").append(nl_ind).append(1, '{');
+    for (std::vector< pch_translation_unit >::const_iterator it = recommendation.translation_units.begin(), end = recommendation.translation_units.end(); it != end; ++it)
+    {
+        if (it != recommendation.translation_units.begin())
+            text.push_back(',');
+        text.append(nl_ind2).append(1, '"').append(it->node->get_path()).append("\":").append(nl_ind2).append(1, '{');
+        text.append(nl_ind3).append("\"included_bytes\":").append(space).append(boost::lexical_cast< std::string >(it->included_bytes)).append(1, ',');
+        text.append(nl_ind3).append("\"saved_bytes\":").append(space).append(boost::lexical_cast< std::string >(it->saved_bytes));
+        text.append(nl_ind2).append(1, '}');
+    }
+    text.append(nl_ind).append(1, '}');
+
+    text.append(pretty_print ? "\n}\n" : "}");
+    strm.write(text.data(), text.size());
+}
@@ -0,0 +1,309 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the rules that prune directories and files from scanning
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/exception/errinfo_at_line.hpp>
+#include <boost/exception/info.hpp>
+#include <prune_rules.hpp>
+#include <cxx_parser.hpp>
+
+namespace {
+
+const std::size_t invalid_node = static_cast< std::size_t >(-1);
+const char globstar[] = "**";
+
+//! Matches the path component to the wildcard with '*' and '?'
+bool wildcard_match(boost::string_ref const& name, std::string const& wildcard)
+{
+    const char* n = name.data(), *nend = n + name.size();
+    const char* w = wildcard.data(), *wend = w + wildcard.size();
+
+    // The position after the last '*' and the name position it was matched at, to backtrack to
+    const char* star = NULL, *star_n = NULL;
+    while (n != nend)
+    {
+        if (w != wend && *w == '*')
+        {
+            star = ++w;
+            star_n = n;
+        }
+        else if (w != wend && (*w == '?' || *w == *n))
+        {
+            ++w;
+            ++n;
+        }
+        else if (star)
+        {
+            w = star;
+            n = ++star_n;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (w != wend && *w == '*')
+        ++w;
+    return w == wend;
+}
+
+inline bool is_separator(char c)
+{
+    return c == '/'
+#if defined(BOOST_WINDOWS)
+        || c == '\\'
+#endif
+    ;
+}
+
+} // namespace
+
+prune_rules::prune_rules() : m_nodes(1u), m_rule_count(0u)
+{
+}
+
+//! Adds a rule
+void prune_rules::add_rule(std::string const& rule)
+{
+    std::string::size_type begin = rule.find_first_not_of(" \t\r\n"), end = rule.find_last_not_of(" \t\r\n");
+    if (begin == std::string::npos || rule[begin] == '#')
+        return;
+
+    boost::string_ref pattern(rule.data() + begin, end + 1u - begin);
+    bool negated = pattern[0] == '!';
+    if (negated)
+        pattern.remove_prefix(1u);
+
+    std::vector< std::string > components;
+    bool has_separators = false;
+    while (!pattern.empty())
+    {
+        std::size_t pos = 0u;
+        while (pos < pattern.size() && !is_separator(pattern[pos]))
+            ++pos;
+
+        boost::string_ref component = pattern.substr(0u, pos);
+        if (!component.empty() && component != ".")
+            components.push_back(std::string(component.data(), component.size()));
+
+        if (pos < pattern.size())
+        {
+            has_separators = true;
+            ++pos;
+        }
+        pattern.remove_prefix(pos);
+    }
+
+    if (components.empty())
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Incorrect prune rule: " + rule));
+
+    if (!has_separators)
+        components.insert(components.begin(), globstar);
+
+    std::size_t node = 0u;
+    for (std::vector< std::string >::const_iterator it = components.begin(), end = components.end(); it != end; ++it)
+    {
+        // Consecutive "**" are equivalent to one
+        if (*it == globstar && m_nodes[node].is_globstar)
+            continue;
+        node = add_child(node, *it);
+    }
+
+    m_nodes[node].rule = m_rule_count++;
+    m_nodes[node].negated = negated;
+    update_negation_below(0u);
+}
+
+//! Reads the rules from a file
+void prune_rules::load(boost::filesystem::path const& file)
+{
+    std::string file_str = file.string();
+    std::ifstream strm(file_str.c_str());
+    if (!strm.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open prune rules file: " + file_str));
+
+    std::string line;
+    unsigned int line_number = 0u;
+    while (std::getline(strm, line))
+    {
+        ++line_number;
+        try
+        {
+            add_rule(line);
+        }
+        catch (boost::exception& e)
+        {
+            e << file_name_info(file_str) << boost::errinfo_at_line(static_cast< int >(line_number));
+            throw;
+        }
+    }
+}
+
+//! Returns the state for Boost root
+void prune_rules::start(state& s) const
+{
+    s.nodes.assign(1u, 0u);
+    s.pruned = false;
+    close_globstars(s.nodes);
+}
+
+//! Computes the state of the directory entry from the state of the directory
+void prune_rules::step(state const& from, boost::string_ref const& name, state& to) const
+{
+    to.nodes.clear();
+    for (std::vector< std::size_t >::const_iterator it = from.nodes.begin(), end = from.nodes.end(); it != end; ++it)
+    {
+        trie_node const& node = m_nodes[*it];
+        if (node.is_globstar)
+            to.nodes.push_back(*it);
+
+        for (std::vector< std::pair< std::string, std::size_t > >::const_iterator child_it = node.literal_children.begin(), child_end = node.literal_children.end(); child_it != child_end; ++child_it)
+        {
+            if (name == child_it->first)
+                to.nodes.push_back(child_it->second);
+        }
+
+        for (std::vector< std::pair< std::string, std::size_t > >::const_iterator child_it = node.wildcard_children.begin(), child_end = node.wildcard_children.end(); child_it != child_end; ++child_it)
+        {
+            if (wildcard_match(name, child_it->first))
+                to.nodes.push_back(child_it->second);
+        }
+    }
+
+    close_globstars(to.nodes);
+
+    // The last matching rule decides, if no rule matches the decision is inherited
+    std::size_t rule = invalid_node;
+    bool negated = false;
+    for (std::vector< std::size_t >::const_iterator it = to.nodes.begin(), end = to.nodes.end(); it != end; ++it)
+    {
+        trie_node const& node = m_nodes[*it];
+        if (node.rule != invalid_node && (rule == invalid_node || node.rule > rule))
+        {
+            rule = node.rule;
+            negated = node.negated;
+        }
+    }
+
+    to.pruned = rule != invalid_node ? !negated : from.pruned;
+}
+
+//! Checks if the directory with the state is pruned together with everything within it
+bool prune_rules::is_subtree_pruned(state const& s) const
+{
+    if (!s.pruned)
+        return false;
+
+    for (std::vector< std::size_t >::const_iterator it = s.nodes.begin(), end = s.nodes.end(); it != end; ++it)
+    {
+        if (m_nodes[*it].negation_below)
+            return false;
+    }
+
+    return true;
+}
+
+//! Computes the state of the path relative to Boost root
+bool prune_rules::match(boost::string_ref const& path, state& s) const
+{
+    start(s);
+
+    state next;
+    boost::string_ref rest = path;
+    while (!rest.empty())
+    {
+        std::size_t pos = 0u;
+        while (pos < rest.size() && !is_separator(rest[pos]))
+            ++pos;
+
+        if (pos > 0u)
+        {
+            if (is_subtree_pruned(s))
+                return false;
+            step(s, rest.substr(0u, pos), next);
+            s.nodes.swap(next.nodes);
+            s.pruned = next.pruned;
+        }
+
+        rest.remove_prefix(pos < rest.size() ? pos + 1u : pos);
+    }
+
+    return true;
+}
+
+std::size_t prune_rules::add_child(std::size_t parent, std::string const& component)
+{
+    if (component == globstar)
+    {
+        if (m_nodes[parent].globstar_child == invalid_node)
+        {
+            std::size_t child = m_nodes.size();
+            m_nodes.push_back(trie_node());
+            m_nodes[child].is_globstar = true;
+            m_nodes[parent].globstar_child = child;
+        }
+        return m_nodes[parent].globstar_child;
+    }
+
+    std::vector< std::pair< std::string, std::size_t > >& children = component.find_first_of("*?") != std::string::npos ?
+        m_nodes[parent].wildcard_children : m_nodes[parent].literal_children;
+    for (std::vector< std::pair< std::string, std::size_t > >::const_iterator it = children.begin(), end = children.end(); it != end; ++it)
+    {
+        if (it->first == component)
+            return it->second;
+    }
+
+    std::size_t child = m_nodes.size();
+    children.push_back(std::make_pair(component, child));
+    // The reference to the children is invalidated by adding the node
+    m_nodes.push_back(trie_node());
+    return child;
+}
+
+//! Adds the "**" children of the nodes, which match without consuming a path component, and orders the nodes
+void prune_rules::close_globstars(std::vector< std::size_t >& nodes) const
+{
+    for (std::size_t i = 0u; i < nodes.size(); ++i)
+    {
+        std::size_t child = m_nodes[nodes[i]].globstar_child;
+        if (child != invalid_node)
+            nodes.push_back(child);
+    }
+
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+}
+
+//! Updates the flags of the node and its descendants. Returns \c true if a negation rule ends at the node or its descendants.
+bool prune_rules::update_negation_below(std::size_t node)
+{
+    bool below = false;
+    for (std::size_t i = 0u, n = m_nodes[node].literal_children.size(); i < n; ++i)
+        below |= update_negation_below(m_nodes[node].literal_children[i].second);
+    for (std::size_t i = 0u, n = m_nodes[node].wildcard_children.size(); i < n; ++i)
+        below |= update_negation_below(m_nodes[node].wildcard_children[i].second);
+    if (m_nodes[node].globstar_child != invalid_node)
+        below |= update_negation_below(m_nodes[node].globstar_child);
+
+    trie_node& n = m_nodes[node];
+    bool negated_here = n.rule != invalid_node && n.negated;
+    // A "**" node also matches the paths below the ones it matched
+    n.negation_below = below || (n.is_globstar && negated_here);
+    return below || negated_here;
+}
@@ -0,0 +1,516 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of the single-file source pack, which stores a scanned source tree
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/cstdint.hpp>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/exception.hpp>
+#include <boost/exception/info.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <source_pack.hpp>
+#include <filesystem_scanner.hpp>
+#include <cxx_parser.hpp>
+
+namespace {
+
+const char pack_magic[8] = { 'B', 'D', 'E', 'P', 'P', 'A', 'C', 'K' };
+//! Maximum number of symlinks to follow while looking up a path, to protect against symlink loops
+const unsigned int max_symlink_depth = 40u;
+//! The size of the buffer for copying file contents into the pack
+const std::size_t copy_buffer_size = 1024u * 1024u;
+
+//! Entry being packed
+struct pack_item
+{
+    source_pack::entry_record record;
+    std::string name;
+    boost::filesystem::path path;
+    //! The symlink target
+    std::string target;
+    //! The prune rules state of the directory
+    prune_rules::state prune_state;
+};
+
+//! Directory listing entry
+typedef std::pair< std::string, boost::filesystem::file_type > listing_entry;
+
+//! Ordering predicate for the directory listing
+struct order_by_name
+{
+    typedef bool result_type;
+
+    result_type operator() (listing_entry const& left, listing_entry const& right) const
+    {
+        return left.first < right.first;
+    }
+};
+
+inline boost::uint64_t align_offset(boost::uint64_t offset)
+{
+    return (offset + 7u) & ~static_cast< boost::uint64_t >(7u);
+}
+
+//! Checks if the range of \a size bytes at \a offset is within \a limit bytes, without overflowing
+inline bool is_in_range(boost::uint64_t offset, boost::uint64_t size, boost::uint64_t limit)
+{
+    return offset <= limit && size <= limit - offset;
+}
+
+//! Writes zero bytes to align the stream position
+void write_padding(std::ofstream& strm, boost::uint64_t from, boost::uint64_t to)
+{
+    static const char zeros[8] = {};
+    strm.write(zeros, static_cast< std::streamsize >(to - from));
+}
+
+//! Copies the file content into the pack. The file must have the size it had when the pack layout was computed.
+void copy_file_content(pack_item const& item, std::vector< char >& buffer, std::ofstream& strm)
+{
+    std::string path_str = item.path.string();
+    std::ifstream file(path_str.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Failed to open file for packing")) << file_name_info(path_str));
+
+    boost::uint64_t left = item.record.size;
+    while (left > 0u)
+    {
+        std::size_t size = static_cast< std::size_t >(std::min< boost::uint64_t >(left, buffer.size()));
+        file.read(&buffer[0], static_cast< std::streamsize >(size));
+        if (static_cast< std::size_t >(file.gcount()) != size)
+            BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("File changed while packing")) << file_name_info(path_str));
+        strm.write(&buffer[0], static_cast< std::streamsize >(size));
+        left -= size;
+    }
+
+    if (file.peek() != std::ifstream::traits_type::eof())
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("File changed while packing")) << file_name_info(path_str));
+}
+
+} // namespace
+
+BOOST_CONSTEXPR_OR_CONST source_pack::entry_id source_pack::invalid_entry;
+BOOST_CONSTEXPR_OR_CONST source_pack::entry_id source_pack::root_entry;
+BOOST_CONSTEXPR_OR_CONST boost::uint8_t source_pack::has_content_flag;
+BOOST_CONSTEXPR_OR_CONST boost::uint32_t source_pack::current_version;
+BOOST_CONSTEXPR_OR_CONST boost::uint32_t source_pack::byte_order_mark;
+
+source_pack_params::source_pack_params() : cxx_wildcards(default_cxx_wildcards())
+{
+    // Unlike scanning, the "boost" directory is packed, because the included headers are found in it
+    skip_root_dirs.push_back(".git");
+    skip_root_dirs.push_back("bin.v2");
+    skip_root_dirs.push_back("stage");
+}
+
+//! The function packs the directory tree into a single file
+void create_source_pack(source_pack_params const& params, boost::filesystem::path const& pack_file, source_pack_stats& stats)
+{
+    std::vector< pack_item > items(1u);
+    std::memset(&items[0].record, 0, sizeof(source_pack::entry_record));
+    items[0].record.type = source_pack::directory;
+    items[0].record.parent = source_pack::invalid_entry;
+    items[0].path = boost::filesystem::system_complete(params.boost_root);
+    if (!boost::filesystem::is_directory(items[0].path))
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Packed directory does not exist: " + items[0].path.string()));
+    if (!params.prune.empty())
+        params.prune.start(items[0].prune_state);
+
+    // The directories are listed in breadth-first order, so that the entries of every directory are adjacent
+    std::vector< listing_entry > listing;
+    prune_rules::state prune_state;
+    for (std::size_t i = 0u; i < items.size(); ++i)
+    {
+        if (items[i].record.type != source_pack::directory)
+            continue;
+
+        listing.clear();
+        boost::filesystem::path dir = items[i].path;
+        boost::filesystem::directory_iterator dir_it(dir), dir_end;
+        for (; dir_it != dir_end; ++dir_it)
+            listing.push_back(listing_entry(dir_it->path().filename().string(), dir_it->symlink_status().type()));
+        std::sort(listing.begin(), listing.end(), order_by_name());
+
+        const prune_rules::state dir_prune_state = items[i].prune_state;
+        items[i].prune_state = prune_rules::state();
+        items[i].record.first_child = static_cast< source_pack::entry_id >(items.size());
+        for (std::vector< listing_entry >::const_iterator it = listing.begin(), end = listing.end(); it != end; ++it)
+        {
+            boost::uint8_t type;
+            switch (it->second)
+            {
+            case boost::filesystem::directory_file:
+                type = source_pack::directory;
+                break;
+            case boost::filesystem::regular_file:
+                type = source_pack::regular_file;
+                break;
+            case boost::filesystem::symlink_file:
+                type = source_pack::symlink;
+                break;
+            default:
+                continue;
+            }
+
+            if (i == source_pack::root_entry && std::find(params.skip_root_dirs.begin(), params.skip_root_dirs.end(), it->first) != params.skip_root_dirs.end())
+                continue;
+
+            if (!params.prune.empty())
+            {
+                params.prune.step(dir_prune_state, it->first, prune_state);
+                if (type == source_pack::directory ? params.prune.is_subtree_pruned(prune_state) : prune_state.pruned)
+                    continue;
+            }
+
+            items.push_back(pack_item());
+            pack_item& item = items.back();
+            std::memset(&item.record, 0, sizeof(source_pack::entry_record));
+            item.record.type = type;
+            item.record.parent = static_cast< source_pack::entry_id >(i);
+            item.name = it->first;
+            item.path = dir / it->first;
+            if (type == source_pack::directory)
+                item.prune_state = prune_state;
+        }
+        items[i].record.child_count = static_cast< boost::uint32_t >(items.size() - items[i].record.first_child);
+    }
+
+    if (items.size() >= source_pack::invalid_entry)
+        BOOST_THROW_EXCEPTION(std::runtime_error("Too many files to pack"));
+
+    // Compute the layout
+    std::string root_str = items[0].path.string();
+    boost::uint64_t names_size = root_str.size(), data_size = 0u;
+    for (std::vector< pack_item >::iterator it = items.begin(), end = items.end(); it != end; ++it)
+    {
+        source_pack::entry_record& record = it->record;
+        if (it != items.begin())
+        {
+            record.name_offset = static_cast< boost::uint32_t >(names_size);
+            record.name_size = static_cast< boost::uint32_t >(it->name.size());
+            names_size += it->name.size();
+        }
+
+        switch (record.type)
+        {
+        case source_pack::directory:
+            ++stats.directories;
+            break;
+
+        case source_pack::regular_file:
+            ++stats.files;
+            record.size = boost::filesystem::file_size(it->path);
+            if (is_cxx_file(it->path, params.cxx_wildcards))
+            {
+                record.flags |= source_pack::has_content_flag;
+                record.data_offset = data_size;
+                data_size += record.size;
+                stats.content_bytes += record.size;
+            }
+            break;
+
+        case source_pack::symlink:
+            ++stats.symlinks;
+            it->target = boost::filesystem::read_symlink(it->path).string();
+            record.size = it->target.size();
+            record.data_offset = data_size;
+            data_size += record.size;
+            break;
+        }
+    }
+
+    if (names_size > static_cast< boost::uint32_t >(-1))
+        BOOST_THROW_EXCEPTION(std::runtime_error("Too many file names to pack"));
+
+    source_pack::header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, pack_magic, sizeof(pack_magic));
+    hdr.version = source_pack::current_version;
+    hdr.byte_order = source_pack::byte_order_mark;
+    hdr.entry_count = static_cast< boost::uint32_t >(items.size());
+    hdr.root_size = static_cast< boost::uint32_t >(root_str.size());
+    hdr.entries_offset = align_offset(sizeof(hdr));
+    hdr.names_offset = hdr.entries_offset + items.size() * sizeof(source_pack::entry_record);
+    hdr.names_size = names_size;
+    hdr.data_offset = align_offset(hdr.names_offset + names_size);
+    hdr.data_size = data_size;
+
+    std::string pack_str = pack_file.string();
+    try
+    {
+        std::ofstream strm;
+        strm.exceptions(std::ios::failbit | std::ios::badbit);
+        strm.open(pack_str.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+
+        strm.write(reinterpret_cast< const char* >(&hdr), sizeof(hdr));
+        write_padding(strm, sizeof(hdr), hdr.entries_offset);
+        for (std::vector< pack_item >::const_iterator it = items.begin(), end = items.end(); it != end; ++it)
+            strm.write(reinterpret_cast< const char* >(&it->record), sizeof(source_pack::entry_record));
+
+        strm.write(root_str.data(), root_str.size());
+        for (std::vector< pack_item >::const_iterator it = items.begin() + 1, end = items.end(); it != end; ++it)
+            strm.write(it->name.data(), it->name.size());
+        write_padding(strm, hdr.names_offset + names_size, hdr.data_offset);
+
+        // The contents are written in the order of the entries, so the files of a directory are adjacent in the pack as well
+        std::vector< char > buffer(copy_buffer_size);
+        for (std::vector< pack_item >::const_iterator it = items.begin(), end = items.end(); it != end; ++it)
+        {
+            if (it->record.type == source_pack::symlink)
+                strm.write(it->target.data(), it->target.size());
+            else if ((it->record.flags & source_pack::has_content_flag) != 0u)
+                copy_file_content(*it, buffer, strm);
+        }
+
+        strm.close();
+    }
+    catch (boost::exception& e)
+    {
+        e << file_name_info(pack_str);
+        throw;
+    }
+    catch (std::exception& e)
+    {
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error(std::string("Failed to write source pack: ") + e.what())) << file_name_info(pack_str));
+    }
+
+    stats.pack_bytes = hdr.data_offset + data_size;
+}
+
+//! Opens and validates the pack
+source_pack::source_pack(boost::filesystem::path const& file) : m_file(file), m_header(NULL), m_entries(NULL), m_names(NULL), m_data(NULL)
+{
+    std::string file_str = file.string();
+    try
+    {
+        m_mapping.open(file_str);
+    }
+    catch (std::exception& e)
+    {
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error(std::string("Failed to open source pack: ") + e.what())) << file_name_info(file_str));
+    }
+
+    validate();
+
+    const char* base = m_mapping.data();
+    m_header = reinterpret_cast< header const* >(base);
+    m_entries = reinterpret_cast< entry_record const* >(base + m_header->entries_offset);
+    m_names = base + m_header->names_offset;
+    m_data = base + m_header->data_offset;
+    m_root = std::string(m_names, m_header->root_size);
+    m_mount_point = canonical_root(m_root);
+}
+
+//! Checks that the offsets and sizes in the pack are within the pack file
+void source_pack::validate() const
+{
+    const std::string file_str = m_file.string();
+    const boost::uint64_t file_size = m_mapping.size();
+    const char* base = m_mapping.data();
+    if (file_size < sizeof(header))
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Source pack is truncated")) << file_name_info(file_str));
+
+    header const& hdr = *reinterpret_cast< header const* >(base);
+    if (std::memcmp(hdr.magic, pack_magic, sizeof(pack_magic)) != 0)
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("The file is not a source pack")) << file_name_info(file_str));
+    if (hdr.byte_order != byte_order_mark)
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Source pack was created on a host with a different byte order")) << file_name_info(file_str));
+    if (hdr.version != current_version)
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Unsupported source pack version")) << file_name_info(file_str));
+
+    if (hdr.entry_count == 0u || hdr.entries_offset % sizeof(boost::uint64_t) != 0u ||
+        !is_in_range(hdr.entries_offset, static_cast< boost::uint64_t >(hdr.entry_count) * sizeof(entry_record), file_size) ||
+        !is_in_range(hdr.names_offset, hdr.names_size, file_size) || hdr.root_size > hdr.names_size ||
+        !is_in_range(hdr.data_offset, hdr.data_size, file_size))
+    {
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Source pack is corrupted: invalid header")) << file_name_info(file_str));
+    }
+
+    entry_record const* entries = reinterpret_cast< entry_record const* >(base + hdr.entries_offset);
+    if (entries[root_entry].type != directory)
+        BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Source pack is corrupted: the root is not a directory")) << file_name_info(file_str));
+
+    for (entry_id id = 0u; id < hdr.entry_count; ++id)
+    {
+        entry_record const& record = entries[id];
+        bool valid = is_in_range(record.name_offset, record.name_size, hdr.names_size) &&
+            (id == root_entry ? record.parent == invalid_entry : record.parent < id);
+        switch (record.type)
+        {
+        case directory:
+            valid = valid && (record.child_count == 0u || (record.first_child > id && is_in_range(record.first_child, record.child_count, hdr.entry_count)));
+            break;
+        case regular_file:
+            valid = valid && ((record.flags & has_content_flag) == 0u || is_in_range(record.data_offset, record.size, hdr.data_size));
+            break;
+        case symlink:
+            valid = valid && is_in_range(record.data_offset, record.size, hdr.data_size);
+            break;
+        default:
+            valid = false;
+            break;
+        }
+
+        if (!valid)
+            BOOST_THROW_EXCEPTION(boost::enable_error_info(std::runtime_error("Source pack is corrupted: invalid entry")) << file_name_info(file_str));
+    }
+}
+
+//! Returns the file type of the entry
+boost::filesystem::file_type source_pack::file_type(entry_id id) const
+{
+    switch (type(id))
+    {
+    case directory:
+        return boost::filesystem::directory_file;
+    case regular_file:
+        return boost::filesystem::regular_file;
+    default:
+        return boost::filesystem::symlink_file;
+    }
+}
+
+//! Looks up the path, which must be absolute, normalized and within the mount point
+source_pack::entry_id source_pack::find(boost::string_ref const& path, bool follow_last) const
+{
+    if (!contains(path))
+        return invalid_entry;
+
+    return find_relative(m_mount_point.make_relative(path), follow_last);
+}
+
+//! Looks up the path relative to the mount point
+source_pack::entry_id source_pack::find_relative(boost::string_ref const& relative_path, bool follow_last) const
+{
+    // The buffer is only used if the path contains symlinks
+    std::string buffer;
+    boost::string_ref rest = relative_path;
+    entry_id id = root_entry;
+    unsigned int depth = 0u;
+    while (true)
+    {
+        while (!rest.empty() && is_path_separator(rest.front()))
+            rest.remove_prefix(1u);
+        if (rest.empty())
+            break;
+
+        std::size_t pos = 0u;
+        while (pos < rest.size() && !is_path_separator(rest[pos]))
+            ++pos;
+        boost::string_ref element = rest.substr(0u, pos);
+        rest.remove_prefix(pos);
+
+        if (element == ".")
+            continue;
+        if (element == "..")
+        {
+            // The parent of the root is outside the pack
+            if (id == root_entry)
+                return invalid_entry;
+            id = parent(id);
+            continue;
+        }
+
+        if (type(id) != directory)
+            return invalid_entry;
+        entry_id child = find_child(id, element);
+        if (child == invalid_entry)
+            return invalid_entry;
+
+        bool is_last = true;
+        for (boost::string_ref::const_iterator it = rest.begin(), end = rest.end(); it != end && is_last; ++it)
+            is_last = is_path_separator(*it);
+
+        if (type(child) == symlink && (follow_last || !is_last))
+        {
+            if (++depth > max_symlink_depth)
+                return invalid_entry;
+
+            // Substitute the symlink target and look up the path from the root again
+            boost::string_ref target = symlink_target(child);
+            std::string resolved;
+            if (!target.empty() && is_path_separator(target.front()))
+            {
+                std::string absolute_target(target.data(), target.size());
+                normalize_path_in_place(absolute_target);
+                if (!contains(absolute_target))
+                    return invalid_entry;
+                boost::string_ref relative_target = m_mount_point.make_relative(absolute_target);
+                resolved.assign(relative_target.data(), relative_target.size());
+            }
+            else
+            {
+                resolved = this->relative_path(id);
+                resolved.push_back('/');
+                resolved.append(target.data(), target.size());
+            }
+            resolved.append(rest.data(), rest.size());
+
+            buffer.swap(resolved);
+            rest = buffer;
+            id = root_entry;
+            continue;
+        }
+
+        id = child;
+    }
+
+    return id;
+}
+
+//! Looks up the child of the directory by name
+source_pack::entry_id source_pack::find_child(entry_id dir, boost::string_ref const& name) const
+{
+    entry_id first = first_child(dir), count = static_cast< entry_id >(child_count(dir));
+    while (count > 0u)
+    {
+        entry_id half = count / 2u, middle = first + half;
+        if (this->name(middle) < name)
+        {
+            first = middle + 1u;
+            count -= half + 1u;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+
+    if (first < first_child(dir) + child_count(dir) && this->name(first) == name)
+        return first;
+
+    return invalid_entry;
+}
+
+//! Returns the path of the entry relative to the pack root
+std::string source_pack::relative_path(entry_id id) const
+{
+    std::vector< entry_id > ancestors;
+    for (; id != root_entry; id = parent(id))
+        ancestors.push_back(id);
+
+    std::string path;
+    for (std::vector< entry_id >::const_reverse_iterator it = ancestors.rbegin(), end = ancestors.rend(); it != end; ++it)
+    {
+        if (!path.empty())
+            path.push_back('/');
+        boost::string_ref element = name(*it);
+        path.append(element.data(), element.size());
+    }
+
+    return path;
+}
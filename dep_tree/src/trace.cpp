@@ -0,0 +1,200 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of tracing the time spent in the processing stages
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <trace.hpp>
+
+boost::atomic< bool > trace_enabled(false);
+
+namespace {
+
+//! Complete trace event, which has start time and duration
+struct trace_event
+{
+    const char* category;
+    const char* name;
+    std::string detail;
+    boost::uint64_t start;
+    boost::uint64_t duration;
+};
+
+//! The events recorded by a thread
+struct trace_buffer
+{
+    unsigned int thread_id;
+    std::string thread_name;
+    std::vector< trace_event > events;
+
+    trace_buffer() : thread_id(0u) {}
+};
+
+//! The buffers of all threads that have recorded events
+struct trace_registry
+{
+    boost::mutex mutex;
+    //! The buffers are not moved when new buffers are added, so the threads can keep pointers to them
+    std::deque< trace_buffer > buffers;
+    boost::chrono::steady_clock::time_point start;
+
+    trace_registry() : start(boost::chrono::steady_clock::now()) {}
+};
+
+trace_registry& get_registry()
+{
+    static trace_registry registry;
+    return registry;
+}
+
+//! The buffers are owned by the registry and outlive the threads
+void keep_buffer(trace_buffer*)
+{
+}
+
+boost::thread_specific_ptr< trace_buffer > current_buffer(&keep_buffer);
+
+//! Returns the buffer of the calling thread
+trace_buffer& get_thread_buffer()
+{
+    trace_buffer* buffer = current_buffer.get();
+    if (!buffer)
+    {
+        trace_registry& registry = get_registry();
+        boost::lock_guard< boost::mutex > lock(registry.mutex);
+        registry.buffers.push_back(trace_buffer());
+        buffer = &registry.buffers.back();
+        buffer->thread_id = static_cast< unsigned int >(registry.buffers.size());
+        current_buffer.reset(buffer);
+    }
+    return *buffer;
+}
+
+//! Appends the string to JSON text as a string literal
+void append_json_string(boost::string_ref const& str, std::string& text)
+{
+    text.push_back('"');
+    for (boost::string_ref::const_iterator it = str.begin(), end = str.end(); it != end; ++it)
+    {
+        const char c = *it;
+        if (c == '"' || c == '\\')
+        {
+            text.push_back('\\');
+            text.push_back(c);
+        }
+        else if (static_cast< unsigned char >(c) < 0x20u)
+        {
+            char buf[8];
+            std::sprintf(buf, "\\u%04x", static_cast< unsigned int >(static_cast< unsigned char >(c)));
+            text.append(buf);
+        }
+        else
+        {
+            text.push_back(c);
+        }
+    }
+    text.push_back('"');
+}
+
+} // namespace
+
+//! Starts collecting trace events
+void enable_tracing()
+{
+    // Make sure the registry is created before any events are recorded, so that the timestamps start at zero
+    get_registry();
+    trace_enabled.store(true, boost::memory_order_relaxed);
+}
+
+//! Returns the trace timestamp, in microseconds since tracing was enabled
+boost::uint64_t get_trace_timestamp()
+{
+    return boost::chrono::duration_cast< boost::chrono::microseconds >(boost::chrono::steady_clock::now() - get_registry().start).count();
+}
+
+//! Records the event in the buffer of the calling thread
+void record_trace_event(const char* category, const char* name, std::string const& detail, boost::uint64_t start, boost::uint64_t end)
+{
+    trace_buffer& buffer = get_thread_buffer();
+    buffer.events.push_back(trace_event());
+    trace_event& event = buffer.events.back();
+    event.category = category;
+    event.name = name;
+    event.detail = detail;
+    event.start = start;
+    event.duration = end - start;
+}
+
+//! Sets the name of the calling thread, as it is displayed in the trace
+void set_trace_thread_name(std::string const& name)
+{
+    if (is_tracing_enabled())
+        get_thread_buffer().thread_name = name;
+}
+
+//! Stops collecting trace events and writes the collected events in Chrome trace event format
+void write_trace_json(std::ostream& strm)
+{
+    trace_enabled.store(false, boost::memory_order_relaxed);
+
+    trace_registry& registry = get_registry();
+    boost::lock_guard< boost::mutex > lock(registry.mutex);
+
+    std::string text = "{\"traceEvents\":[";
+    bool first = true;
+    for (std::deque< trace_buffer >::const_iterator it = registry.buffers.begin(), end = registry.buffers.end(); it != end; ++it)
+    {
+        std::string tid = boost::lexical_cast< std::string >(it->thread_id);
+        if (!it->thread_name.empty())
+        {
+            text.append(first ? "\n" : ",\n");
+            first = false;
+            text.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":").append(tid).append(",\"args\":{\"name\":");
+            append_json_string(it->thread_name, text);
+            text.append("}}");
+        }
+
+        for (std::vector< trace_event >::const_iterator event_it = it->events.begin(), event_end = it->events.end(); event_it != event_end; ++event_it)
+        {
+            text.append(first ? "\n" : ",\n");
+            first = false;
+            text.append("{\"name\":");
+            append_json_string(event_it->name, text);
+            text.append(",\"cat\":");
+            append_json_string(event_it->category, text);
+            text.append(",\"ph\":\"X\",\"ts\":").append(boost::lexical_cast< std::string >(event_it->start));
+            text.append(",\"dur\":").append(boost::lexical_cast< std::string >(event_it->duration));
+            text.append(",\"pid\":1,\"tid\":").append(tid);
+            if (!event_it->detail.empty())
+            {
+                text.append(",\"args\":{\"detail\":");
+                append_json_string(event_it->detail, text);
+                text.push_back('}');
+            }
+            text.push_back('}');
+        }
+
+        // Flush the text periodically to limit memory consumption
+        if (text.size() >= 1024u * 1024u)
+        {
+            strm.write(text.data(), text.size());
+            text.clear();
+        }
+    }
+    text.append("\n],\"displayTimeUnit\":\"ms\"}\n");
+    strm.write(text.data(), text.size());
+}
@@ -0,0 +1,53 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This header defines implementation of processing independent work items in a pool of worker threads
+ */
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/locks.hpp>
+#include <work_queue.hpp>
+#include <trace.hpp>
+
+//! Runs the worker function in the worker threads and waits for them to complete
+void work_queue::run(unsigned int thread_count, const char* thread_name, worker_function const& worker)
+{
+    if (thread_count == 0u)
+        thread_count = boost::thread::hardware_concurrency();
+    if (thread_count > m_item_count)
+        thread_count = static_cast< unsigned int >(m_item_count);
+    if (thread_count == 0u)
+        thread_count = 1u;
+
+    boost::thread_group workers;
+    for (unsigned int i = 0; i < thread_count; ++i)
+        workers.create_thread(boost::bind(&work_queue::run_worker, this, thread_name, boost::cref(worker)));
+    workers.join_all();
+
+    if (m_error)
+        boost::rethrow_exception(m_error);
+}
+
+//! Worker thread function
+void work_queue::run_worker(const char* thread_name, worker_function const& worker)
+{
+    if (thread_name)
+        set_trace_thread_name(thread_name);
+    try
+    {
+        worker();
+    }
+    catch (...)
+    {
+        m_next = m_item_count;
+        boost::lock_guard< boost::mutex > lock(m_mutex);
+        if (!m_error)
+            m_error = boost::current_exception();
+    }
+}
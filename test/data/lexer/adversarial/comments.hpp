@@ -0,0 +1,15 @@
+// #include <commented_out.hpp>
+#include <after_line_comment.hpp>
+/* #include <in_block_comment.hpp>
+#include <in_block_comment2.hpp> */ #include <after_block_comment.hpp>
+/**/#include <after_empty_block_comment.hpp>
+int a; /* a comment that starts after code
+#include <in_multiline_block_comment.hpp>
+*/
+// a line comment continued to the next line \
+#include <in_continued_line_comment.hpp>
+#include "after_continued_line_comment.hpp"
+/* a block comment with a slash-star /* inside */ #include <after_nested_looking_comment.hpp>
+int b; // #include <after_code.hpp>
+/* *** **/
+#include <after_stars.hpp>
@@ -0,0 +1,9 @@
+int x = 1; \
+#include <joined_with_code.hpp>
+#define MACRO(a) \
+    a + 1 \
+#include <joined_with_macro.hpp>
+#include <after_macro.hpp>
+int y; \   
+#include <joined_with_trailing_spaces.hpp>
+#include <after_trailing_spaces.hpp>
@@ -0,0 +1,14 @@
+#include <crlf_first.hpp>
+// a line comment continued to the next line \
+#include <in_continued_line_comment.hpp>
+int x = 1; \
+#include <joined_with_code.hpp>
+const char* s = "escaped line break \
+#include <in_continued_string.hpp>";
+const char* r = R"(
+#include <in_raw_string.hpp>
+)";
+#  include "crlf_quoted.hpp"
+/* #include <in_block_comment.hpp>
+*/
+#include <crlf_last.hpp>
@@ -0,0 +1,14 @@
+#include<no_space.hpp>
+#  include <spaces_after_hash.hpp>
+  #	include	"tabs.hpp"
+	#include <indented.hpp>
+#include BOOST_ABI_PREFIX
+#include_next <include_next.hpp>
+#includes <not_include.hpp>
+#include <unterminated.hpp
+#include "unterminated_quoted.hpp
+#include <after_unterminated.hpp>
+x #include <not_first_in_line.hpp>
+# /* comment */ include <comment_after_hash.hpp>
+#include <trailing_comment.hpp> // comment
+#include <last_line_without_break.hpp>
\ No newline at end of file
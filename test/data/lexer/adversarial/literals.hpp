@@ -0,0 +1,8 @@
+int n1 = 1'000'000;
+#include <after_digit_separators.hpp>
+double n2 = 0x1'F.0p1'0;
+#include <after_hex_digit_separators.hpp>
+char c = ';
+#include <after_unterminated_char.hpp>
+const char* s = "unterminated;
+#include <after_unterminated_string.hpp>
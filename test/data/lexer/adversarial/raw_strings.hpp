@@ -0,0 +1,17 @@
+const char* r1 = R"(
+#include <in_raw_string.hpp>
+)";
+#include <after_raw_string.hpp>
+const char* r2 = R"delim(
+)"
+#include <in_raw_string_with_delimiter.hpp>
+)delim";
+#include <after_raw_string_with_delimiter.hpp>
+const char* r3 = u8R"(" \)";
+#include <after_u8_raw_string.hpp>
+const wchar_t* r4 = LR"x(\)x";
+#include <after_wide_raw_string.hpp>
+int R = 1; const char* r5 = "not raw (";
+#include <after_non_raw_string.hpp>
+const char* r6 = FOOR"(";
+#include <after_identifier_ending_with_r.hpp>
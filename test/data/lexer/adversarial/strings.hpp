@@ -0,0 +1,18 @@
+const char* s1 = "#include <in_string.hpp>";
+const char* s2 = "escaped quote \" #include <in_string_after_escaped_quote.hpp>";
+const char* s3 = "escaped line break \
+#include <in_continued_string.hpp>";
+const char* s4 = "trailing backslash \\";
+#include <after_trailing_backslash.hpp>
+char c1 = '"';
+#include <after_quote_char.hpp>
+char c2 = '\'';
+#include <after_escaped_quote_char.hpp>
+char c3 = '\\';
+#include <after_backslash_char.hpp>
+const char* s5 = "/* not a comment";
+#include <after_comment_in_string.hpp>
+const char* s6 = "// not a comment";
+#include <after_line_comment_in_string.hpp>
+#define INCLUDE_TEXT "#include <in_define.hpp>"
+#include "quoted.hpp"
@@ -0,0 +1,103 @@
+# Copyright Andrey Semashev 2014.
+# Distributed under the Boost Software License, Version 1.0.
+#    (See accompanying file LICENSE_1_0.txt or copy at
+#          http://www.boost.org/LICENSE_1_0.txt)
+#
+# Checks that the git object store reads the same objects as git. The script creates a repository in WORK_DIR with the objects
+# in three forms: a pack with deltas referring to the base objects by identifier, a pack with deltas referring to the bases
+# by offset, and loose objects. All objects are dumped with git cat-file and compared with what GIT_OBJECTS_TEST reads.
+#
+# Usage: cmake -DGIT_EXECUTABLE=<git> -DGIT_OBJECTS_TEST=<git-objects-test executable> -DWORK_DIR=<directory> -P git_pack_objects.cmake
+
+if(NOT GIT_EXECUTABLE OR NOT GIT_OBJECTS_TEST OR NOT WORK_DIR)
+	message(FATAL_ERROR "GIT_EXECUTABLE, GIT_OBJECTS_TEST and WORK_DIR must be specified")
+endif()
+
+set(REPO_DIR "${WORK_DIR}/repo")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${REPO_DIR}")
+
+function(run_git)
+	execute_process(
+		COMMAND "${GIT_EXECUTABLE}" -C "${REPO_DIR}" -c user.name=boost-dep -c user.email=boost-dep@localhost -c gc.auto=0 ${ARGN}
+		RESULT_VARIABLE RESULT
+		OUTPUT_VARIABLE OUTPUT
+		ERROR_VARIABLE ERROR)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "git ${ARGN} failed: ${ERROR}")
+	endif()
+	set(GIT_OUTPUT "${OUTPUT}" PARENT_SCOPE)
+endfunction()
+
+# Every commit changes a few lines of every header, so the versions of the headers are stored as deltas of each other
+function(make_commit NUMBER)
+	foreach(LIB RANGE 2)
+		foreach(HEADER RANGE 3)
+			set(CONTENT "#ifndef LIB${LIB}_H${HEADER}_HPP\n#define LIB${LIB}_H${HEADER}_HPP\n")
+			foreach(LINE RANGE 60)
+				math(EXPR CHANGED "(${LINE} + ${HEADER}) % 20")
+				if(CHANGED EQUAL NUMBER)
+					set(CONTENT "${CONTENT}int lib${LIB}_h${HEADER}_line${LINE}_changed_in_commit${NUMBER}();\n")
+				else()
+					set(CONTENT "${CONTENT}int lib${LIB}_h${HEADER}_line${LINE}();\n")
+				endif()
+			endforeach()
+			set(CONTENT "${CONTENT}#endif\n")
+			file(WRITE "${REPO_DIR}/libs/lib${LIB}/include/boost/lib${LIB}/h${HEADER}.hpp" "${CONTENT}")
+		endforeach()
+	endforeach()
+	file(WRITE "${REPO_DIR}/libs/lib${NUMBER}.txt" "commit ${NUMBER}\n")
+	run_git(add -A)
+	run_git(commit -q -m "Commit ${NUMBER}")
+endfunction()
+
+run_git(init -q)
+run_git(symbolic-ref HEAD refs/heads/master)
+foreach(NUMBER RANGE 4)
+	make_commit(${NUMBER})
+endforeach()
+run_git(-c repack.useDeltaBaseOffset=false repack -a -d -q --window=10 --depth=10)
+
+foreach(NUMBER RANGE 5 9)
+	make_commit(${NUMBER})
+endforeach()
+run_git(repack -d -q --window=10 --depth=10)
+
+# The last commit is left in loose objects
+make_commit(10)
+run_git(tag -a -m "Annotated tag" v1)
+
+# The test is only meaningful if the packs contain deltas
+file(GLOB PACK_INDICES "${REPO_DIR}/.git/objects/pack/*.idx")
+list(LENGTH PACK_INDICES PACK_COUNT)
+if(NOT PACK_COUNT EQUAL 2)
+	message(FATAL_ERROR "Expected 2 pack files, found ${PACK_COUNT}")
+endif()
+foreach(PACK_INDEX ${PACK_INDICES})
+	run_git(verify-pack -v "${PACK_INDEX}")
+	if(NOT GIT_OUTPUT MATCHES "chain length")
+		message(FATAL_ERROR "The pack file has no deltas: ${PACK_INDEX}")
+	endif()
+endforeach()
+
+execute_process(
+	COMMAND "${GIT_EXECUTABLE}" -C "${REPO_DIR}" cat-file --batch-all-objects --batch
+	OUTPUT_FILE "${WORK_DIR}/objects.batch"
+	RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+	message(FATAL_ERROR "git cat-file failed: ${RESULT}")
+endif()
+
+set(REVISIONS)
+foreach(REVISION HEAD HEAD~1 HEAD~6 HEAD^1~3 v1 master~10)
+	run_git(rev-parse "${REVISION}^{commit}")
+	string(STRIP "${GIT_OUTPUT}" ID)
+	list(APPEND REVISIONS "${REVISION}=${ID}")
+endforeach()
+
+execute_process(
+	COMMAND "${GIT_OBJECTS_TEST}" "${REPO_DIR}/.git" "${WORK_DIR}/objects.batch" ${REVISIONS}
+	RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+	message(FATAL_ERROR "The objects read from the repository differ from git")
+endif()
@@ -0,0 +1,54 @@
+# Copyright Andrey Semashev 2014.
+# Distributed under the Boost Software License, Version 1.0.
+#    (See accompanying file LICENSE_1_0.txt or copy at
+#          http://www.boost.org/LICENSE_1_0.txt)
+#
+# Checks that the JSON output is identical when written with one thread and with multiple threads, in separate processes.
+# The script generates a Boost-like tree in WORK_DIR and scans it with BOOST_DEP.
+#
+# Usage: cmake -DBOOST_DEP=<boost-dep executable> -DWORK_DIR=<directory> -P parallel_json_output.cmake
+
+if(NOT BOOST_DEP OR NOT WORK_DIR)
+	message(FATAL_ERROR "BOOST_DEP and WORK_DIR must be specified")
+endif()
+
+set(LIB_COUNT 24)
+set(HEADER_COUNT 40)
+
+set(BOOST_ROOT_DIR "${WORK_DIR}/root")
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(WRITE "${BOOST_ROOT_DIR}/Jamroot" "")
+file(MAKE_DIRECTORY "${BOOST_ROOT_DIR}/boost")
+
+# Every header includes a few headers of its own library and of the next libraries, so the tree has enough nodes and edges to be split into chunks
+math(EXPR LAST_LIB "${LIB_COUNT} - 1")
+math(EXPR LAST_HEADER "${HEADER_COUNT} - 1")
+foreach(LIB RANGE ${LAST_LIB})
+	foreach(HEADER RANGE ${LAST_HEADER})
+		set(CONTENT "#ifndef LIB${LIB}_H${HEADER}_HPP\n#define LIB${LIB}_H${HEADER}_HPP\n")
+		foreach(STEP 1 3 7)
+			math(EXPR DEP_LIB "(${LIB} + ${STEP} / 3) % ${LIB_COUNT}")
+			math(EXPR DEP_HEADER "(${HEADER} * ${STEP} + 1) % ${HEADER_COUNT}")
+			set(CONTENT "${CONTENT}#include <boost/lib${DEP_LIB}/h${DEP_HEADER}.hpp>\n")
+		endforeach()
+		set(CONTENT "${CONTENT}#endif\n")
+		file(WRITE "${BOOST_ROOT_DIR}/libs/lib${LIB}/include/boost/lib${LIB}/h${HEADER}.hpp" "${CONTENT}")
+	endforeach()
+	# Like in modular Boost, the includes are resolved through the symlinks in the boost directory
+	execute_process(COMMAND "${CMAKE_COMMAND}" -E create_symlink "../libs/lib${LIB}/include/boost/lib${LIB}" "${BOOST_ROOT_DIR}/boost/lib${LIB}")
+endforeach()
+
+foreach(JOBS 1 4 4 8)
+	execute_process(
+		COMMAND "${BOOST_DEP}" -j ${JOBS} --boost-root "${BOOST_ROOT_DIR}" -o "${WORK_DIR}/out_${JOBS}.json" "${BOOST_ROOT_DIR}"
+		RESULT_VARIABLE RESULT)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "boost-dep failed with ${JOBS} threads: ${RESULT}")
+	endif()
+
+	# The repeated runs overwrite the output, which is then compared to the output of the first run
+	execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${WORK_DIR}/out_1.json" "${WORK_DIR}/out_${JOBS}.json" RESULT_VARIABLE RESULT)
+	if(NOT RESULT EQUAL 0)
+		message(FATAL_ERROR "The output written with ${JOBS} threads differs from the output written with one thread")
+	endif()
+endforeach()
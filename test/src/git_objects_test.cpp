@@ -0,0 +1,151 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This file contains implementation of the git object store test. The objects of the repository are read with \c git_object_store
+ * and compared with the objects dumped by "git cat-file --batch-all-objects --batch". The commits and the trees are parsed as well.
+ * The revisions passed on the command line as "revision=id" must resolve to the commits with the identifiers.
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/filesystem/path.hpp>
+#include <content_digest.hpp>
+#include <git_objects.hpp>
+
+namespace {
+
+const char* const object_type_names[] = { "", "commit", "tree", "blob", "tag" };
+
+//! Reads the next object from the cat-file output. Returns \c false at the end of the output.
+bool read_batch_object(std::istream& strm, git_object_id& id, std::string& type, std::string& data)
+{
+    std::string id_str;
+    std::size_t size = 0u;
+    if (!(strm >> id_str))
+        return false;
+    if (!(strm >> type >> size) || strm.get() != '\n' || !from_hex_string(id_str, id))
+        BOOST_THROW_EXCEPTION(std::runtime_error("Invalid object list entry for object " + id_str));
+
+    data.resize(size);
+    if ((size > 0u && !strm.read(&data[0], size)) || strm.get() != '\n')
+        BOOST_THROW_EXCEPTION(std::runtime_error("Truncated object list entry for object " + id_str));
+    return true;
+}
+
+//! Compares the object read from the repository with the expected one
+bool check_object(git_object_store& store, git_object_id const& id, std::string const& type, std::string const& data)
+{
+    const std::string id_str = to_hex_string(id);
+    git_object obj;
+    if (!store.read_object(id, obj))
+    {
+        std::cerr << "FAILED: object " << id_str << " not found" << std::endl;
+        return false;
+    }
+
+    const char* obj_type = static_cast< std::size_t >(obj.type) < sizeof(object_type_names) / sizeof(*object_type_names) ? object_type_names[obj.type] : "";
+    if (type != obj_type || data != obj.data)
+    {
+        std::cerr << "FAILED: object " << id_str << ": read " << obj_type << " of " << obj.data.size() << " bytes, expected " << type
+            << " of " << data.size() << " bytes" << std::endl;
+        return false;
+    }
+
+    if (obj.type == git_commit_object)
+    {
+        git_commit commit;
+        parse_git_commit(obj.data, commit);
+        if (!store.read_object(commit.tree, obj) || obj.type != git_tree_object)
+        {
+            std::cerr << "FAILED: commit " << id_str << ": tree " << to_hex_string(commit.tree) << " not found" << std::endl;
+            return false;
+        }
+    }
+    else if (obj.type == git_tree_object)
+    {
+        std::vector< git_tree_entry > entries;
+        parse_git_tree(obj.data, entries);
+        if (entries.empty())
+        {
+            std::cerr << "FAILED: tree " << id_str << " has no entries" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//! Checks that the revision resolves to the commit
+bool check_revision(git_object_store& store, std::string const& arg)
+{
+    const std::size_t pos = arg.rfind('=');
+    git_object_id expected_id;
+    if (pos == std::string::npos || !from_hex_string(arg.substr(pos + 1u), expected_id))
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid revision argument: " + arg));
+
+    // Annotated tags resolve to the tag objects, so the commits are compared after following the tags
+    const std::string revision = arg.substr(0u, pos);
+    git_object commit, expected_commit;
+    store.read_object(store.resolve_revision(revision), git_commit_object, commit);
+    store.read_object(expected_id, git_commit_object, expected_commit);
+    if (commit.data != expected_commit.data)
+    {
+        std::cerr << "FAILED: revision " << revision << " does not resolve to " << to_hex_string(expected_id) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc < 3)
+        {
+            std::cout << "Usage: git-objects-test <git dir> <cat-file batch output> [revision=id...]" << std::endl;
+            return 1;
+        }
+
+        git_object_store store(argv[1]);
+        std::ifstream batch(argv[2], std::ios_base::in | std::ios_base::binary);
+        if (!batch.is_open())
+            BOOST_THROW_EXCEPTION(std::runtime_error(std::string("Failed to open file: ") + argv[2]));
+
+        std::size_t failures = 0u, object_count = 0u;
+        git_object_id id;
+        std::string type, data;
+        while (read_batch_object(batch, id, type, data))
+        {
+            ++object_count;
+            if (!check_object(store, id, type, data))
+                ++failures;
+        }
+
+        for (int i = 3; i < argc; ++i)
+        {
+            if (!check_revision(store, argv[i]))
+                ++failures;
+        }
+
+        std::cout << "Checked " << object_count << " objects and " << (argc - 3) << " revisions, " << failures << " failures" << std::endl;
+
+        return failures == 0u && object_count > 0u ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Failure: " << boost::diagnostic_information(e) << std::endl;
+        return 1;
+    }
+}
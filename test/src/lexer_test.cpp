@@ -0,0 +1,231 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This file contains implementation of the include directive lexer test and benchmark. The lexer is run over the files in the test data
+ * directory, which are the adversarial cases and a frozen snapshot of Boost headers, and over a generated corpus of the adversarial
+ * constructs. The extracted includes are checked against the golden results, which are stored next to the files in the ".golden" files,
+ * one include per line with the delimiters. The lexer throughput is reported for the snapshot and the generated corpus.
+ */
+
+#include <cstddef>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/chrono/duration.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <cxx_parser.hpp>
+
+namespace {
+
+//! A fragment of the generated corpus with the includes it contains
+struct corpus_fragment
+{
+    const char* text;
+    const char* includes[3];
+};
+
+//! The fragments of the generated corpus, which combine the constructs the lexer must not mistake for include directives
+const corpus_fragment corpus_fragments[] =
+{
+    { "// #include <commented_out.hpp>\n#include <a.hpp>\n", { "<a.hpp>" } },
+    { "/* #include <in_comment.hpp>\n*/ #include <b.hpp>\n", { "<b.hpp>" } },
+    { "// continued comment \\\n#include <in_comment.hpp>\n#include \"c.hpp\"\n", { "\"c.hpp\"" } },
+    { "int x = 1; \\\n#include <joined.hpp>\n#  include <d.hpp>\n", { "<d.hpp>" } },
+    { "const char* s = \"\\\" #include <in_string.hpp>\";\n#include <e.hpp>\n", { "<e.hpp>" } },
+    { "const char* s = \"line \\\n#include <in_string.hpp>\";\nchar c = '\\'';\n#include <f.hpp>\n", { "<f.hpp>" } },
+    { "const char* r = R\"x(\n)\"\n#include <in_raw_string.hpp>\n)x\";\n#include <g.hpp>\n", { "<g.hpp>" } },
+    { "int n = 1'000'000;\n\t#\tinclude <h.hpp>\n#include MACRO_INCLUDE\n", { "<h.hpp>" } },
+    { "#include <i.hpp> // trailing comment\n#include \"j.hpp\"\nint y; /* a\nmultiline comment */\n", { "<i.hpp>", "\"j.hpp\"" } },
+    { "template< typename T > struct k { typedef T type; }; // some code\n", { } }
+};
+
+const std::size_t corpus_fragment_count = sizeof(corpus_fragments) / sizeof(*corpus_fragments);
+
+//! Converts the line breaks to CRLF
+std::string to_crlf(std::string const& text)
+{
+    std::string result;
+    result.reserve(text.size() + text.size() / 16u);
+    for (std::string::const_iterator it = text.begin(), end = text.end(); it != end; ++it)
+    {
+        if (*it == '\n')
+            result.push_back('\r');
+        result.push_back(*it);
+    }
+    return result;
+}
+
+//! Generates the corpus of at least \a size bytes from the fragments, every other round of the fragments with CRLF line breaks
+void generate_corpus(std::size_t size, std::string& text, std::vector< std::string >& includes)
+{
+    std::vector< std::string > crlf_fragments;
+    for (std::size_t i = 0; i < corpus_fragment_count; ++i)
+        crlf_fragments.push_back(to_crlf(corpus_fragments[i].text));
+
+    for (std::size_t i = 0; text.size() < size; ++i)
+    {
+        const std::size_t fragment = i % corpus_fragment_count;
+        if ((i / corpus_fragment_count) % 2u == 0u)
+            text.append(corpus_fragments[fragment].text);
+        else
+            text.append(crlf_fragments[fragment]);
+
+        for (std::size_t j = 0; j < sizeof(corpus_fragments[fragment].includes) / sizeof(*corpus_fragments[fragment].includes) && corpus_fragments[fragment].includes[j]; ++j)
+            includes.push_back(corpus_fragments[fragment].includes[j]);
+    }
+}
+
+//! Runs the lexer and formats the extracted includes like in the golden files
+void extract_includes(std::string const& text, std::vector< std::string >& result)
+{
+    std::vector< cxx_include_directive > includes;
+    parse_cxx_includes(text, includes);
+    for (std::vector< cxx_include_directive >::const_iterator it = includes.begin(), end = includes.end(); it != end; ++it)
+    {
+        if (it->is_quoted)
+            result.push_back('"' + it->header + '"');
+        else
+            result.push_back('<' + it->header + '>');
+    }
+}
+
+std::string read_file(boost::filesystem::path const& path)
+{
+    std::ifstream file(path.string().c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to open file: " + path.string()));
+
+    return std::string(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
+}
+
+//! Reads the golden includes, one per line
+void read_golden(boost::filesystem::path const& path, std::vector< std::string >& includes)
+{
+    std::istringstream strm(read_file(path));
+    std::string line;
+    while (std::getline(strm, line))
+    {
+        if (!line.empty())
+            includes.push_back(line);
+    }
+}
+
+//! Compares the extracted includes with the expected ones and reports the first difference
+bool check_includes(std::string const& name, std::vector< std::string > const& includes, std::vector< std::string > const& expected)
+{
+    if (includes == expected)
+        return true;
+
+    std::pair< std::vector< std::string >::const_iterator, std::vector< std::string >::const_iterator > mismatch =
+        includes.size() <= expected.size() ?
+        std::mismatch(includes.begin(), includes.end(), expected.begin()) :
+        std::make_pair(includes.begin() + expected.size(), expected.end());
+
+    std::cerr << "FAILED: " << name << ": include " << (mismatch.first - includes.begin()) << ": extracted "
+        << (mismatch.first != includes.end() ? *mismatch.first : std::string("nothing")) << ", expected "
+        << (mismatch.second != expected.end() ? *mismatch.second : std::string("nothing")) << std::endl;
+    return false;
+}
+
+//! Runs the lexer over the text \a iterations times and returns the throughput, in MB/s
+double measure_throughput(std::vector< std::string > const& texts, unsigned int iterations)
+{
+    std::size_t total_size = 0u;
+    std::vector< cxx_include_directive > includes;
+    boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+    {
+        for (std::vector< std::string >::const_iterator it = texts.begin(), end = texts.end(); it != end; ++it)
+        {
+            includes.clear();
+            parse_cxx_includes(*it, includes);
+            total_size += it->size();
+        }
+    }
+    boost::chrono::duration< double > elapsed = boost::chrono::steady_clock::now() - start;
+
+    return elapsed.count() > 0.0 ? static_cast< double >(total_size) / (1024.0 * 1024.0) / elapsed.count() : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cout << "Usage: lexer-test <data dir> [corpus size, MiB] [iterations]" << std::endl;
+            return 1;
+        }
+
+        const boost::filesystem::path data_dir = argv[1];
+        const std::size_t corpus_size = (argc > 2 ? boost::lexical_cast< std::size_t >(argv[2]) : 4u) * 1024u * 1024u;
+        const unsigned int iterations = argc > 3 ? boost::lexical_cast< unsigned int >(argv[3]) : 4u;
+
+        // The data files are sorted, so the failures are reported in the same order on every run
+        std::vector< boost::filesystem::path > files;
+        for (boost::filesystem::recursive_directory_iterator it(data_dir), end; it != end; ++it)
+        {
+            if (boost::filesystem::is_regular_file(it->status()) && it->path().extension() != ".golden")
+                files.push_back(it->path());
+        }
+        std::sort(files.begin(), files.end());
+
+        std::size_t failures = 0u;
+        std::vector< std::string > snapshot_texts;
+        for (std::vector< boost::filesystem::path >::const_iterator it = files.begin(), end = files.end(); it != end; ++it)
+        {
+            boost::filesystem::path golden_file = *it;
+            golden_file += ".golden";
+            if (!boost::filesystem::exists(golden_file))
+                continue;
+
+            std::string text = read_file(*it);
+            std::vector< std::string > includes, expected;
+            extract_includes(text, includes);
+            read_golden(golden_file, expected);
+            if (!check_includes(it->string(), includes, expected))
+                ++failures;
+
+            snapshot_texts.push_back(text);
+        }
+
+        std::string corpus;
+        std::vector< std::string > corpus_expected;
+        generate_corpus(corpus_size, corpus, corpus_expected);
+        {
+            std::vector< std::string > includes;
+            extract_includes(corpus, includes);
+            if (!check_includes("generated corpus", includes, corpus_expected))
+                ++failures;
+        }
+
+        std::cout << "Checked " << snapshot_texts.size() << " files and " << corpus.size() << " bytes of generated corpus, " << failures << " failures" << std::endl;
+
+        std::cout << "Data files: " << measure_throughput(snapshot_texts, iterations * 64u) << " MB/s" << std::endl;
+        std::cout << "Generated corpus: " << measure_throughput(std::vector< std::string >(1u, corpus), iterations) << " MB/s" << std::endl;
+
+        return failures == 0u ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Failure: " << boost::diagnostic_information(e) << std::endl;
+        return 1;
+    }
+}
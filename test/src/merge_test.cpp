@@ -0,0 +1,206 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This file contains implementation of the tree merging test. A Boost-like tree is generated in the work directory and scanned in full
+ * and in shards. The trees of the shards are merged, directly and after writing them in the JSON and the compact JSON formats, and
+ * every merged tree must have the same nodes, dependencies and dependents as the full scan. The order of the dependencies is not compared,
+ * since it follows the order the nodes were created in.
+ */
+
+#include <cstddef>
+#include <set>
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <dep_tree.hpp>
+#include <filesystem_scanner.hpp>
+#include <json.hpp>
+
+namespace {
+
+//! The number of the generated libraries
+const unsigned int lib_count = 12u;
+//! The number of the headers in every library
+const unsigned int header_count = 20u;
+//! The numbers of shards the tree is scanned in
+const unsigned int shard_counts[] = { 2u, 3u, 7u };
+
+//! The dependencies and the dependents of a node, by path
+struct node_edges
+{
+    std::set< std::string > dependencies;
+    std::set< std::string > dependents;
+
+    bool operator== (node_edges const& that) const
+    {
+        return dependencies == that.dependencies && dependents == that.dependents;
+    }
+    bool operator!= (node_edges const& that) const { return !operator== (that); }
+};
+
+//! The tree contents, by node path
+typedef std::map< std::string, node_edges > tree_description;
+
+void write_file(boost::filesystem::path const& path, std::string const& content)
+{
+    boost::filesystem::create_directories(path.parent_path());
+    std::ofstream file(path.string().c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+    if (!file.is_open())
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to create file: " + path.string()));
+    file << content;
+}
+
+//! Generates the tree: every header includes a few headers of its own library and of the next libraries. Like in modular Boost, the includes are resolved through the symlinks in the boost directory.
+void generate_tree(boost::filesystem::path const& boost_root)
+{
+    boost::filesystem::remove_all(boost_root);
+    write_file(boost_root / "Jamroot", std::string());
+    boost::filesystem::create_directories(boost_root / "boost");
+
+    for (unsigned int lib = 0; lib < lib_count; ++lib)
+    {
+        const std::string lib_name = "lib" + boost::lexical_cast< std::string >(lib);
+        for (unsigned int header = 0; header < header_count; ++header)
+        {
+            std::ostringstream content;
+            content << "#ifndef " << lib_name << "_h" << header << "_hpp\n#define " << lib_name << "_h" << header << "_hpp\n";
+            const unsigned int steps[] = { 1u, 3u, 7u };
+            for (std::size_t i = 0; i < sizeof(steps) / sizeof(*steps); ++i)
+                content << "#include <boost/lib" << (lib + steps[i] / 3u) % lib_count << "/h" << (header * steps[i] + 1u) % header_count << ".hpp>\n";
+            content << "#include \"detail/impl" << header % 3u << ".hpp\"\n#endif\n";
+            write_file(boost_root / "libs" / lib_name / "include" / "boost" / lib_name / ("h" + boost::lexical_cast< std::string >(header) + ".hpp"), content.str());
+        }
+
+        for (unsigned int impl = 0; impl < 3u; ++impl)
+            write_file(boost_root / "libs" / lib_name / "include" / "boost" / lib_name / "detail" / ("impl" + boost::lexical_cast< std::string >(impl) + ".hpp"), "#include <vector>\n");
+        write_file(boost_root / "libs" / lib_name / "test" / "test.cpp", "#include <boost/" + lib_name + "/h0.hpp>\nint main() {}\n");
+
+        boost::filesystem::create_directory_symlink(boost::filesystem::path("..") / "libs" / lib_name / "include" / "boost" / lib_name, boost_root / "boost" / lib_name);
+    }
+}
+
+//! Collects the nodes of the tree and their edges
+void describe_tree(dep_node const& node, tree_description& description)
+{
+    node_edges& edges = description[node.get_path()];
+    for (dep_node::nodes::const_iterator it = node.get_dependencies().begin(), end = node.get_dependencies().end(); it != end; ++it)
+        edges.dependencies.insert((*it)->get_path());
+    for (dep_node::nodes::const_iterator it = node.get_dependents().begin(), end = node.get_dependents().end(); it != end; ++it)
+        edges.dependents.insert((*it)->get_path());
+
+    for (dep_node::node_set::const_iterator it = node.get_children().begin(), end = node.get_children().end(); it != end; ++it)
+        describe_tree(*it, description);
+}
+
+//! Compares the tree with the expected description and reports the first difference
+bool check_tree(std::string const& name, dep_tree const& root, tree_description const& expected)
+{
+    tree_description description;
+    describe_tree(root, description);
+    if (description == expected)
+        return true;
+
+    tree_description::const_iterator it = description.begin(), end = description.end(), expected_it = expected.begin(), expected_end = expected.end();
+    for (; it != end && expected_it != expected_end && it->first == expected_it->first && it->second == expected_it->second; ++it, ++expected_it)
+    {
+    }
+
+    std::cerr << "FAILED: " << name << ": ";
+    if (it == end || (expected_it != expected_end && expected_it->first < it->first))
+        std::cerr << "missing node \"" << expected_it->first << "\"";
+    else if (expected_it == expected_end || it->first < expected_it->first)
+        std::cerr << "unexpected node \"" << it->first << "\"";
+    else
+        std::cerr << "node \"" << it->first << "\" has " << it->second.dependencies.size() << " dependencies and " << it->second.dependents.size()
+            << " dependents, expected " << expected_it->second.dependencies.size() << " and " << expected_it->second.dependents.size();
+    std::cerr << std::endl;
+    return false;
+}
+
+//! Writes the tree in the JSON or the compact JSON format and reads it back
+void reread_tree(dep_tree const& root, bool compact, dep_tree& result)
+{
+    std::stringstream strm;
+    if (compact)
+        serialize_compact_json(root, strm);
+    else
+        serialize_json(root, strm);
+    parse_json(strm, result);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        if (argc < 2)
+        {
+            std::cout << "Usage: merge-test <work dir>" << std::endl;
+            return 1;
+        }
+
+        const boost::filesystem::path boost_root = boost::filesystem::system_complete(argv[1]) / "root";
+        generate_tree(boost_root);
+
+        scan_params params = scan_params::typical(boost_root);
+        params.create_reverse_dependencies = true;
+
+        tree_description expected;
+        {
+            dep_tree root;
+            scan_filesystem_tree(boost_root, params, root);
+            describe_tree(root, expected);
+        }
+
+        std::size_t failures = 0u;
+        for (std::size_t i = 0; i < sizeof(shard_counts) / sizeof(*shard_counts); ++i)
+        {
+            const std::string name = boost::lexical_cast< std::string >(shard_counts[i]) + " shards";
+            dep_tree merged, merged_json, merged_compact;
+            params.shard_count = shard_counts[i];
+            for (params.shard_index = 0u; params.shard_index < params.shard_count; ++params.shard_index)
+            {
+                dep_tree shard;
+                scan_filesystem_tree(boost_root, params, shard);
+                merge(merged, shard);
+
+                // The shard files are read into separate trees, like the merge command does
+                dep_tree shard_json, shard_compact;
+                reread_tree(shard, false, shard_json);
+                merge(merged_json, shard_json);
+                reread_tree(shard, true, shard_compact);
+                merge(merged_compact, shard_compact);
+            }
+
+            if (!check_tree(name, merged, expected))
+                ++failures;
+            if (!check_tree(name + ", json", merged_json, expected))
+                ++failures;
+            if (!check_tree(name + ", compact json", merged_compact, expected))
+                ++failures;
+        }
+
+        std::cout << "Checked " << expected.size() << " nodes, " << failures << " failures" << std::endl;
+
+        return failures == 0u ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Failure: " << boost::diagnostic_information(e) << std::endl;
+        return 1;
+    }
+}
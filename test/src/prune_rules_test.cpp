@@ -0,0 +1,175 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This file contains implementation of the prune rules test. Every case is a set of rules and a path, with the expected decision:
+ * whether the path is reached by scanning and, if it is, whether it is pruned. The path is matched at once with \c prune_rules::match
+ * and incrementally, one path component at a time, like the scanner descends the directories, and both must give the expected decision.
+ */
+
+#include <cstddef>
+#include <string>
+#include <iostream>
+#include <boost/utility/string_ref.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <prune_rules.hpp>
+
+namespace {
+
+//! The expected decision for a path
+enum decision
+{
+    //! The path is scanned
+    kept,
+    //! The path is reached, but pruned
+    pruned,
+    //! The path is within a directory that is pruned with everything within it
+    unreached
+};
+
+struct prune_case
+{
+    const char* rules[3];
+    const char* path;
+    decision expected;
+};
+
+const prune_case prune_cases[] =
+{
+    // A rule without separators matches the name at any depth
+    { { "test" }, "test", pruned },
+    { { "test" }, "libs/foo/test", pruned },
+    { { "test" }, "libs/foo/test/a.cpp", unreached },
+    { { "test" }, "libs/foo/tests", kept },
+    { { "test" }, "libs/foo/include/boost/foo.hpp", kept },
+    { { "*.txt" }, "libs/foo/CMakeLists.txt", pruned },
+    { { "*.txt" }, "libs/foo/txt", kept },
+
+    // A rule with separators is anchored at Boost root
+    { { "libs/*/doc" }, "libs/foo/doc", pruned },
+    { { "libs/*/doc" }, "libs/foo/doc/html/index.html", unreached },
+    { { "libs/*/doc" }, "libs/foo/bar/doc", kept },
+    { { "libs/*/doc" }, "doc", kept },
+    { { "libs/?/doc" }, "libs/a/doc", pruned },
+    { { "libs/?/doc" }, "libs/ab/doc", kept },
+
+    // "**" matches any number of components, including none
+    { { "libs/**/example" }, "libs/example", pruned },
+    { { "libs/**/example" }, "libs/foo/example", pruned },
+    { { "libs/**/example" }, "libs/foo/bar/baz/example", pruned },
+    { { "libs/**/example" }, "example", kept },
+    { { "libs/**/example" }, "tools/foo/example", kept },
+    { { "**/*.txt" }, "a.txt", pruned },
+    { { "**/*.txt" }, "libs/foo/doc/readme.txt", pruned },
+    { { "libs/foo/**" }, "libs/foo", pruned },
+    { { "libs/foo/**" }, "libs/foo/src/a.cpp", unreached },
+    { { "libs/foo/**" }, "libs/foobar/src/a.cpp", kept },
+
+    // Negations keep the paths within the pruned directories, the last matching rule wins
+    { { "test", "!libs/foo/test" }, "libs/foo/test", kept },
+    { { "test", "!libs/foo/test" }, "libs/foo/test/a.cpp", kept },
+    { { "test", "!libs/foo/test" }, "libs/bar/test", pruned },
+    { { "test", "!libs/foo/test" }, "libs/bar/test/a.cpp", unreached },
+    { { "!libs/foo/test", "test" }, "libs/foo/test", pruned },
+    { { "!libs/foo/test", "test" }, "libs/foo/test/a.cpp", unreached },
+    { { "libs/foo", "!libs/foo/include/**" }, "libs/foo", pruned },
+    { { "libs/foo", "!libs/foo/include/**" }, "libs/foo/include", kept },
+    { { "libs/foo", "!libs/foo/include/**" }, "libs/foo/include/boost/foo/a.hpp", kept },
+    { { "libs/foo", "!libs/foo/include/**" }, "libs/foo/src", pruned },
+    { { "libs/foo", "!libs/foo/include/**" }, "libs/foo/src/a.cpp", unreached },
+    { { "libs/**", "!*.hpp" }, "libs/foo/include/boost/foo.hpp", kept },
+    { { "libs/**", "!*.hpp" }, "libs/foo/include/boost/foo.ipp", pruned },
+    { { "*.cpp", "!libs/foo/**", "libs/foo/src" }, "libs/foo/src", pruned },
+    { { "*.cpp", "!libs/foo/**", "libs/foo/src" }, "libs/foo/src/a.cpp", kept },
+    { { "*.cpp", "!libs/foo/**", "libs/foo/src" }, "libs/foo/test/a.cpp", kept },
+    { { "*.cpp", "!libs/foo/**", "libs/foo/src" }, "libs/bar/test/a.cpp", pruned },
+
+    // Comments and empty rules are ignored
+    { { "# test", "" }, "test", kept }
+};
+
+const char* to_string(decision d)
+{
+    switch (d)
+    {
+    case kept:
+        return "kept";
+    case pruned:
+        return "pruned";
+    default:
+        return "unreached";
+    }
+}
+
+//! Matches the path at once
+decision match_path(prune_rules const& rules, boost::string_ref const& path)
+{
+    prune_rules::state s;
+    if (!rules.match(path, s))
+        return unreached;
+    return s.pruned ? pruned : kept;
+}
+
+//! Matches the path one component at a time, like the scanner does
+decision step_path(prune_rules const& rules, boost::string_ref path)
+{
+    prune_rules::state s, next;
+    rules.start(s);
+    while (true)
+    {
+        const std::size_t pos = path.find('/');
+        rules.step(s, path.substr(0, pos), next);
+        s = next;
+        if (pos == boost::string_ref::npos)
+            return s.pruned ? pruned : kept;
+
+        // The scanner does not descend into the directories that are pruned with everything within them
+        if (rules.is_subtree_pruned(s))
+            return unreached;
+        path.remove_prefix(pos + 1u);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    try
+    {
+        std::size_t failures = 0u;
+        const std::size_t case_count = sizeof(prune_cases) / sizeof(*prune_cases);
+        for (std::size_t i = 0; i < case_count; ++i)
+        {
+            prune_case const& c = prune_cases[i];
+            prune_rules rules;
+            std::string rule_list;
+            for (std::size_t j = 0; j < sizeof(c.rules) / sizeof(*c.rules) && c.rules[j]; ++j)
+            {
+                rules.add_rule(c.rules[j]);
+                if (j > 0u)
+                    rule_list += ", ";
+                rule_list += c.rules[j];
+            }
+
+            const decision matched = match_path(rules, c.path), stepped = step_path(rules, c.path);
+            if (matched != c.expected || stepped != c.expected)
+            {
+                std::cerr << "FAILED: rules [" << rule_list << "], path " << c.path << ": matched " << to_string(matched) << ", stepped "
+                    << to_string(stepped) << ", expected " << to_string(c.expected) << std::endl;
+                ++failures;
+            }
+        }
+
+        std::cout << "Checked " << case_count << " cases, " << failures << " failures" << std::endl;
+
+        return failures == 0u ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Failure: " << boost::diagnostic_information(e) << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,279 @@
+/*
+ *             Copyright Andrey Semashev 2014.
+ * Distributed under the Boost Software License, Version 1.0.
+ *    (See accompanying file LICENSE_1_0.txt or copy at
+ *          http://www.boost.org/LICENSE_1_0.txt)
+ */
+/*!
+ * This file contains implementation of the transitive reduction test. Pseudo-random graphs, with and without cycles, are reduced with
+ * one and with multiple threads. The reduced graph must be a subgraph of the original one with the same reachability between all vertices.
+ * For acyclic graphs, the reduction must also be minimal: no remaining edge is implied by the other edges. The reduction of the dependency
+ * tree is checked the same way, and the dependents must stay consistent with the reduced dependencies.
+ */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <dep_tree.hpp>
+#include <graph_algorithms.hpp>
+
+namespace {
+
+//! Graph generation parameters
+struct graph_case
+{
+    //! The number of vertex layers and vertices per layer. The edges go from a layer to the following layers.
+    std::size_t layer_count, layer_size;
+    //! The number of edges from every vertex
+    std::size_t edge_count;
+    //! The number of edges that go to the previous layers and create cycles
+    std::size_t back_edge_count;
+};
+
+const graph_case graph_cases[] =
+{
+    { 4u, 3u, 2u, 0u },
+    { 8u, 16u, 4u, 0u },
+    { 8u, 16u, 4u, 6u },
+    // Large layers are reduced in parallel
+    { 6u, 600u, 5u, 0u },
+    { 6u, 600u, 5u, 40u }
+};
+
+const unsigned int thread_counts[] = { 1u, 4u };
+
+//! Linear congruential generator, so that the graphs are the same on every platform
+class random_generator
+{
+private:
+    boost::uint64_t m_state;
+
+public:
+    explicit random_generator(boost::uint64_t seed) : m_state(seed) {}
+
+    std::size_t operator() (std::size_t bound)
+    {
+        m_state = m_state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast< std::size_t >((m_state >> 33) % bound);
+    }
+};
+
+//! Generates the graph with ordered edge lists without duplicates or self-loops
+void generate_graph(graph_case const& c, boost::uint64_t seed, adjacency_list& graph)
+{
+    random_generator random(seed);
+    const std::size_t vertex_count = c.layer_count * c.layer_size;
+    graph.assign(vertex_count, std::vector< std::size_t >());
+    for (std::size_t vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        std::vector< std::size_t >& edges = graph[vertex];
+        const std::size_t layer = vertex / c.layer_size;
+        if (layer + 1u < c.layer_count)
+        {
+            // Most edges go to the next layer, so that the other edges are often implied
+            for (std::size_t i = 0; i < c.edge_count; ++i)
+            {
+                const std::size_t target_layer = layer + 1u + (random(4u) == 0u ? random(c.layer_count - layer - 1u) : 0u);
+                edges.push_back(target_layer * c.layer_size + random(c.layer_size));
+            }
+        }
+        if (layer > 0u && random(vertex_count) < c.back_edge_count)
+            edges.push_back(random(layer * c.layer_size));
+
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+}
+
+//! Computes the vertices reachable from every vertex, through at least one edge
+void compute_reachability(adjacency_list const& graph, std::vector< std::vector< bool > >& reachable)
+{
+    const std::size_t vertex_count = graph.size();
+    reachable.assign(vertex_count, std::vector< bool >(vertex_count, false));
+    std::vector< std::size_t > stack;
+    for (std::size_t vertex = 0; vertex < vertex_count; ++vertex)
+    {
+        std::vector< bool >& visited = reachable[vertex];
+        stack.assign(graph[vertex].begin(), graph[vertex].end());
+        while (!stack.empty())
+        {
+            const std::size_t current = stack.back();
+            stack.pop_back();
+            if (visited[current])
+                continue;
+            visited[current] = true;
+            stack.insert(stack.end(), graph[current].begin(), graph[current].end());
+        }
+    }
+}
+
+//! Checks if \a to is reachable from \a from without using the direct edge between them
+bool is_reachable_indirectly(adjacency_list const& graph, std::size_t from, std::size_t to)
+{
+    std::vector< bool > visited(graph.size(), false);
+    std::vector< std::size_t > stack;
+    for (std::vector< std::size_t >::const_iterator it = graph[from].begin(), end = graph[from].end(); it != end; ++it)
+    {
+        if (*it != to)
+            stack.push_back(*it);
+    }
+
+    while (!stack.empty())
+    {
+        const std::size_t current = stack.back();
+        stack.pop_back();
+        if (current == to)
+            return true;
+        if (visited[current])
+            continue;
+        visited[current] = true;
+        stack.insert(stack.end(), graph[current].begin(), graph[current].end());
+    }
+    return false;
+}
+
+//! Checks the reduced graph against the original one
+bool check_reduction(std::string const& name, adjacency_list const& original, adjacency_list const& reduced, bool acyclic)
+{
+    for (std::size_t vertex = 0, n = original.size(); vertex < n; ++vertex)
+    {
+        if (!std::includes(original[vertex].begin(), original[vertex].end(), reduced[vertex].begin(), reduced[vertex].end()))
+        {
+            std::cerr << "FAILED: " << name << ": vertex " << vertex << " has edges that are not in the original graph" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector< std::vector< bool > > original_reachable, reduced_reachable;
+    compute_reachability(original, original_reachable);
+    compute_reachability(reduced, reduced_reachable);
+    for (std::size_t vertex = 0, n = original.size(); vertex < n; ++vertex)
+    {
+        if (original_reachable[vertex] != reduced_reachable[vertex])
+        {
+            std::cerr << "FAILED: " << name << ": the reachability from vertex " << vertex << " has changed" << std::endl;
+            return false;
+        }
+    }
+
+    if (acyclic)
+    {
+        for (std::size_t vertex = 0, n = reduced.size(); vertex < n; ++vertex)
+        {
+            for (std::vector< std::size_t >::const_iterator it = reduced[vertex].begin(), end = reduced[vertex].end(); it != end; ++it)
+            {
+                if (is_reachable_indirectly(reduced, vertex, *it))
+                {
+                    std::cerr << "FAILED: " << name << ": the edge " << vertex << " -> " << *it << " is implied by other edges" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//! Builds the tree with a node for every vertex and the dependencies for the edges
+void build_tree(adjacency_list const& graph, dep_tree& root, std::vector< dep_node* >& nodes)
+{
+    for (std::size_t vertex = 0, n = graph.size(); vertex < n; ++vertex)
+        nodes.push_back(root.add_nested_child("dir" + boost::lexical_cast< std::string >(vertex % 7u) + "/file" + boost::lexical_cast< std::string >(vertex)));
+
+    for (std::size_t vertex = 0, n = graph.size(); vertex < n; ++vertex)
+    {
+        for (std::vector< std::size_t >::const_iterator it = graph[vertex].begin(), end = graph[vertex].end(); it != end; ++it)
+            nodes[vertex]->add_dependency(nodes[*it]);
+    }
+    reconstruct_reverse_dependencies(root);
+}
+
+//! Reads the dependencies of the tree back as a graph. Returns \c false if the dependents are not consistent with the dependencies.
+bool read_tree(std::string const& name, std::vector< dep_node* > const& nodes, adjacency_list& graph)
+{
+    boost::unordered_map< dep_node const*, std::size_t > node_indices;
+    for (std::size_t vertex = 0, n = nodes.size(); vertex < n; ++vertex)
+        node_indices[nodes[vertex]] = vertex;
+
+    std::vector< std::size_t > dependent_counts(nodes.size(), 0u);
+    graph.assign(nodes.size(), std::vector< std::size_t >());
+    for (std::size_t vertex = 0, n = nodes.size(); vertex < n; ++vertex)
+    {
+        dep_node::nodes const& deps = nodes[vertex]->get_dependencies();
+        for (dep_node::nodes::const_iterator it = deps.begin(), end = deps.end(); it != end; ++it)
+        {
+            const std::size_t target = node_indices[*it];
+            dep_node::nodes const& rdeps = nodes[target]->get_dependents();
+            if (std::find(rdeps.begin(), rdeps.end(), nodes[vertex]) == rdeps.end())
+            {
+                std::cerr << "FAILED: " << name << ": vertex " << vertex << " is missing in the dependents of vertex " << target << std::endl;
+                return false;
+            }
+            graph[vertex].push_back(target);
+            ++dependent_counts[target];
+        }
+        std::sort(graph[vertex].begin(), graph[vertex].end());
+    }
+
+    for (std::size_t vertex = 0, n = nodes.size(); vertex < n; ++vertex)
+    {
+        if (nodes[vertex]->get_dependents().size() != dependent_counts[vertex])
+        {
+            std::cerr << "FAILED: " << name << ": vertex " << vertex << " has dependents that are not its dependencies" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    try
+    {
+        std::size_t failures = 0u, checks = 0u;
+        for (std::size_t i = 0; i < sizeof(graph_cases) / sizeof(*graph_cases); ++i)
+        {
+            graph_case const& c = graph_cases[i];
+            adjacency_list original;
+            generate_graph(c, i + 1u, original);
+
+            for (std::size_t j = 0; j < sizeof(thread_counts) / sizeof(*thread_counts); ++j)
+            {
+                const std::string name = "graph " + boost::lexical_cast< std::string >(i) + ", " + boost::lexical_cast< std::string >(thread_counts[j]) + " threads";
+
+                adjacency_list reduced = original;
+                reduce_transitive_edges(reduced, thread_counts[j]);
+                ++checks;
+                if (!check_reduction(name, original, reduced, c.back_edge_count == 0u))
+                    ++failures;
+
+                dep_tree root;
+                std::vector< dep_node* > nodes;
+                build_tree(original, root, nodes);
+                reduce_dependencies(root, thread_counts[j]);
+
+                adjacency_list reduced_tree;
+                ++checks;
+                if (!read_tree(name + ", tree", nodes, reduced_tree) || !check_reduction(name + ", tree", original, reduced_tree, c.back_edge_count == 0u))
+                    ++failures;
+            }
+        }
+
+        std::cout << "Checked " << checks << " reductions, " << failures << " failures" << std::endl;
+
+        return failures == 0u ? 0 : 1;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Failure: " << boost::diagnostic_information(e) << std::endl;
+        return 1;
+    }
+}